@@ -70,6 +70,10 @@ NK_API void                 nk_xfont_del(Display *dpy, XFont *font);
 #ifndef NK_X11_DOUBLE_CLICK_HI
 #define NK_X11_DOUBLE_CLICK_HI 200
 #endif
+/* Size in pixels of the square tiles that damage is tracked in */
+#ifndef NK_XLIB_TILE_SIZE
+#define NK_XLIB_TILE_SIZE 32
+#endif
 
 typedef struct XSurface XSurface;
 typedef struct XImageWithAlpha XImageWithAlpha;
@@ -80,6 +84,18 @@ struct XFont {
     XFontSet set;
     XFontStruct *xfont;
     struct nk_user_font handle;
+    /* Advance widths of the glyphs measured so far, so text can be measured
+     * without calling into Xlib. Single bytes are looked up directly, which
+     * covers ASCII for font sets and every glyph of a plain font, and other
+     * code points go in an open addressed hash table. Unknown is negative. */
+    float byte_advance[256];
+    nk_rune *glyph_runes;
+    float *glyph_advance;
+    int glyph_count;
+    int glyph_capacity;
+};
+struct nk_xsurf_box {
+    int x0, y0, x1, y1;
 };
 struct XSurface {
     GC gc;
@@ -88,6 +104,19 @@ struct XSurface {
     Window root;
     Drawable drawable;
     unsigned int w, h;
+    /* The drawable is a back buffer that only has the damaged tiles redrawn,
+     * found by comparing per-tile hashes of the commands with the last frame */
+    unsigned int tiles_x, tiles_y;
+    nk_uint *tile_hash;
+    nk_uint *prev_tile_hash;
+    nk_byte *damaged;
+    XRectangle *damage;
+    int damage_count;
+    int *runs;
+    XRectangle *clip;
+    nk_uint frame_hash;
+    int full_damage;
+    struct nk_xsurf_box expose;
 };
 struct XImageWithAlpha {
     XImage* ximage;
@@ -130,6 +159,32 @@ nk_color_from_byte(const nk_byte *c)
     return (res);
 }
 
+NK_INTERN void
+nk_xsurf_alloc_tiles(XSurface *surf)
+{
+    nk_size count;
+    free(surf->tile_hash);
+    free(surf->prev_tile_hash);
+    free(surf->damaged);
+    free(surf->damage);
+    free(surf->clip);
+    free(surf->runs);
+
+    surf->tiles_x = (surf->w + NK_XLIB_TILE_SIZE - 1) / NK_XLIB_TILE_SIZE;
+    surf->tiles_y = (surf->h + NK_XLIB_TILE_SIZE - 1) / NK_XLIB_TILE_SIZE;
+    count = NK_MAX((nk_size)surf->tiles_x * surf->tiles_y, 1);
+    surf->tile_hash = (nk_uint*)calloc(count, sizeof(nk_uint));
+    surf->prev_tile_hash = (nk_uint*)calloc(count, sizeof(nk_uint));
+    surf->damaged = (nk_byte*)calloc(count, sizeof(nk_byte));
+    surf->damage = (XRectangle*)calloc(count, sizeof(XRectangle));
+    surf->clip = (XRectangle*)calloc(count, sizeof(XRectangle));
+    surf->runs = (int*)calloc(2 * (surf->tiles_x + 1), sizeof(int));
+    surf->damage_count = 0;
+
+    /* A new pixmap starts out with undefined contents */
+    surf->full_damage = 1;
+}
+
 NK_INTERN XSurface*
 nk_xsurf_create(int screen, unsigned int w, unsigned int h)
 {
@@ -143,6 +198,7 @@ nk_xsurf_create(int screen, unsigned int w, unsigned int h)
     XSetLineAttributes(xlib.dpy, surface->gc, 1, LineSolid, CapButt, JoinMiter);
     surface->drawable = XCreatePixmap(xlib.dpy, xlib.root, w, h,
         (unsigned int)DefaultDepth(xlib.dpy, screen));
+    nk_xsurf_alloc_tiles(surface);
     return surface;
 }
 
@@ -155,17 +211,275 @@ nk_xsurf_resize(XSurface *surf, unsigned int w, unsigned int h)
     if(surf->drawable) XFreePixmap(surf->dpy, surf->drawable);
     surf->drawable = XCreatePixmap(surf->dpy, surf->root, w, h,
         (unsigned int)DefaultDepth(surf->dpy, surf->screen));
+    nk_xsurf_alloc_tiles(surf);
 }
 
 NK_INTERN void
-nk_xsurf_scissor(XSurface *surf, float x, float y, float w, float h)
+nk_xsurf_expose(XSurface *surf, int x, int y, int w, int h)
+{
+    /* The back buffer still holds the frame, it only has to be copied again */
+    struct nk_xsurf_box *e;
+    if (!surf || w <= 0 || h <= 0) return;
+    e = &surf->expose;
+    if (e->x0 >= e->x1 || e->y0 >= e->y1) {
+        e->x0 = x; e->y0 = y; e->x1 = x + w; e->y1 = y + h;
+    } else {
+        e->x0 = NK_MIN(e->x0, x); e->y0 = NK_MIN(e->y0, y);
+        e->x1 = NK_MAX(e->x1, x + w); e->y1 = NK_MAX(e->y1, y + h);
+    }
+}
+
+NK_INTERN int
+nk_xsurf_box_clip(struct nk_xsurf_box *box, const struct nk_xsurf_box *clip)
+{
+    box->x0 = NK_MAX(box->x0, clip->x0);
+    box->y0 = NK_MAX(box->y0, clip->y0);
+    box->x1 = NK_MIN(box->x1, clip->x1);
+    box->y1 = NK_MIN(box->y1, clip->y1);
+    return box->x0 < box->x1 && box->y0 < box->y1;
+}
+
+NK_INTERN void
+nk_xsurf_box_points(struct nk_xsurf_box *box, const struct nk_vec2i *pnts, int count)
+{
+    int i;
+    box->x0 = box->x1 = pnts[0].x;
+    box->y0 = box->y1 = pnts[0].y;
+    for (i = 1; i < count; ++i) {
+        box->x0 = NK_MIN(box->x0, pnts[i].x); box->x1 = NK_MAX(box->x1, pnts[i].x);
+        box->y0 = NK_MIN(box->y0, pnts[i].y); box->y1 = NK_MAX(box->y1, pnts[i].y);
+    }
+}
+
+NK_INTERN void
+nk_xsurf_scissor_box(XSurface *surf, const struct nk_command_scissor *s,
+    struct nk_xsurf_box *scissor)
+{
+    struct nk_xsurf_box bounds;
+    bounds.x0 = 0; bounds.y0 = 0;
+    bounds.x1 = (int)surf->w; bounds.y1 = (int)surf->h;
+
+    /* Matches the one pixel of slack that the clip rectangle is given */
+    scissor->x0 = s->x - 1;
+    scissor->y0 = s->y - 1;
+    scissor->x1 = s->x + s->w + 1;
+    scissor->y1 = s->y + s->h + 1;
+    if (!nk_xsurf_box_clip(scissor, &bounds))
+        scissor->x0 = scissor->y0 = scissor->x1 = scissor->y1 = 0;
+}
+
+NK_INTERN int
+nk_xsurf_command_box(const struct nk_command *cmd, const struct nk_xsurf_box *scissor,
+    struct nk_xsurf_box *box)
+{
+    /* Bounding box of everything a command can touch, clipped to the scissor */
+    int pad = 2;
+    switch (cmd->type) {
+    case NK_COMMAND_LINE: {
+        const struct nk_command_line *l = (const struct nk_command_line*)cmd;
+        box->x0 = NK_MIN(l->begin.x, l->end.x); box->x1 = NK_MAX(l->begin.x, l->end.x);
+        box->y0 = NK_MIN(l->begin.y, l->end.y); box->y1 = NK_MAX(l->begin.y, l->end.y);
+        pad += l->line_thickness;
+    } break;
+    case NK_COMMAND_RECT: {
+        const struct nk_command_rect *r = (const struct nk_command_rect*)cmd;
+        box->x0 = r->x; box->y0 = r->y; box->x1 = r->x + r->w; box->y1 = r->y + r->h;
+        pad += r->line_thickness;
+    } break;
+    case NK_COMMAND_RECT_FILLED: {
+        const struct nk_command_rect_filled *r = (const struct nk_command_rect_filled*)cmd;
+        box->x0 = r->x; box->y0 = r->y; box->x1 = r->x + r->w; box->y1 = r->y + r->h;
+    } break;
+    case NK_COMMAND_CIRCLE: {
+        const struct nk_command_circle *c = (const struct nk_command_circle*)cmd;
+        box->x0 = c->x; box->y0 = c->y; box->x1 = c->x + c->w; box->y1 = c->y + c->h;
+        pad += c->line_thickness;
+    } break;
+    case NK_COMMAND_CIRCLE_FILLED: {
+        const struct nk_command_circle_filled *c = (const struct nk_command_circle_filled*)cmd;
+        box->x0 = c->x; box->y0 = c->y; box->x1 = c->x + c->w; box->y1 = c->y + c->h;
+    } break;
+    case NK_COMMAND_TRIANGLE: {
+        const struct nk_command_triangle *t = (const struct nk_command_triangle*)cmd;
+        struct nk_vec2i pnts[3];
+        pnts[0] = t->a; pnts[1] = t->b; pnts[2] = t->c;
+        nk_xsurf_box_points(box, pnts, 3);
+        pad += t->line_thickness;
+    } break;
+    case NK_COMMAND_TRIANGLE_FILLED: {
+        const struct nk_command_triangle_filled *t = (const struct nk_command_triangle_filled*)cmd;
+        struct nk_vec2i pnts[3];
+        pnts[0] = t->a; pnts[1] = t->b; pnts[2] = t->c;
+        nk_xsurf_box_points(box, pnts, 3);
+    } break;
+    case NK_COMMAND_POLYGON: {
+        const struct nk_command_polygon *p = (const struct nk_command_polygon*)cmd;
+        if (!p->point_count) return 0;
+        nk_xsurf_box_points(box, p->points, p->point_count);
+        pad += p->line_thickness;
+    } break;
+    case NK_COMMAND_POLYGON_FILLED: {
+        const struct nk_command_polygon_filled *p = (const struct nk_command_polygon_filled*)cmd;
+        if (!p->point_count) return 0;
+        nk_xsurf_box_points(box, p->points, p->point_count);
+    } break;
+    case NK_COMMAND_POLYLINE: {
+        const struct nk_command_polyline *p = (const struct nk_command_polyline*)cmd;
+        if (!p->point_count) return 0;
+        nk_xsurf_box_points(box, p->points, p->point_count);
+        pad += p->line_thickness;
+    } break;
+    case NK_COMMAND_TEXT: {
+        const struct nk_command_text *t = (const struct nk_command_text*)cmd;
+        box->x0 = t->x; box->y0 = t->y; box->x1 = t->x + t->w; box->y1 = t->y + t->h;
+    } break;
+    case NK_COMMAND_CURVE: {
+        const struct nk_command_curve *q = (const struct nk_command_curve*)cmd;
+        struct nk_vec2i pnts[4];
+        pnts[0] = q->begin; pnts[1] = q->ctrl[0]; pnts[2] = q->ctrl[1]; pnts[3] = q->end;
+        nk_xsurf_box_points(box, pnts, 4);
+        pad += q->line_thickness;
+    } break;
+    case NK_COMMAND_IMAGE: {
+        const struct nk_command_image *i = (const struct nk_command_image*)cmd;
+        box->x0 = i->x; box->y0 = i->y; box->x1 = i->x + i->w; box->y1 = i->y + i->h;
+    } break;
+    default: return 0;
+    }
+    box->x0 -= pad; box->y0 -= pad;
+    box->x1 += pad; box->y1 += pad;
+    return nk_xsurf_box_clip(box, scissor);
+}
+
+NK_INTERN nk_uint
+nk_xsurf_command_hash(const struct nk_command *cmd, nk_uint seed)
+{
+    /* Hash what comes after the header, since the offset to the next command
+     * moves whenever anything earlier in the buffer changes size */
+    nk_size size;
+    switch (cmd->type) {
+    case NK_COMMAND_LINE: size = sizeof(struct nk_command_line); break;
+    case NK_COMMAND_RECT: size = sizeof(struct nk_command_rect); break;
+    case NK_COMMAND_RECT_FILLED: size = sizeof(struct nk_command_rect_filled); break;
+    case NK_COMMAND_CIRCLE: size = sizeof(struct nk_command_circle); break;
+    case NK_COMMAND_CIRCLE_FILLED: size = sizeof(struct nk_command_circle_filled); break;
+    case NK_COMMAND_TRIANGLE: size = sizeof(struct nk_command_triangle); break;
+    case NK_COMMAND_TRIANGLE_FILLED: size = sizeof(struct nk_command_triangle_filled); break;
+    case NK_COMMAND_POLYGON:
+        size = NK_OFFSETOF(struct nk_command_polygon, points) + sizeof(struct nk_vec2i) *
+            ((const struct nk_command_polygon*)cmd)->point_count; break;
+    case NK_COMMAND_POLYGON_FILLED:
+        size = NK_OFFSETOF(struct nk_command_polygon_filled, points) + sizeof(struct nk_vec2i) *
+            ((const struct nk_command_polygon_filled*)cmd)->point_count; break;
+    case NK_COMMAND_POLYLINE:
+        size = NK_OFFSETOF(struct nk_command_polyline, points) + sizeof(struct nk_vec2i) *
+            ((const struct nk_command_polyline*)cmd)->point_count; break;
+    case NK_COMMAND_TEXT:
+        size = NK_OFFSETOF(struct nk_command_text, string) +
+            (nk_size)((const struct nk_command_text*)cmd)->length; break;
+    case NK_COMMAND_CURVE: size = sizeof(struct nk_command_curve); break;
+    case NK_COMMAND_IMAGE: size = sizeof(struct nk_command_image); break;
+    default: return seed;
+    }
+    seed = (seed ^ (nk_uint)cmd->type) * 16777619u;
+    return nk_murmur_hash((const nk_byte*)cmd + sizeof(struct nk_command),
+        (int)(size - sizeof(struct nk_command)), seed);
+}
+
+NK_INTERN void
+nk_xsurf_hash_tiles(XSurface *surf, const struct nk_xsurf_box *box, nk_uint hash)
+{
+    unsigned int tx, ty;
+    unsigned int tx0 = (unsigned int)box->x0 / NK_XLIB_TILE_SIZE;
+    unsigned int ty0 = (unsigned int)box->y0 / NK_XLIB_TILE_SIZE;
+    unsigned int tx1 = (unsigned int)(box->x1 - 1) / NK_XLIB_TILE_SIZE;
+    unsigned int ty1 = (unsigned int)(box->y1 - 1) / NK_XLIB_TILE_SIZE;
+    for (ty = ty0; ty <= ty1; ++ty) {
+        nk_uint *row = &surf->tile_hash[ty * surf->tiles_x];
+        for (tx = tx0; tx <= tx1; ++tx)
+            row[tx] = (row[tx] ^ hash) * 16777619u;
+    }
+}
+
+NK_INTERN int
+nk_xsurf_box_damaged(const XSurface *surf, const struct nk_xsurf_box *box)
+{
+    unsigned int tx, ty;
+    unsigned int tx0 = (unsigned int)box->x0 / NK_XLIB_TILE_SIZE;
+    unsigned int ty0 = (unsigned int)box->y0 / NK_XLIB_TILE_SIZE;
+    unsigned int tx1 = (unsigned int)(box->x1 - 1) / NK_XLIB_TILE_SIZE;
+    unsigned int ty1 = (unsigned int)(box->y1 - 1) / NK_XLIB_TILE_SIZE;
+    for (ty = ty0; ty <= ty1; ++ty) {
+        const nk_byte *row = &surf->damaged[ty * surf->tiles_x];
+        for (tx = tx0; tx <= tx1; ++tx)
+            if (row[tx]) return 1;
+    }
+    return 0;
+}
+
+NK_INTERN void
+nk_xsurf_build_damage(XSurface *surf)
+{
+    /* Runs of damaged tiles in a row become rectangles, which are merged with
+     * an identical run in the row above when there is one */
+    unsigned int tx, ty, start;
+    int *above_runs = surf->runs, *row_runs = surf->runs + surf->tiles_x + 1, *swap;
+    int above_count = 0, row_count, i;
+    surf->damage_count = 0;
+    for (ty = 0; ty < surf->tiles_y; ++ty) {
+        const nk_byte *row = &surf->damaged[ty * surf->tiles_x];
+        row_count = 0;
+        for (tx = 0; tx < surf->tiles_x; ++tx) {
+            XRectangle r;
+            int merged = 0;
+            if (!row[tx]) continue;
+            start = tx;
+            while (tx + 1 < surf->tiles_x && row[tx + 1]) ++tx;
+
+            r.x = (short)(start * NK_XLIB_TILE_SIZE);
+            r.y = (short)(ty * NK_XLIB_TILE_SIZE);
+            r.width = (unsigned short)(NK_MIN((tx + 1) * NK_XLIB_TILE_SIZE, surf->w) - (unsigned int)r.x);
+            r.height = (unsigned short)(NK_MIN((ty + 1) * NK_XLIB_TILE_SIZE, surf->h) - (unsigned int)r.y);
+            for (i = 0; i < above_count; ++i) {
+                XRectangle *above = &surf->damage[above_runs[i]];
+                if (above->x == r.x && above->width == r.width) {
+                    above->height = (unsigned short)(above->height + r.height);
+                    row_runs[row_count++] = above_runs[i];
+                    merged = 1;
+                    break;
+                }
+            }
+            if (!merged) {
+                row_runs[row_count++] = surf->damage_count;
+                surf->damage[surf->damage_count++] = r;
+            }
+        }
+        swap = above_runs;
+        above_runs = row_runs;
+        row_runs = swap;
+        above_count = row_count;
+    }
+}
+
+NK_INTERN int
+nk_xsurf_scissor(XSurface *surf, const struct nk_xsurf_box *scissor)
 {
-    XRectangle clip_rect;
-    clip_rect.x = (short)(x-1);
-    clip_rect.y = (short)(y-1);
-    clip_rect.width = (unsigned short)(w+2);
-    clip_rect.height = (unsigned short)(h+2);
-    XSetClipRectangles(surf->dpy, surf->gc, 0, 0, &clip_rect, 1, Unsorted);
+    /* Clip to the parts of the scissor that are damaged */
+    int i, count = 0;
+    for (i = 0; i < surf->damage_count; ++i) {
+        const XRectangle *d = &surf->damage[i];
+        struct nk_xsurf_box box;
+        box.x0 = d->x; box.y0 = d->y;
+        box.x1 = d->x + d->width; box.y1 = d->y + d->height;
+        if (!nk_xsurf_box_clip(&box, scissor)) continue;
+        surf->clip[count].x = (short)box.x0;
+        surf->clip[count].y = (short)box.y0;
+        surf->clip[count].width = (unsigned short)(box.x1 - box.x0);
+        surf->clip[count].height = (unsigned short)(box.y1 - box.y0);
+        ++count;
+    }
+    XSetClipRectangles(surf->dpy, surf->gc, 0, 0, surf->clip, count, Unsorted);
+    return count;
 }
 
 NK_INTERN void
@@ -531,9 +845,22 @@ nk_xsurf_clear(XSurface *surf, unsigned long color)
 }
 
 NK_INTERN void
-nk_xsurf_blit(Drawable target, XSurface *surf, unsigned int w, unsigned int h)
+nk_xsurf_blit(Drawable target, XSurface *surf)
 {
-    XCopyArea(surf->dpy, surf->drawable, target, surf->gc, 0, 0, w, h, 0, 0);
+    /* Only the damaged and exposed parts of the window need the new pixels */
+    struct nk_xsurf_box *e = &surf->expose;
+    int i;
+    XSetClipMask(surf->dpy, surf->gc, None);
+    for (i = 0; i < surf->damage_count; ++i) {
+        const XRectangle *d = &surf->damage[i];
+        XCopyArea(surf->dpy, surf->drawable, target, surf->gc,
+            d->x, d->y, d->width, d->height, d->x, d->y);
+    }
+    if (e->x0 < e->x1 && e->y0 < e->y1)
+        XCopyArea(surf->dpy, surf->drawable, target, surf->gc, e->x0, e->y0,
+            (unsigned int)(e->x1 - e->x0), (unsigned int)(e->y1 - e->y0), e->x0, e->y0);
+    surf->damage_count = 0;
+    e->x0 = e->y0 = e->x1 = e->y1 = 0;
 }
 
 NK_INTERN void
@@ -541,6 +868,12 @@ nk_xsurf_del(XSurface *surf)
 {
     XFreePixmap(surf->dpy, surf->drawable);
     XFreeGC(surf->dpy, surf->gc);
+    free(surf->tile_hash);
+    free(surf->prev_tile_hash);
+    free(surf->damaged);
+    free(surf->damage);
+    free(surf->clip);
+    free(surf->runs);
     free(surf);
 }
 
@@ -550,6 +883,8 @@ nk_xfont_create(Display *dpy, const char *name)
     int n;
     char *def, **missing;
     XFont *font = (XFont*)calloc(1, sizeof(XFont));
+    for (n = 0; n < 256; ++n)
+        font->byte_advance[n] = -1.0f;
     font->set = XCreateFontSet(dpy, name, &missing, &n, &def);
     if(missing) {
         while(n--)
@@ -579,24 +914,109 @@ nk_xfont_create(Display *dpy, const char *name)
     return font;
 }
 
+NK_INTERN float
+nk_xfont_measure(XFont *font, const char *text, int len)
+{
+    XRectangle r;
+    if(font->set) {
+        XmbTextExtents(font->set, (const char*)text, len, NULL, &r);
+        return (float)r.width;
+    } else{
+        int w = XTextWidth(font->xfont, (const char*)text, len);
+        return (float)w;
+    }
+}
+
+NK_INTERN nk_uint
+nk_xfont_glyph_slot(const XFont *font, nk_rune rune)
+{
+    nk_uint mask = (nk_uint)font->glyph_capacity - 1;
+    nk_uint slot = (rune * 2654435761u) & mask;
+    while (font->glyph_runes[slot] && font->glyph_runes[slot] != rune)
+        slot = (slot + 1) & mask;
+    return slot;
+}
+
+NK_INTERN float
+nk_xfont_glyph_width(XFont *font, nk_rune rune, const char *glyph, int len)
+{
+    nk_uint slot;
+    float advance;
+
+    if (font->glyph_capacity) {
+        slot = nk_xfont_glyph_slot(font, rune);
+        if (font->glyph_runes[slot]) return font->glyph_advance[slot];
+    }
+
+    /* Grow the table once it is over half full */
+    if ((font->glyph_count + 1) * 2 > font->glyph_capacity) {
+        nk_rune *old_runes = font->glyph_runes;
+        float *old_advance = font->glyph_advance;
+        int i, old_capacity = font->glyph_capacity;
+        int capacity = old_capacity ? old_capacity * 2 : 256;
+        nk_rune *runes = (nk_rune*)calloc((nk_size)capacity, sizeof(nk_rune));
+        float *advances = (float*)calloc((nk_size)capacity, sizeof(float));
+        if (!runes || !advances) {
+            free(runes);
+            free(advances);
+            return nk_xfont_measure(font, glyph, len);
+        }
+        font->glyph_runes = runes;
+        font->glyph_advance = advances;
+        font->glyph_capacity = capacity;
+        for (i = 0; i < old_capacity; ++i) {
+            if (!old_runes[i]) continue;
+            slot = nk_xfont_glyph_slot(font, old_runes[i]);
+            font->glyph_runes[slot] = old_runes[i];
+            font->glyph_advance[slot] = old_advance[i];
+        }
+        free(old_runes);
+        free(old_advance);
+    }
+
+    advance = nk_xfont_measure(font, glyph, len);
+    slot = nk_xfont_glyph_slot(font, rune);
+    font->glyph_runes[slot] = rune;
+    font->glyph_advance[slot] = advance;
+    font->glyph_count++;
+    return advance;
+}
+
 NK_INTERN float
 nk_xfont_get_text_width(nk_handle handle, float height, const char *text, int len)
 {
     XFont *font = (XFont*)handle.ptr;
-    XRectangle r;
+    float width = 0;
+    int i = 0;
 
     NK_UNUSED(height);
 
     if(!font || !text)
         return 0;
 
-    if(font->set) {
-        XmbTextExtents(font->set, (const char*)text, len, NULL, &r);
-        return (float)r.width;
-    } else{
-        int w = XTextWidth(font->xfont, (const char*)text, len);
-        return (float)w;
+    /* Core fonts have no kerning, so a string is as wide as its glyphs */
+    while (i < len) {
+        nk_byte c = (nk_byte)text[i];
+        if (c < 0x80 || !font->set) {
+            if (font->byte_advance[c] < 0)
+                font->byte_advance[c] = nk_xfont_measure(font, &text[i], 1);
+            width += font->byte_advance[c];
+            i++;
+        } else {
+            nk_rune rune;
+            int glyph_len = nk_utf_decode(&text[i], &rune, len - i);
+            if (!glyph_len) {
+                /* Cut off in the middle of a character */
+                width += nk_xfont_measure(font, &text[i], len - i);
+                break;
+            }
+            if (rune == NK_UTF_INVALID)
+                width += nk_xfont_measure(font, &text[i], glyph_len);
+            else width += nk_xfont_glyph_width(font, rune, &text[i], glyph_len);
+            i += glyph_len;
+        }
     }
+    return width;
 }
 
 NK_API void
@@ -607,6 +1027,8 @@ nk_xfont_del(Display *dpy, XFont *font)
         XFreeFontSet(dpy, font->set);
     else
         XFreeFont(dpy, font->xfont);
+    free(font->glyph_runes);
+    free(font->glyph_advance);
     free(font);
 }
 
@@ -796,14 +1218,14 @@ nk_xlib_handle_event(Display *dpy, int screen, Window win, XEvent *evt)
             XWarpPointer(xlib.dpy, None, xlib.surf->root, 0, 0, 0, 0, (int)ctx->input.mouse.pos.x, (int)ctx->input.mouse.pos.y);
         }
         return 1;
-    } else if (evt->type == Expose || evt->type == ConfigureNotify) {
+    } else if (evt->type == ConfigureNotify) {
         /* Window resize handler */
-        unsigned int width, height;
-        XWindowAttributes attr;
-        XGetWindowAttributes(dpy, win, &attr);
-        width = (unsigned int)attr.width;
-        height = (unsigned int)attr.height;
-        nk_xsurf_resize(xlib.surf, width, height);
+        nk_xsurf_resize(xlib.surf, (unsigned int)evt->xconfigure.width,
+            (unsigned int)evt->xconfigure.height);
+        return 1;
+    } else if (evt->type == Expose) {
+        nk_xsurf_expose(xlib.surf, evt->xexpose.x, evt->xexpose.y,
+            evt->xexpose.width, evt->xexpose.height);
         return 1;
     } else if (evt->type == KeymapNotify) {
         XRefreshKeyboardMapping(&evt->xmapping);
@@ -881,16 +1303,67 @@ nk_xlib_render(Drawable screen, struct nk_color clear)
     const struct nk_command *cmd;
     struct nk_context *ctx = &xlib.ctx;
     XSurface *surf = xlib.surf;
+    struct nk_xsurf_box bounds, scissor, box;
+    nk_uint frame_hash, scissor_hash = 0, *swap;
+    nk_size i, count = (nk_size)surf->tiles_x * surf->tiles_y;
+    int clip_count;
+
+    bounds.x0 = 0; bounds.y0 = 0;
+    bounds.x1 = (int)surf->w; bounds.y1 = (int)surf->h;
+
+    /* Hash every command into the tiles it covers */
+    frame_hash = nk_murmur_hash(&clear, (int)sizeof(clear), 0);
+    for (i = 0; i < count; ++i)
+        surf->tile_hash[i] = frame_hash;
+    scissor = bounds;
+    nk_foreach(cmd, ctx)
+    {
+        nk_uint hash;
+        if (cmd->type == NK_COMMAND_SCISSOR) {
+            nk_xsurf_scissor_box(surf, (const struct nk_command_scissor*)cmd, &scissor);
+            scissor_hash = nk_murmur_hash(&scissor, (int)sizeof(scissor), 0);
+            continue;
+        }
+        if (!nk_xsurf_command_box(cmd, &scissor, &box)) continue;
+        hash = nk_xsurf_command_hash(cmd, scissor_hash);
+        frame_hash = (frame_hash ^ hash) * 16777619u;
+        nk_xsurf_hash_tiles(surf, &box, hash);
+    }
+
+    /* The back buffer already holds an identical frame */
+    if (!surf->full_damage && frame_hash == surf->frame_hash) {
+        nk_clear(ctx);
+        nk_xsurf_blit(screen, surf);
+        return;
+    }
 
-    nk_xsurf_clear(xlib.surf, nk_color_from_byte(&clear.r));
-    nk_foreach(cmd, &xlib.ctx)
+    /* Redraw the tiles that differ from the last frame */
+    for (i = 0; i < count; ++i)
+        surf->damaged[i] = (nk_byte)(surf->full_damage || surf->tile_hash[i] != surf->prev_tile_hash[i]);
+    swap = surf->prev_tile_hash;
+    surf->prev_tile_hash = surf->tile_hash;
+    surf->tile_hash = swap;
+    surf->frame_hash = frame_hash;
+    surf->full_damage = 0;
+    nk_xsurf_build_damage(surf);
+
+    scissor = bounds;
+    clip_count = nk_xsurf_scissor(surf, &scissor);
+    if (clip_count)
+        nk_xsurf_clear(xlib.surf, nk_color_from_byte(&clear.r));
+    nk_foreach(cmd, ctx)
     {
+        if (cmd->type == NK_COMMAND_SCISSOR) {
+            nk_xsurf_scissor_box(surf, (const struct nk_command_scissor*)cmd, &scissor);
+            clip_count = nk_xsurf_scissor(surf, &scissor);
+            continue;
+        }
+        if (!clip_count || !nk_xsurf_command_box(cmd, &scissor, &box) ||
+            !nk_xsurf_box_damaged(surf, &box))
+            continue;
+
         switch (cmd->type) {
         case NK_COMMAND_NOP: break;
-        case NK_COMMAND_SCISSOR: {
-            const struct nk_command_scissor *s =(const struct nk_command_scissor*)cmd;
-            nk_xsurf_scissor(surf, s->x, s->y, s->w, s->h);
-        } break;
         case NK_COMMAND_LINE: {
             const struct nk_command_line *l = (const struct nk_command_line *)cmd;
             nk_xsurf_stroke_line(surf, l->begin.x, l->begin.y, l->end.x,
@@ -952,6 +1425,7 @@ nk_xlib_render(Drawable screen, struct nk_color clear)
         case NK_COMMAND_IMAGE: {
             const struct nk_command_image *i = (const struct nk_command_image *)cmd;
             nk_xsurf_draw_image(surf, i->x, i->y, i->w, i->h, i->img, i->col);
+            nk_xsurf_scissor(surf, &scissor);
         } break;
         case NK_COMMAND_RECT_MULTI_COLOR:
         case NK_COMMAND_ARC:
@@ -961,6 +1435,6 @@ nk_xlib_render(Drawable screen, struct nk_color clear)
         }
     }
     nk_clear(ctx);
-    nk_xsurf_blit(screen, surf, surf->w, surf->h);
+    nk_xsurf_blit(screen, surf);
 }
 #endif
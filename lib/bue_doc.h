@@ -0,0 +1,864 @@
+/******************************************************************************
+ * bue_doc -- The document model behind the markdown editor. The text is a    *
+ *            piece table: runs of immutable text kept in a balanced tree     *
+ *            that also counts bytes and newlines, so that edits and line     *
+ *            lookups anywhere in the document take O(log n). Nodes are       *
+ *            reference counted and copied on write, which makes a snapshot   *
+ *            of the whole document as cheap as taking a reference.           *
+ *                                                                            *
+ * Author: 7B Industries                                                      *
+ * License: Apache 2.0                                                        *
+ *                                                                            *
+ * ***************************************************************************/
+
+#include <stdatomic.h>
+#include <sys/stat.h>
+
+// The size of the blocks that typed text is appended to
+#define DOC_BLOCK_SIZE 65536
+
+// The longest a piece can be, since finding a line inside of a piece means scanning it
+#define DOC_PIECE_MAX 4096
+
+/*
+ * A block of text that pieces point into. Bytes are only ever appended to a
+ * block, so a piece never sees its text change.
+ */
+struct doc_block {
+    atomic_int refs;
+    size_t used;  // The number of bytes that have been written
+    size_t size;  // The number of bytes the block can hold
+    char data[];
+};
+
+/*
+ * A piece of the document, and the root of a treap of the pieces around it.
+ * A node with more than one reference is shared with a snapshot and is
+ * copied before it is changed.
+ */
+struct doc_node {
+    atomic_int refs;
+    uint32_t priority;  // Random heap priority that keeps the tree balanced
+    struct doc_node* left;  // Pieces before this one
+    struct doc_node* right;  // Pieces after this one
+    struct doc_block* block;  // The block the text lives in
+    const char* text;  // The first byte of the piece
+    size_t len;  // The number of bytes in the piece
+    size_t lines;  // The number of newlines in the piece
+    size_t total_len;  // Bytes in the whole subtree
+    size_t total_lines;  // Newlines in the whole subtree
+};
+
+typedef struct document document;
+struct document {
+    struct doc_node* root;  // The pieces of the document, NULL when it is empty
+    struct doc_block* add;  // The block that inserted text is appended to
+    uint32_t seed;  // State of the generator for node priorities
+};
+
+// Called with each span of text in order, returning false to stop early
+typedef bool (*doc_span_fn)(const char* text, size_t len, void* arg);
+
+/******************************************************************************
+ * doc_block_new -- Allocates a block for text to be written to.              *
+ *                                                                            *
+ * Parameters                                                                 *
+ *      size -- The number of bytes the block needs to hold.                  *
+ *                                                                            *
+ * Returns                                                                    *
+ *      The new block with one reference.                                     *
+ *****************************************************************************/
+struct doc_block* doc_block_new(size_t size) {
+    struct doc_block* block = malloc(sizeof(struct doc_block) + (size > 0 ? size : 1));
+    if (block == NULL) {
+        printf("Unable to allocate memory for the document.\n");
+        exit(EXIT_FAILURE);
+    }
+
+    atomic_init(&block->refs, 1);
+    block->used = 0;
+    block->size = size;
+
+    return block;
+}
+
+/******************************************************************************
+ * doc_block_release -- Drops a reference to a block, freeing it when it was  *
+ *                      the last one.                                         *
+ *                                                                            *
+ * Parameters                                                                 *
+ *      block -- The block to release, which may be NULL.                     *
+ *                                                                            *
+ * Returns                                                                    *
+ *      Nothing                                                               *
+ *****************************************************************************/
+void doc_block_release(struct doc_block* block) {
+    if (block != NULL && atomic_fetch_sub(&block->refs, 1) == 1)
+        free(block);
+}
+
+/******************************************************************************
+ * doc_count_lines -- Counts the newlines in a span of text.                  *
+ *                                                                            *
+ * Parameters                                                                 *
+ *      text -- The text to count in.                                         *
+ *      len -- The number of bytes of text.                                   *
+ *                                                                            *
+ * Returns                                                                    *
+ *      The number of newlines.                                               *
+ *****************************************************************************/
+size_t doc_count_lines(const char* text, size_t len) {
+    size_t lines = 0;
+    const char* end = text + len;
+
+    while (text < end && (text = memchr(text, '\n', end - text)) != NULL) {
+        lines++;
+        text++;
+    }
+
+    return lines;
+}
+
+/******************************************************************************
+ * doc_node_update -- Recomputes a node's subtree totals from its children.   *
+ *                                                                            *
+ * Parameters                                                                 *
+ *      node -- The node to update.                                           *
+ *                                                                            *
+ * Returns                                                                    *
+ *      Nothing                                                               *
+ *****************************************************************************/
+void doc_node_update(struct doc_node* node) {
+    node->total_len = node->len;
+    node->total_lines = node->lines;
+
+    if (node->left != NULL) {
+        node->total_len += node->left->total_len;
+        node->total_lines += node->left->total_lines;
+    }
+    if (node->right != NULL) {
+        node->total_len += node->right->total_len;
+        node->total_lines += node->right->total_lines;
+    }
+}
+
+/******************************************************************************
+ * doc_node_new -- Creates a piece pointing at text in a block.               *
+ *                                                                            *
+ * Parameters                                                                 *
+ *      doc -- The document, used for the node's priority.                    *
+ *      block -- The block holding the text, which gains a reference.         *
+ *      text -- The first byte of the piece.                                  *
+ *      len -- The number of bytes in the piece.                              *
+ *                                                                            *
+ * Returns                                                                    *
+ *      The new node with one reference.                                      *
+ *****************************************************************************/
+struct doc_node* doc_node_new(document* doc, struct doc_block* block, const char* text, size_t len) {
+    struct doc_node* node = malloc(sizeof(struct doc_node));
+    if (node == NULL) {
+        printf("Unable to allocate memory for the document.\n");
+        exit(EXIT_FAILURE);
+    }
+
+    // xorshift32 is plenty for keeping the tree balanced
+    doc->seed ^= doc->seed << 13;
+    doc->seed ^= doc->seed >> 17;
+    doc->seed ^= doc->seed << 5;
+
+    atomic_init(&node->refs, 1);
+    node->priority = doc->seed;
+    node->left = NULL;
+    node->right = NULL;
+    node->block = block;
+    atomic_fetch_add(&block->refs, 1);
+    node->text = text;
+    node->len = len;
+    node->lines = doc_count_lines(text, len);
+    doc_node_update(node);
+
+    return node;
+}
+
+/******************************************************************************
+ * doc_node_retain -- Takes another reference to a node.                      *
+ *                                                                            *
+ * Parameters                                                                 *
+ *      node -- The node, which may be NULL.                                  *
+ *                                                                            *
+ * Returns                                                                    *
+ *      The same node.                                                        *
+ *****************************************************************************/
+struct doc_node* doc_node_retain(struct doc_node* node) {
+    if (node != NULL)
+        atomic_fetch_add(&node->refs, 1);
+
+    return node;
+}
+
+/******************************************************************************
+ * doc_node_release -- Drops a reference to a node, freeing it and releasing  *
+ *                     its children when it was the last one.                 *
+ *                                                                            *
+ * Parameters                                                                 *
+ *      node -- The node to release, which may be NULL.                       *
+ *                                                                            *
+ * Returns                                                                    *
+ *      Nothing                                                               *
+ *****************************************************************************/
+void doc_node_release(struct doc_node* node) {
+    while (node != NULL && atomic_fetch_sub(&node->refs, 1) == 1) {
+        struct doc_node* right = node->right;
+        doc_node_release(node->left);
+        doc_block_release(node->block);
+        free(node);
+
+        // Loop down the right side rather than recursing
+        node = right;
+    }
+}
+
+/******************************************************************************
+ * doc_node_mutable -- Makes sure that a node is not shared before changing   *
+ *                     it, copying it when it is.                             *
+ *                                                                            *
+ * Parameters                                                                 *
+ *      node -- The node, whose reference is handed over.                     *
+ *                                                                            *
+ * Returns                                                                    *
+ *      A node with the same contents that the caller owns outright.          *
+ *****************************************************************************/
+struct doc_node* doc_node_mutable(struct doc_node* node) {
+    if (atomic_load(&node->refs) == 1)
+        return node;
+
+    struct doc_node* copy = malloc(sizeof(struct doc_node));
+    if (copy == NULL) {
+        printf("Unable to allocate memory for the document.\n");
+        exit(EXIT_FAILURE);
+    }
+
+    *copy = *node;
+    atomic_init(&copy->refs, 1);
+    doc_node_retain(copy->left);
+    doc_node_retain(copy->right);
+    atomic_fetch_add(&copy->block->refs, 1);
+    doc_node_release(node);
+
+    return copy;
+}
+
+/******************************************************************************
+ * doc_merge -- Joins two trees, with every piece of the first coming before  *
+ *              every piece of the second.                                    *
+ *                                                                            *
+ * Parameters                                                                 *
+ *      left -- The first tree, whose reference is handed over.               *
+ *      right -- The second tree, whose reference is handed over.             *
+ *                                                                            *
+ * Returns                                                                    *
+ *      The joined tree.                                                      *
+ *****************************************************************************/
+struct doc_node* doc_merge(struct doc_node* left, struct doc_node* right) {
+    if (left == NULL) return right;
+    if (right == NULL) return left;
+
+    if (left->priority > right->priority) {
+        left = doc_node_mutable(left);
+        left->right = doc_merge(left->right, right);
+        doc_node_update(left);
+        return left;
+    }
+
+    right = doc_node_mutable(right);
+    right->left = doc_merge(left, right->left);
+    doc_node_update(right);
+    return right;
+}
+
+/******************************************************************************
+ * doc_split -- Splits a tree in two at a byte offset, cutting a piece in     *
+ *              half when the offset falls inside of it.                      *
+ *                                                                            *
+ * Parameters                                                                 *
+ *      doc -- The document, used to create new pieces.                       *
+ *      node -- The tree to split, whose reference is handed over.            *
+ *      offset -- The number of bytes that go to the left tree.               *
+ *      left -- Set to the tree of the text before the offset.                *
+ *      right -- Set to the tree of the text from the offset on.              *
+ *                                                                            *
+ * Returns                                                                    *
+ *      Nothing                                                               *
+ *****************************************************************************/
+void doc_split(document* doc, struct doc_node* node, size_t offset, struct doc_node** left, struct doc_node** right) {
+    if (node == NULL) {
+        *left = NULL;
+        *right = NULL;
+        return;
+    }
+
+    node = doc_node_mutable(node);
+    size_t left_len = node->left != NULL ? node->left->total_len : 0;
+
+    if (offset <= left_len) {
+        doc_split(doc, node->left, offset, left, &node->left);
+        doc_node_update(node);
+        *right = node;
+    }
+    else if (offset >= left_len + node->len) {
+        doc_split(doc, node->right, offset - left_len - node->len, &node->right, right);
+        doc_node_update(node);
+        *left = node;
+    }
+    else {
+        // The offset is inside of this piece, so the rest of it becomes a new piece
+        size_t cut = offset - left_len;
+        struct doc_node* rest = doc_node_new(doc, node->block, node->text + cut, node->len - cut);
+        struct doc_node* after = node->right;
+
+        node->len = cut;
+        node->lines -= rest->lines;
+        node->right = NULL;
+        doc_node_update(node);
+
+        *left = node;
+        *right = doc_merge(rest, after);
+    }
+}
+
+/******************************************************************************
+ * doc_grow_last -- Extends the last piece of a tree over bytes that were     *
+ *                  just appended to its block.                               *
+ *                                                                            *
+ * Parameters                                                                 *
+ *      node -- The tree, whose reference is handed over.                     *
+ *      len -- The number of bytes to add to the piece.                       *
+ *      lines -- The number of newlines in those bytes.                       *
+ *                                                                            *
+ * Returns                                                                    *
+ *      The updated tree.                                                     *
+ *****************************************************************************/
+struct doc_node* doc_grow_last(struct doc_node* node, size_t len, size_t lines) {
+    node = doc_node_mutable(node);
+
+    if (node->right != NULL) {
+        node->right = doc_grow_last(node->right, len, lines);
+    }
+    else {
+        node->len += len;
+        node->lines += lines;
+    }
+    doc_node_update(node);
+
+    return node;
+}
+
+/******************************************************************************
+ * doc_last_piece -- Finds the last piece of a tree.                          *
+ *                                                                            *
+ * Parameters                                                                 *
+ *      node -- The tree.                                                     *
+ *                                                                            *
+ * Returns                                                                    *
+ *      The last node, or NULL if the tree is empty.                          *
+ *****************************************************************************/
+const struct doc_node* doc_last_piece(const struct doc_node* node) {
+    while (node != NULL && node->right != NULL)
+        node = node->right;
+
+    return node;
+}
+
+/******************************************************************************
+ * doc_pieces -- Builds a tree for a run of text in a block, cut into pieces  *
+ *               no longer than DOC_PIECE_MAX so that line lookups stay fast. *
+ *                                                                            *
+ * Parameters                                                                 *
+ *      doc -- The document the tree is for.                                  *
+ *      block -- The block holding the text.                                  *
+ *      text -- The first byte of the text.                                   *
+ *      len -- The number of bytes of text.                                   *
+ *                                                                            *
+ * Returns                                                                    *
+ *      The tree, or NULL if there is no text.                                *
+ *****************************************************************************/
+struct doc_node* doc_pieces(document* doc, struct doc_block* block, const char* text, size_t len) {
+    struct doc_node* tree = NULL;
+
+    for (size_t offset = 0; offset < len; offset += DOC_PIECE_MAX) {
+        size_t piece_len = len - offset < DOC_PIECE_MAX ? len - offset : DOC_PIECE_MAX;
+        tree = doc_merge(tree, doc_node_new(doc, block, text + offset, piece_len));
+    }
+
+    return tree;
+}
+
+/******************************************************************************
+ * doc_init -- Sets up an empty document.                                     *
+ *                                                                            *
+ * Parameters                                                                 *
+ *      doc -- The document to set up.                                        *
+ *                                                                            *
+ * Returns                                                                    *
+ *      Nothing                                                               *
+ *****************************************************************************/
+void doc_init(document* doc) {
+    doc->root = NULL;
+    doc->add = NULL;
+    doc->seed = 2463534242u;
+}
+
+/******************************************************************************
+ * doc_free -- Releases a document's pieces. Snapshots taken from it stay     *
+ *             valid until they are released.                                 *
+ *                                                                            *
+ * Parameters                                                                 *
+ *      doc -- The document to free.                                          *
+ *                                                                            *
+ * Returns                                                                    *
+ *      Nothing                                                               *
+ *****************************************************************************/
+void doc_free(document* doc) {
+    doc_node_release(doc->root);
+    doc_block_release(doc->add);
+    doc->root = NULL;
+    doc->add = NULL;
+}
+
+/******************************************************************************
+ * doc_length -- Gets the number of bytes in a document or snapshot.          *
+ *                                                                            *
+ * Parameters                                                                 *
+ *      root -- The root of the document's tree.                              *
+ *                                                                            *
+ * Returns                                                                    *
+ *      The length of the text in bytes.                                      *
+ *****************************************************************************/
+size_t doc_length(const struct doc_node* root) {
+    return root != NULL ? root->total_len : 0;
+}
+
+/******************************************************************************
+ * doc_line_count -- Gets the number of lines in a document or snapshot.      *
+ *                   An empty document, or one ending in a newline, still     *
+ *                   has a last line with nothing on it.                      *
+ *                                                                            *
+ * Parameters                                                                 *
+ *      root -- The root of the document's tree.                              *
+ *                                                                            *
+ * Returns                                                                    *
+ *      The number of lines.                                                  *
+ *****************************************************************************/
+size_t doc_line_count(const struct doc_node* root) {
+    return (root != NULL ? root->total_lines : 0) + 1;
+}
+
+/******************************************************************************
+ * doc_insert -- Inserts text into a document.                                *
+ *                                                                            *
+ * Parameters                                                                 *
+ *      doc -- The document to insert into.                                   *
+ *      offset -- The byte offset to insert the text at.                      *
+ *      text -- The text to insert.                                           *
+ *      len -- The number of bytes to insert.                                 *
+ *                                                                            *
+ * Returns                                                                    *
+ *      Nothing                                                               *
+ *****************************************************************************/
+void doc_insert(document* doc, size_t offset, const char* text, size_t len) {
+    if (len == 0)
+        return;
+    if (offset > doc_length(doc->root))
+        offset = doc_length(doc->root);
+
+    // Start a new block when the text will not fit in the current one
+    if (doc->add == NULL || doc->add->size - doc->add->used < len) {
+        doc_block_release(doc->add);
+        doc->add = doc_block_new(len > DOC_BLOCK_SIZE ? len : DOC_BLOCK_SIZE);
+    }
+
+    char* dest = doc->add->data + doc->add->used;
+    memcpy(dest, text, len);
+
+    struct doc_node* left;
+    struct doc_node* right;
+    doc_split(doc, doc->root, offset, &left, &right);
+
+    // Typing appends right after the previous insert, so the piece before can just grow
+    const struct doc_node* last = doc_last_piece(left);
+    if (last != NULL && last->block == doc->add && last->text + last->len == dest && last->len + len <= DOC_PIECE_MAX)
+        left = doc_grow_last(left, len, doc_count_lines(text, len));
+    else
+        left = doc_merge(left, doc_pieces(doc, doc->add, dest, len));
+    doc->add->used += len;
+
+    doc->root = doc_merge(left, right);
+}
+
+/******************************************************************************
+ * doc_delete -- Removes a range of text from a document.                     *
+ *                                                                            *
+ * Parameters                                                                 *
+ *      doc -- The document to delete from.                                   *
+ *      offset -- The byte offset of the first byte to remove.                *
+ *      len -- The number of bytes to remove.                                 *
+ *                                                                            *
+ * Returns                                                                    *
+ *      Nothing                                                               *
+ *****************************************************************************/
+void doc_delete(document* doc, size_t offset, size_t len) {
+    size_t length = doc_length(doc->root);
+    if (offset >= length || len == 0)
+        return;
+    if (len > length - offset)
+        len = length - offset;
+
+    struct doc_node* left;
+    struct doc_node* middle;
+    struct doc_node* right;
+    doc_split(doc, doc->root, offset, &left, &right);
+    doc_split(doc, right, len, &middle, &right);
+    doc_node_release(middle);
+
+    doc->root = doc_merge(left, right);
+}
+
+/******************************************************************************
+ * doc_snapshot -- Takes an immutable snapshot of a document. Later edits to  *
+ *                 the document do not change it, and it can be read from     *
+ *                 another thread.                                            *
+ *                                                                            *
+ * Parameters                                                                 *
+ *      doc -- The document.                                                  *
+ *                                                                            *
+ * Returns                                                                    *
+ *      The root of the snapshot, to be released with doc_node_release.       *
+ *****************************************************************************/
+struct doc_node* doc_snapshot(document* doc) {
+    return doc_node_retain(doc->root);
+}
+
+/******************************************************************************
+ * doc_restore -- Replaces the text of a document with a snapshot.            *
+ *                                                                            *
+ * Parameters                                                                 *
+ *      doc -- The document.                                                  *
+ *      snapshot -- The snapshot to restore, whose reference is handed over.  *
+ *                                                                            *
+ * Returns                                                                    *
+ *      Nothing                                                               *
+ *****************************************************************************/
+void doc_restore(document* doc, struct doc_node* snapshot) {
+    doc_node_release(doc->root);
+    doc->root = snapshot;
+}
+
+/******************************************************************************
+ * doc_set_text -- Replaces the text of a document with a copy of a string.   *
+ *                                                                            *
+ * Parameters                                                                 *
+ *      doc -- The document.                                                  *
+ *      text -- The new text, which can be NULL when len is zero.             *
+ *      len -- The number of bytes of text.                                   *
+ *                                                                            *
+ * Returns                                                                    *
+ *      Nothing                                                               *
+ *****************************************************************************/
+void doc_set_text(document* doc, const char* text, size_t len) {
+    doc_node_release(doc->root);
+    doc->root = NULL;
+    if (len == 0)
+        return;
+
+    struct doc_block* block = doc_block_new(len);
+    memcpy(block->data, text, len);
+    block->used = len;
+    doc->root = doc_pieces(doc, block, block->data, len);
+    doc_block_release(block);
+}
+
+/******************************************************************************
+ * doc_load_file -- Replaces the text of a document with the contents of a    *
+ *                  file. The file is read straight into a block of its own   *
+ *                  size and the pieces point into it, so loading costs one   *
+ *                  read no matter how many lines there are.                  *
+ *                                                                            *
+ * Parameters                                                                 *
+ *      doc -- The document.                                                  *
+ *      path -- The path to the file to read.                                 *
+ *                                                                            *
+ * Returns                                                                    *
+ *      A boolean specifying whether or not the file could be read. The       *
+ *      document is left alone when it could not be.                          *
+ *****************************************************************************/
+bool doc_load_file(document* doc, const char* path) {
+    int fd = open(path, O_RDONLY | O_CLOEXEC);
+    if (fd < 0)
+        return false;
+
+    struct stat info;
+    if (fstat(fd, &info) != 0) {
+        close(fd);
+        return false;
+    }
+
+    // One spare byte shows whether the file grew since it was measured
+    struct doc_block* block = doc_block_new((size_t)info.st_size + 1);
+    bool ok = true;
+    while (ok) {
+        if (block->used == block->size) {
+            struct doc_block* bigger = doc_block_new(block->size * 2);
+            memcpy(bigger->data, block->data, block->used);
+            bigger->used = block->used;
+            doc_block_release(block);
+            block = bigger;
+        }
+
+        ssize_t read_size = read(fd, block->data + block->used, block->size - block->used);
+        if (read_size < 0 && errno == EINTR)
+            continue;
+        if (read_size <= 0) {
+            ok = read_size == 0;
+            break;
+        }
+        block->used += (size_t)read_size;
+    }
+    close(fd);
+
+    if (!ok) {
+        doc_block_release(block);
+        return false;
+    }
+
+    doc_node_release(doc->root);
+    doc->root = doc_pieces(doc, block, block->data, block->used);
+    doc_block_release(block);
+
+    return true;
+}
+
+/******************************************************************************
+ * doc_spans -- Calls a function with each run of contiguous text in a range  *
+ *              of a document, in order.                                      *
+ *                                                                            *
+ * Parameters                                                                 *
+ *      root -- The root of the document's tree.                              *
+ *      start -- The byte offset to start at.                                 *
+ *      end -- The byte offset to stop before.                                *
+ *      fn -- The function to call with each span.                            *
+ *      arg -- Passed through to the function.                                *
+ *                                                                            *
+ * Returns                                                                    *
+ *      False if the function stopped early, true otherwise.                  *
+ *****************************************************************************/
+bool doc_spans(const struct doc_node* root, size_t start, size_t end, doc_span_fn fn, void* arg) {
+    while (root != NULL && start < end) {
+        size_t left_len = root->left != NULL ? root->left->total_len : 0;
+
+        if (start < left_len && !doc_spans(root->left, start, end < left_len ? end : left_len, fn, arg))
+            return false;
+
+        // This piece, clipped to the range
+        size_t piece_start = left_len;
+        size_t piece_end = left_len + root->len;
+        if (start < piece_end && end > piece_start) {
+            size_t from = start > piece_start ? start - piece_start : 0;
+            size_t to = (end < piece_end ? end : piece_end) - piece_start;
+            if (!fn(root->text + from, to - from, arg))
+                return false;
+        }
+
+        // Carry on to the right without recursing
+        if (end <= piece_end)
+            return true;
+        start = start > piece_end ? start - piece_end : 0;
+        end -= piece_end;
+        root = root->right;
+    }
+
+    return true;
+}
+
+// Used by doc_copy to write the spans it is given
+struct doc_copy_state {
+    char* dest;
+};
+
+bool doc_copy_span(const char* text, size_t len, void* arg) {
+    struct doc_copy_state* state = arg;
+    memcpy(state->dest, text, len);
+    state->dest += len;
+    return true;
+}
+
+/******************************************************************************
+ * doc_copy -- Copies a range of a document into a buffer.                    *
+ *                                                                            *
+ * Parameters                                                                 *
+ *      root -- The root of the document's tree.                              *
+ *      start -- The byte offset to start at.                                 *
+ *      end -- The byte offset to stop before.                                *
+ *      dest -- The buffer to copy to, which must hold end - start bytes.     *
+ *                                                                            *
+ * Returns                                                                    *
+ *      The number of bytes copied.                                           *
+ *****************************************************************************/
+size_t doc_copy(const struct doc_node* root, size_t start, size_t end, char* dest) {
+    size_t length = doc_length(root);
+    if (end > length) end = length;
+    if (start >= end) return 0;
+
+    struct doc_copy_state state = {dest};
+    doc_spans(root, start, end, doc_copy_span, &state);
+
+    return end - start;
+}
+
+/******************************************************************************
+ * doc_text -- Copies a whole document into one NUL terminated string, for    *
+ *             code that needs the text in one piece.                         *
+ *                                                                            *
+ * Parameters                                                                 *
+ *      root -- The root of the document's tree.                              *
+ *      len -- Set to the length of the text if not NULL.                     *
+ *                                                                            *
+ * Returns                                                                    *
+ *      The text, which the caller must free.                                 *
+ *****************************************************************************/
+char* doc_text(const struct doc_node* root, size_t* len) {
+    size_t length = doc_length(root);
+    char* text = malloc(length + 1);
+    if (text == NULL) {
+        printf("Unable to allocate memory for the document.\n");
+        exit(EXIT_FAILURE);
+    }
+
+    doc_copy(root, 0, length, text);
+    text[length] = '\0';
+    if (len != NULL) *len = length;
+
+    return text;
+}
+
+/******************************************************************************
+ * doc_byte_at -- Gets the byte at an offset in a document.                   *
+ *                                                                            *
+ * Parameters                                                                 *
+ *      root -- The root of the document's tree.                              *
+ *      offset -- The byte offset.                                            *
+ *                                                                            *
+ * Returns                                                                    *
+ *      The byte, or '\0' past the end of the document.                       *
+ *****************************************************************************/
+char doc_byte_at(const struct doc_node* root, size_t offset) {
+    while (root != NULL) {
+        size_t left_len = root->left != NULL ? root->left->total_len : 0;
+
+        if (offset < left_len) {
+            root = root->left;
+        }
+        else if (offset < left_len + root->len) {
+            return root->text[offset - left_len];
+        }
+        else {
+            offset -= left_len + root->len;
+            root = root->right;
+        }
+    }
+
+    return '\0';
+}
+
+/******************************************************************************
+ * doc_line_start -- Finds the byte offset that a line starts at.             *
+ *                                                                            *
+ * Parameters                                                                 *
+ *      root -- The root of the document's tree.                              *
+ *      line -- The line number, starting at 0.                               *
+ *                                                                            *
+ * Returns                                                                    *
+ *      The offset of the line's first byte, or the length of the document    *
+ *      if there are not that many lines.                                     *
+ *****************************************************************************/
+size_t doc_line_start(const struct doc_node* root, size_t line) {
+    if (line == 0)
+        return 0;
+
+    // Find the newline that ends the line before, and start just after it
+    size_t offset = 0;
+    while (root != NULL) {
+        size_t left_lines = root->left != NULL ? root->left->total_lines : 0;
+        size_t left_len = root->left != NULL ? root->left->total_len : 0;
+
+        if (line <= left_lines) {
+            root = root->left;
+        }
+        else if (line <= left_lines + root->lines) {
+            const char* text = root->text;
+            for (size_t seen = left_lines; ; text++) {
+                text = memchr(text, '\n', root->text + root->len - text);
+                if (++seen == line)
+                    return offset + left_len + (text - root->text) + 1;
+            }
+        }
+        else {
+            line -= left_lines + root->lines;
+            offset += left_len + root->len;
+            root = root->right;
+        }
+    }
+
+    return offset;
+}
+
+/******************************************************************************
+ * doc_line_of -- Finds the line that a byte offset is on.                    *
+ *                                                                            *
+ * Parameters                                                                 *
+ *      root -- The root of the document's tree.                              *
+ *      offset -- The byte offset.                                            *
+ *                                                                            *
+ * Returns                                                                    *
+ *      The line number, starting at 0.                                       *
+ *****************************************************************************/
+size_t doc_line_of(const struct doc_node* root, size_t offset) {
+    size_t line = 0;
+
+    while (root != NULL) {
+        size_t left_len = root->left != NULL ? root->left->total_len : 0;
+
+        if (offset < left_len) {
+            root = root->left;
+        }
+        else {
+            line += root->left != NULL ? root->left->total_lines : 0;
+            if (offset < left_len + root->len)
+                return line + doc_count_lines(root->text, offset - left_len);
+
+            line += root->lines;
+            offset -= left_len + root->len;
+            root = root->right;
+        }
+    }
+
+    return line;
+}
+
+/******************************************************************************
+ * doc_line_end -- Finds the byte offset of the end of a line, not counting   *
+ *                 its newline.                                               *
+ *                                                                            *
+ * Parameters                                                                 *
+ *      root -- The root of the document's tree.                              *
+ *      line -- The line number, starting at 0.                               *
+ *                                                                            *
+ * Returns                                                                    *
+ *      The offset of the line's newline, or the length of the document for   *
+ *      the last line.                                                        *
+ *****************************************************************************/
+size_t doc_line_end(const struct doc_node* root, size_t line) {
+    if (line + 1 >= doc_line_count(root))
+        return doc_length(root);
+
+    return doc_line_start(root, line + 1) - 1;
+}
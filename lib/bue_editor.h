@@ -0,0 +1,1235 @@
+/******************************************************************************
+ * bue_editor -- The markdown editor widget. Draws and edits a document from  *
+ *               bue_doc, laying out only the lines that are scrolled into    *
+ *               view, and keeps its undo history as snapshots of the         *
+ *               document so that undoing an edit is just swapping a root.    *
+ *               A read-only, wrapped mode is used for the HTML preview.      *
+ *                                                                            *
+ * Author: 7B Industries                                                      *
+ * License: Apache 2.0                                                        *
+ *                                                                            *
+ * ***************************************************************************/
+
+#include <ctype.h>
+
+// How many steps of undo history are kept
+#define EDITOR_UNDO_MAX 1000
+
+// How many changes the edit journal remembers, a power of two
+#define EDITOR_JOURNAL_SIZE 256
+
+// Kinds of edits, so that a run of typing or deleting is undone in one step
+enum editor_edit_kinds {edit_other = 0, edit_typing = 1, edit_deleting = 2};
+
+/*
+ * One change to the text. The bytes from offset to offset + removed were
+ * replaced by the bytes from offset to offset + inserted.
+ */
+struct editor_change {
+    unsigned long version;  // The version of the text the change produced
+    size_t offset;  // Where the change starts
+    size_t removed;  // How many bytes were taken out
+    size_t inserted;  // How many bytes were put in their place
+};
+
+// A point in the undo history
+struct editor_state {
+    struct doc_node* text;  // Snapshot of the document
+    size_t cursor;  // Where the cursor was, since the selection is not kept
+};
+
+struct editor_history {
+    struct editor_state* states;  // Oldest first
+    int count;
+    int capacity;
+};
+
+// The most runs of color that a line can be split into
+#define EDITOR_MAX_RUNS 64
+
+// A run of text on one line drawn in one color
+struct editor_run {
+    size_t len;  // The number of bytes in the run
+    struct nk_color color;  // The color of the text
+};
+
+typedef struct text_editor text_editor;
+
+// Splits a line into runs of color, returning how many runs were written
+typedef int (*editor_style_fn)(text_editor* ed, size_t line, const char* text, size_t len, struct nk_color text_color,
+                               struct editor_run* runs, int max_runs, void* arg);
+
+struct text_editor {
+    document doc;  // The text being edited
+    size_t cursor;  // Byte offset of the cursor
+    size_t anchor;  // The other end of the selection, the same as the cursor when nothing is selected
+    float preferred_x;  // Where the cursor stays when moving up and down, negative when unset
+    struct nk_vec2 scroll;  // How far the text is scrolled, in pixels
+    bool active;  // Whether the editor has the keyboard
+    bool read_only;  // Allows selecting and copying but not editing
+    bool wrap;  // Wraps long lines at the width of the editor instead of scrolling sideways
+    bool follow_cursor;  // Scroll the cursor into view on the next draw
+    unsigned long version;  // Goes up by one with every change to the text
+    struct editor_change journal[EDITOR_JOURNAL_SIZE];  // The latest changes, indexed by version
+    struct editor_history undo;
+    struct editor_history redo;
+    int last_edit;  // Kind of the last edit, one of the editor_edit_kinds
+    size_t last_edit_end;  // Where the cursor was left by the last edit
+    void (*copy)(const char* text, size_t len);  // Puts text on the clipboard
+    char* (*paste)(void);  // Gets the text on the clipboard, which the caller frees
+    editor_style_fn style;  // Colors the text of each line, or NULL for plain text
+    void* style_arg;  // Passed through to the style function
+    char* line;  // Scratch space holding the text of one line
+    size_t line_capacity;
+    size_t* rows;  // Offsets where each wrapped row starts, only used when wrapping
+    size_t row_count;
+    size_t row_capacity;
+    unsigned long rows_version;  // The version of the text that the rows were laid out for
+    float rows_width;  // The width that the rows were laid out for, negative when never laid out
+};
+
+/******************************************************************************
+ * editor_init -- Sets up an empty editor.                                    *
+ *                                                                            *
+ * Parameters                                                                 *
+ *      ed -- The editor to set up.                                           *
+ *                                                                            *
+ * Returns                                                                    *
+ *      Nothing                                                               *
+ *****************************************************************************/
+void editor_init(text_editor* ed) {
+    memset(ed, 0, sizeof(text_editor));
+    doc_init(&ed->doc);
+    ed->preferred_x = -1.0f;
+    ed->rows_width = -1.0f;
+}
+
+/******************************************************************************
+ * editor_history_push -- Adds a state to the end of an undo history,         *
+ *                        dropping the oldest state when it is full.          *
+ *                                                                            *
+ * Parameters                                                                 *
+ *      history -- The history to add to.                                     *
+ *      state -- The state, whose snapshot reference is handed over.          *
+ *                                                                            *
+ * Returns                                                                    *
+ *      Nothing                                                               *
+ *****************************************************************************/
+void editor_history_push(struct editor_history* history, struct editor_state state) {
+    if (history->count == EDITOR_UNDO_MAX) {
+        doc_node_release(history->states[0].text);
+        memmove(history->states, history->states + 1, (history->count - 1) * sizeof(struct editor_state));
+        history->count--;
+    }
+
+    if (history->count == history->capacity) {
+        history->capacity = history->capacity == 0 ? 64 : history->capacity * 2;
+        history->states = realloc(history->states, history->capacity * sizeof(struct editor_state));
+        if (history->states == NULL) {
+            printf("Unable to allocate memory for the undo history.\n");
+            exit(EXIT_FAILURE);
+        }
+    }
+
+    history->states[history->count++] = state;
+}
+
+/******************************************************************************
+ * editor_history_clear -- Empties an undo history.                           *
+ *                                                                            *
+ * Parameters                                                                 *
+ *      history -- The history to empty.                                      *
+ *                                                                            *
+ * Returns                                                                    *
+ *      Nothing                                                               *
+ *****************************************************************************/
+void editor_history_clear(struct editor_history* history) {
+    for (int i = 0; i < history->count; i++)
+        doc_node_release(history->states[i].text);
+    history->count = 0;
+}
+
+/******************************************************************************
+ * editor_free -- Releases everything held by an editor.                      *
+ *                                                                            *
+ * Parameters                                                                 *
+ *      ed -- The editor to free.                                             *
+ *                                                                            *
+ * Returns                                                                    *
+ *      Nothing                                                               *
+ *****************************************************************************/
+void editor_free(text_editor* ed) {
+    editor_history_clear(&ed->undo);
+    editor_history_clear(&ed->redo);
+    free(ed->undo.states);
+    free(ed->redo.states);
+    free(ed->line);
+    free(ed->rows);
+    doc_free(&ed->doc);
+}
+
+/******************************************************************************
+ * editor_record -- Adds a change to the edit journal and moves the text on   *
+ *                  to its next version.                                      *
+ *                                                                            *
+ * Parameters                                                                 *
+ *      ed -- The editor.                                                     *
+ *      offset -- Where the change starts.                                    *
+ *      removed -- How many bytes were taken out.                             *
+ *      inserted -- How many bytes were put in their place.                   *
+ *                                                                            *
+ * Returns                                                                    *
+ *      Nothing                                                               *
+ *****************************************************************************/
+void editor_record(text_editor* ed, size_t offset, size_t removed, size_t inserted) {
+    ed->version++;
+
+    struct editor_change* change = &ed->journal[ed->version & (EDITOR_JOURNAL_SIZE - 1)];
+    change->version = ed->version;
+    change->offset = offset;
+    change->removed = removed;
+    change->inserted = inserted;
+}
+
+/******************************************************************************
+ * editor_change -- Looks up a change in the edit journal. Anything that      *
+ *                  keeps state derived from the text remembers the version   *
+ *                  it last saw, and catches up by reading each change after  *
+ *                  it, starting over from scratch when one is missing.       *
+ *                                                                            *
+ * Parameters                                                                 *
+ *      ed -- The editor.                                                     *
+ *      version -- The version that the change produced.                      *
+ *                                                                            *
+ * Returns                                                                    *
+ *      The change, or NULL if it is too old to still be in the journal.      *
+ *****************************************************************************/
+const struct editor_change* editor_change(const text_editor* ed, unsigned long version) {
+    const struct editor_change* change = &ed->journal[version & (EDITOR_JOURNAL_SIZE - 1)];
+
+    return change->version == version && version != 0 ? change : NULL;
+}
+
+/******************************************************************************
+ * editor_reset -- Starts the editor over after its text was replaced,        *
+ *                 dropping the undo history.                                 *
+ *                                                                            *
+ * Parameters                                                                 *
+ *      ed -- The editor.                                                     *
+ *      old_length -- How long the text was before it was replaced.           *
+ *                                                                            *
+ * Returns                                                                    *
+ *      Nothing                                                               *
+ *****************************************************************************/
+void editor_reset(text_editor* ed, size_t old_length) {
+    editor_record(ed, 0, old_length, doc_length(ed->doc.root));
+    editor_history_clear(&ed->undo);
+    editor_history_clear(&ed->redo);
+    ed->cursor = ed->anchor = 0;
+    ed->scroll = nk_vec2(0, 0);
+    ed->preferred_x = -1.0f;
+    ed->last_edit = edit_other;
+}
+
+/******************************************************************************
+ * editor_load_file -- Replaces the editor's text with a file in one step,    *
+ *                     starting the undo history over.                        *
+ *                                                                            *
+ * Parameters                                                                 *
+ *      ed -- The editor.                                                     *
+ *      path -- The path to the file to load.                                 *
+ *                                                                            *
+ * Returns                                                                    *
+ *      A boolean specifying whether or not the file could be read.           *
+ *****************************************************************************/
+bool editor_load_file(text_editor* ed, const char* path) {
+    size_t old_length = doc_length(ed->doc.root);
+    if (!doc_load_file(&ed->doc, path))
+        return false;
+
+    editor_reset(ed, old_length);
+
+    return true;
+}
+
+/******************************************************************************
+ * editor_set_text -- Replaces the editor's text, starting the undo history   *
+ *                    over.                                                   *
+ *                                                                            *
+ * Parameters                                                                 *
+ *      ed -- The editor.                                                     *
+ *      text -- The new text, which can be NULL when len is zero.             *
+ *      len -- The number of bytes of text.                                   *
+ *                                                                            *
+ * Returns                                                                    *
+ *      Nothing                                                               *
+ *****************************************************************************/
+void editor_set_text(text_editor* ed, const char* text, size_t len) {
+    size_t old_length = doc_length(ed->doc.root);
+    doc_set_text(&ed->doc, text, len);
+    editor_reset(ed, old_length);
+}
+
+/******************************************************************************
+ * editor_current_state -- Takes a snapshot of the editor for the history.    *
+ *                                                                            *
+ * Parameters                                                                 *
+ *      ed -- The editor.                                                     *
+ *                                                                            *
+ * Returns                                                                    *
+ *      The state, holding a new reference to the document.                   *
+ *****************************************************************************/
+struct editor_state editor_current_state(text_editor* ed) {
+    struct editor_state state = {doc_snapshot(&ed->doc), ed->cursor};
+    return state;
+}
+
+/******************************************************************************
+ * editor_selection -- Gets the selected range, in order.                     *
+ *                                                                            *
+ * Parameters                                                                 *
+ *      ed -- The editor.                                                     *
+ *      start -- Set to the offset of the first selected byte.                *
+ *      end -- Set to the offset just past the selection.                     *
+ *                                                                            *
+ * Returns                                                                    *
+ *      Nothing                                                               *
+ *****************************************************************************/
+void editor_selection(const text_editor* ed, size_t* start, size_t* end) {
+    *start = ed->cursor < ed->anchor ? ed->cursor : ed->anchor;
+    *end = ed->cursor < ed->anchor ? ed->anchor : ed->cursor;
+}
+
+/******************************************************************************
+ * editor_edit -- Replaces the selection with new text, recording the change  *
+ *                in the undo history. Runs of typing or deleting in one      *
+ *                place share a single undo step.                             *
+ *                                                                            *
+ * Parameters                                                                 *
+ *      ed -- The editor.                                                     *
+ *      text -- The text to put in place of the selection, may be NULL.       *
+ *      len -- The number of bytes of text.                                   *
+ *      kind -- One of the editor_edit_kinds.                                 *
+ *                                                                            *
+ * Returns                                                                    *
+ *      Nothing                                                               *
+ *****************************************************************************/
+void editor_edit(text_editor* ed, const char* text, size_t len, int kind) {
+    size_t start, end;
+    editor_selection(ed, &start, &end);
+    if (ed->read_only || (start == end && len == 0))
+        return;
+
+    bool continues = kind != edit_other && kind == ed->last_edit && (ed->last_edit_end == start || ed->last_edit_end == end);
+    if (!continues || ed->undo.count == 0)
+        editor_history_push(&ed->undo, editor_current_state(ed));
+    editor_history_clear(&ed->redo);
+
+    doc_delete(&ed->doc, start, end - start);
+    doc_insert(&ed->doc, start, text, len);
+
+    ed->cursor = ed->anchor = start + len;
+    ed->last_edit = kind;
+    ed->last_edit_end = ed->cursor;
+    ed->preferred_x = -1.0f;
+    ed->follow_cursor = true;
+    editor_record(ed, start, end - start, len);
+}
+
+/******************************************************************************
+ * editor_insert -- Inserts text at the cursor, replacing the selection.      *
+ *                                                                            *
+ * Parameters                                                                 *
+ *      ed -- The editor.                                                     *
+ *      text -- The text to insert.                                           *
+ *      len -- The number of bytes of text.                                   *
+ *                                                                            *
+ * Returns                                                                    *
+ *      Nothing                                                               *
+ *****************************************************************************/
+void editor_insert(text_editor* ed, const char* text, size_t len) {
+    editor_edit(ed, text, len, edit_other);
+}
+
+/******************************************************************************
+ * editor_delete_selection -- Deletes the selected text.                      *
+ *                                                                            *
+ * Parameters                                                                 *
+ *      ed -- The editor.                                                     *
+ *                                                                            *
+ * Returns                                                                    *
+ *      Nothing                                                               *
+ *****************************************************************************/
+void editor_delete_selection(text_editor* ed) {
+    editor_edit(ed, NULL, 0, edit_other);
+}
+
+/******************************************************************************
+ * editor_select_all -- Selects all of the text.                              *
+ *                                                                            *
+ * Parameters                                                                 *
+ *      ed -- The editor.                                                     *
+ *                                                                            *
+ * Returns                                                                    *
+ *      Nothing                                                               *
+ *****************************************************************************/
+void editor_select_all(text_editor* ed) {
+    ed->anchor = 0;
+    ed->cursor = doc_length(ed->doc.root);
+}
+
+/******************************************************************************
+ * editor_selected_text -- Copies out the selected text.                      *
+ *                                                                            *
+ * Parameters                                                                 *
+ *      ed -- The editor.                                                     *
+ *      len -- Set to the number of bytes selected.                           *
+ *                                                                            *
+ * Returns                                                                    *
+ *      The NUL terminated text, which the caller must free.                  *
+ *****************************************************************************/
+char* editor_selected_text(const text_editor* ed, size_t* len) {
+    size_t start, end;
+    editor_selection(ed, &start, &end);
+
+    char* text = malloc(end - start + 1);
+    if (text == NULL) {
+        printf("Unable to allocate memory for the selected text.\n");
+        exit(EXIT_FAILURE);
+    }
+    doc_copy(ed->doc.root, start, end, text);
+    text[end - start] = '\0';
+    *len = end - start;
+
+    return text;
+}
+
+/******************************************************************************
+ * editor_replace_all -- Replaces every copy of some text in the editor, as   *
+ *                       one change that can be undone.                       *
+ *                                                                            *
+ * Parameters                                                                 *
+ *      ed -- The editor.                                                     *
+ *      query -- The text to replace.                                         *
+ *      replacement -- The text to replace it with.                           *
+ *                                                                            *
+ * Returns                                                                    *
+ *      The number of copies that were replaced.                              *
+ *****************************************************************************/
+int editor_replace_all(text_editor* ed, const char* query, const char* replacement) {
+    if (query[0] == '\0')
+        return 0;
+
+    size_t len;
+    char* text = doc_text(ed->doc.root, &len);
+    size_t query_len = strlen(query);
+
+    string_buffer out;
+    str_buf_init(&out);
+    const char* pos = text;
+    const char* match;
+    int replaced = 0;
+    while ((match = span_find(pos, text + len - pos, query)) != NULL) {
+        str_buf_append(&out, pos, match - pos);
+        str_buf_append_str(&out, replacement);
+        pos = match + query_len;
+        replaced++;
+    }
+    str_buf_append(&out, pos, text + len - pos);
+
+    if (replaced > 0) {
+        // Keep the cursor about where it was rather than jumping to the end
+        size_t cursor = ed->cursor;
+        editor_select_all(ed);
+        editor_insert(ed, out.data, out.len);
+        ed->cursor = ed->anchor = cursor < out.len ? cursor : out.len;
+    }
+
+    str_buf_free(&out);
+    free(text);
+
+    return replaced;
+}
+
+/******************************************************************************
+ * editor_step_history -- Moves the editor back or forward through its undo   *
+ *                        history.                                            *
+ *                                                                            *
+ * Parameters                                                                 *
+ *      ed -- The editor.                                                     *
+ *      from -- The history to take the state from.                           *
+ *      to -- The history to save the current state to.                       *
+ *                                                                            *
+ * Returns                                                                    *
+ *      Nothing                                                               *
+ *****************************************************************************/
+void editor_step_history(text_editor* ed, struct editor_history* from, struct editor_history* to) {
+    if (from->count == 0)
+        return;
+
+    editor_history_push(to, editor_current_state(ed));
+
+    // The whole text is swapped for the snapshot, so it is journaled as replaced
+    size_t old_length = doc_length(ed->doc.root);
+    struct editor_state state = from->states[--from->count];
+    doc_restore(&ed->doc, state.text);
+
+    size_t length = doc_length(ed->doc.root);
+    ed->cursor = ed->anchor = state.cursor < length ? state.cursor : length;
+    ed->last_edit = edit_other;
+    ed->preferred_x = -1.0f;
+    ed->follow_cursor = true;
+    editor_record(ed, 0, old_length, length);
+}
+
+/******************************************************************************
+ * editor_undo -- Undoes the last edit.                                       *
+ *                                                                            *
+ * Parameters                                                                 *
+ *      ed -- The editor.                                                     *
+ *                                                                            *
+ * Returns                                                                    *
+ *      Nothing                                                               *
+ *****************************************************************************/
+void editor_undo(text_editor* ed) {
+    editor_step_history(ed, &ed->undo, &ed->redo);
+}
+
+/******************************************************************************
+ * editor_redo -- Redoes the last edit that was undone.                       *
+ *                                                                            *
+ * Parameters                                                                 *
+ *      ed -- The editor.                                                     *
+ *                                                                            *
+ * Returns                                                                    *
+ *      Nothing                                                               *
+ *****************************************************************************/
+void editor_redo(text_editor* ed) {
+    editor_step_history(ed, &ed->redo, &ed->undo);
+}
+
+/******************************************************************************
+ * editor_next_glyph -- Finds the start of the character after an offset.     *
+ *                                                                            *
+ * Parameters                                                                 *
+ *      ed -- The editor.                                                     *
+ *      offset -- The byte offset to move from.                               *
+ *                                                                            *
+ * Returns                                                                    *
+ *      The offset of the next character.                                     *
+ *****************************************************************************/
+size_t editor_next_glyph(const text_editor* ed, size_t offset) {
+    size_t length = doc_length(ed->doc.root);
+    if (offset >= length)
+        return length;
+
+    // Step over any UTF-8 continuation bytes
+    offset++;
+    while (offset < length && (doc_byte_at(ed->doc.root, offset) & 0xC0) == 0x80)
+        offset++;
+
+    return offset;
+}
+
+/******************************************************************************
+ * editor_prev_glyph -- Finds the start of the character before an offset.    *
+ *                                                                            *
+ * Parameters                                                                 *
+ *      ed -- The editor.                                                     *
+ *      offset -- The byte offset to move from.                               *
+ *                                                                            *
+ * Returns                                                                    *
+ *      The offset of the previous character.                                 *
+ *****************************************************************************/
+size_t editor_prev_glyph(const text_editor* ed, size_t offset) {
+    if (offset == 0)
+        return 0;
+
+    offset--;
+    while (offset > 0 && (doc_byte_at(ed->doc.root, offset) & 0xC0) == 0x80)
+        offset--;
+
+    return offset;
+}
+
+/******************************************************************************
+ * editor_word_edge -- Finds the edge of the word before or after an offset,  *
+ *                     skipping any whitespace on the way.                    *
+ *                                                                            *
+ * Parameters                                                                 *
+ *      ed -- The editor.                                                     *
+ *      offset -- The byte offset to move from.                               *
+ *      forward -- Whether to look after the offset rather than before it.    *
+ *                                                                            *
+ * Returns                                                                    *
+ *      The offset of the edge of the word.                                   *
+ *****************************************************************************/
+size_t editor_word_edge(const text_editor* ed, size_t offset, bool forward) {
+    size_t length = doc_length(ed->doc.root);
+
+    if (forward) {
+        while (offset < length && isspace((unsigned char)doc_byte_at(ed->doc.root, offset)))
+            offset++;
+        while (offset < length && !isspace((unsigned char)doc_byte_at(ed->doc.root, offset)))
+            offset++;
+    }
+    else {
+        while (offset > 0 && isspace((unsigned char)doc_byte_at(ed->doc.root, offset - 1)))
+            offset--;
+        while (offset > 0 && !isspace((unsigned char)doc_byte_at(ed->doc.root, offset - 1)))
+            offset--;
+    }
+
+    return offset;
+}
+
+/******************************************************************************
+ * editor_row_count -- Gets the number of rows the editor's text takes up.    *
+ *                                                                            *
+ * Parameters                                                                 *
+ *      ed -- The editor.                                                     *
+ *                                                                            *
+ * Returns                                                                    *
+ *      The number of rows.                                                   *
+ *****************************************************************************/
+size_t editor_row_count(const text_editor* ed) {
+    return ed->wrap ? ed->row_count : doc_line_count(ed->doc.root);
+}
+
+/******************************************************************************
+ * editor_row_of -- Finds the row that an offset is drawn on.                 *
+ *                                                                            *
+ * Parameters                                                                 *
+ *      ed -- The editor.                                                     *
+ *      offset -- The byte offset.                                            *
+ *                                                                            *
+ * Returns                                                                    *
+ *      The row number, starting at 0.                                        *
+ *****************************************************************************/
+size_t editor_row_of(const text_editor* ed, size_t offset) {
+    if (!ed->wrap)
+        return doc_line_of(ed->doc.root, offset);
+
+    // The last row starting at or before the offset
+    size_t low = 0;
+    size_t high = ed->row_count;
+    while (high - low > 1) {
+        size_t mid = low + (high - low) / 2;
+        if (ed->rows[mid] <= offset)
+            low = mid;
+        else
+            high = mid;
+    }
+
+    return low;
+}
+
+/******************************************************************************
+ * editor_row_text -- Copies the text of one row into the scratch buffer.     *
+ *                                                                            *
+ * Parameters                                                                 *
+ *      ed -- The editor.                                                     *
+ *      row -- The row number, starting at 0.                                 *
+ *      start -- Set to the offset of the start of the row.                   *
+ *      len -- Set to the length of the row, not counting its newline.        *
+ *                                                                            *
+ * Returns                                                                    *
+ *      The text of the row, which is only good until the next call.          *
+ *****************************************************************************/
+const char* editor_row_text(text_editor* ed, size_t row, size_t* start, size_t* len) {
+    if (ed->wrap) {
+        *start = ed->rows[row];
+        size_t end = row + 1 < ed->row_count ? ed->rows[row + 1] : doc_length(ed->doc.root);
+        if (end > *start && doc_byte_at(ed->doc.root, end - 1) == '\n')
+            end--;
+        *len = end - *start;
+    }
+    else {
+        *start = doc_line_start(ed->doc.root, row);
+        *len = doc_line_end(ed->doc.root, row) - *start;
+    }
+
+    if (*len + 1 > ed->line_capacity) {
+        ed->line_capacity = *len + 1 > 256 ? *len + 1 : 256;
+        ed->line = realloc(ed->line, ed->line_capacity);
+        if (ed->line == NULL) {
+            printf("Unable to allocate memory for the editor.\n");
+            exit(EXIT_FAILURE);
+        }
+    }
+    doc_copy(ed->doc.root, *start, *start + *len, ed->line);
+
+    return ed->line;
+}
+
+/******************************************************************************
+ * editor_text_width -- Measures a span of text in the editor's font.         *
+ *                                                                            *
+ * Parameters                                                                 *
+ *      font -- The font to measure with.                                     *
+ *      text -- The text.                                                     *
+ *      len -- The number of bytes of text.                                   *
+ *                                                                            *
+ * Returns                                                                    *
+ *      The width in pixels.                                                  *
+ *****************************************************************************/
+float editor_text_width(const struct nk_user_font* font, const char* text, size_t len) {
+    if (len == 0)
+        return 0.0f;
+
+    return font->width(font->userdata, font->height, text, (int)len);
+}
+
+/******************************************************************************
+ * editor_offset_at_x -- Finds the character in a line closest to a position. *
+ *                                                                            *
+ * Parameters                                                                 *
+ *      font -- The font the line is drawn in.                                *
+ *      text -- The text of the line.                                         *
+ *      len -- The number of bytes in the line.                               *
+ *      x -- The position, relative to the start of the line.                 *
+ *                                                                            *
+ * Returns                                                                    *
+ *      The offset within the line.                                           *
+ *****************************************************************************/
+size_t editor_offset_at_x(const struct nk_user_font* font, const char* text, size_t len, float x) {
+    float pos = 0.0f;
+    size_t i = 0;
+
+    while (i < len) {
+        nk_rune rune;
+        int glyph_len = nk_utf_decode(text + i, &rune, (int)(len - i));
+        if (glyph_len == 0) break;
+
+        float width = editor_text_width(font, text + i, glyph_len);
+        if (x < pos + width / 2.0f) break;
+
+        pos += width;
+        i += glyph_len;
+    }
+
+    return i;
+}
+
+/******************************************************************************
+ * editor_add_row -- Records where a wrapped row starts.                      *
+ *                                                                            *
+ * Parameters                                                                 *
+ *      ed -- The editor.                                                     *
+ *      start -- The offset of the first byte of the row.                     *
+ *                                                                            *
+ * Returns                                                                    *
+ *      Nothing                                                               *
+ *****************************************************************************/
+void editor_add_row(text_editor* ed, size_t start) {
+    if (ed->row_count == ed->row_capacity) {
+        ed->row_capacity = ed->row_capacity == 0 ? 256 : ed->row_capacity * 2;
+        ed->rows = realloc(ed->rows, ed->row_capacity * sizeof(size_t));
+        if (ed->rows == NULL) {
+            printf("Unable to allocate memory for the editor.\n");
+            exit(EXIT_FAILURE);
+        }
+    }
+
+    ed->rows[ed->row_count++] = start;
+}
+
+/******************************************************************************
+ * editor_layout -- Works out where the text wraps. The rows are kept until   *
+ *                  the text or the width changes, so a view whose text is    *
+ *                  only replaced now and then, like the preview, measures    *
+ *                  its text once and then scrolls for free.                  *
+ *                                                                            *
+ * Parameters                                                                 *
+ *      ed -- The editor.                                                     *
+ *      font -- The font the text is drawn in.                                *
+ *      width -- How wide a row can be.                                       *
+ *                                                                            *
+ * Returns                                                                    *
+ *      Nothing                                                               *
+ *****************************************************************************/
+void editor_layout(text_editor* ed, const struct nk_user_font* font, float width) {
+    if (!ed->wrap || (ed->rows_version == ed->version && ed->rows_width == width))
+        return;
+
+    ed->rows_version = ed->version;
+    ed->rows_width = width;
+    ed->row_count = 0;
+    editor_add_row(ed, 0);
+
+    size_t len;
+    char* text = doc_text(ed->doc.root, &len);
+    size_t row_start = 0;
+    size_t last_break = 0;  // Just past the last space in the row, 0 when there is none
+    float row_width = 0.0f;
+
+    size_t i = 0;
+    while (i < len) {
+        if (text[i] == '\n') {
+            i++;
+            editor_add_row(ed, i);
+            row_start = i;
+            last_break = 0;
+            row_width = 0.0f;
+            continue;
+        }
+
+        nk_rune rune;
+        int glyph_len = nk_utf_decode(text + i, &rune, (int)(len - i));
+        if (glyph_len == 0) glyph_len = 1;
+        float glyph_width = editor_text_width(font, text + i, glyph_len);
+
+        // Break after the last space when there is one, or else right before this character
+        if (row_width + glyph_width > width && i > row_start) {
+            row_start = last_break > row_start ? last_break : i;
+            editor_add_row(ed, row_start);
+            last_break = 0;
+            row_width = editor_text_width(font, text + row_start, i - row_start);
+        }
+
+        row_width += glyph_width;
+        i += glyph_len;
+        if (text[i - 1] == ' ')
+            last_break = i;
+    }
+
+    free(text);
+}
+
+/******************************************************************************
+ * editor_move_line -- Moves the cursor up or down by some number of rows,    *
+ *                     keeping it as close to the same column as it can.      *
+ *                                                                            *
+ * Parameters                                                                 *
+ *      ed -- The editor.                                                     *
+ *      font -- The font the text is drawn in.                                *
+ *      lines -- How many rows to move, negative to move up.                  *
+ *                                                                            *
+ * Returns                                                                    *
+ *      Nothing                                                               *
+ *****************************************************************************/
+void editor_move_line(text_editor* ed, const struct nk_user_font* font, long lines) {
+    size_t start, len;
+    size_t row = editor_row_of(ed, ed->cursor);
+    size_t row_count = editor_row_count(ed);
+
+    if (ed->preferred_x < 0.0f) {
+        const char* text = editor_row_text(ed, row, &start, &len);
+        ed->preferred_x = editor_text_width(font, text, ed->cursor - start);
+    }
+
+    long target = (long)row + lines;
+    if (target < 0) target = 0;
+    if (target >= (long)row_count) target = (long)row_count - 1;
+
+    const char* text = editor_row_text(ed, (size_t)target, &start, &len);
+    ed->cursor = start + editor_offset_at_x(font, text, len, ed->preferred_x);
+}
+
+/******************************************************************************
+ * editor_offset_at -- Finds the character under a point in the editor.       *
+ *                                                                            *
+ * Parameters                                                                 *
+ *      ed -- The editor.                                                     *
+ *      font -- The font the text is drawn in.                                *
+ *      area -- The area the text is drawn in.                                *
+ *      row_height -- The height of each row.                                 *
+ *      pos -- The point, in screen coordinates.                              *
+ *                                                                            *
+ * Returns                                                                    *
+ *      The byte offset of the character.                                     *
+ *****************************************************************************/
+size_t editor_offset_at(text_editor* ed, const struct nk_user_font* font, struct nk_rect area, float row_height, struct nk_vec2 pos) {
+    float y = pos.y - area.y + ed->scroll.y;
+    size_t row_count = editor_row_count(ed);
+    size_t row = y > 0.0f ? (size_t)(y / row_height) : 0;
+    if (row >= row_count) row = row_count - 1;
+
+    size_t start, len;
+    const char* text = editor_row_text(ed, row, &start, &len);
+
+    return start + editor_offset_at_x(font, text, len, pos.x - area.x + ed->scroll.x);
+}
+
+/******************************************************************************
+ * editor_handle_keys -- Applies the keyboard input for this frame.           *
+ *                                                                            *
+ * Parameters                                                                 *
+ *      ed -- The editor.                                                     *
+ *      in -- The Nuklear input state.                                        *
+ *      font -- The font the text is drawn in.                                *
+ *      page_lines -- How many lines fit in the editor.                       *
+ *                                                                            *
+ * Returns                                                                    *
+ *      Nothing                                                               *
+ *****************************************************************************/
+void editor_handle_keys(text_editor* ed, struct nk_input* in, const struct nk_user_font* font, long page_lines) {
+    bool shift = in->keyboard.keys[NK_KEY_SHIFT].down;
+    size_t start, end;
+    editor_selection(ed, &start, &end);
+    size_t old_cursor = ed->cursor;
+    bool moved = true;
+
+    if (nk_input_is_key_pressed(in, NK_KEY_LEFT))
+        ed->cursor = (start != end && !shift) ? start : editor_prev_glyph(ed, ed->cursor);
+    else if (nk_input_is_key_pressed(in, NK_KEY_RIGHT))
+        ed->cursor = (start != end && !shift) ? end : editor_next_glyph(ed, ed->cursor);
+    else if (nk_input_is_key_pressed(in, NK_KEY_TEXT_WORD_LEFT))
+        ed->cursor = editor_word_edge(ed, ed->cursor, false);
+    else if (nk_input_is_key_pressed(in, NK_KEY_TEXT_WORD_RIGHT))
+        ed->cursor = editor_word_edge(ed, ed->cursor, true);
+    else if (nk_input_is_key_pressed(in, NK_KEY_UP))
+        editor_move_line(ed, font, -1);
+    else if (nk_input_is_key_pressed(in, NK_KEY_DOWN))
+        editor_move_line(ed, font, 1);
+    else if (nk_input_is_key_pressed(in, NK_KEY_SCROLL_UP))
+        editor_move_line(ed, font, -page_lines);
+    else if (nk_input_is_key_pressed(in, NK_KEY_SCROLL_DOWN))
+        editor_move_line(ed, font, page_lines);
+    else if (nk_input_is_key_pressed(in, NK_KEY_TEXT_LINE_START) || nk_input_is_key_pressed(in, NK_KEY_TEXT_LINE_END)) {
+        size_t row_start, row_len;
+        editor_row_text(ed, editor_row_of(ed, ed->cursor), &row_start, &row_len);
+        ed->cursor = nk_input_is_key_pressed(in, NK_KEY_TEXT_LINE_START) ? row_start : row_start + row_len;
+    }
+    else if (nk_input_is_key_pressed(in, NK_KEY_TEXT_START))
+        ed->cursor = 0;
+    else if (nk_input_is_key_pressed(in, NK_KEY_TEXT_END))
+        ed->cursor = doc_length(ed->doc.root);
+    else if (nk_input_is_key_pressed(in, NK_KEY_TEXT_SELECT_ALL))
+        editor_select_all(ed);
+    else
+        moved = false;
+
+    if (moved) {
+        // Moving the cursor without shift held drops the selection
+        if (!shift && !nk_input_is_key_pressed(in, NK_KEY_TEXT_SELECT_ALL))
+            ed->anchor = ed->cursor;
+
+        // Only moving up and down keeps the column that the cursor started in
+        if (!nk_input_is_key_pressed(in, NK_KEY_UP) && !nk_input_is_key_pressed(in, NK_KEY_DOWN) &&
+            !nk_input_is_key_pressed(in, NK_KEY_SCROLL_UP) && !nk_input_is_key_pressed(in, NK_KEY_SCROLL_DOWN))
+            ed->preferred_x = -1.0f;
+
+        if (ed->cursor != old_cursor)
+            ed->last_edit = edit_other;
+        ed->follow_cursor = true;
+    }
+
+    if (nk_input_is_key_pressed(in, NK_KEY_BACKSPACE)) {
+        if (start == end)
+            ed->anchor = editor_prev_glyph(ed, ed->cursor);
+        editor_edit(ed, NULL, 0, edit_deleting);
+    }
+    else if (nk_input_is_key_pressed(in, NK_KEY_DEL)) {
+        if (start == end)
+            ed->anchor = editor_next_glyph(ed, ed->cursor);
+        editor_edit(ed, NULL, 0, edit_deleting);
+    }
+    else if (nk_input_is_key_pressed(in, NK_KEY_ENTER)) {
+        editor_edit(ed, "\n", 1, edit_other);
+    }
+
+    // Clipboard
+    if ((nk_input_is_key_pressed(in, NK_KEY_COPY) || nk_input_is_key_pressed(in, NK_KEY_CUT)) && start != end && ed->copy != NULL) {
+        size_t len;
+        char* text = editor_selected_text(ed, &len);
+        ed->copy(text, len);
+        free(text);
+
+        if (nk_input_is_key_pressed(in, NK_KEY_CUT))
+            editor_delete_selection(ed);
+    }
+    if (nk_input_is_key_pressed(in, NK_KEY_PASTE) && ed->paste != NULL) {
+        char* text = ed->paste();
+        if (text != NULL) {
+            editor_insert(ed, text, strlen(text));
+            free(text);
+        }
+    }
+
+    if (nk_input_is_key_pressed(in, NK_KEY_TEXT_UNDO))
+        editor_undo(ed);
+    else if (nk_input_is_key_pressed(in, NK_KEY_TEXT_REDO))
+        editor_redo(ed);
+
+    // Typed text, leaving out control characters
+    if (in->keyboard.text_len > 0) {
+        char typed[NK_INPUT_MAX];
+        int len = 0;
+        for (int i = 0; i < in->keyboard.text_len; i++) {
+            unsigned char c = (unsigned char)in->keyboard.text[i];
+            if (c >= 0x20 && c != 0x7F)
+                typed[len++] = (char)c;
+        }
+        editor_edit(ed, typed, len, edit_typing);
+        in->keyboard.text_len = 0;
+    }
+}
+
+/******************************************************************************
+ * editor_draw_span -- Draws a run of text and returns how wide it was.       *
+ *                                                                            *
+ * Parameters                                                                 *
+ *      out -- The command buffer to draw to.                                 *
+ *      font -- The font to draw with.                                        *
+ *      x -- Where the span starts.                                           *
+ *      y -- The top of the line.                                             *
+ *      row_height -- The height of the line.                                 *
+ *      text -- The text to draw.                                             *
+ *      len -- The number of bytes of text.                                   *
+ *      bg -- The background color.                                           *
+ *      fg -- The text color.                                                 *
+ *                                                                            *
+ * Returns                                                                    *
+ *      The width of the span.                                                *
+ *****************************************************************************/
+float editor_draw_span(struct nk_command_buffer* out, const struct nk_user_font* font, float x, float y, float row_height,
+                       const char* text, size_t len, struct nk_color bg, struct nk_color fg) {
+    if (len == 0)
+        return 0.0f;
+
+    float width = editor_text_width(font, text, len);
+    nk_draw_text(out, nk_rect(x, y, width, row_height), text, (int)len, font, bg, fg);
+
+    return width;
+}
+
+/******************************************************************************
+ * editor_draw_run -- Draws a run of text in one color, in the selection's    *
+ *                    colors wherever it overlaps the selection.              *
+ *                                                                            *
+ * Parameters                                                                 *
+ *      out -- The command buffer to draw to.                                 *
+ *      font -- The font to draw with.                                        *
+ *      x -- Where the run starts.                                            *
+ *      y -- The top of the line.                                             *
+ *      row_height -- The height of the line.                                 *
+ *      text -- The text of the whole line.                                   *
+ *      start -- Offset of the run in the line.                               *
+ *      end -- Offset just past the run in the line.                          *
+ *      from -- Offset of the start of the selection in the line.             *
+ *      to -- Offset just past the selection in the line.                     *
+ *      bg -- The background color.                                           *
+ *      fg -- The color of the run.                                           *
+ *      sel_bg -- The background color of selected text.                      *
+ *      sel_fg -- The color of selected text.                                 *
+ *                                                                            *
+ * Returns                                                                    *
+ *      The width of the run.                                                 *
+ *****************************************************************************/
+float editor_draw_run(struct nk_command_buffer* out, const struct nk_user_font* font, float x, float y, float row_height,
+                      const char* text, size_t start, size_t end, size_t from, size_t to,
+                      struct nk_color bg, struct nk_color fg, struct nk_color sel_bg, struct nk_color sel_fg) {
+    size_t sel_start = NK_CLAMP(start, from, end);
+    size_t sel_end = NK_CLAMP(sel_start, to, end);
+    float width = 0.0f;
+
+    width += editor_draw_span(out, font, x + width, y, row_height, text + start, sel_start - start, bg, fg);
+    width += editor_draw_span(out, font, x + width, y, row_height, text + sel_start, sel_end - sel_start, sel_bg, sel_fg);
+    width += editor_draw_span(out, font, x + width, y, row_height, text + sel_end, end - sel_end, bg, fg);
+
+    return width;
+}
+
+/******************************************************************************
+ * editor_draw -- Adds the editor to the current Nuklear window, handling its *
+ *                input and drawing the lines that are scrolled into view.    *
+ *                                                                            *
+ * Parameters                                                                 *
+ *      ctx -- The Nuklear context.                                           *
+ *      ed -- The editor.                                                     *
+ *                                                                            *
+ * Returns                                                                    *
+ *      A boolean specifying whether or not the text was changed.             *
+ *****************************************************************************/
+bool editor_draw(struct nk_context* ctx, text_editor* ed) {
+    if (ctx == NULL || ctx->current == NULL || ctx->current->layout == NULL)
+        return false;
+
+    struct nk_window* win = ctx->current;
+    const struct nk_style_edit* style = &ctx->style.edit;
+    const struct nk_user_font* font = ctx->style.font;
+    struct nk_command_buffer* out = &win->buffer;
+    unsigned long version = ed->version;
+
+    struct nk_rect bounds;
+    enum nk_widget_layout_states state = nk_widget(&bounds, ctx);
+    if (state == NK_WIDGET_INVALID)
+        return false;
+    struct nk_input* in = (state == NK_WIDGET_ROM || (win->layout->flags & NK_WINDOW_ROM)) ? NULL : &ctx->input;
+
+    // Dialogs and menus are drawn after the editor, so leave alone the input that goes to one left open last frame
+    struct nk_window* popup = win->popup.active ? win->popup.win : NULL;
+    if (popup != NULL && (win->popup.type == NK_PANEL_POPUP || nk_input_is_mouse_hovering_rect(&ctx->input, popup->bounds)))
+        in = NULL;
+
+    // The text goes inside of the padding, leaving room for the scrollbar
+    struct nk_rect area;
+    area.x = bounds.x + style->padding.x + style->border;
+    area.y = bounds.y + style->padding.y + style->border;
+    area.w = NK_MAX(0, bounds.w - (2.0f * style->padding.x + 2 * style->border) - style->scrollbar_size.x);
+    area.h = NK_MAX(0, bounds.h - (2.0f * style->padding.y + 2 * style->border));
+    float row_height = font->height + style->row_padding;
+    long page_lines = (long)(area.h / row_height);
+    if (page_lines < 1) page_lines = 1;
+    editor_layout(ed, font, area.w);
+
+    // Clicking in the editor gives it the keyboard, and clicking anywhere else takes it away
+    if (in != NULL && in->mouse.buttons[NK_BUTTON_LEFT].clicked && in->mouse.buttons[NK_BUTTON_LEFT].down)
+        ed->active = NK_INBOX(in->mouse.pos.x, in->mouse.pos.y, bounds.x, bounds.y, bounds.w, bounds.h);
+
+    bool hovered = in != NULL && nk_input_is_mouse_hovering_rect(in, area);
+    if (hovered)
+        ctx->style.cursor_active = ctx->style.cursors[NK_CURSOR_TEXT];
+
+    if (ed->active && in != NULL) {
+        const struct nk_mouse_button* left = &in->mouse.buttons[NK_BUTTON_LEFT];
+        const struct nk_mouse_button* twice = &in->mouse.buttons[NK_BUTTON_DOUBLE];
+
+        if (hovered && twice->clicked && twice->down) {
+            // Double clicking selects a word
+            size_t offset = editor_offset_at(ed, font, area, row_height, in->mouse.pos);
+            ed->anchor = editor_word_edge(ed, editor_next_glyph(ed, offset), false);
+            ed->cursor = editor_word_edge(ed, offset, true);
+            ed->last_edit = edit_other;
+        }
+        else if (hovered && left->clicked && left->down) {
+            ed->cursor = editor_offset_at(ed, font, area, row_height, in->mouse.pos);
+            if (!in->keyboard.keys[NK_KEY_SHIFT].down)
+                ed->anchor = ed->cursor;
+            ed->preferred_x = -1.0f;
+            ed->last_edit = edit_other;
+        }
+        else if (left->down && nk_input_has_mouse_click_down_in_rect(in, NK_BUTTON_LEFT, area, nk_true) &&
+                 (in->mouse.delta.x != 0.0f || in->mouse.delta.y != 0.0f)) {
+            // Dragging extends the selection, scrolling when it goes past the edge
+            ed->cursor = editor_offset_at(ed, font, area, row_height, in->mouse.pos);
+            ed->preferred_x = -1.0f;
+            ed->follow_cursor = true;
+        }
+
+        editor_handle_keys(ed, in, font, page_lines);
+        editor_layout(ed, font, area.w);
+    }
+
+    // The mouse wheel scrolls a few rows at a time
+    size_t row_count = editor_row_count(ed);
+    float content_height = row_count * row_height;
+    if (in != NULL && nk_input_is_mouse_hovering_rect(in, bounds) && in->mouse.scroll_delta.y != 0.0f) {
+        ed->scroll.y -= in->mouse.scroll_delta.y * row_height * 3.0f;
+        in->mouse.scroll_delta.y = 0.0f;
+    }
+
+    // Keep the cursor in view after it moves
+    size_t start, len;
+    const char* text;
+    if (ed->follow_cursor) {
+        size_t cursor_row = editor_row_of(ed, ed->cursor);
+        float cursor_y = cursor_row * row_height;
+        if (cursor_y < ed->scroll.y)
+            ed->scroll.y = cursor_y;
+        if (cursor_y + row_height > ed->scroll.y + area.h)
+            ed->scroll.y = cursor_y + row_height - area.h;
+
+        text = editor_row_text(ed, cursor_row, &start, &len);
+        float cursor_x = editor_text_width(font, text, ed->cursor - start);
+        float scroll_increment = area.w * 0.25f;
+        if (cursor_x < ed->scroll.x)
+            ed->scroll.x = (float)(int)NK_MAX(0.0f, cursor_x - scroll_increment);
+        if (cursor_x >= ed->scroll.x + area.w)
+            ed->scroll.x = (float)(int)NK_MAX(0.0f, cursor_x - area.w + scroll_increment);
+        if (ed->wrap)
+            ed->scroll.x = 0.0f;
+
+        ed->follow_cursor = false;
+    }
+    ed->scroll.y = NK_CLAMP(0.0f, ed->scroll.y, NK_MAX(0.0f, content_height - area.h));
+
+    // Pick the colors for the state the editor is in
+    const struct nk_style_item* background;
+    struct nk_color text_color, sel_color, sel_text_color, cursor_color;
+    if (ed->active) {
+        background = &style->active;
+        text_color = style->text_active;
+        sel_color = style->selected_hover;
+        sel_text_color = style->selected_text_hover;
+        cursor_color = style->cursor_hover;
+    }
+    else if (hovered) {
+        background = &style->hover;
+        text_color = style->text_hover;
+        sel_color = style->selected_hover;
+        sel_text_color = style->selected_text_hover;
+        cursor_color = style->cursor_hover;
+    }
+    else {
+        background = &style->normal;
+        text_color = style->text_normal;
+        sel_color = style->selected_normal;
+        sel_text_color = style->selected_text_normal;
+        cursor_color = style->cursor_normal;
+    }
+    struct nk_color background_color = background->type == NK_STYLE_ITEM_COLOR ? background->data.color : style->normal.data.color;
+
+    nk_fill_rect(out, bounds, style->rounding, background_color);
+    nk_stroke_rect(out, bounds, style->rounding, style->border, style->border_color);
+
+    // Scrollbar
+    struct nk_rect scroll_bounds = area;
+    scroll_bounds.x = (bounds.x + bounds.w - style->border) - style->scrollbar_size.x;
+    scroll_bounds.w = style->scrollbar_size.x;
+    nk_flags scroll_state;
+    ed->scroll.y = nk_do_scrollbarv(&scroll_state, out, scroll_bounds, 0, ed->scroll.y, content_height,
+                                    scroll_bounds.h * 0.10f, scroll_bounds.h * 0.01f, &style->scrollbar, in, font);
+
+    // Only the rows that are scrolled into view are drawn
+    struct nk_rect old_clip = out->clip;
+    struct nk_rect clip;
+    nk_unify(&clip, &old_clip, area.x, area.y, area.x + area.w, area.y + area.h);
+    nk_push_scissor(out, clip);
+
+    size_t first_row = (size_t)(ed->scroll.y / row_height);
+    size_t last_row = (size_t)((ed->scroll.y + area.h) / row_height) + 1;
+    if (last_row > row_count) last_row = row_count;
+
+    size_t sel_start, sel_end;
+    editor_selection(ed, &sel_start, &sel_end);
+    struct editor_run runs[EDITOR_MAX_RUNS];
+    size_t cursor_row = editor_row_of(ed, ed->cursor);
+
+    for (size_t row = first_row; row < last_row; row++) {
+        text = editor_row_text(ed, row, &start, &len);
+        float x = area.x - ed->scroll.x;
+        float y = area.y + row * row_height - ed->scroll.y;
+
+        // Split the row around the part of it that is selected
+        size_t from = sel_start > start ? sel_start - start : 0;
+        size_t to = sel_end > start ? sel_end - start : 0;
+        if (from > len) from = len;
+        if (to > len) to = len;
+
+        // Unwrapped rows are whole lines, which is what the style function colors
+        int run_count = 0;
+        if (ed->style != NULL && !ed->wrap)
+            run_count = ed->style(ed, row, text, len, text_color, runs, EDITOR_MAX_RUNS, ed->style_arg);
+
+        size_t run_start = 0;
+        for (int i = 0; i < run_count && run_start < len; i++) {
+            size_t run_end = run_start + runs[i].len < len ? run_start + runs[i].len : len;
+            x += editor_draw_run(out, font, x, y, row_height, text, run_start, run_end, from, to,
+                                 background_color, runs[i].color, sel_color, sel_text_color);
+            run_start = run_end;
+        }
+        editor_draw_run(out, font, x, y, row_height, text, run_start, len, from, to,
+                        background_color, text_color, sel_color, sel_text_color);
+
+        if (ed->active && row == cursor_row) {
+            float cursor_x = area.x - ed->scroll.x + editor_text_width(font, text, ed->cursor - start);
+            nk_fill_rect(out, nk_rect(cursor_x, y, style->cursor_size, row_height), 0, cursor_color);
+        }
+    }
+
+    nk_push_scissor(out, old_clip);
+
+    return ed->version != version;
+}
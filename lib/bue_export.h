@@ -0,0 +1,2014 @@
+/******************************************************************************
+ * bue_export -- Exports every page of the open project to HTML in the _site  *
+ *               directory, laid out by the project's page template with the  *
+ *               site navigation, along with the images that the pages use    *
+ *               and smaller copies of the oversized ones. The work is done   *
+ *               in parallel on a pool of worker threads, while the UI shows  *
+ *               how far along it is.                                         *
+ *                                                                            *
+ * Author: 7B Industries                                                      *
+ * License: Apache 2.0                                                        *
+ *                                                                            *
+ * ***************************************************************************/
+
+#include <ctype.h>
+#include <stdatomic.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+// The file in the site directory that records what the last export was built from
+#define EXPORT_MANIFEST ".manifest"
+
+// Identifies a manifest file, with the format version in the last byte
+#define EXPORT_MANIFEST_MAGIC "BUMAN\0\0\4"
+
+// The file in the project root that lays out the exported pages, the built in template is used without it
+#define EXPORT_TEMPLATE "template.html"
+
+// The stylesheet in the project root that is published with the site
+#define EXPORT_STYLESHEET "style.css"
+
+// The deepest that steps are nested in the site navigation
+#define EXPORT_NAV_MAX_DEPTH 8
+
+// Images wider than this get a shrunken copy that the pages show instead
+#define EXPORT_IMAGE_MAX_WIDTH 1600
+
+// The directory in the site that keeps the shrunken copies by the hash of their source
+#define EXPORT_CACHE_DIR ".cache"
+
+// Added to the name of an image in the site to name its shrunken copy, with the width filled in
+#define EXPORT_VARIANT_SUFFIX ".%dw.jpg"
+
+/*
+ * The manifest is a header followed by arrays of fixed size records, and then
+ * a block of NUL terminated strings that the records point into by offset,
+ * the same layout as the project index. Each page keeps the stat data and
+ * hash of its source, the hash of the HTML written for it, and the pages
+ * whose titles and images it used. Each image keeps the stat data and hash of
+ * the file that was published, and the width of its shrunken copy. The header
+ * keeps a hash of the template and navigation that every page was laid out
+ * with.
+ */
+struct manifest_header {
+    char magic[8];
+    uint32_t root_path;  // The project path that the manifest was written for
+    uint32_t number_pages;
+    uint32_t number_deps;
+    uint32_t number_assets;
+    uint32_t strings_size;  // The number of bytes in the string block
+    uint32_t reserved;  // Keeps the records after the header aligned
+    uint64_t layout_hash;  // The hash of the template and the navigation
+};
+
+struct manifest_page {
+    uint32_t path;  // The path to the page's source
+    uint32_t output;  // The path to the HTML written for the page
+    uint32_t first_dep;
+    uint32_t number_deps;
+    int64_t mtime_sec;
+    int64_t mtime_nsec;
+    int64_t size;
+    uint64_t source_hash;
+    uint64_t output_hash;
+};
+
+struct manifest_dep {
+    uint32_t path;  // The path to the page whose title or image was used
+    uint32_t reserved;
+    uint64_t title_hash;  // The hash of the title, 0 if the page had none, or the image's asset_variant_hash
+};
+
+struct manifest_asset {
+    uint32_t path;  // The path to the image in the project
+    uint32_t output;  // The path to the image in the site
+    int64_t mtime_sec;
+    int64_t mtime_nsec;
+    int64_t size;
+    uint64_t hash;
+    int32_t variant_width;  // The width of the shrunken copy, 0 if the image is shown as it is
+    int32_t reserved;
+};
+
+typedef struct export_manifest export_manifest;
+struct export_manifest {
+    void* map;  // The memory mapped manifest file
+    size_t map_size;
+    const struct manifest_header* header;
+    const struct manifest_page* pages;
+    const struct manifest_dep* deps;
+    const struct manifest_asset* assets;
+    const char* strings;
+    uint32_t* page_table;  // Open addressed table of record number + 1 with the pages before the images, zero when empty
+    size_t page_table_capacity;
+};
+
+// How the export of one page went
+enum export_results {export_failed = 0, export_unchanged = 1, export_written = 2};
+
+// Buffers that one worker reuses from page to page
+struct export_scratch {
+    string_buffer src;  // The BuildUp markdown read from the page
+    string_buffer md;  // The markdown with the BuildUp tags handled
+    string_buffer html;  // The HTML that md4c writes
+};
+
+// What an image was published from, to go in the next manifest
+struct asset_record {
+    bool valid;  // Cleared when the image failed, so it is published again next time
+    bool publish;  // Set when the image's copy in the site is out of date
+    int64_t mtime_sec;
+    int64_t mtime_nsec;
+    int64_t size;
+    uint64_t hash;
+    int variant_width;  // The width of the shrunken copy, 0 if the image is shown as it is
+};
+
+// The content of an image, for sorting identical images next to each other
+struct asset_key {
+    uint64_t hash;
+    int64_t size;
+    int index;  // Index of the image in the export's list of images
+};
+
+// Images with the same content, as a run of the export's sorted list of images
+struct asset_group {
+    int first;
+    int count;
+};
+
+// What a page was built from, to go in the next manifest
+struct export_record {
+    bool valid;  // Cleared when the page failed, so it is built again next time
+    int64_t mtime_sec;
+    int64_t mtime_nsec;
+    int64_t size;
+    uint64_t source_hash;
+    uint64_t output_hash;
+    string_buffer deps;  // The dependency list of the page
+};
+
+typedef struct site_export site_export;
+
+// The work of exporting one page, checking one image or publishing one group of images
+struct export_task {
+    site_export* job;  // The export the task belongs to
+    int index;  // Index of the page, image or group in the export's lists
+    unsigned long generation;  // The export that the task was queued for
+};
+
+struct site_export {
+    work_pool pool;  // The threads that render the pages
+    bool pool_running;
+    struct export_scratch* scratch;  // One set of buffers per worker thread
+    atomic_ulong generation;  // Bumped to cancel the running export
+    char* root_path;  // Copy of the path to the project
+    char* site_dir;  // The path to the site directory
+    char** pages;  // Copies of the paths of the pages being exported
+    char** outputs;  // The path of the HTML file for each page
+    int number_pages;
+    int* steps;  // The pages that each page links to as steps, in the order of the links
+    int* first_step;  // Where each page's steps start in steps, with one more entry for the end
+    char** titles;  // The title of each page, or its file name when it has none
+    page_template layout;  // The page template, parsed once for every page
+    page_template nav;  // The site navigation, built once for every page
+    uint64_t layout_hash;  // The hash of the template and the navigation
+    bool layout_current;  // Whether the last export used the same template and navigation
+    struct export_task layout_task;  // The task that builds the template and the navigation
+    struct export_task* tasks;  // One task per page
+    struct export_record* records;  // What each page was built from
+    export_manifest manifest;  // The manifest from the last export
+    unsigned char* manifest_seen;  // Set for each page in the old manifest that is still in the project
+    atomic_bool manifest_dirty;  // Set when a record differs from the one in the old manifest
+    char** assets;  // Copies of the paths of the images that the pages use
+    char** asset_outputs;  // The path of each image in the site
+    int number_assets;
+    int* asset_table;  // Open addressed table of image index + 1 by path, zero when empty
+    size_t asset_table_capacity;
+    struct export_task* asset_tasks;  // One task per image to check and hash it
+    struct asset_record* asset_records;  // What each image was published from
+    unsigned char* manifest_assets_seen;  // Set for each image in the old manifest that is still used
+    struct asset_key* asset_order;  // The images that are published, sorted by content
+    int number_keys;
+    struct asset_group* asset_groups;  // The groups of identical images that need publishing
+    struct export_task* group_tasks;  // One task per group to publish it
+    atomic_bool running;  // Cleared once the last task has written the manifest
+    atomic_int tasks_left;  // The number of queued tasks, which tells the last one that it is last
+    atomic_int checks_left;  // The number of images still to be checked, plus one until the layout is built
+    atomic_int pages_left;  // The number of pages still to be exported
+    atomic_int pages_written;  // The number of pages whose HTML was written
+    atomic_int pages_unchanged;  // The number of pages whose HTML was already up to date
+    atomic_int pages_failed;  // The number of pages that could not be read, parsed or written
+    atomic_int assets_left;  // The number of images still to be published
+    atomic_int assets_copied;  // The number of images copied into the site
+    atomic_int assets_linked;  // The number of images linked to an identical one in the site
+    atomic_int assets_shrunk;  // The number of shrunken copies that had to be encoded
+    atomic_int assets_unchanged;  // The number of images that were already up to date
+    atomic_int assets_failed;  // The number of images that could not be published
+    long started;  // Timestamp, in milliseconds, when the export started
+    atomic_long elapsed;  // How long the export took, in milliseconds, once it is done
+};
+
+site_export exporter;  // Exports the open project to HTML
+
+/******************************************************************************
+ * manifest_path -- Builds the path to a site's manifest file.                *
+ *                                                                            *
+ * Parameters                                                                 *
+ *      out -- Buffer that the path is appended to.                           *
+ *      site_dir -- The path to the site directory.                           *
+ *                                                                            *
+ * Returns                                                                    *
+ *      Nothing                                                               *
+ *****************************************************************************/
+void manifest_path(string_buffer* out, const char* site_dir) {
+    str_buf_append_str(out, site_dir);
+    str_buf_append_str(out, PATH_SEP);
+    str_buf_append_str(out, EXPORT_MANIFEST);
+}
+
+/******************************************************************************
+ * manifest_records_valid -- Checks that every offset and count in the        *
+ *                           manifest points inside of the file, so that a    *
+ *                           damaged manifest is thrown away.                 *
+ *                                                                            *
+ * Parameters                                                                 *
+ *      manifest -- The manifest, with its section pointers set up.           *
+ *                                                                            *
+ * Returns                                                                    *
+ *      A boolean specifying whether or not the manifest can be used.         *
+ *****************************************************************************/
+bool manifest_records_valid(const export_manifest* manifest) {
+    const struct manifest_header* header = manifest->header;
+    uint32_t size = header->strings_size;
+
+    // Every string must end inside of the block
+    if (size == 0 || manifest->strings[size - 1] != '\0' || header->root_path >= size)
+        return false;
+
+    for (uint32_t i = 0; i < header->number_pages; i++) {
+        const struct manifest_page* page = &manifest->pages[i];
+        if (page->path >= size || page->output >= size)
+            return false;
+        if (page->first_dep > header->number_deps || page->number_deps > header->number_deps - page->first_dep)
+            return false;
+    }
+
+    for (uint32_t i = 0; i < header->number_deps; i++) {
+        if (manifest->deps[i].path >= size)
+            return false;
+    }
+
+    for (uint32_t i = 0; i < header->number_assets; i++) {
+        if (manifest->assets[i].path >= size || manifest->assets[i].output >= size)
+            return false;
+    }
+
+    return true;
+}
+
+/******************************************************************************
+ * export_manifest_close -- Unmaps a manifest and frees its lookup table.     *
+ *                                                                            *
+ * Parameters                                                                 *
+ *      manifest -- The manifest to close.                                    *
+ *                                                                            *
+ * Returns                                                                    *
+ *      Nothing                                                               *
+ *****************************************************************************/
+void export_manifest_close(export_manifest* manifest) {
+    if (manifest->map != NULL)
+        munmap(manifest->map, manifest->map_size);
+    free(manifest->page_table);
+    memset(manifest, 0, sizeof(export_manifest));
+}
+
+/******************************************************************************
+ * export_manifest_open -- Maps a site's manifest into memory and checks that *
+ *                         it is whole and was written for this project.      *
+ *                                                                            *
+ * Parameters                                                                 *
+ *      manifest -- The manifest to fill in.                                  *
+ *      site_dir -- The path to the site directory.                           *
+ *      root_path -- The path to the project directory.                       *
+ *                                                                            *
+ * Returns                                                                    *
+ *      A boolean specifying whether or not the manifest can be used.         *
+ *****************************************************************************/
+bool export_manifest_open(export_manifest* manifest, const char* site_dir, const char* root_path) {
+    memset(manifest, 0, sizeof(export_manifest));
+
+    string_buffer path;
+    str_buf_init(&path);
+    manifest_path(&path, site_dir);
+    int fd = open(path.data, O_RDONLY | O_CLOEXEC);
+    str_buf_free(&path);
+    if (fd < 0)
+        return false;
+
+    struct stat st;
+    if (fstat(fd, &st) != 0 || (size_t)st.st_size < sizeof(struct manifest_header)) {
+        close(fd);
+        return false;
+    }
+
+    // The mapping stays good after the descriptor is closed
+    void* map = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (map == MAP_FAILED)
+        return false;
+
+    manifest->map = map;
+    manifest->map_size = st.st_size;
+    manifest->header = map;
+
+    const struct manifest_header* header = manifest->header;
+    if (memcmp(header->magic, EXPORT_MANIFEST_MAGIC, sizeof(header->magic)) != 0) {
+        export_manifest_close(manifest);
+        return false;
+    }
+
+    // Make sure the file is big enough to hold everything the header says it holds
+    uint64_t needed = sizeof(struct manifest_header);
+    needed += (uint64_t)header->number_pages * sizeof(struct manifest_page);
+    needed += (uint64_t)header->number_deps * sizeof(struct manifest_dep);
+    needed += (uint64_t)header->number_assets * sizeof(struct manifest_asset);
+    needed += header->strings_size;
+    if (needed != manifest->map_size) {
+        export_manifest_close(manifest);
+        return false;
+    }
+
+    const char* pos = (const char*)map + sizeof(struct manifest_header);
+    manifest->pages = (const struct manifest_page*)pos;
+    pos += header->number_pages * sizeof(struct manifest_page);
+    manifest->deps = (const struct manifest_dep*)pos;
+    pos += header->number_deps * sizeof(struct manifest_dep);
+    manifest->assets = (const struct manifest_asset*)pos;
+    pos += header->number_assets * sizeof(struct manifest_asset);
+    manifest->strings = pos;
+
+    if (!manifest_records_valid(manifest) || strcmp(manifest->strings + header->root_path, root_path) != 0) {
+        export_manifest_close(manifest);
+        return false;
+    }
+
+    // Set up a table so that pages and images can be found by path
+    uint32_t number_records = header->number_pages + header->number_assets;
+    manifest->page_table_capacity = 16;
+    while (manifest->page_table_capacity < (size_t)number_records * 2)
+        manifest->page_table_capacity *= 2;
+    manifest->page_table = calloc(manifest->page_table_capacity, sizeof(uint32_t));
+
+    for (uint32_t i = 0; i < number_records; i++) {
+        uint32_t path_offset = i < header->number_pages ? manifest->pages[i].path : manifest->assets[i - header->number_pages].path;
+        const char* page_path = manifest->strings + path_offset;
+        size_t slot = (size_t)hash_bytes(page_path, strlen(page_path)) & (manifest->page_table_capacity - 1);
+        while (manifest->page_table[slot] != 0)
+            slot = (slot + 1) & (manifest->page_table_capacity - 1);
+        manifest->page_table[slot] = i + 1;
+    }
+
+    return true;
+}
+
+/******************************************************************************
+ * export_manifest_find -- Looks up a page or image in a manifest.            *
+ *                                                                            *
+ * Parameters                                                                 *
+ *      manifest -- The open manifest.                                        *
+ *      path -- The path to the page's source or the image.                   *
+ *      asset -- Whether to look for an image rather than a page.             *
+ *                                                                            *
+ * Returns                                                                    *
+ *      The index of the page's or image's record, or -1 if it is not in the  *
+ *      manifest.                                                             *
+ *****************************************************************************/
+int export_manifest_find(const export_manifest* manifest, const char* path, bool asset) {
+    if (manifest->page_table == NULL)
+        return -1;
+
+    uint32_t number_pages = manifest->header->number_pages;
+    size_t slot = (size_t)hash_bytes(path, strlen(path)) & (manifest->page_table_capacity - 1);
+    while (manifest->page_table[slot] != 0) {
+        uint32_t index = manifest->page_table[slot] - 1;
+        bool is_asset = index >= number_pages;
+        uint32_t path_offset = is_asset ? manifest->assets[index - number_pages].path : manifest->pages[index].path;
+        if (is_asset == asset && strcmp(manifest->strings + path_offset, path) == 0)
+            return (int)(is_asset ? index - number_pages : index);
+        slot = (slot + 1) & (manifest->page_table_capacity - 1);
+    }
+
+    return -1;
+}
+
+/******************************************************************************
+ * export_find_asset -- Looks up an image that the export publishes.          *
+ *                                                                            *
+ * Parameters                                                                 *
+ *      job -- The export.                                                    *
+ *      path -- The normalized path to the image.                             *
+ *                                                                            *
+ * Returns                                                                    *
+ *      The index of the image in the export's list of images, or -1 if the   *
+ *      export does not publish it.                                           *
+ *****************************************************************************/
+int export_find_asset(const site_export* job, const char* path) {
+    if (job->asset_table == NULL)
+        return -1;
+
+    size_t slot = (size_t)hash_bytes(path, strlen(path)) & (job->asset_table_capacity - 1);
+    while (job->asset_table[slot] != 0) {
+        int index = job->asset_table[slot] - 1;
+        if (strcmp(job->assets[index], path) == 0)
+            return index;
+        slot = (slot + 1) & (job->asset_table_capacity - 1);
+    }
+
+    return -1;
+}
+
+/******************************************************************************
+ * asset_variant_hash -- Sums up how a page shows an image, to go in the      *
+ *                       page's dependencies in place of a title hash.        *
+ *                                                                            *
+ * Parameters                                                                 *
+ *      job -- The export.                                                    *
+ *      asset -- The index of the image.                                      *
+ *                                                                            *
+ * Returns                                                                    *
+ *      A value that changes when the image gets or loses a shrunken copy,    *
+ *      never 0.                                                              *
+ *****************************************************************************/
+uint64_t asset_variant_hash(const site_export* job, int asset) {
+    return ((uint64_t)job->asset_records[asset].variant_width << 1) | 1;
+}
+
+/******************************************************************************
+ * export_variant_path -- Builds the path to the shrunken copy of an image.   *
+ *                                                                            *
+ * Parameters                                                                 *
+ *      out -- The buffer to put the path in.                                 *
+ *      output -- The path to the image in the site.                          *
+ *      width -- The width of the shrunken copy.                              *
+ *                                                                            *
+ * Returns                                                                    *
+ *      Nothing                                                               *
+ *****************************************************************************/
+void export_variant_path(string_buffer* out, const char* output, int width) {
+    char suffix[32];
+    snprintf(suffix, sizeof(suffix), EXPORT_VARIANT_SUFFIX, width);
+    str_buf_append_str(out, output);
+    str_buf_append_str(out, suffix);
+}
+
+/******************************************************************************
+ * export_cache_path -- Builds the path to the cached shrunken copy of an     *
+ *                      image's content.                                      *
+ *                                                                            *
+ * Parameters                                                                 *
+ *      out -- The buffer to put the path in.                                 *
+ *      site_dir -- The path to the site directory.                           *
+ *      hash -- The hash of the image's content.                              *
+ *      width -- The width of the shrunken copy.                              *
+ *                                                                            *
+ * Returns                                                                    *
+ *      Nothing                                                               *
+ *****************************************************************************/
+void export_cache_path(string_buffer* out, const char* site_dir, uint64_t hash, int width) {
+    char name[64];
+    snprintf(name, sizeof(name), "%016llx-%dw.jpg", (unsigned long long)hash, width);
+    str_buf_append_str(out, site_dir);
+    str_buf_append_str(out, PATH_SEP);
+    str_buf_append_str(out, EXPORT_CACHE_DIR);
+    str_buf_append_str(out, PATH_SEP);
+    str_buf_append_str(out, name);
+}
+
+/******************************************************************************
+ * manifest_deps_current -- Checks whether the pages that a page used the     *
+ *                          titles of still have those titles, and the images *
+ *                          it showed are still shown the same way.           *
+ *                                                                            *
+ * Parameters                                                                 *
+ *      job -- The export.                                                    *
+ *      page -- The page's record in the old manifest.                        *
+ *                                                                            *
+ * Returns                                                                    *
+ *      A boolean specifying whether or not all of the dependencies are the   *
+ *      same.                                                                 *
+ *****************************************************************************/
+bool manifest_deps_current(const site_export* job, const struct manifest_page* page) {
+    const export_manifest* manifest = &job->manifest;
+    for (uint32_t i = 0; i < page->number_deps; i++) {
+        const struct manifest_dep* dep = &manifest->deps[page->first_dep + i];
+        const char* dep_path = manifest->strings + dep->path;
+
+        // The images are all checked before the first page is exported
+        int asset = export_find_asset(job, dep_path);
+        if (asset >= 0 ? asset_variant_hash(job, asset) != dep->title_hash : !page_dependency_current(dep_path, dep->title_hash))
+            return false;
+    }
+
+    return true;
+}
+
+/******************************************************************************
+ * export_link_images -- Points the images in a page's HTML at their shrunken *
+ *                       copies, and adds the images that the page shows to   *
+ *                       its dependencies.                                    *
+ *                                                                            *
+ * Parameters                                                                 *
+ *      job -- The export.                                                    *
+ *      page_path -- The path to the page's source.                           *
+ *      scratch -- The buffers of the worker, with the HTML in html. The md   *
+ *                 buffer is used up.                                         *
+ *      deps -- The dependency list of the page.                              *
+ *                                                                            *
+ * Returns                                                                    *
+ *      Nothing                                                               *
+ *****************************************************************************/
+void export_link_images(site_export* job, const char* page_path, struct export_scratch* scratch, string_buffer* deps) {
+    static const char img_tag[] = "<img src=\"";
+    if (job->number_assets == 0 || span_find(scratch->html.data, scratch->html.len, img_tag) == NULL)
+        return;
+
+    // Image paths are relative to the directory that holds the page
+    const char* last_sep = strrchr(page_path, PATH_SEP[0]);
+    size_t dir_len = last_sep ? (size_t)(last_sep - page_path) : 0;
+
+    string_buffer* out = &scratch->md;
+    str_buf_reset(out);
+    const char* pos = scratch->html.data;
+    const char* end = scratch->html.data + scratch->html.len;
+    const char* tag;
+    while ((tag = span_find(pos, end - pos, img_tag)) != NULL) {
+        const char* url = tag + strlen(img_tag);
+        const char* quote = memchr(url, '"', end - url);
+        if (quote == NULL)
+            break;
+
+        // Drop any anchor or query, and undo the escaping that md4c does on URLs
+        const char* url_end = url;
+        while (url_end < quote && *url_end != '#' && *url_end != '?')
+            url_end++;
+
+        string_buffer target;
+        str_buf_init(&target);
+        if (url[0] != PATH_SEP[0]) {
+            str_buf_append(&target, page_path, dir_len);
+            str_buf_append_str(&target, PATH_SEP);
+        }
+        size_t target_start = target.len;
+        for (const char* c = url; c < url_end; c++) {
+            if (*c == '&' && url_end - c >= 5 && memcmp(c, "&amp;", 5) == 0) {
+                str_buf_append_char(&target, '&');
+                c += 4;
+            }
+            else if (*c == '%' && url_end - c >= 3 && isxdigit((unsigned char)c[1]) && isxdigit((unsigned char)c[2])) {
+                char hex[3] = {c[1], c[2], 0};
+                str_buf_append_char(&target, (char)strtol(hex, NULL, 16));
+                c += 2;
+            }
+            else {
+                str_buf_append_char(&target, *c);
+            }
+        }
+
+        int asset = -1;
+        if (link_target_is_local(target.data + target_start, target.len - target_start)) {
+            string_buffer normalized;
+            str_buf_init(&normalized);
+            normalize_path(&normalized, target.data, target.len);
+            asset = export_find_asset(job, normalized.data);
+            str_buf_free(&normalized);
+        }
+        str_buf_free(&target);
+
+        // The suffix goes on the end of the file name, in front of any anchor or query
+        str_buf_append(out, pos, url_end - pos);
+        if (asset >= 0) {
+            add_page_dependency(deps, job->assets[asset], asset_variant_hash(job, asset));
+
+            int width = job->asset_records[asset].variant_width;
+            if (width > 0) {
+                char suffix[32];
+                snprintf(suffix, sizeof(suffix), EXPORT_VARIANT_SUFFIX, width);
+                str_buf_append_str(out, suffix);
+            }
+        }
+        pos = url_end;
+    }
+    str_buf_append(out, pos, end - pos);
+
+    // The rewritten HTML takes the place of the original
+    string_buffer html = scratch->html;
+    scratch->html = scratch->md;
+    scratch->md = html;
+}
+
+/******************************************************************************
+ * export_keep_record -- Carries a page's record over from the old manifest,  *
+ *                       for a page that did not need to be built again.      *
+ *                                                                            *
+ * Parameters                                                                 *
+ *      rec -- The page's record for the new manifest.                        *
+ *      manifest -- The old manifest.                                         *
+ *      old -- The page's record in the old manifest.                         *
+ *      st -- The current stat data of the page's source.                     *
+ *                                                                            *
+ * Returns                                                                    *
+ *      Nothing                                                               *
+ *****************************************************************************/
+void export_keep_record(struct export_record* rec, const export_manifest* manifest, const struct manifest_page* old, const struct stat* st) {
+    rec->valid = true;
+    rec->mtime_sec = st->st_mtim.tv_sec;
+    rec->mtime_nsec = st->st_mtim.tv_nsec;
+    rec->size = st->st_size;
+    rec->source_hash = old->source_hash;
+    rec->output_hash = old->output_hash;
+
+    str_buf_reset(&rec->deps);
+    for (uint32_t i = 0; i < old->number_deps; i++) {
+        const struct manifest_dep* dep = &manifest->deps[old->first_dep + i];
+        add_page_dependency(&rec->deps, manifest->strings + dep->path, dep->title_hash);
+    }
+}
+
+/******************************************************************************
+ * export_page -- Renders one page to HTML, lays it out with the template and *
+ *                writes it to the site, unless the manifest shows that the   *
+ *                HTML is already up to date.                                 *
+ *                                                                            *
+ * Parameters                                                                 *
+ *      job -- The export.                                                    *
+ *      page -- Index of the page in the export's list of pages.              *
+ *      scratch -- The buffers of the worker doing the export.                *
+ *                                                                            *
+ * Returns                                                                    *
+ *      One of the export_results.                                            *
+ *****************************************************************************/
+int export_page(site_export* job, int page, struct export_scratch* scratch) {
+    const char* path = job->pages[page];
+    struct export_record* rec = &job->records[page];
+
+    struct stat st;
+    if (stat(path, &st) != 0)
+        return export_failed;
+
+    // The page can only be skipped if its last HTML is still there and used the same titles
+    int old_index = export_manifest_find(&job->manifest, path, false);
+    const struct manifest_page* old = NULL;
+    bool reusable = false;
+    if (old_index >= 0) {
+        job->manifest_seen[old_index] = 1;
+        old = &job->manifest.pages[old_index];
+
+        struct stat out_st;
+        reusable = job->layout_current && stat(job->outputs[page], &out_st) == 0 && manifest_deps_current(job, old);
+    }
+
+    // Matching stat data means the source has not been touched since it was built
+    if (reusable && old->size == st.st_size && old->mtime_sec == st.st_mtim.tv_sec && old->mtime_nsec == st.st_mtim.tv_nsec) {
+        export_keep_record(rec, &job->manifest, old, &st);
+        return export_unchanged;
+    }
+    atomic_store(&job->manifest_dirty, true);
+
+    str_buf_reset(&scratch->src);
+    str_buf_reset(&scratch->md);
+    str_buf_reset(&scratch->html);
+
+    if (!read_whole_file(path, &scratch->src))
+        return export_failed;
+
+    // A source that was touched without being changed does not need to be built again either
+    uint64_t source_hash = hash_bytes(scratch->src.data, scratch->src.len);
+    if (reusable && old->source_hash == source_hash) {
+        export_keep_record(rec, &job->manifest, old, &st);
+        return export_unchanged;
+    }
+
+    // Handle the BuildUp tags and convert the page the same way as the preview does
+    str_buf_reset(&rec->deps);
+    struct md_userdata userdata = {.name = "Name", .output = &scratch->html};
+    preprocess_span(&scratch->md, scratch->src.data, scratch->src.len, path, &rec->deps);
+    if (md_html(scratch->md.data, (MD_SIZE)scratch->md.len, process_output, (void*)&userdata, parser_flags, renderer_flags) == -1)
+        return export_failed;
+    export_link_images(job, path, scratch, &rec->deps);
+
+    // Every page is one level further from the root of the site for each directory it is in
+    string_buffer root;
+    str_buf_init(&root);
+    for (const char* c = job->outputs[page] + strlen(job->site_dir) + 1; *c != '\0'; c++) {
+        if (*c == PATH_SEP[0])
+            str_buf_append_str(&root, "../");
+    }
+
+    // Put the page together around its HTML, with the navigation shared by every page
+    struct template_values values = {job->titles[page], scratch->html.data ? scratch->html.data : "", scratch->html.len, root.data ? root.data : "", page, &job->nav};
+    str_buf_reset(&scratch->md);
+    template_render(&scratch->md, &job->layout, &values);
+    str_buf_free(&root);
+
+    string_buffer html = scratch->html;
+    scratch->html = scratch->md;
+    scratch->md = html;
+
+    rec->mtime_sec = st.st_mtim.tv_sec;
+    rec->mtime_nsec = st.st_mtim.tv_nsec;
+    rec->size = st.st_size;
+    rec->source_hash = source_hash;
+    rec->output_hash = hash_bytes(scratch->html.data, scratch->html.len);
+
+    // Leave the file alone if the new HTML is the same as what is there, so its modification time holds still
+    struct stat out_st;
+    if (old != NULL && old->output_hash == rec->output_hash && stat(job->outputs[page], &out_st) == 0) {
+        rec->valid = true;
+        return export_unchanged;
+    }
+
+    if (!write_file_atomic(job->outputs[page], scratch->html.data ? scratch->html.data : "", scratch->html.len))
+        return export_failed;
+
+    rec->valid = true;
+    return export_written;
+}
+
+/******************************************************************************
+ * asset_content_compare -- Orders images by their content, for bsearch.      *
+ *                                                                            *
+ * Parameters                                                                 *
+ *      a -- The first asset_key.                                             *
+ *      b -- The second asset_key.                                            *
+ *                                                                            *
+ * Returns                                                                    *
+ *      Less than, equal to, or greater than zero as the first image sorts    *
+ *      before, with, or after the second.                                    *
+ *****************************************************************************/
+int asset_content_compare(const void* a, const void* b) {
+    const struct asset_key* key_a = a;
+    const struct asset_key* key_b = b;
+
+    if (key_a->hash != key_b->hash)
+        return key_a->hash < key_b->hash ? -1 : 1;
+    if (key_a->size != key_b->size)
+        return key_a->size < key_b->size ? -1 : 1;
+    return 0;
+}
+
+/******************************************************************************
+ * asset_key_compare -- Orders images by their content, and images with the   *
+ *                      same content by index, for qsort.                     *
+ *                                                                            *
+ * Parameters                                                                 *
+ *      a -- The first asset_key.                                             *
+ *      b -- The second asset_key.                                            *
+ *                                                                            *
+ * Returns                                                                    *
+ *      Less than, equal to, or greater than zero as the first image sorts    *
+ *      before, with, or after the second.                                    *
+ *****************************************************************************/
+int asset_key_compare(const void* a, const void* b) {
+    int order = asset_content_compare(a, b);
+    if (order != 0)
+        return order;
+    return ((const struct asset_key*)a)->index - ((const struct asset_key*)b)->index;
+}
+
+/******************************************************************************
+ * export_save_manifest -- Writes the manifest for a finished export, and     *
+ *                         removes the HTML of pages that are no longer in    *
+ *                         the project, the images no page uses anymore, and  *
+ *                         cached copies that no image has the content of.    *
+ *                                                                            *
+ * Parameters                                                                 *
+ *      job -- The export.                                                    *
+ *                                                                            *
+ * Returns                                                                    *
+ *      A boolean specifying whether or not the manifest was written.         *
+ *****************************************************************************/
+bool export_save_manifest(site_export* job) {
+    string_buffer pages;
+    string_buffer deps;
+    string_buffer assets;
+    string_buffer strings;
+    str_buf_init(&pages);
+    str_buf_init(&deps);
+    str_buf_init(&assets);
+    str_buf_init(&strings);
+
+    struct manifest_header header;
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, EXPORT_MANIFEST_MAGIC, sizeof(header.magic));
+    header.root_path = (uint32_t)strings.len;
+    header.layout_hash = job->layout_hash;
+    str_buf_append(&strings, job->root_path, strlen(job->root_path) + 1);
+
+    for (int i = 0; i < job->number_pages; i++) {
+        struct export_record* rec = &job->records[i];
+        if (!rec->valid)
+            continue;
+
+        struct manifest_page page = {0};
+        page.path = (uint32_t)strings.len;
+        str_buf_append(&strings, job->pages[i], strlen(job->pages[i]) + 1);
+        page.output = (uint32_t)strings.len;
+        str_buf_append(&strings, job->outputs[i], strlen(job->outputs[i]) + 1);
+        page.first_dep = header.number_deps;
+        page.mtime_sec = rec->mtime_sec;
+        page.mtime_nsec = rec->mtime_nsec;
+        page.size = rec->size;
+        page.source_hash = rec->source_hash;
+        page.output_hash = rec->output_hash;
+
+        const char* pos = rec->deps.data;
+        const char* end = rec->deps.data + rec->deps.len;
+        struct manifest_dep dep = {0};
+        const char* dep_path;
+        while (next_page_dependency(&pos, end, &dep_path, &dep.title_hash)) {
+            dep.path = (uint32_t)strings.len;
+            str_buf_append(&strings, dep_path, strlen(dep_path) + 1);
+            str_buf_append(&deps, (const char*)&dep, sizeof(dep));
+            page.number_deps++;
+        }
+
+        header.number_deps += page.number_deps;
+        header.number_pages++;
+        str_buf_append(&pages, (const char*)&page, sizeof(page));
+    }
+
+    for (int i = 0; i < job->number_assets; i++) {
+        struct asset_record* rec = &job->asset_records[i];
+        if (!rec->valid)
+            continue;
+
+        struct manifest_asset asset = {0};
+        asset.path = (uint32_t)strings.len;
+        str_buf_append(&strings, job->assets[i], strlen(job->assets[i]) + 1);
+        asset.output = (uint32_t)strings.len;
+        str_buf_append(&strings, job->asset_outputs[i], strlen(job->asset_outputs[i]) + 1);
+        asset.mtime_sec = rec->mtime_sec;
+        asset.mtime_nsec = rec->mtime_nsec;
+        asset.size = rec->size;
+        asset.hash = rec->hash;
+        asset.variant_width = rec->variant_width;
+
+        header.number_assets++;
+        str_buf_append(&assets, (const char*)&asset, sizeof(asset));
+    }
+    header.strings_size = (uint32_t)strings.len;
+
+    // Pages that were removed or renamed would otherwise leave their HTML behind
+    const export_manifest* old = &job->manifest;
+    bool changed = old->header == NULL || old->header->number_pages != header.number_pages || !job->layout_current || atomic_load(&job->manifest_dirty);
+    for (uint32_t i = 0; old->header != NULL && i < old->header->number_pages; i++) {
+        if (!job->manifest_seen[i]) {
+            remove(old->strings + old->pages[i].output);
+            changed = true;
+        }
+    }
+
+    // The same goes for images that no page uses anymore, and their shrunken copies
+    changed = changed || (old->header != NULL && old->header->number_assets != header.number_assets);
+    for (uint32_t i = 0; old->header != NULL && i < old->header->number_assets; i++) {
+        const struct manifest_asset* asset = &old->assets[i];
+        if (!job->manifest_assets_seen[i]) {
+            remove(old->strings + asset->output);
+            if (asset->variant_width > 0) {
+                string_buffer variant;
+                str_buf_init(&variant);
+                export_variant_path(&variant, old->strings + asset->output, asset->variant_width);
+                remove(variant.data);
+                str_buf_free(&variant);
+            }
+            changed = true;
+        }
+
+        // A cached copy is kept for as long as some image still has that content
+        struct asset_key key = {asset->hash, asset->size, -1};
+        const struct asset_key* match = job->number_keys == 0 ? NULL : bsearch(&key, job->asset_order, job->number_keys, sizeof(struct asset_key), asset_content_compare);
+        if (asset->variant_width > 0 && (match == NULL || job->asset_records[match->index].variant_width != asset->variant_width)) {
+            string_buffer cached;
+            str_buf_init(&cached);
+            export_cache_path(&cached, job->site_dir, asset->hash, asset->variant_width);
+            remove(cached.data);
+            str_buf_free(&cached);
+        }
+    }
+
+    // Put the sections together in the order they are read back in
+    string_buffer out;
+    str_buf_init(&out);
+    str_buf_append(&out, (const char*)&header, sizeof(header));
+    str_buf_append(&out, pages.data, pages.len);
+    str_buf_append(&out, deps.data, deps.len);
+    str_buf_append(&out, assets.data, assets.len);
+    str_buf_append(&out, strings.data, strings.len);
+
+    // A manifest that would come out the same is not written again
+    string_buffer path;
+    str_buf_init(&path);
+    manifest_path(&path, job->site_dir);
+    bool ok = !changed || write_file_atomic(path.data, out.data, out.len);
+    if (!ok)
+        printf("Unable to write the export manifest to %s.\n", path.data);
+
+    str_buf_free(&path);
+    str_buf_free(&out);
+    str_buf_free(&pages);
+    str_buf_free(&deps);
+    str_buf_free(&assets);
+    str_buf_free(&strings);
+
+    return ok;
+}
+
+/******************************************************************************
+ * export_task_done -- Counts off a finished task. The last task of the       *
+ *                     export also writes the manifest.                       *
+ *                                                                            *
+ * Parameters                                                                 *
+ *      job -- The export.                                                    *
+ *      generation -- The export that the task was queued for.                *
+ *                                                                            *
+ * Returns                                                                    *
+ *      Nothing                                                               *
+ *****************************************************************************/
+void export_task_done(site_export* job, unsigned long generation) {
+    // Every other task is done by now, so the records can be read without a lock
+    if (atomic_fetch_sub(&job->tasks_left, 1) == 1) {
+        if (atomic_load(&job->generation) == generation)
+            export_save_manifest(job);
+        atomic_store(&job->elapsed, timestamp() - job->started);
+        atomic_store(&job->running, false);
+    }
+
+    // Let the UI move the progress bar along
+    wakeup_signal();
+}
+
+/******************************************************************************
+ * export_page_task -- Exports one page on a worker thread.                   *
+ *                                                                            *
+ * Parameters                                                                 *
+ *      arg -- The export_task for the page.                                  *
+ *      worker -- The index of the worker running the task.                   *
+ *                                                                            *
+ * Returns                                                                    *
+ *      Nothing                                                               *
+ *****************************************************************************/
+void export_page_task(void* arg, int worker) {
+    struct export_task* task = arg;
+    site_export* job = task->job;
+
+    // Skip the page if the export was cancelled before it got here
+    if (atomic_load(&job->generation) == task->generation) {
+        int result = export_page(job, task->index, &job->scratch[worker]);
+        if (result == export_written)
+            atomic_fetch_add(&job->pages_written, 1);
+        else if (result == export_unchanged)
+            atomic_fetch_add(&job->pages_unchanged, 1);
+        else
+            atomic_fetch_add(&job->pages_failed, 1);
+    }
+
+    atomic_fetch_sub(&job->pages_left, 1);
+    export_task_done(job, task->generation);
+}
+
+/******************************************************************************
+ * asset_hash_file -- Hashes the content of a file without copying it into    *
+ *                    memory.                                                 *
+ *                                                                            *
+ * Parameters                                                                 *
+ *      path -- The path to the file.                                         *
+ *      hash -- Where to put the hash.                                        *
+ *                                                                            *
+ * Returns                                                                    *
+ *      A boolean specifying whether or not the file could be read.           *
+ *****************************************************************************/
+bool asset_hash_file(const char* path, uint64_t* hash) {
+    int fd = open(path, O_RDONLY);
+    if (fd < 0)
+        return false;
+
+    struct stat st;
+    if (fstat(fd, &st) != 0) {
+        close(fd);
+        return false;
+    }
+
+    if (st.st_size == 0) {
+        close(fd);
+        *hash = hash_bytes("", 0);
+        return true;
+    }
+
+    void* map = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (map == MAP_FAILED)
+        return false;
+
+    *hash = hash_bytes(map, st.st_size);
+    munmap(map, st.st_size);
+
+    return true;
+}
+
+/******************************************************************************
+ * asset_files_match -- Compares the bytes of two images. Images are grouped  *
+ *                      by hash, and a matching hash is only very likely to   *
+ *                      mean matching content.                                *
+ *                                                                            *
+ * Parameters                                                                 *
+ *      path_a -- The path to the first image.                                *
+ *      path_b -- The path to the second image.                               *
+ *                                                                            *
+ * Returns                                                                    *
+ *      A boolean specifying whether or not both could be read and are the    *
+ *      same.                                                                 *
+ *****************************************************************************/
+bool asset_files_match(const char* path_a, const char* path_b) {
+    int fd_a = open(path_a, O_RDONLY);
+    int fd_b = open(path_b, O_RDONLY);
+    struct stat st_a;
+    struct stat st_b;
+    bool ok = fd_a >= 0 && fd_b >= 0 && fstat(fd_a, &st_a) == 0 && fstat(fd_b, &st_b) == 0 && st_a.st_size == st_b.st_size;
+
+    // Links to the same file, and empty files, have nothing to compare
+    bool match = ok && ((st_a.st_dev == st_b.st_dev && st_a.st_ino == st_b.st_ino) || st_a.st_size == 0);
+    if (ok && !match) {
+        void* map_a = mmap(NULL, st_a.st_size, PROT_READ, MAP_PRIVATE, fd_a, 0);
+        void* map_b = mmap(NULL, st_b.st_size, PROT_READ, MAP_PRIVATE, fd_b, 0);
+        match = map_a != MAP_FAILED && map_b != MAP_FAILED && memcmp(map_a, map_b, st_a.st_size) == 0;
+        if (map_a != MAP_FAILED)
+            munmap(map_a, st_a.st_size);
+        if (map_b != MAP_FAILED)
+            munmap(map_b, st_b.st_size);
+    }
+
+    if (fd_a >= 0)
+        close(fd_a);
+    if (fd_b >= 0)
+        close(fd_b);
+
+    return match;
+}
+
+/******************************************************************************
+ * export_write_variant -- Encodes the shrunken copy of an image straight     *
+ *                         into the site, for an image whose hash is shared   *
+ *                         with different content and so cannot use the       *
+ *                         cache.                                             *
+ *                                                                            *
+ * Parameters                                                                 *
+ *      job -- The export.                                                    *
+ *      asset -- The index of the image.                                      *
+ *      variant -- The path of the shrunken copy in the site.                 *
+ *                                                                            *
+ * Returns                                                                    *
+ *      A boolean specifying whether or not the copy was written.             *
+ *****************************************************************************/
+bool export_write_variant(site_export* job, int asset, const char* variant) {
+    string_buffer jpeg;
+    str_buf_init(&jpeg);
+    bool ok = image_shrink_to_jpeg(job->assets[asset], job->asset_records[asset].variant_width, &jpeg) && write_file_atomic(variant, jpeg.data, jpeg.len);
+    str_buf_free(&jpeg);
+
+    if (ok)
+        atomic_fetch_add(&job->assets_shrunk, 1);
+
+    return ok;
+}
+
+/******************************************************************************
+ * export_prepare_variant -- Makes sure the cache has the shrunken copy of a  *
+ *                           group of identical images, encoding it if it is  *
+ *                           not there yet.                                   *
+ *                                                                            *
+ * Parameters                                                                 *
+ *      job -- The export.                                                    *
+ *      asset -- The index of one of the images in the group.                 *
+ *      cached -- The buffer to put the path to the cached copy in.           *
+ *                                                                            *
+ * Returns                                                                    *
+ *      A boolean specifying whether or not the cached copy is there.         *
+ *****************************************************************************/
+bool export_prepare_variant(site_export* job, int asset, string_buffer* cached) {
+    struct asset_record* rec = &job->asset_records[asset];
+    export_cache_path(cached, job->site_dir, rec->hash, rec->variant_width);
+
+    // Another image with this content, or an earlier export, may have made it already
+    struct stat st;
+    if (stat(cached->data, &st) == 0)
+        return true;
+
+    string_buffer jpeg;
+    str_buf_init(&jpeg);
+    bool ok = image_shrink_to_jpeg(job->assets[asset], rec->variant_width, &jpeg) && write_file_atomic(cached->data, jpeg.data, jpeg.len);
+    str_buf_free(&jpeg);
+
+    if (ok)
+        atomic_fetch_add(&job->assets_shrunk, 1);
+    else
+        printf("Unable to shrink %s for the site.\n", job->assets[asset]);
+
+    return ok;
+}
+
+/******************************************************************************
+ * export_publish_group_task -- Publishes a group of identical images on a    *
+ *                              worker thread. The content goes into the site *
+ *                              once, and the rest of the group are hard      *
+ *                              links to that copy once their bytes are       *
+ *                              checked to match. The same goes for the       *
+ *                              group's shrunken copy.                        *
+ *                                                                            *
+ * Parameters                                                                 *
+ *      arg -- The export_task for the group.                                 *
+ *      worker -- The index of the worker running the task.                   *
+ *                                                                            *
+ * Returns                                                                    *
+ *      Nothing                                                               *
+ *****************************************************************************/
+void export_publish_group_task(void* arg, int worker) {
+    (void)worker;
+    struct export_task* task = arg;
+    site_export* job = task->job;
+
+    // Skip the group if the export was cancelled before it got here
+    if (atomic_load(&job->generation) == task->generation) {
+        struct asset_group* group = &job->asset_groups[task->index];
+
+        // A copy that is already up to date saves copying the content at all
+        int source = -1;
+        for (int i = 0; i < group->count && source < 0; i++) {
+            int asset = job->asset_order[group->first + i].index;
+            if (!job->asset_records[asset].publish)
+                source = asset;
+        }
+        for (int i = 0; i < group->count && source < 0; i++)
+            source = job->asset_order[group->first + i].index;
+        bool source_ready = !job->asset_records[source].publish;
+
+        // Identical images are the same size, so they share one shrunken copy
+        string_buffer cached;
+        string_buffer variant;
+        str_buf_init(&cached);
+        bool has_variant = job->asset_records[source].variant_width > 0;
+        bool variant_ready = has_variant && export_prepare_variant(job, source, &cached);
+
+        for (int i = 0; i < group->count; i++) {
+            int asset = job->asset_order[group->first + i].index;
+            struct asset_record* rec = &job->asset_records[asset];
+            if (!rec->publish)
+                continue;
+
+            // An image whose hash only collides with the group's is published on its own
+            bool same = asset == source || asset_files_match(job->assets[source], job->assets[asset]);
+
+            // Linking can fail across file systems, so fall back to a copy
+            bool linked = same && source_ready && link_file_atomic(job->asset_outputs[source], job->asset_outputs[asset]);
+            bool ok = linked || copy_file_atomic(job->assets[asset], job->asset_outputs[asset]);
+            if (ok && asset == source)
+                source_ready = true;
+
+            if (ok && rec->variant_width > 0) {
+                str_buf_init(&variant);
+                export_variant_path(&variant, job->asset_outputs[asset], rec->variant_width);
+                if (same)
+                    ok = variant_ready && (link_file_atomic(cached.data, variant.data) || copy_file_atomic(cached.data, variant.data));
+                else
+                    ok = export_write_variant(job, asset, variant.data);
+                str_buf_free(&variant);
+            }
+
+            if (!ok) {
+                printf("Unable to copy %s into the site.\n", job->assets[asset]);
+                rec->valid = false;
+                atomic_fetch_add(&job->assets_failed, 1);
+            }
+            else if (linked) {
+                atomic_fetch_add(&job->assets_linked, 1);
+            }
+            else {
+                atomic_fetch_add(&job->assets_copied, 1);
+            }
+            atomic_fetch_sub(&job->assets_left, 1);
+        }
+
+        str_buf_free(&cached);
+    }
+
+    export_task_done(job, task->generation);
+}
+
+/******************************************************************************
+ * export_queue_publish -- Sorts the checked images by content and queues a   *
+ *                         task for each group of identical images that has   *
+ *                         something to publish, followed by the pages. The   *
+ *                         pages wait for the images to be checked since they *
+ *                         need to know which images have shrunken copies.    *
+ *                                                                            *
+ * Parameters                                                                 *
+ *      job -- The export.                                                    *
+ *      generation -- The export that the images were checked for.            *
+ *                                                                            *
+ * Returns                                                                    *
+ *      Nothing                                                               *
+ *****************************************************************************/
+void export_queue_publish(site_export* job, unsigned long generation) {
+    if (atomic_load(&job->generation) != generation)
+        return;
+
+    int number_keys = 0;
+    for (int i = 0; i < job->number_assets; i++) {
+        struct asset_record* rec = &job->asset_records[i];
+        if (rec->valid)
+            job->asset_order[number_keys++] = (struct asset_key){rec->hash, rec->size, i};
+    }
+    qsort(job->asset_order, number_keys, sizeof(struct asset_key), asset_key_compare);
+    job->number_keys = number_keys;
+
+    // Only the groups with an image to publish need a task
+    int number_groups = 0;
+    for (int first = 0, last; first < number_keys; first = last) {
+        bool publish = false;
+        for (last = first; last < number_keys && asset_content_compare(&job->asset_order[last], &job->asset_order[first]) == 0; last++)
+            publish = publish || job->asset_records[job->asset_order[last].index].publish;
+
+        if (publish)
+            job->asset_groups[number_groups++] = (struct asset_group){first, last - first};
+    }
+
+    // Counted before any are queued, so that none of them can be taken for the last task
+    atomic_fetch_add(&job->tasks_left, number_groups + job->number_pages);
+    for (int i = 0; i < number_groups; i++) {
+        job->group_tasks[i] = (struct export_task){job, i, generation};
+        pool_submit(&job->pool, export_publish_group_task, &job->group_tasks[i]);
+    }
+    for (int i = 0; i < job->number_pages; i++) {
+        job->tasks[i] = (struct export_task){job, i, generation};
+        pool_submit(&job->pool, export_page_task, &job->tasks[i]);
+    }
+}
+
+/******************************************************************************
+ * export_nav_add_link -- Adds a link to a page to the navigation.            *
+ *                                                                            *
+ * Parameters                                                                 *
+ *      job -- The export.                                                    *
+ *      page -- The index of the page.                                        *
+ *                                                                            *
+ * Returns                                                                    *
+ *      Nothing                                                               *
+ *****************************************************************************/
+void export_nav_add_link(site_export* job, int page) {
+    page_template* nav = &job->nav;
+
+    // The link is relative to the root of the site, which the page fills in
+    template_add_text(nav, "<a href=\"", strlen("<a href=\""));
+    template_add(nav, template_root, -1);
+    string_buffer href;
+    str_buf_init(&href);
+    for (const char* c = job->outputs[page] + strlen(job->site_dir) + 1; *c != '\0'; c++) {
+        if (*c == PATH_SEP[0])
+            str_buf_append_char(&href, '/');
+        else if (*c == ' ')
+            str_buf_append_str(&href, "%20");
+        else
+            str_buf_append_char(&href, *c);
+    }
+    template_add_escaped(nav, href.data);
+    str_buf_free(&href);
+    template_add_text(nav, "\"", 1);
+    template_add(nav, template_current, page);
+    template_add_text(nav, ">", 1);
+    template_add_escaped(nav, job->titles[page]);
+    template_add_text(nav, "</a>", strlen("</a>"));
+}
+
+/******************************************************************************
+ * export_nav_add_page -- Adds the link to a page to the navigation, followed *
+ *                        by its steps. Each page's steps are listed under it *
+ *                        only once, so a step of several pages is a plain    *
+ *                        link under the others, and the steps stop nesting   *
+ *                        at EXPORT_NAV_MAX_DEPTH.                            *
+ *                                                                            *
+ * Parameters                                                                 *
+ *      job -- The export.                                                    *
+ *      page -- The index of the page.                                        *
+ *      open -- Has bit 1 set for each page that is being added further up,   *
+ *              so that steps that link back around are left out, and bit 2   *
+ *              set for each page that has been added with its steps.         *
+ *      depth -- How many pages further up the page is being added under.     *
+ *                                                                            *
+ * Returns                                                                    *
+ *      Nothing                                                               *
+ *****************************************************************************/
+void export_nav_add_page(site_export* job, int page, unsigned char* open, int depth) {
+    page_template* nav = &job->nav;
+    open[page] |= 3;
+
+    template_add_text(nav, "<li>", strlen("<li>"));
+    export_nav_add_link(job, page);
+
+    bool has_steps = false;
+    for (int i = job->first_step[page]; i < job->first_step[page + 1]; i++) {
+        int step = job->steps[i];
+        if (open[step] & 1)
+            continue;
+
+        if (!has_steps)
+            template_add_text(nav, "\n<ul>\n", strlen("\n<ul>\n"));
+        has_steps = true;
+
+        // A step that is too deep to nest is left for the top level, where it is listed with its own steps
+        if ((open[step] & 2) || depth + 1 >= EXPORT_NAV_MAX_DEPTH) {
+            template_add_text(nav, "<li>", strlen("<li>"));
+            export_nav_add_link(job, step);
+            template_add_text(nav, "</li>\n", strlen("</li>\n"));
+        }
+        else {
+            export_nav_add_page(job, step, open, depth + 1);
+        }
+    }
+    if (has_steps)
+        template_add_text(nav, "</ul>\n", strlen("</ul>\n"));
+    template_add_text(nav, "</li>\n", strlen("</li>\n"));
+
+    open[page] &= ~1;
+}
+
+/******************************************************************************
+ * export_publish_stylesheet -- Copies the project's stylesheet into the site *
+ *                              when it is newer than the copy there.         *
+ *                                                                            *
+ * Parameters                                                                 *
+ *      job -- The export.                                                    *
+ *                                                                            *
+ * Returns                                                                    *
+ *      Nothing                                                               *
+ *****************************************************************************/
+void export_publish_stylesheet(site_export* job) {
+    string_buffer source;
+    string_buffer output;
+    str_buf_init(&source);
+    str_buf_init(&output);
+    str_buf_append_str(&source, job->root_path);
+    str_buf_append_str(&source, PATH_SEP);
+    str_buf_append_str(&source, EXPORT_STYLESHEET);
+    str_buf_append_str(&output, job->site_dir);
+    str_buf_append_str(&output, PATH_SEP);
+    str_buf_append_str(&output, EXPORT_STYLESHEET);
+
+    struct stat st;
+    struct stat out_st;
+    if (stat(source.data, &st) == 0) {
+        bool current = stat(output.data, &out_st) == 0 && out_st.st_size == st.st_size && (out_st.st_mtim.tv_sec > st.st_mtim.tv_sec || (out_st.st_mtim.tv_sec == st.st_mtim.tv_sec && out_st.st_mtim.tv_nsec >= st.st_mtim.tv_nsec));
+        if (!current && !copy_file_atomic(source.data, output.data))
+            printf("Unable to copy %s into the site.\n", source.data);
+    }
+
+    str_buf_free(&source);
+    str_buf_free(&output);
+}
+
+/******************************************************************************
+ * export_build_layout_task -- Reads the titles of the pages, and builds the  *
+ *                             site navigation and parses the page template   *
+ *                             on a worker thread. This runs alongside the    *
+ *                             image checks, and the pages wait for both.     *
+ *                                                                            *
+ * Parameters                                                                 *
+ *      arg -- The export_task for the layout.                                *
+ *      worker -- The index of the worker running the task.                   *
+ *                                                                            *
+ * Returns                                                                    *
+ *      Nothing                                                               *
+ *****************************************************************************/
+void export_build_layout_task(void* arg, int worker) {
+    (void)worker;
+    struct export_task* task = arg;
+    site_export* job = task->job;
+
+    // Skip the layout if the export was cancelled before it got here
+    if (atomic_load(&job->generation) == task->generation) {
+        // A page without a title goes by its file name in the navigation
+        for (int i = 0; i < job->number_pages; i++) {
+            string_buffer title;
+            str_buf_init(&title);
+            if (!title_cache_lookup(job->pages[i], &title)) {
+                const char* name = strrchr(job->pages[i], PATH_SEP[0]);
+                name = name != NULL ? name + 1 : job->pages[i];
+                str_buf_append(&title, name, strlen(name) - strlen(".md"));
+            }
+            job->titles[i] = str_buf_detach(&title);
+        }
+
+        // Pages that are steps of another page are listed under it rather than on their own
+        unsigned char* is_step = calloc(job->number_pages, 1);
+        unsigned char* open = calloc(job->number_pages, 1);
+        if (is_step == NULL || open == NULL) {
+            printf("Unable to allocate memory for the export.\n");
+            exit(EXIT_FAILURE);
+        }
+        for (int i = 0; i < job->first_step[job->number_pages]; i++)
+            is_step[job->steps[i]] = 1;
+
+        template_add_text(&job->nav, "<ul>\n", strlen("<ul>\n"));
+        for (int i = 0; i < job->number_pages; i++) {
+            if (!is_step[i])
+                export_nav_add_page(job, i, open, 0);
+        }
+
+        // Steps that only link around in a loop, or were too deep to nest, start again from the top
+        for (int i = 0; i < job->number_pages; i++) {
+            if (!(open[i] & 2))
+                export_nav_add_page(job, i, open, 0);
+        }
+        template_add_text(&job->nav, "</ul>\n", strlen("</ul>\n"));
+        free(is_step);
+        free(open);
+
+        string_buffer path;
+        string_buffer source;
+        str_buf_init(&path);
+        str_buf_init(&source);
+        str_buf_append_str(&path, job->root_path);
+        str_buf_append_str(&path, PATH_SEP);
+        str_buf_append_str(&path, EXPORT_TEMPLATE);
+        if (!read_whole_file(path.data, &source)) {
+            str_buf_reset(&source);
+            str_buf_append_str(&source, template_default);
+        }
+        template_parse(&job->layout, source.data, source.len);
+
+        // Every page has to be laid out again when the template or the navigation changes
+        uint64_t hashes[2] = {hash_bytes(source.data, source.len), hash_bytes(job->nav.text.data, job->nav.text.len)};
+        job->layout_hash = hash_bytes(hashes, sizeof(hashes));
+        job->layout_current = job->manifest.header != NULL && job->manifest.header->layout_hash == job->layout_hash;
+        str_buf_free(&path);
+        str_buf_free(&source);
+
+        export_publish_stylesheet(job);
+    }
+
+    if (atomic_fetch_sub(&job->checks_left, 1) == 1)
+        export_queue_publish(job, task->generation);
+    export_task_done(job, task->generation);
+}
+
+/******************************************************************************
+ * export_variant_exists -- Checks that an image's shrunken copy is still in  *
+ *                          the site.                                         *
+ *                                                                            *
+ * Parameters                                                                 *
+ *      job -- The export.                                                    *
+ *      asset -- The index of the image.                                      *
+ *      width -- The width of the shrunken copy, 0 if the image has none.     *
+ *                                                                            *
+ * Returns                                                                    *
+ *      A boolean specifying whether or not the copy is there, true if there  *
+ *      is no copy to look for.                                               *
+ *****************************************************************************/
+bool export_variant_exists(site_export* job, int asset, int width) {
+    if (width == 0)
+        return true;
+
+    string_buffer variant;
+    str_buf_init(&variant);
+    export_variant_path(&variant, job->asset_outputs[asset], width);
+    struct stat st;
+    bool exists = stat(variant.data, &st) == 0;
+    str_buf_free(&variant);
+
+    return exists;
+}
+
+/******************************************************************************
+ * export_check_asset_task -- Checks whether an image's copy in the site is   *
+ *                            up to date on a worker thread, and hashes the   *
+ *                            image if it is not. The last image to be        *
+ *                            checked queues the publishing and the pages.    *
+ *                                                                            *
+ * Parameters                                                                 *
+ *      arg -- The export_task for the image.                                 *
+ *      worker -- The index of the worker running the task.                   *
+ *                                                                            *
+ * Returns                                                                    *
+ *      Nothing                                                               *
+ *****************************************************************************/
+void export_check_asset_task(void* arg, int worker) {
+    (void)worker;
+    struct export_task* task = arg;
+    site_export* job = task->job;
+
+    // Skip the image if the export was cancelled before it got here
+    if (atomic_load(&job->generation) == task->generation) {
+        const char* path = job->assets[task->index];
+        struct asset_record* rec = &job->asset_records[task->index];
+
+        struct stat st;
+        struct stat out_st;
+        int old_index = export_manifest_find(&job->manifest, path, true);
+        const struct manifest_asset* old = old_index >= 0 ? &job->manifest.assets[old_index] : NULL;
+        if (old != NULL)
+            job->manifest_assets_seen[old_index] = 1;
+
+        if (stat(path, &st) != 0) {
+            printf("Could not open the required file: %s.\n", path);
+            atomic_fetch_add(&job->assets_failed, 1);
+            atomic_fetch_sub(&job->assets_left, 1);
+            atomic_store(&job->manifest_dirty, true);
+        }
+        else {
+            rec->mtime_sec = st.st_mtim.tv_sec;
+            rec->mtime_nsec = st.st_mtim.tv_nsec;
+            rec->size = st.st_size;
+
+            // The image has not been touched since it was published
+            if (old != NULL && old->mtime_sec == rec->mtime_sec && old->mtime_nsec == rec->mtime_nsec && old->size == rec->size && stat(job->asset_outputs[task->index], &out_st) == 0 && out_st.st_size == st.st_size && export_variant_exists(job, task->index, old->variant_width)) {
+                rec->hash = old->hash;
+                rec->variant_width = old->variant_width;
+                rec->valid = true;
+                atomic_fetch_add(&job->assets_unchanged, 1);
+                atomic_fetch_sub(&job->assets_left, 1);
+            }
+            else if (asset_hash_file(path, &rec->hash)) {
+                // Only the header is read here, the shrinking happens once per content
+                rec->variant_width = image_width(path) > EXPORT_IMAGE_MAX_WIDTH ? EXPORT_IMAGE_MAX_WIDTH : 0;
+                rec->valid = true;
+                rec->publish = true;
+                atomic_store(&job->manifest_dirty, true);
+
+                // An image that is small enough now should not leave its old shrunken copy behind
+                if (old != NULL && old->variant_width > 0 && old->variant_width != rec->variant_width) {
+                    string_buffer variant;
+                    str_buf_init(&variant);
+                    export_variant_path(&variant, job->asset_outputs[task->index], old->variant_width);
+                    remove(variant.data);
+                    str_buf_free(&variant);
+                }
+            }
+            else {
+                printf("Could not open the required file: %s.\n", path);
+                atomic_fetch_add(&job->assets_failed, 1);
+                atomic_fetch_sub(&job->assets_left, 1);
+                atomic_store(&job->manifest_dirty, true);
+            }
+        }
+    }
+
+    if (atomic_fetch_sub(&job->checks_left, 1) == 1)
+        export_queue_publish(job, task->generation);
+    export_task_done(job, task->generation);
+}
+
+/******************************************************************************
+ * export_collect_pages -- Copies the paths of the pages in a directory, and  *
+ *                         the directories inside of it, into an export. The  *
+ *                         matching directories in the site are created here  *
+ *                         so that the workers only have to write files.      *
+ *                                                                            *
+ * Parameters                                                                 *
+ *      job -- The export.                                                    *
+ *      dir -- The directory.                                                 *
+ *      root_len -- The length of the path to the project root.               *
+ *      site_dir -- The path to the site directory.                           *
+ *      capacity -- The number of paths there is room for.                    *
+ *                                                                            *
+ * Returns                                                                    *
+ *      A boolean specifying whether or not the site directories could be     *
+ *      created.                                                              *
+ *****************************************************************************/
+bool export_collect_pages(site_export* job, dir_contents* dir, size_t root_len, const char* site_dir, int* capacity) {
+    // The site's copy of this directory has the same path below the site directory
+    string_buffer out_dir;
+    str_buf_init(&out_dir);
+    str_buf_append_str(&out_dir, site_dir);
+    str_buf_append_str(&out_dir, dir->path + root_len);
+    bool ok = create_dir(out_dir.data) == 0;
+
+    for (int i = 0; ok && i < dir->number_files; i++) {
+        if (!string_ends_with(dir->files[i].name, ".md"))
+            continue;
+
+        if (job->number_pages == *capacity) {
+            *capacity = *capacity == 0 ? 256 : *capacity * 2;
+            job->pages = realloc(job->pages, *capacity * sizeof(char*));
+            job->outputs = realloc(job->outputs, *capacity * sizeof(char*));
+            if (job->pages == NULL || job->outputs == NULL) {
+                printf("Unable to allocate memory for the export.\n");
+                exit(EXIT_FAILURE);
+            }
+        }
+
+        // The page keeps its name, with the .md swapped for .html
+        const char* name = dir->files[i].name;
+        string_buffer output;
+        str_buf_init(&output);
+        str_buf_append(&output, out_dir.data, out_dir.len);
+        str_buf_append_str(&output, PATH_SEP);
+        str_buf_append(&output, name, strlen(name) - strlen(".md"));
+        str_buf_append_str(&output, ".html");
+
+        job->pages[job->number_pages] = strdup(dir->files[i].path);
+        job->outputs[job->number_pages] = str_buf_detach(&output);
+        job->number_pages++;
+    }
+    str_buf_free(&out_dir);
+
+    for (int i = 0; ok && i < dir->number_directories; i++) {
+        ok = export_collect_pages(job, dir->dirs[i], root_len, site_dir, capacity);
+    }
+
+    return ok;
+}
+
+/******************************************************************************
+ * export_collect_assets -- Copies the paths of the images that the pages of  *
+ *                          the project use into an export. Images outside of *
+ *                          the project are left where they are.              *
+ *                                                                            *
+ * Parameters                                                                 *
+ *      job -- The export.                                                    *
+ *                                                                            *
+ * Returns                                                                    *
+ *      Nothing                                                               *
+ *****************************************************************************/
+void export_collect_assets(site_export* job) {
+    // The nodes in the link graph have normalized paths
+    string_buffer root;
+    str_buf_init(&root);
+    normalize_path(&root, job->root_path, strlen(job->root_path));
+    str_buf_append_str(&root, PATH_SEP);
+
+    string_buffer site_dir;
+    str_buf_init(&site_dir);
+    str_buf_append(&site_dir, root.data, root.len);
+    str_buf_append_str(&site_dir, EXPORT_SITE_DIR);
+    str_buf_append_str(&site_dir, PATH_SEP);
+
+    // An image used by many pages is only published once
+    unsigned char* seen = calloc(project_links.number_nodes + 1, 1);
+    if (seen == NULL) {
+        printf("Unable to allocate memory for the export.\n");
+        exit(EXIT_FAILURE);
+    }
+
+    int capacity = 0;
+    for (int i = 0; i < project_links.number_nodes; i++) {
+        struct link_node* node = &project_links.nodes[i];
+        for (int j = 0; j < node->number_links; j++) {
+            int target = node->links[j].target;
+            const char* path = project_links.nodes[target].path;
+            if (node->links[j].kind != image_link || seen[target] || !project_links.nodes[target].exists)
+                continue;
+            seen[target] = 1;
+
+            if (strncmp(path, root.data, root.len) != 0 || strncmp(path, site_dir.data, site_dir.len) == 0)
+                continue;
+
+            if (job->number_assets == capacity) {
+                capacity = capacity == 0 ? 64 : capacity * 2;
+                job->assets = realloc(job->assets, capacity * sizeof(char*));
+                job->asset_outputs = realloc(job->asset_outputs, capacity * sizeof(char*));
+                if (job->assets == NULL || job->asset_outputs == NULL) {
+                    printf("Unable to allocate memory for the export.\n");
+                    exit(EXIT_FAILURE);
+                }
+            }
+
+            // The image has the same path below the site directory as below the project
+            string_buffer output;
+            str_buf_init(&output);
+            str_buf_append_str(&output, job->site_dir);
+            str_buf_append_str(&output, path + root.len - 1);
+
+            job->assets[job->number_assets] = strdup(path);
+            job->asset_outputs[job->number_assets] = str_buf_detach(&output);
+            job->number_assets++;
+        }
+    }
+
+    free(seen);
+    str_buf_free(&site_dir);
+    str_buf_free(&root);
+
+    // Set up a table so that the pages can find their images by path
+    job->asset_table_capacity = 16;
+    while (job->asset_table_capacity < (size_t)job->number_assets * 2)
+        job->asset_table_capacity *= 2;
+    job->asset_table = calloc(job->asset_table_capacity, sizeof(int));
+    if (job->asset_table == NULL) {
+        printf("Unable to allocate memory for the export.\n");
+        exit(EXIT_FAILURE);
+    }
+
+    for (int i = 0; i < job->number_assets; i++) {
+        size_t slot = (size_t)hash_bytes(job->assets[i], strlen(job->assets[i])) & (job->asset_table_capacity - 1);
+        while (job->asset_table[slot] != 0)
+            slot = (slot + 1) & (job->asset_table_capacity - 1);
+        job->asset_table[slot] = i + 1;
+    }
+}
+
+/******************************************************************************
+ * export_collect_steps -- Copies the step links between the pages of an      *
+ *                         export out of the link graph, which only the UI    *
+ *                         thread may read.                                   *
+ *                                                                            *
+ * Parameters                                                                 *
+ *      job -- The export.                                                    *
+ *                                                                            *
+ * Returns                                                                    *
+ *      Nothing                                                               *
+ *****************************************************************************/
+void export_collect_steps(site_export* job) {
+    int* node_pages = malloc((project_links.number_nodes + 1) * sizeof(int));
+    int* page_nodes = malloc(job->number_pages * sizeof(int));
+    job->first_step = malloc((job->number_pages + 1) * sizeof(int));
+    if (node_pages == NULL || page_nodes == NULL || job->first_step == NULL) {
+        printf("Unable to allocate memory for the export.\n");
+        exit(EXIT_FAILURE);
+    }
+
+    // Match the pages up with their nodes in the graph
+    for (int i = 0; i < project_links.number_nodes; i++)
+        node_pages[i] = -1;
+    for (int i = 0; i < job->number_pages; i++) {
+        string_buffer normalized;
+        str_buf_init(&normalized);
+        normalize_path(&normalized, job->pages[i], strlen(job->pages[i]));
+        page_nodes[i] = link_graph_find(&project_links, normalized.data);
+        if (page_nodes[i] >= 0)
+            node_pages[page_nodes[i]] = i;
+        str_buf_free(&normalized);
+    }
+
+    int number_steps = 0;
+    int capacity = 0;
+    for (int i = 0; i < job->number_pages; i++) {
+        job->first_step[i] = number_steps;
+        if (page_nodes[i] < 0)
+            continue;
+
+        struct link_node* node = &project_links.nodes[page_nodes[i]];
+        for (int j = 0; j < node->number_links; j++) {
+            int step = node_pages[node->links[j].target];
+            if (node->links[j].kind != step_link || step < 0 || step == i)
+                continue;
+
+            if (number_steps == capacity) {
+                capacity = capacity == 0 ? 64 : capacity * 2;
+                job->steps = realloc(job->steps, capacity * sizeof(int));
+                if (job->steps == NULL) {
+                    printf("Unable to allocate memory for the export.\n");
+                    exit(EXIT_FAILURE);
+                }
+            }
+            job->steps[number_steps++] = step;
+        }
+    }
+    job->first_step[job->number_pages] = number_steps;
+
+    free(node_pages);
+    free(page_nodes);
+}
+
+/******************************************************************************
+ * export_cancel -- Stops the running export. Waits only for the pages and    *
+ *                  images that are being written right now, the rest are     *
+ *                  skipped.                                                  *
+ *                                                                            *
+ * Parameters                                                                 *
+ *      job -- The export.                                                    *
+ *                                                                            *
+ * Returns                                                                    *
+ *      Nothing                                                               *
+ *****************************************************************************/
+void export_cancel(site_export* job) {
+    atomic_fetch_add(&job->generation, 1);
+    if (job->pool_running)
+        pool_wait(&job->pool);
+
+    for (int i = 0; i < job->number_pages; i++) {
+        free(job->pages[i]);
+        free(job->outputs[i]);
+        if (job->records != NULL)
+            str_buf_free(&job->records[i].deps);
+        if (job->titles != NULL)
+            free(job->titles[i]);
+    }
+    for (int i = 0; i < job->number_assets; i++) {
+        free(job->assets[i]);
+        free(job->asset_outputs[i]);
+    }
+    free(job->pages);
+    free(job->outputs);
+    free(job->tasks);
+    free(job->records);
+    free(job->manifest_seen);
+    free(job->steps);
+    free(job->first_step);
+    free(job->titles);
+    template_free(&job->layout);
+    template_free(&job->nav);
+    free(job->assets);
+    free(job->asset_outputs);
+    free(job->asset_table);
+    free(job->asset_tasks);
+    free(job->asset_records);
+    free(job->manifest_assets_seen);
+    free(job->asset_order);
+    free(job->asset_groups);
+    free(job->group_tasks);
+    free(job->root_path);
+    free(job->site_dir);
+    job->pages = NULL;
+    job->outputs = NULL;
+    job->tasks = NULL;
+    job->records = NULL;
+    job->manifest_seen = NULL;
+    job->steps = NULL;
+    job->first_step = NULL;
+    job->titles = NULL;
+    job->layout_hash = 0;
+    job->layout_current = false;
+    job->assets = NULL;
+    job->asset_outputs = NULL;
+    job->asset_table = NULL;
+    job->asset_table_capacity = 0;
+    job->asset_tasks = NULL;
+    job->asset_records = NULL;
+    job->manifest_assets_seen = NULL;
+    job->asset_order = NULL;
+    job->asset_groups = NULL;
+    job->group_tasks = NULL;
+    job->root_path = NULL;
+    job->site_dir = NULL;
+    job->number_pages = 0;
+    job->number_assets = 0;
+    job->number_keys = 0;
+    export_manifest_close(&job->manifest);
+
+    atomic_store(&job->running, false);
+    atomic_store(&job->tasks_left, 0);
+    atomic_store(&job->checks_left, 0);
+    atomic_store(&job->pages_left, 0);
+    atomic_store(&job->manifest_dirty, false);
+    atomic_store(&job->pages_written, 0);
+    atomic_store(&job->pages_unchanged, 0);
+    atomic_store(&job->pages_failed, 0);
+    atomic_store(&job->assets_left, 0);
+    atomic_store(&job->assets_copied, 0);
+    atomic_store(&job->assets_linked, 0);
+    atomic_store(&job->assets_shrunk, 0);
+    atomic_store(&job->assets_unchanged, 0);
+    atomic_store(&job->assets_failed, 0);
+    atomic_store(&job->elapsed, 0);
+}
+
+/******************************************************************************
+ * export_start -- Starts exporting every page of a project to its site       *
+ *                 directory, along with the images the pages use. Returns    *
+ *                 right away, the export runs in the background.             *
+ *                                                                            *
+ * Parameters                                                                 *
+ *      job -- The export.                                                    *
+ *      root -- The root of the project tree.                                 *
+ *                                                                            *
+ * Returns                                                                    *
+ *      A boolean specifying whether or not the site directories could be     *
+ *      created.                                                              *
+ *****************************************************************************/
+bool export_start(site_export* job, dir_contents* root) {
+    export_cancel(job);
+
+    if (root == NULL)
+        return true;
+
+    if (!job->pool_running) {
+        pool_start(&job->pool, pool_default_threads());
+        job->pool_running = true;
+
+        job->scratch = calloc(job->pool.number_threads, sizeof(struct export_scratch));
+        if (job->scratch == NULL) {
+            printf("Unable to allocate memory for the export.\n");
+            exit(EXIT_FAILURE);
+        }
+    }
+
+    string_buffer site_dir;
+    str_buf_init(&site_dir);
+    str_buf_append_str(&site_dir, root->path);
+    str_buf_append_str(&site_dir, PATH_SEP);
+    str_buf_append_str(&site_dir, EXPORT_SITE_DIR);
+
+    int capacity = 0;
+    job->root_path = strdup(root->path);
+    job->site_dir = str_buf_detach(&site_dir);
+    if (!export_collect_pages(job, root, strlen(root->path), job->site_dir, &capacity))
+        return false;
+    if (job->number_pages == 0)
+        return true;
+    export_collect_assets(job);
+    export_collect_steps(job);
+
+    // The last export's manifest says which pages and images can be left as they are
+    if (export_manifest_open(&job->manifest, job->site_dir, job->root_path)) {
+        job->manifest_seen = calloc(job->manifest.header->number_pages + 1, 1);
+        job->manifest_assets_seen = calloc(job->manifest.header->number_assets + 1, 1);
+        if (job->manifest_seen == NULL || job->manifest_assets_seen == NULL) {
+            printf("Unable to allocate memory for the export.\n");
+            exit(EXIT_FAILURE);
+        }
+    }
+
+    // The image arrays get one extra slot so that none of them is empty
+    job->tasks = malloc(job->number_pages * sizeof(struct export_task));
+    job->records = calloc(job->number_pages, sizeof(struct export_record));
+    job->titles = calloc(job->number_pages, sizeof(char*));
+    job->asset_tasks = malloc((job->number_assets + 1) * sizeof(struct export_task));
+    job->asset_records = calloc(job->number_assets + 1, sizeof(struct asset_record));
+    job->asset_order = malloc((job->number_assets + 1) * sizeof(struct asset_key));
+    job->asset_groups = malloc((job->number_assets + 1) * sizeof(struct asset_group));
+    job->group_tasks = malloc((job->number_assets + 1) * sizeof(struct export_task));
+    if (job->tasks == NULL || job->records == NULL || job->titles == NULL || job->asset_tasks == NULL || job->asset_records == NULL || job->asset_order == NULL || job->asset_groups == NULL || job->group_tasks == NULL) {
+        printf("Unable to allocate memory for the export.\n");
+        exit(EXIT_FAILURE);
+    }
+
+    // The shrunken copies are cached by content so that renamed and reverted images reuse them
+    string_buffer cache_dir;
+    str_buf_init(&cache_dir);
+    str_buf_append_str(&cache_dir, job->site_dir);
+    str_buf_append_str(&cache_dir, PATH_SEP);
+    str_buf_append_str(&cache_dir, EXPORT_CACHE_DIR);
+    bool ok = job->number_assets == 0 || create_dir(cache_dir.data) == 0;
+    str_buf_free(&cache_dir);
+    if (!ok)
+        return false;
+
+    // Everything is counted before the first task is queued, so that none of them can be taken for the last
+    unsigned long generation = atomic_load(&job->generation);
+    job->started = timestamp();
+    atomic_store(&job->running, true);
+    atomic_store(&job->tasks_left, job->number_assets + 1);
+    atomic_store(&job->checks_left, job->number_assets + 1);
+    atomic_store(&job->pages_left, job->number_pages);
+    atomic_store(&job->assets_left, job->number_assets);
+
+    // The layout is built and the images are checked first, the last of them queues the rest of the export
+    job->layout_task = (struct export_task){job, 0, generation};
+    pool_submit(&job->pool, export_build_layout_task, &job->layout_task);
+    for (int i = 0; i < job->number_assets; i++) {
+        job->asset_tasks[i] = (struct export_task){job, i, generation};
+        pool_submit(&job->pool, export_check_asset_task, &job->asset_tasks[i]);
+    }
+
+    return true;
+}
+
+/******************************************************************************
+ * export_running -- Checks whether an export still has pages or images to go *
+ *                   through.                                                 *
+ *                                                                            *
+ * Parameters                                                                 *
+ *      job -- The export.                                                    *
+ *                                                                            *
+ * Returns                                                                    *
+ *      A boolean specifying whether or not the export is still running.      *
+ *****************************************************************************/
+bool export_running(site_export* job) {
+    return atomic_load(&job->running);
+}
+
+/******************************************************************************
+ * export_stop -- Cancels any export and stops the worker threads.            *
+ *                                                                            *
+ * Parameters                                                                 *
+ *      job -- The export.                                                    *
+ *                                                                            *
+ * Returns                                                                    *
+ *      Nothing                                                               *
+ *****************************************************************************/
+void export_stop(site_export* job) {
+    export_cancel(job);
+
+    if (job->pool_running) {
+        int number_threads = job->pool.number_threads;
+        pool_stop(&job->pool);
+        job->pool_running = false;
+
+        for (int i = 0; i < number_threads; i++) {
+            str_buf_free(&job->scratch[i].src);
+            str_buf_free(&job->scratch[i].md);
+            str_buf_free(&job->scratch[i].html);
+        }
+        free(job->scratch);
+        job->scratch = NULL;
+    }
+}
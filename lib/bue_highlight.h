@@ -0,0 +1,506 @@
+/******************************************************************************
+ * bue_highlight -- Syntax highlighting for BuildUp markdown in the editor.   *
+ *                  The lexer state at the start of every line is kept, so    *
+ *                  after an edit only the lines from the edit onwards are    *
+ *                  lexed again, and only until the state they end in matches *
+ *                  what it was before. The lines on screen are split into    *
+ *                  colored runs as they are drawn.                           *
+ *                                                                            *
+ * Author: 7B Industries                                                      *
+ * License: Apache 2.0                                                        *
+ *                                                                            *
+ * ***************************************************************************/
+
+// How many lines may be lexed in one frame before the rest is left for the next
+#define HIGHLIGHT_LINES_PER_FRAME 5000
+
+// The kinds of text that are colored differently
+enum highlight_kinds {hl_text = 0, hl_header, hl_list, hl_quote, hl_code, hl_comment, hl_link, hl_image, hl_step_link,
+                      hl_error, hl_kind_count};
+
+// What the lexer is in the middle of at the end of a line
+enum highlight_states {hl_state_normal = 0, hl_state_fence_backtick = 1, hl_state_fence_tilde = 2, hl_state_comment = 3};
+
+// The color of each kind of text, hl_text uses the editor's own text color
+static const struct nk_color highlight_colors[hl_kind_count] = {
+    {0, 0, 0, 0},  // hl_text
+    {230, 180, 80, 255},  // hl_header
+    {120, 170, 230, 255},  // hl_list
+    {140, 165, 140, 255},  // hl_quote
+    {150, 200, 120, 255},  // hl_code
+    {120, 120, 120, 255},  // hl_comment
+    {100, 170, 240, 255},  // hl_link
+    {200, 140, 230, 255},  // hl_image
+    {80, 210, 200, 255},  // hl_step_link
+    {240, 90, 90, 255}  // hl_error
+};
+
+// A run of one kind of text on a line
+struct highlight_token {
+    size_t start;  // Offset of the run in the line
+    size_t len;  // The number of bytes in the run
+    int kind;  // One of the highlight_kinds
+};
+
+typedef struct highlighter highlighter;
+struct highlighter {
+    uint8_t* states;  // Lexer state at the start of each line, plus one for the end of the text
+    size_t line_count;  // The number of lines the states are kept for
+    size_t capacity;  // The number of states there is room for
+    unsigned long version;  // The editor's version that the states were updated for
+    size_t length;  // The length of the text at that version
+    size_t relex_from;  // The first line whose ending state is out of date, line_count when none are
+    size_t relex_until;  // Lexing cannot stop early until it gets past this line
+    bool valid;  // Whether the states have ever been set up
+    char* line;  // Scratch space holding the text of one line
+    size_t line_capacity;
+};
+
+highlighter md_highlight;  // Highlighting for the markdown editor
+
+/******************************************************************************
+ * highlight_add_token -- Adds a token to a line's list of tokens.            *
+ *                                                                            *
+ * Parameters                                                                 *
+ *      tokens -- The list of tokens, or NULL when only the state is wanted.  *
+ *      max_tokens -- The number of tokens there is room for.                 *
+ *      count -- The number of tokens in the list so far.                     *
+ *      start -- Offset of the token in the line.                             *
+ *      len -- The number of bytes in the token.                              *
+ *      kind -- One of the highlight_kinds.                                   *
+ *                                                                            *
+ * Returns                                                                    *
+ *      Nothing                                                               *
+ *****************************************************************************/
+void highlight_add_token(struct highlight_token* tokens, int max_tokens, int* count, size_t start, size_t len, int kind) {
+    if (tokens == NULL || *count == max_tokens || len == 0)
+        return;
+
+    tokens[*count].start = start;
+    tokens[*count].len = len;
+    tokens[*count].kind = kind;
+    (*count)++;
+}
+
+/******************************************************************************
+ * highlight_link -- Checks the link or image that starts at an offset in a   *
+ *                   line, the same way that the preprocessor finds the parts *
+ *                   of a step link.                                          *
+ *                                                                            *
+ * Parameters                                                                 *
+ *      line -- The text of the line.                                         *
+ *      len -- The number of bytes in the line.                               *
+ *      start -- Offset of the '[' of a link, or the '!' of an image.         *
+ *      end -- Set to the offset just past the link.                          *
+ *                                                                            *
+ * Returns                                                                    *
+ *      The kind of link, hl_error if it is not well formed, or hl_text if it *
+ *      is not a link after all.                                              *
+ *****************************************************************************/
+int highlight_link(const char* line, size_t len, size_t start, size_t* end) {
+    bool image = line[start] == '!';
+    size_t i = start + (image ? 1 : 0);
+
+    // Find the bracket that closes the link text, allowing brackets inside of it
+    int depth = 0;
+    for (; i < len; i++) {
+        if (line[i] == '[')
+            depth++;
+        else if (line[i] == ']' && --depth == 0)
+            break;
+    }
+
+    // Brackets that are not followed by a target are just text
+    if (i + 1 >= len || line[i + 1] != '(')
+        return hl_text;
+
+    const char* target = line + i + 2;
+    const char* close = memchr(target, ')', len - (i + 2));
+    if (close == NULL) {
+        *end = len;
+        return hl_error;
+    }
+    size_t target_len = close - target;
+    *end = close - line + 1;
+
+    // A step link has to point at another page
+    if (!image && *end + 6 <= len && memcmp(line + *end, "{step}", 6) == 0) {
+        *end += 6;
+        if (target_len < 3 || memcmp(close - 3, ".md", 3) != 0)
+            return hl_error;
+        return hl_step_link;
+    }
+
+    if (target_len == 0)
+        return hl_error;
+
+    return image ? hl_image : hl_link;
+}
+
+/******************************************************************************
+ * highlight_lex_line -- Splits a line into tokens and works out the state    *
+ *                       the lexer is in at the end of it.                    *
+ *                                                                            *
+ * Parameters                                                                 *
+ *      line -- The text of the line, without its newline.                    *
+ *      len -- The number of bytes in the line.                               *
+ *      state -- The state at the start of the line.                          *
+ *      tokens -- Filled in with the tokens, or NULL to only get the state.   *
+ *      max_tokens -- The number of tokens there is room for.                 *
+ *      count -- Set to the number of tokens, may be NULL with no tokens.     *
+ *                                                                            *
+ * Returns                                                                    *
+ *      The state at the end of the line, one of the highlight_states.        *
+ *****************************************************************************/
+int highlight_lex_line(const char* line, size_t len, int state, struct highlight_token* tokens, int max_tokens, int* count) {
+    int number_tokens = 0;
+    size_t i = 0;
+
+    // Block markers can be indented by up to three spaces
+    size_t indent = 0;
+    while (indent < len && indent < 3 && line[indent] == ' ')
+        indent++;
+    const char* lead = line + indent;
+    size_t lead_len = len - indent;
+
+    if (state == hl_state_fence_backtick || state == hl_state_fence_tilde) {
+        // Everything inside of a fenced block is code, including the fence that closes it
+        const char* fence = state == hl_state_fence_backtick ? "```" : "~~~";
+        highlight_add_token(tokens, max_tokens, &number_tokens, 0, len, hl_code);
+        if (lead_len >= 3 && memcmp(lead, fence, 3) == 0)
+            state = hl_state_normal;
+    }
+    else if (state == hl_state_comment) {
+        const char* close = span_find(line, len, "-->");
+        if (close == NULL) {
+            highlight_add_token(tokens, max_tokens, &number_tokens, 0, len, hl_comment);
+            i = len;
+        }
+        else {
+            i = close - line + 3;
+            highlight_add_token(tokens, max_tokens, &number_tokens, 0, i, hl_comment);
+            state = hl_state_normal;
+        }
+    }
+    else if (lead_len >= 3 && (memcmp(lead, "```", 3) == 0 || memcmp(lead, "~~~", 3) == 0)) {
+        highlight_add_token(tokens, max_tokens, &number_tokens, 0, len, hl_code);
+        state = lead[0] == '`' ? hl_state_fence_backtick : hl_state_fence_tilde;
+    }
+    else {
+        // Headers are colored as a whole
+        size_t hashes = 0;
+        while (hashes < lead_len && hashes < 7 && lead[hashes] == '#')
+            hashes++;
+        if (hashes >= 1 && hashes <= 6 && (hashes == lead_len || lead[hashes] == ' ')) {
+            highlight_add_token(tokens, max_tokens, &number_tokens, 0, len, hl_header);
+            i = len;
+        }
+        else if (lead_len >= 1 && lead[0] == '>') {
+            highlight_add_token(tokens, max_tokens, &number_tokens, indent, 1, hl_quote);
+            i = indent + 1;
+        }
+        else if (lead_len >= 1 && (lead[0] == '-' || lead[0] == '*' || lead[0] == '+') && (lead_len == 1 || lead[1] == ' ')) {
+            highlight_add_token(tokens, max_tokens, &number_tokens, indent, 1, hl_list);
+            i = indent + 1;
+        }
+        else {
+            // Ordered list items, like "12." or "3)"
+            size_t digits = 0;
+            while (digits < lead_len && digits < 9 && lead[digits] >= '0' && lead[digits] <= '9')
+                digits++;
+            if (digits > 0 && digits < lead_len && (lead[digits] == '.' || lead[digits] == ')') &&
+                (digits + 1 == lead_len || lead[digits + 1] == ' ')) {
+                highlight_add_token(tokens, max_tokens, &number_tokens, indent, digits + 1, hl_list);
+                i = indent + digits + 1;
+            }
+        }
+    }
+
+    // The spans inside of the line
+    while (i < len) {
+        char c = line[i];
+
+        if (c == '`') {
+            // Code spans close with a run of the same number of backticks
+            size_t run = 1;
+            while (i + run < len && line[i + run] == '`')
+                run++;
+
+            size_t j = i + run;
+            size_t end = 0;
+            while (j < len) {
+                if (line[j] != '`') {
+                    j++;
+                    continue;
+                }
+                size_t close_run = 1;
+                while (j + close_run < len && line[j + close_run] == '`')
+                    close_run++;
+                if (close_run == run) {
+                    end = j + close_run;
+                    break;
+                }
+                j += close_run;
+            }
+
+            if (end > 0) {
+                highlight_add_token(tokens, max_tokens, &number_tokens, i, end - i, hl_code);
+                i = end;
+            }
+            else {
+                i += run;
+            }
+        }
+        else if (c == '<' && len - i >= 4 && memcmp(line + i, "<!--", 4) == 0) {
+            const char* close = span_find(line + i + 4, len - i - 4, "-->");
+            if (close == NULL) {
+                highlight_add_token(tokens, max_tokens, &number_tokens, i, len - i, hl_comment);
+                state = hl_state_comment;
+                break;
+            }
+            size_t end = close - line + 3;
+            highlight_add_token(tokens, max_tokens, &number_tokens, i, end - i, hl_comment);
+            i = end;
+        }
+        else if (c == '[' || (c == '!' && i + 1 < len && line[i + 1] == '[')) {
+            size_t end;
+            int kind = highlight_link(line, len, i, &end);
+            if (kind == hl_text) {
+                i++;
+                continue;
+            }
+            highlight_add_token(tokens, max_tokens, &number_tokens, i, end - i, kind);
+            i = end;
+        }
+        else if (c == '{' && len - i >= 6 && memcmp(line + i, "{step}", 6) == 0) {
+            // A step tag that does not follow a link will not do anything
+            highlight_add_token(tokens, max_tokens, &number_tokens, i, 6, hl_error);
+            i += 6;
+        }
+        else {
+            i++;
+        }
+    }
+
+    if (count != NULL)
+        *count = number_tokens;
+
+    return state;
+}
+
+/******************************************************************************
+ * highlight_line_text -- Copies the text of one line into the scratch space. *
+ *                                                                            *
+ * Parameters                                                                 *
+ *      hl -- The highlighter.                                                *
+ *      root -- The root of the document's tree.                              *
+ *      line -- The line number.                                              *
+ *      len -- Set to the length of the line, not counting its newline.       *
+ *                                                                            *
+ * Returns                                                                    *
+ *      The text of the line, which is only good until the next call.         *
+ *****************************************************************************/
+const char* highlight_line_text(highlighter* hl, const struct doc_node* root, size_t line, size_t* len) {
+    size_t start = doc_line_start(root, line);
+    *len = doc_line_end(root, line) - start;
+
+    if (*len + 1 > hl->line_capacity) {
+        hl->line_capacity = *len + 1 > 256 ? *len + 1 : 256;
+        hl->line = realloc(hl->line, hl->line_capacity);
+        if (hl->line == NULL) {
+            printf("Unable to allocate memory for syntax highlighting.\n");
+            exit(EXIT_FAILURE);
+        }
+    }
+    doc_copy(root, start, start + *len, hl->line);
+
+    return hl->line;
+}
+
+/******************************************************************************
+ * highlight_reserve -- Makes sure there is room for the states of a number   *
+ *                      of lines.                                             *
+ *                                                                            *
+ * Parameters                                                                 *
+ *      hl -- The highlighter.                                                *
+ *      line_count -- The number of lines.                                    *
+ *                                                                            *
+ * Returns                                                                    *
+ *      Nothing                                                               *
+ *****************************************************************************/
+void highlight_reserve(highlighter* hl, size_t line_count) {
+    if (line_count + 1 <= hl->capacity)
+        return;
+
+    hl->capacity = line_count + 1 > hl->capacity * 2 ? line_count + 1 : hl->capacity * 2;
+    hl->states = realloc(hl->states, hl->capacity);
+    if (hl->states == NULL) {
+        printf("Unable to allocate memory for syntax highlighting.\n");
+        exit(EXIT_FAILURE);
+    }
+}
+
+/******************************************************************************
+ * highlight_catch_up -- Reads the edit journal to find the lines that were   *
+ *                       changed since the last update, moving the states of  *
+ *                       the lines after them to where those lines are now.   *
+ *                                                                            *
+ * Parameters                                                                 *
+ *      hl -- The highlighter.                                                *
+ *      ed -- The editor holding the text.                                    *
+ *                                                                            *
+ * Returns                                                                    *
+ *      Nothing                                                               *
+ *****************************************************************************/
+void highlight_catch_up(highlighter* hl, const text_editor* ed) {
+    size_t line_count = doc_line_count(ed->doc.root);
+    size_t length = doc_length(ed->doc.root);
+
+    // Work out how much at the start and the end of the text is untouched by any of the changes
+    bool complete = hl->valid;
+    size_t prefix = SIZE_MAX;
+    size_t suffix = SIZE_MAX;
+    size_t change_length = hl->length;
+    for (unsigned long version = hl->version + 1; complete && version <= ed->version; version++) {
+        const struct editor_change* change = editor_change(ed, version);
+        if (change == NULL) {
+            complete = false;
+            break;
+        }
+
+        change_length = change_length - change->removed + change->inserted;
+        if (change->offset < prefix)
+            prefix = change->offset;
+        if (change_length - (change->offset + change->inserted) < suffix)
+            suffix = change_length - (change->offset + change->inserted);
+    }
+
+    hl->version = ed->version;
+    hl->length = length;
+    highlight_reserve(hl, line_count);
+
+    // Without the whole journal to go on, everything is lexed again
+    if (!complete) {
+        memset(hl->states, hl_state_normal, line_count + 1);
+        hl->line_count = line_count;
+        hl->relex_from = 0;
+        hl->relex_until = line_count;
+        hl->valid = true;
+        return;
+    }
+
+    size_t first = doc_line_of(ed->doc.root, prefix);
+    size_t last = doc_line_of(ed->doc.root, length - suffix);
+    long delta = (long)line_count - (long)hl->line_count;
+
+    // The lines after the changes are the same as before, only moved
+    memmove(hl->states + last + 1, hl->states + (long)last + 1 - delta, line_count - last);
+
+    // Fold in any lexing that was still left over from before
+    if (hl->relex_from < hl->line_count) {
+        size_t until = (long)hl->relex_until + delta > (long)last ? (size_t)((long)hl->relex_until + delta) : last;
+        if (hl->relex_from < first)
+            first = hl->relex_from;
+        last = until;
+    }
+
+    hl->line_count = line_count;
+    hl->relex_from = first;
+    hl->relex_until = last;
+}
+
+/******************************************************************************
+ * highlight_update -- Brings the line states up to date with the editor,     *
+ *                     lexing no more lines than fit in one frame.            *
+ *                                                                            *
+ * Parameters                                                                 *
+ *      hl -- The highlighter.                                                *
+ *      ed -- The editor holding the text.                                    *
+ *                                                                            *
+ * Returns                                                                    *
+ *      A boolean specifying whether or not there are still lines left to     *
+ *      lex on a later frame.                                                 *
+ *****************************************************************************/
+bool highlight_update(highlighter* hl, const text_editor* ed) {
+    if (!hl->valid || hl->version != ed->version)
+        highlight_catch_up(hl, ed);
+
+    int lexed = 0;
+    while (hl->relex_from < hl->line_count && lexed < HIGHLIGHT_LINES_PER_FRAME) {
+        size_t line = hl->relex_from;
+        size_t len;
+        const char* text = highlight_line_text(hl, ed->doc.root, line, &len);
+        int state = highlight_lex_line(text, len, hl->states[line], NULL, 0, NULL);
+        lexed++;
+
+        // Once past the edit, a line ending the same as before means the rest are still right
+        if (line >= hl->relex_until && hl->states[line + 1] == state) {
+            hl->relex_from = hl->line_count;
+            break;
+        }
+
+        hl->states[line + 1] = (uint8_t)state;
+        hl->relex_from++;
+    }
+
+    return hl->relex_from < hl->line_count;
+}
+
+/******************************************************************************
+ * highlight_style_line -- Colors a line of the markdown editor. Used as the  *
+ *                         editor's style function.                           *
+ *                                                                            *
+ * Parameters                                                                 *
+ *      ed -- The editor.                                                     *
+ *      line -- The line number.                                              *
+ *      text -- The text of the line.                                         *
+ *      len -- The number of bytes in the line.                               *
+ *      text_color -- The color of plain text.                                *
+ *      runs -- Filled in with the runs of color.                             *
+ *      max_runs -- The number of runs there is room for.                     *
+ *      arg -- The highlighter.                                               *
+ *                                                                            *
+ * Returns                                                                    *
+ *      The number of runs.                                                   *
+ *****************************************************************************/
+int highlight_style_line(text_editor* ed, size_t line, const char* text, size_t len, struct nk_color text_color,
+                         struct editor_run* runs, int max_runs, void* arg) {
+    highlighter* hl = arg;
+
+    // Edits made while handling this frame's input have not been seen yet
+    if (!hl->valid || hl->version != ed->version)
+        highlight_update(hl, ed);
+    if (line >= hl->line_count)
+        return 0;
+
+    // Every token can need a plain run before it, so only half as many fit
+    struct highlight_token tokens[EDITOR_MAX_RUNS / 2];
+    int count;
+    highlight_lex_line(text, len, hl->states[line], tokens, NK_MIN(max_runs, EDITOR_MAX_RUNS) / 2, &count);
+
+    int number_runs = 0;
+    size_t pos = 0;
+    for (int i = 0; i < count; i++) {
+        if (tokens[i].start > pos)
+            runs[number_runs++] = (struct editor_run){tokens[i].start - pos, text_color};
+        runs[number_runs++] = (struct editor_run){tokens[i].len, highlight_colors[tokens[i].kind]};
+        pos = tokens[i].start + tokens[i].len;
+    }
+
+    return number_runs;
+}
+
+/******************************************************************************
+ * highlight_free -- Releases the memory held by a highlighter.               *
+ *                                                                            *
+ * Parameters                                                                 *
+ *      hl -- The highlighter.                                                *
+ *                                                                            *
+ * Returns                                                                    *
+ *      Nothing                                                               *
+ *****************************************************************************/
+void highlight_free(highlighter* hl) {
+    free(hl->states);
+    free(hl->line);
+    memset(hl, 0, sizeof(highlighter));
+}
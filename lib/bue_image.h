@@ -0,0 +1,553 @@
+/******************************************************************************
+ * bue_image -- Shrinks oversized images and encodes the result as a baseline *
+ *              JPEG, so that exported sites stay quick to load. Decoding is  *
+ *              left to stb_image.                                            *
+ *                                                                            *
+ * Author: 7B Industries                                                      *
+ * License: Apache 2.0                                                        *
+ *                                                                            *
+ * ***************************************************************************/
+
+#include <math.h>
+
+// The quality that shrunken images are encoded at, from 1 to 100
+#define IMAGE_JPEG_QUALITY 85
+
+// The order that the coefficients of a block are written in
+static const unsigned char jpeg_zigzag[64] = {
+    0, 1, 8, 16, 9, 2, 3, 10, 17, 24, 32, 25, 18, 11, 4, 5,
+    12, 19, 26, 33, 40, 48, 41, 34, 27, 20, 13, 6, 7, 14, 21, 28,
+    35, 42, 49, 56, 57, 50, 43, 36, 29, 22, 15, 23, 30, 37, 44, 51,
+    58, 59, 52, 45, 38, 31, 39, 46, 53, 60, 61, 54, 47, 55, 62, 63
+};
+
+// The example quantization tables from the JPEG standard, for quality 50
+static const unsigned char jpeg_luma_quant[64] = {
+    16, 11, 10, 16, 24, 40, 51, 61,
+    12, 12, 14, 19, 26, 58, 60, 55,
+    14, 13, 16, 24, 40, 57, 69, 56,
+    14, 17, 22, 29, 51, 87, 80, 62,
+    18, 22, 37, 56, 68, 109, 103, 77,
+    24, 35, 55, 64, 81, 104, 113, 92,
+    49, 64, 78, 87, 103, 121, 120, 101,
+    72, 92, 95, 98, 112, 100, 103, 99
+};
+
+static const unsigned char jpeg_chroma_quant[64] = {
+    17, 18, 24, 47, 99, 99, 99, 99,
+    18, 21, 26, 66, 99, 99, 99, 99,
+    24, 26, 56, 99, 99, 99, 99, 99,
+    47, 66, 99, 99, 99, 99, 99, 99,
+    99, 99, 99, 99, 99, 99, 99, 99,
+    99, 99, 99, 99, 99, 99, 99, 99,
+    99, 99, 99, 99, 99, 99, 99, 99,
+    99, 99, 99, 99, 99, 99, 99, 99
+};
+
+// The example Huffman tables from the JPEG standard, as code counts per length then values
+static const unsigned char jpeg_dc_luma_bits[16] = {0, 1, 5, 1, 1, 1, 1, 1, 1, 0, 0, 0, 0, 0, 0, 0};
+static const unsigned char jpeg_dc_luma_values[12] = {0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11};
+static const unsigned char jpeg_dc_chroma_bits[16] = {0, 3, 1, 1, 1, 1, 1, 1, 1, 1, 1, 0, 0, 0, 0, 0};
+static const unsigned char jpeg_dc_chroma_values[12] = {0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11};
+
+static const unsigned char jpeg_ac_luma_bits[16] = {0, 2, 1, 3, 3, 2, 4, 3, 5, 5, 4, 4, 0, 0, 1, 0x7d};
+static const unsigned char jpeg_ac_luma_values[162] = {
+    0x01, 0x02, 0x03, 0x00, 0x04, 0x11, 0x05, 0x12, 0x21, 0x31, 0x41, 0x06, 0x13, 0x51, 0x61, 0x07,
+    0x22, 0x71, 0x14, 0x32, 0x81, 0x91, 0xa1, 0x08, 0x23, 0x42, 0xb1, 0xc1, 0x15, 0x52, 0xd1, 0xf0,
+    0x24, 0x33, 0x62, 0x72, 0x82, 0x09, 0x0a, 0x16, 0x17, 0x18, 0x19, 0x1a, 0x25, 0x26, 0x27, 0x28,
+    0x29, 0x2a, 0x34, 0x35, 0x36, 0x37, 0x38, 0x39, 0x3a, 0x43, 0x44, 0x45, 0x46, 0x47, 0x48, 0x49,
+    0x4a, 0x53, 0x54, 0x55, 0x56, 0x57, 0x58, 0x59, 0x5a, 0x63, 0x64, 0x65, 0x66, 0x67, 0x68, 0x69,
+    0x6a, 0x73, 0x74, 0x75, 0x76, 0x77, 0x78, 0x79, 0x7a, 0x83, 0x84, 0x85, 0x86, 0x87, 0x88, 0x89,
+    0x8a, 0x92, 0x93, 0x94, 0x95, 0x96, 0x97, 0x98, 0x99, 0x9a, 0xa2, 0xa3, 0xa4, 0xa5, 0xa6, 0xa7,
+    0xa8, 0xa9, 0xaa, 0xb2, 0xb3, 0xb4, 0xb5, 0xb6, 0xb7, 0xb8, 0xb9, 0xba, 0xc2, 0xc3, 0xc4, 0xc5,
+    0xc6, 0xc7, 0xc8, 0xc9, 0xca, 0xd2, 0xd3, 0xd4, 0xd5, 0xd6, 0xd7, 0xd8, 0xd9, 0xda, 0xe1, 0xe2,
+    0xe3, 0xe4, 0xe5, 0xe6, 0xe7, 0xe8, 0xe9, 0xea, 0xf1, 0xf2, 0xf3, 0xf4, 0xf5, 0xf6, 0xf7, 0xf8,
+    0xf9, 0xfa
+};
+
+static const unsigned char jpeg_ac_chroma_bits[16] = {0, 2, 1, 2, 4, 4, 3, 4, 7, 5, 4, 4, 0, 1, 2, 0x77};
+static const unsigned char jpeg_ac_chroma_values[162] = {
+    0x00, 0x01, 0x02, 0x03, 0x11, 0x04, 0x05, 0x21, 0x31, 0x06, 0x12, 0x41, 0x51, 0x07, 0x61, 0x71,
+    0x13, 0x22, 0x32, 0x81, 0x08, 0x14, 0x42, 0x91, 0xa1, 0xb1, 0xc1, 0x09, 0x23, 0x33, 0x52, 0xf0,
+    0x15, 0x62, 0x72, 0xd1, 0x0a, 0x16, 0x24, 0x34, 0xe1, 0x25, 0xf1, 0x17, 0x18, 0x19, 0x1a, 0x26,
+    0x27, 0x28, 0x29, 0x2a, 0x35, 0x36, 0x37, 0x38, 0x39, 0x3a, 0x43, 0x44, 0x45, 0x46, 0x47, 0x48,
+    0x49, 0x4a, 0x53, 0x54, 0x55, 0x56, 0x57, 0x58, 0x59, 0x5a, 0x63, 0x64, 0x65, 0x66, 0x67, 0x68,
+    0x69, 0x6a, 0x73, 0x74, 0x75, 0x76, 0x77, 0x78, 0x79, 0x7a, 0x82, 0x83, 0x84, 0x85, 0x86, 0x87,
+    0x88, 0x89, 0x8a, 0x92, 0x93, 0x94, 0x95, 0x96, 0x97, 0x98, 0x99, 0x9a, 0xa2, 0xa3, 0xa4, 0xa5,
+    0xa6, 0xa7, 0xa8, 0xa9, 0xaa, 0xb2, 0xb3, 0xb4, 0xb5, 0xb6, 0xb7, 0xb8, 0xb9, 0xba, 0xc2, 0xc3,
+    0xc4, 0xc5, 0xc6, 0xc7, 0xc8, 0xc9, 0xca, 0xd2, 0xd3, 0xd4, 0xd5, 0xd6, 0xd7, 0xd8, 0xd9, 0xda,
+    0xe2, 0xe3, 0xe4, 0xe5, 0xe6, 0xe7, 0xe8, 0xe9, 0xea, 0xf2, 0xf3, 0xf4, 0xf5, 0xf6, 0xf7, 0xf8,
+    0xf9, 0xfa
+};
+
+// The code for each symbol of a Huffman table
+struct jpeg_huffman {
+    uint16_t code[256];
+    unsigned char size[256];  // The length of each code in bits, zero for unused symbols
+};
+
+// The state of one JPEG being encoded
+typedef struct jpeg_encoder jpeg_encoder;
+struct jpeg_encoder {
+    string_buffer* out;
+    uint32_t bits;  // Bits waiting to be written, in the low end
+    int number_bits;
+    float quant[2][64];  // The luma and chroma quantizers, in natural order
+    unsigned char quant_bytes[2][64];  // The same, as written to the file in zigzag order
+    struct jpeg_huffman dc[2];
+    struct jpeg_huffman ac[2];
+    float cosines[8][8];  // The DCT basis, scaled so a row and a column pass give the standard transform
+};
+
+/******************************************************************************
+ * jpeg_build_huffman -- Assigns the canonical codes of a Huffman table.      *
+ *                                                                            *
+ * Parameters                                                                 *
+ *      table -- Where to put the codes.                                      *
+ *      bits -- The number of codes of each length from 1 to 16 bits.         *
+ *      values -- The symbols, in code order.                                 *
+ *                                                                            *
+ * Returns                                                                    *
+ *      Nothing                                                               *
+ *****************************************************************************/
+void jpeg_build_huffman(struct jpeg_huffman* table, const unsigned char* bits, const unsigned char* values) {
+    memset(table, 0, sizeof(struct jpeg_huffman));
+
+    uint16_t code = 0;
+    int k = 0;
+    for (int len = 1; len <= 16; len++) {
+        for (int i = 0; i < bits[len - 1]; i++) {
+            table->code[values[k]] = code++;
+            table->size[values[k]] = (unsigned char)len;
+            k++;
+        }
+        code <<= 1;
+    }
+}
+
+/******************************************************************************
+ * jpeg_encoder_init -- Sets up the tables for encoding at a given quality.   *
+ *                                                                            *
+ * Parameters                                                                 *
+ *      enc -- The encoder.                                                   *
+ *      out -- The buffer to write the JPEG to.                               *
+ *      quality -- The quality, from 1 to 100.                                *
+ *                                                                            *
+ * Returns                                                                    *
+ *      Nothing                                                               *
+ *****************************************************************************/
+void jpeg_encoder_init(jpeg_encoder* enc, string_buffer* out, int quality) {
+    enc->out = out;
+    enc->bits = 0;
+    enc->number_bits = 0;
+
+    // The usual scaling of the example tables, so that 50 gives them as they are
+    quality = quality < 1 ? 1 : quality > 100 ? 100 : quality;
+    int scale = quality < 50 ? 5000 / quality : 200 - quality * 2;
+    for (int i = 0; i < 64; i++) {
+        const unsigned char* base[2] = {jpeg_luma_quant, jpeg_chroma_quant};
+        for (int t = 0; t < 2; t++) {
+            int q = (base[t][i] * scale + 50) / 100;
+            q = q < 1 ? 1 : q > 255 ? 255 : q;
+            enc->quant[t][i] = (float)q;
+        }
+    }
+    for (int i = 0; i < 64; i++) {
+        enc->quant_bytes[0][i] = (unsigned char)enc->quant[0][jpeg_zigzag[i]];
+        enc->quant_bytes[1][i] = (unsigned char)enc->quant[1][jpeg_zigzag[i]];
+    }
+
+    jpeg_build_huffman(&enc->dc[0], jpeg_dc_luma_bits, jpeg_dc_luma_values);
+    jpeg_build_huffman(&enc->dc[1], jpeg_dc_chroma_bits, jpeg_dc_chroma_values);
+    jpeg_build_huffman(&enc->ac[0], jpeg_ac_luma_bits, jpeg_ac_luma_values);
+    jpeg_build_huffman(&enc->ac[1], jpeg_ac_chroma_bits, jpeg_ac_chroma_values);
+
+    for (int u = 0; u < 8; u++) {
+        for (int x = 0; x < 8; x++) {
+            float c = u == 0 ? 0.70710678f : 1.0f;
+            enc->cosines[u][x] = 0.5f * c * cosf((2 * x + 1) * u * 3.14159265f / 16.0f);
+        }
+    }
+}
+
+/******************************************************************************
+ * jpeg_put_bits -- Writes bits to the entropy coded data, stuffing a zero    *
+ *                  byte after any 0xFF so it is not read as a marker.        *
+ *                                                                            *
+ * Parameters                                                                 *
+ *      enc -- The encoder.                                                   *
+ *      value -- The bits, in the low end.                                    *
+ *      count -- The number of bits, at most 16.                              *
+ *                                                                            *
+ * Returns                                                                    *
+ *      Nothing                                                               *
+ *****************************************************************************/
+void jpeg_put_bits(jpeg_encoder* enc, uint32_t value, int count) {
+    enc->bits = (enc->bits << count) | (value & ((1u << count) - 1));
+    enc->number_bits += count;
+
+    while (enc->number_bits >= 8) {
+        char byte = (char)(enc->bits >> (enc->number_bits - 8));
+        str_buf_append_char(enc->out, byte);
+        if ((unsigned char)byte == 0xFF)
+            str_buf_append_char(enc->out, 0);
+        enc->number_bits -= 8;
+    }
+    enc->bits &= (1u << enc->number_bits) - 1;
+}
+
+/******************************************************************************
+ * jpeg_put_marker -- Writes a marker segment header.                         *
+ *                                                                            *
+ * Parameters                                                                 *
+ *      enc -- The encoder.                                                   *
+ *      marker -- The second byte of the marker.                              *
+ *      len -- The number of bytes in the segment after the marker.           *
+ *                                                                            *
+ * Returns                                                                    *
+ *      Nothing                                                               *
+ *****************************************************************************/
+void jpeg_put_marker(jpeg_encoder* enc, int marker, int len) {
+    const char header[4] = {(char)0xFF, (char)marker, (char)(len >> 8), (char)len};
+    str_buf_append(enc->out, header, sizeof(header));
+}
+
+/******************************************************************************
+ * jpeg_put_huffman -- Writes one Huffman table to a DHT segment.             *
+ *                                                                            *
+ * Parameters                                                                 *
+ *      enc -- The encoder.                                                   *
+ *      id -- The class of the table in the high nibble and its slot in the   *
+ *            low nibble.                                                     *
+ *      bits -- The number of codes of each length.                           *
+ *      values -- The symbols, in code order.                                 *
+ *      number_values -- The number of symbols.                               *
+ *                                                                            *
+ * Returns                                                                    *
+ *      Nothing                                                               *
+ *****************************************************************************/
+void jpeg_put_huffman(jpeg_encoder* enc, int id, const unsigned char* bits, const unsigned char* values, int number_values) {
+    str_buf_append_char(enc->out, (char)id);
+    str_buf_append(enc->out, (const char*)bits, 16);
+    str_buf_append(enc->out, (const char*)values, number_values);
+}
+
+/******************************************************************************
+ * jpeg_put_headers -- Writes everything in front of the image data for a     *
+ *                     three channel image with the chroma halved in both     *
+ *                     directions.                                            *
+ *                                                                            *
+ * Parameters                                                                 *
+ *      enc -- The encoder.                                                   *
+ *      width -- The width of the image.                                      *
+ *      height -- The height of the image.                                    *
+ *                                                                            *
+ * Returns                                                                    *
+ *      Nothing                                                               *
+ *****************************************************************************/
+void jpeg_put_headers(jpeg_encoder* enc, int width, int height) {
+    static const char start[] = {(char)0xFF, (char)0xD8};
+    static const char jfif[] = {'J', 'F', 'I', 'F', 0, 1, 1, 0, 0, 1, 0, 1, 0, 0};
+    str_buf_append(enc->out, start, sizeof(start));
+    jpeg_put_marker(enc, 0xE0, 2 + sizeof(jfif));
+    str_buf_append(enc->out, jfif, sizeof(jfif));
+
+    jpeg_put_marker(enc, 0xDB, 2 + 2 * 65);
+    for (int t = 0; t < 2; t++) {
+        str_buf_append_char(enc->out, (char)t);
+        str_buf_append(enc->out, (const char*)enc->quant_bytes[t], 64);
+    }
+
+    // Luma is sampled 2x2 against the chroma, and the chroma shares the second tables
+    const char frame[] = {
+        8, (char)(height >> 8), (char)height, (char)(width >> 8), (char)width, 3,
+        1, 0x22, 0, 2, 0x11, 1, 3, 0x11, 1
+    };
+    jpeg_put_marker(enc, 0xC0, 2 + sizeof(frame));
+    str_buf_append(enc->out, frame, sizeof(frame));
+
+    jpeg_put_marker(enc, 0xC4, 2 + 4 * 17 + 12 + 12 + 162 + 162);
+    jpeg_put_huffman(enc, 0x00, jpeg_dc_luma_bits, jpeg_dc_luma_values, 12);
+    jpeg_put_huffman(enc, 0x10, jpeg_ac_luma_bits, jpeg_ac_luma_values, 162);
+    jpeg_put_huffman(enc, 0x01, jpeg_dc_chroma_bits, jpeg_dc_chroma_values, 12);
+    jpeg_put_huffman(enc, 0x11, jpeg_ac_chroma_bits, jpeg_ac_chroma_values, 162);
+
+    static const char scan[] = {3, 1, 0x00, 2, 0x11, 3, 0x11, 0, 63, 0};
+    jpeg_put_marker(enc, 0xDA, 2 + sizeof(scan));
+    str_buf_append(enc->out, scan, sizeof(scan));
+}
+
+/******************************************************************************
+ * jpeg_put_value -- Writes a coefficient as its size category's Huffman code *
+ *                   followed by the bits of the value.                       *
+ *                                                                            *
+ * Parameters                                                                 *
+ *      enc -- The encoder.                                                   *
+ *      table -- The Huffman table to code the symbol with.                   *
+ *      run -- The number of zeros in front of the value, for AC values.      *
+ *      value -- The coefficient.                                             *
+ *                                                                            *
+ * Returns                                                                    *
+ *      Nothing                                                               *
+ *****************************************************************************/
+void jpeg_put_value(jpeg_encoder* enc, const struct jpeg_huffman* table, int run, int value) {
+    int magnitude = value < 0 ? -value : value;
+    int category = 0;
+    while (magnitude > 0) {
+        category++;
+        magnitude >>= 1;
+    }
+
+    int symbol = (run << 4) | category;
+    jpeg_put_bits(enc, table->code[symbol], table->size[symbol]);
+
+    // Negative values are written as their ones' complement
+    if (category > 0)
+        jpeg_put_bits(enc, (uint32_t)(value < 0 ? value - 1 : value), category);
+}
+
+/******************************************************************************
+ * jpeg_put_block -- Transforms, quantizes and writes one 8x8 block.          *
+ *                                                                            *
+ * Parameters                                                                 *
+ *      enc -- The encoder.                                                   *
+ *      block -- The samples, centered on zero, in row order.                 *
+ *      table -- 0 for a luma block, 1 for a chroma block.                    *
+ *      last_dc -- The DC value of the last block of the same channel, which  *
+ *                 is updated.                                                *
+ *                                                                            *
+ * Returns                                                                    *
+ *      Nothing                                                               *
+ *****************************************************************************/
+void jpeg_put_block(jpeg_encoder* enc, const float* block, int table, int* last_dc) {
+    float rows[64];
+    int coefficients[64];
+
+    // The DCT is separable, so the rows are transformed first and then the columns
+    for (int y = 0; y < 8; y++) {
+        for (int u = 0; u < 8; u++) {
+            float sum = 0.0f;
+            for (int x = 0; x < 8; x++)
+                sum += enc->cosines[u][x] * block[y * 8 + x];
+            rows[y * 8 + u] = sum;
+        }
+    }
+    for (int u = 0; u < 8; u++) {
+        for (int v = 0; v < 8; v++) {
+            float sum = 0.0f;
+            for (int y = 0; y < 8; y++)
+                sum += enc->cosines[v][y] * rows[y * 8 + u];
+            coefficients[v * 8 + u] = (int)lroundf(sum / enc->quant[table][v * 8 + u]);
+        }
+    }
+
+    jpeg_put_value(enc, &enc->dc[table], 0, coefficients[0] - *last_dc);
+    *last_dc = coefficients[0];
+
+    int run = 0;
+    for (int i = 1; i < 64; i++) {
+        int value = coefficients[jpeg_zigzag[i]];
+        if (value == 0) {
+            run++;
+            continue;
+        }
+
+        // Runs longer than 15 zeros are broken up with ZRL codes
+        while (run > 15) {
+            jpeg_put_bits(enc, enc->ac[table].code[0xF0], enc->ac[table].size[0xF0]);
+            run -= 16;
+        }
+        jpeg_put_value(enc, &enc->ac[table], run, value);
+        run = 0;
+    }
+
+    // The end of block code stands in for the zeros at the end
+    if (run > 0)
+        jpeg_put_bits(enc, enc->ac[table].code[0x00], enc->ac[table].size[0x00]);
+}
+
+/******************************************************************************
+ * jpeg_encode -- Encodes an RGB image as a baseline JPEG with the chroma     *
+ *                halved in both directions.                                  *
+ *                                                                            *
+ * Parameters                                                                 *
+ *      out -- The buffer to write the JPEG to.                               *
+ *      rgb -- The pixels, three bytes each, in row order.                    *
+ *      width -- The width of the image, at most 65535.                       *
+ *      height -- The height of the image, at most 65535.                     *
+ *      quality -- The quality, from 1 to 100.                                *
+ *                                                                            *
+ * Returns                                                                    *
+ *      Nothing                                                               *
+ *****************************************************************************/
+void jpeg_encode(string_buffer* out, const unsigned char* rgb, int width, int height, int quality) {
+    jpeg_encoder* enc = malloc(sizeof(jpeg_encoder));
+    if (enc == NULL) {
+        printf("Unable to allocate memory for the JPEG encoder.\n");
+        exit(EXIT_FAILURE);
+    }
+    jpeg_encoder_init(enc, out, quality);
+    jpeg_put_headers(enc, width, height);
+
+    int last_dc[3] = {0, 0, 0};
+    float luma[4][64];
+    float chroma[2][64];
+
+    // Each 16x16 unit has four luma blocks and one block of each chroma channel
+    for (int unit_y = 0; unit_y < height; unit_y += 16) {
+        for (int unit_x = 0; unit_x < width; unit_x += 16) {
+            memset(chroma, 0, sizeof(chroma));
+
+            for (int y = 0; y < 16; y++) {
+                // Pixels past the edge repeat the last row or column
+                int src_y = unit_y + y < height ? unit_y + y : height - 1;
+                for (int x = 0; x < 16; x++) {
+                    int src_x = unit_x + x < width ? unit_x + x : width - 1;
+                    const unsigned char* pixel = rgb + ((size_t)src_y * width + src_x) * 3;
+                    float r = pixel[0];
+                    float g = pixel[1];
+                    float b = pixel[2];
+
+                    int block = (y / 8) * 2 + x / 8;
+                    int slot = (y % 8) * 8 + x % 8;
+                    luma[block][slot] = 0.299f * r + 0.587f * g + 0.114f * b - 128.0f;
+
+                    // The chroma of each 2x2 square is averaged
+                    slot = (y / 2) * 8 + x / 2;
+                    chroma[0][slot] += 0.25f * (-0.168736f * r - 0.331264f * g + 0.5f * b);
+                    chroma[1][slot] += 0.25f * (0.5f * r - 0.418688f * g - 0.081312f * b);
+                }
+            }
+
+            for (int i = 0; i < 4; i++)
+                jpeg_put_block(enc, luma[i], 0, &last_dc[0]);
+            jpeg_put_block(enc, chroma[0], 1, &last_dc[1]);
+            jpeg_put_block(enc, chroma[1], 1, &last_dc[2]);
+        }
+    }
+
+    // Pad the last byte with ones and close the image
+    jpeg_put_bits(enc, 0x7F, 7);
+    static const char end[] = {(char)0xFF, (char)0xD9};
+    str_buf_append(out, end, sizeof(end));
+
+    free(enc);
+}
+
+/******************************************************************************
+ * image_width -- Reads the width of an image from its header, without        *
+ *                decoding it.                                                *
+ *                                                                            *
+ * Parameters                                                                 *
+ *      path -- The path to the image.                                        *
+ *                                                                            *
+ * Returns                                                                    *
+ *      The width in pixels, or 0 if the image can not be read.               *
+ *****************************************************************************/
+int image_width(const char* path) {
+    int width;
+    int height;
+    int channels;
+    if (!stbi_info(path, &width, &height, &channels))
+        return 0;
+
+    return width;
+}
+
+/******************************************************************************
+ * image_shrink -- Scales an image down by averaging the pixels under each    *
+ *                 new pixel. Transparent parts are laid over white, since    *
+ *                 JPEG has no transparency.                                  *
+ *                                                                            *
+ * Parameters                                                                 *
+ *      rgba -- The pixels, four bytes each, in row order.                    *
+ *      width -- The width of the image.                                      *
+ *      height -- The height of the image.                                    *
+ *      new_width -- The width to scale to, no more than the width.           *
+ *      new_height -- The height to scale to, no more than the height.        *
+ *                                                                            *
+ * Returns                                                                    *
+ *      The new pixels, three bytes each, which the caller frees.             *
+ *****************************************************************************/
+unsigned char* image_shrink(const unsigned char* rgba, int width, int height, int new_width, int new_height) {
+    unsigned char* rgb = malloc((size_t)new_width * new_height * 3);
+    uint32_t* sums = malloc((size_t)new_width * 3 * sizeof(uint32_t));
+    int* columns = malloc((size_t)(new_width + 1) * sizeof(int));
+    if (rgb == NULL || sums == NULL || columns == NULL) {
+        printf("Unable to allocate memory to shrink an image.\n");
+        exit(EXIT_FAILURE);
+    }
+
+    // The first source column of each new column
+    for (int x = 0; x <= new_width; x++)
+        columns[x] = (int)((int64_t)x * width / new_width);
+
+    for (int y = 0; y < new_height; y++) {
+        int first_row = (int)((int64_t)y * height / new_height);
+        int last_row = (int)((int64_t)(y + 1) * height / new_height);
+        memset(sums, 0, (size_t)new_width * 3 * sizeof(uint32_t));
+
+        // Add up whole source rows at a time so the image is read in order
+        for (int src_y = first_row; src_y < last_row; src_y++) {
+            const unsigned char* pixel = rgba + (size_t)src_y * width * 4;
+            for (int x = 0; x < new_width; x++) {
+                for (int src_x = columns[x]; src_x < columns[x + 1]; src_x++, pixel += 4) {
+                    uint32_t alpha = pixel[3];
+                    for (int c = 0; c < 3; c++)
+                        sums[x * 3 + c] += alpha == 255 ? pixel[c] : (pixel[c] * alpha + 255 * (255 - alpha) + 127) / 255;
+                }
+            }
+        }
+
+        unsigned char* out = rgb + (size_t)y * new_width * 3;
+        for (int x = 0; x < new_width; x++) {
+            uint32_t count = (uint32_t)(last_row - first_row) * (columns[x + 1] - columns[x]);
+            for (int c = 0; c < 3; c++)
+                out[x * 3 + c] = (unsigned char)((sums[x * 3 + c] + count / 2) / count);
+        }
+    }
+
+    free(columns);
+    free(sums);
+
+    return rgb;
+}
+
+/******************************************************************************
+ * image_shrink_to_jpeg -- Decodes an image and encodes a copy of it that is  *
+ *                         scaled down to a given width.                      *
+ *                                                                            *
+ * Parameters                                                                 *
+ *      path -- The path to the image.                                        *
+ *      max_width -- The width to scale the image down to.                    *
+ *      out -- The buffer to write the JPEG to.                               *
+ *                                                                            *
+ * Returns                                                                    *
+ *      A boolean specifying whether or not the image could be decoded and    *
+ *      needed no more than 65535 pixels of height once shrunk.               *
+ *****************************************************************************/
+bool image_shrink_to_jpeg(const char* path, int max_width, string_buffer* out) {
+    int width;
+    int height;
+    int channels;
+    unsigned char* rgba = stbi_load(path, &width, &height, &channels, 4);
+    if (rgba == NULL)
+        return false;
+
+    // Keep the aspect ratio, and never scale up
+    int new_width = width < max_width ? width : max_width;
+    int new_height = (int)(((int64_t)height * new_width + width / 2) / width);
+    new_height = new_height < 1 ? 1 : new_height;
+    if (new_height > 65535) {
+        stbi_image_free(rgba);
+        return false;
+    }
+
+    unsigned char* rgb = image_shrink(rgba, width, height, new_width, new_height);
+    stbi_image_free(rgba);
+
+    jpeg_encode(out, rgb, new_width, new_height, IMAGE_JPEG_QUALITY);
+    free(rgb);
+
+    return true;
+}
@@ -0,0 +1,674 @@
+/******************************************************************************
+ * bue_index -- Saves the project tree, page titles and links to an index     *
+ *              file in the project, so that an unchanged project can be      *
+ *              reopened without listing every directory and reading every    *
+ *              page again.                                                   *
+ *                                                                            *
+ * Author: 7B Industries                                                      *
+ * License: Apache 2.0                                                        *
+ *                                                                            *
+ * ***************************************************************************/
+
+#include <sys/mman.h>
+
+// The directory in the project that holds the editor's own files, and the index in it
+#define INDEX_DIR ".buildup"
+#define INDEX_FILE "index"
+
+// Identifies an index file, with the format version in the last byte
+#define INDEX_MAGIC "BUIDX\0\0\1"
+
+// Marks a string offset that has no string, such as a page without a title
+#define INDEX_NO_STRING UINT32_MAX
+
+/*
+ * The index is a header followed by arrays of fixed size records, and then a
+ * block of NUL terminated strings that the records point into by offset. The
+ * directories are stored in tree order with each one after its parent, and
+ * the files are stored in tree order after the directories.
+ */
+struct index_header {
+    char magic[8];
+    uint32_t root_path;  // The project path that the index was written for
+    uint32_t number_dirs;
+    uint32_t number_files;
+    uint32_t number_links;
+    uint32_t number_headings;
+    uint32_t strings_size;  // The number of bytes in the string block
+};
+
+struct index_dir {
+    uint32_t path;
+    uint32_t name;
+    uint32_t parent;  // Index of the parent directory, unused for the project root
+    uint32_t reserved;
+    int64_t mtime_sec;  // Changes whenever an entry is added to or removed from the directory
+    int64_t mtime_nsec;
+};
+
+struct index_file {
+    uint32_t path;
+    uint32_t name;
+    uint32_t dir;  // Index of the directory holding the file
+    uint32_t title;  // The page title, or INDEX_NO_STRING
+    int64_t mtime_sec;
+    int64_t mtime_nsec;
+    int64_t size;
+    uint32_t first_link;
+    uint32_t number_links;
+    uint32_t first_heading;
+    uint32_t number_headings;
+};
+
+struct index_link {
+    uint32_t target;  // The normalized path of the linked-to file
+    uint32_t kind;
+    uint32_t line;
+};
+
+struct index_heading {
+    uint32_t text;
+    uint32_t level;
+    uint32_t line;
+};
+
+typedef struct project_index project_index;
+struct project_index {
+    void* map;  // The memory mapped index file
+    size_t map_size;
+    const struct index_header* header;
+    const struct index_dir* dirs;
+    const struct index_file* files;
+    const struct index_link* links;
+    const struct index_heading* headings;
+    const char* strings;
+    uint32_t* file_table;  // Open addressed table of file index + 1, zero when empty
+    size_t file_table_capacity;
+};
+
+bool project_index_dirty = false;  // Set when the project has changed since the index was written
+
+/******************************************************************************
+ * index_path -- Builds the path to a project's index file.                   *
+ *                                                                            *
+ * Parameters                                                                 *
+ *      out -- Buffer that the path is appended to.                           *
+ *      project_path -- The path to the project directory.                    *
+ *                                                                            *
+ * Returns                                                                    *
+ *      Nothing                                                               *
+ *****************************************************************************/
+void index_path(string_buffer* out, const char* project_path) {
+    str_buf_append_str(out, project_path);
+    str_buf_append_str(out, PATH_SEP);
+    str_buf_append_str(out, INDEX_DIR);
+    str_buf_append_str(out, PATH_SEP);
+    str_buf_append_str(out, INDEX_FILE);
+}
+
+/******************************************************************************
+ * index_string -- Gets a string from the index's string block.               *
+ *                                                                            *
+ * Parameters                                                                 *
+ *      index -- The open index.                                              *
+ *      offset -- The offset of the string.                                   *
+ *                                                                            *
+ * Returns                                                                    *
+ *      The string, or NULL for INDEX_NO_STRING.                              *
+ *****************************************************************************/
+const char* index_string(const project_index* index, uint32_t offset) {
+    return offset == INDEX_NO_STRING ? NULL : index->strings + offset;
+}
+
+/******************************************************************************
+ * index_records_valid -- Checks that every offset and count in the index     *
+ *                        points inside of the file, so that a damaged index  *
+ *                        is thrown away instead of being trusted.            *
+ *                                                                            *
+ * Parameters                                                                 *
+ *      index -- The index, with its section pointers set up.                 *
+ *                                                                            *
+ * Returns                                                                    *
+ *      A boolean specifying whether or not the index can be used.            *
+ *****************************************************************************/
+bool index_records_valid(const project_index* index) {
+    const struct index_header* header = index->header;
+    uint32_t size = header->strings_size;
+
+    // Every string must end inside of the block
+    if (size == 0 || index->strings[size - 1] != '\0')
+        return false;
+    if (header->root_path >= size || header->number_dirs == 0)
+        return false;
+
+    for (uint32_t i = 0; i < header->number_dirs; i++) {
+        const struct index_dir* dir = &index->dirs[i];
+        if (dir->path >= size || dir->name >= size)
+            return false;
+        if (i > 0 && dir->parent >= i)
+            return false;
+    }
+
+    for (uint32_t i = 0; i < header->number_files; i++) {
+        const struct index_file* file = &index->files[i];
+        if (file->path >= size || file->name >= size || file->dir >= header->number_dirs)
+            return false;
+        if (file->title != INDEX_NO_STRING && file->title >= size)
+            return false;
+        if (file->first_link > header->number_links || file->number_links > header->number_links - file->first_link)
+            return false;
+        if (file->first_heading > header->number_headings || file->number_headings > header->number_headings - file->first_heading)
+            return false;
+    }
+
+    for (uint32_t i = 0; i < header->number_links; i++) {
+        if (index->links[i].target >= size)
+            return false;
+    }
+
+    for (uint32_t i = 0; i < header->number_headings; i++) {
+        if (index->headings[i].text >= size)
+            return false;
+    }
+
+    return true;
+}
+
+/******************************************************************************
+ * project_index_close -- Unmaps an index and frees its lookup table.         *
+ *                                                                            *
+ * Parameters                                                                 *
+ *      index -- The index to close.                                          *
+ *                                                                            *
+ * Returns                                                                    *
+ *      Nothing                                                               *
+ *****************************************************************************/
+void project_index_close(project_index* index) {
+    if (index->map != NULL)
+        munmap(index->map, index->map_size);
+    free(index->file_table);
+    memset(index, 0, sizeof(project_index));
+}
+
+/******************************************************************************
+ * project_index_open -- Maps a project's index file into memory and checks   *
+ *                       that it is whole and was written for this project.   *
+ *                                                                            *
+ * Parameters                                                                 *
+ *      index -- The index to fill in.                                        *
+ *      project_path -- The path to the project directory.                    *
+ *                                                                            *
+ * Returns                                                                    *
+ *      A boolean specifying whether or not the index can be used.            *
+ *****************************************************************************/
+bool project_index_open(project_index* index, const char* project_path) {
+    memset(index, 0, sizeof(project_index));
+
+    string_buffer path;
+    str_buf_init(&path);
+    index_path(&path, project_path);
+    int fd = open(path.data, O_RDONLY | O_CLOEXEC);
+    str_buf_free(&path);
+    if (fd < 0)
+        return false;
+
+    struct stat st;
+    if (fstat(fd, &st) != 0 || (size_t)st.st_size < sizeof(struct index_header)) {
+        close(fd);
+        return false;
+    }
+
+    // The mapping stays good after the descriptor is closed
+    void* map = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (map == MAP_FAILED)
+        return false;
+
+    index->map = map;
+    index->map_size = st.st_size;
+    index->header = map;
+
+    const struct index_header* header = index->header;
+    if (memcmp(header->magic, INDEX_MAGIC, sizeof(header->magic)) != 0) {
+        project_index_close(index);
+        return false;
+    }
+
+    // Make sure the file is big enough to hold everything the header says it holds
+    uint64_t needed = sizeof(struct index_header);
+    needed += (uint64_t)header->number_dirs * sizeof(struct index_dir);
+    needed += (uint64_t)header->number_files * sizeof(struct index_file);
+    needed += (uint64_t)header->number_links * sizeof(struct index_link);
+    needed += (uint64_t)header->number_headings * sizeof(struct index_heading);
+    needed += header->strings_size;
+    if (needed != index->map_size) {
+        project_index_close(index);
+        return false;
+    }
+
+    const char* pos = (const char*)map + sizeof(struct index_header);
+    index->dirs = (const struct index_dir*)pos;
+    pos += header->number_dirs * sizeof(struct index_dir);
+    index->files = (const struct index_file*)pos;
+    pos += header->number_files * sizeof(struct index_file);
+    index->links = (const struct index_link*)pos;
+    pos += header->number_links * sizeof(struct index_link);
+    index->headings = (const struct index_heading*)pos;
+    pos += header->number_headings * sizeof(struct index_heading);
+    index->strings = pos;
+
+    if (!index_records_valid(index) || strcmp(index_string(index, header->root_path), project_path) != 0) {
+        project_index_close(index);
+        return false;
+    }
+
+    // Set up a table so that files can be found by path
+    index->file_table_capacity = 16;
+    while (index->file_table_capacity < (size_t)header->number_files * 2)
+        index->file_table_capacity *= 2;
+    index->file_table = calloc(index->file_table_capacity, sizeof(uint32_t));
+
+    for (uint32_t i = 0; i < header->number_files; i++) {
+        const char* file_path = index_string(index, index->files[i].path);
+        size_t slot = (size_t)hash_bytes(file_path, strlen(file_path)) & (index->file_table_capacity - 1);
+        while (index->file_table[slot] != 0)
+            slot = (slot + 1) & (index->file_table_capacity - 1);
+        index->file_table[slot] = i + 1;
+    }
+
+    return true;
+}
+
+/******************************************************************************
+ * project_index_find_file -- Looks up a file's record in the index.          *
+ *                                                                            *
+ * Parameters                                                                 *
+ *      index -- The open index.                                              *
+ *      path -- The path of the file.                                         *
+ *                                                                            *
+ * Returns                                                                    *
+ *      The file's record, or NULL if the file is not in the index.           *
+ *****************************************************************************/
+const struct index_file* project_index_find_file(const project_index* index, const char* path) {
+    if (index == NULL || index->file_table == NULL)
+        return NULL;
+
+    size_t slot = (size_t)hash_bytes(path, strlen(path)) & (index->file_table_capacity - 1);
+    while (index->file_table[slot] != 0) {
+        const struct index_file* file = &index->files[index->file_table[slot] - 1];
+        if (strcmp(index_string(index, file->path), path) == 0)
+            return file;
+        slot = (slot + 1) & (index->file_table_capacity - 1);
+    }
+
+    return NULL;
+}
+
+/******************************************************************************
+ * project_index_tree -- Rebuilds the project tree from the index, as long as *
+ *                       none of the directories have changed since it was    *
+ *                       written.                                             *
+ *                                                                            *
+ * Parameters                                                                 *
+ *      index -- The open index.                                              *
+ *      arena -- The arena to build the project tree in.                      *
+ *                                                                            *
+ * Returns                                                                    *
+ *      A pointer to the root of the project tree, or NULL if the project     *
+ *      needs to be listed again.                                             *
+ *****************************************************************************/
+dir_contents* project_index_tree(const project_index* index, tree_arena* arena) {
+    const struct index_header* header = index->header;
+
+    // A directory's modification time changes whenever an entry is added, removed or renamed
+    for (uint32_t i = 0; i < header->number_dirs; i++) {
+        struct stat st;
+        if (stat(index_string(index, index->dirs[i].path), &st) != 0 || !S_ISDIR(st.st_mode))
+            return NULL;
+        if (st.st_mtim.tv_sec != index->dirs[i].mtime_sec || st.st_mtim.tv_nsec != index->dirs[i].mtime_nsec)
+            return NULL;
+    }
+
+    dir_contents** nodes = malloc(header->number_dirs * sizeof(dir_contents*));
+    if (nodes == NULL)
+        return NULL;
+
+    // Parents always come before their children, so each node can be linked in as it is made
+    for (uint32_t i = 0; i < header->number_dirs; i++) {
+        const struct index_dir* rec = &index->dirs[i];
+        dir_contents* parent = i == 0 ? NULL : nodes[rec->parent];
+        nodes[i] = new_dir_node(arena, parent, index_string(index, rec->name), index_string(index, rec->path));
+        if (parent != NULL)
+            add_dir_entry(arena, parent, nodes[i]);
+    }
+
+    for (uint32_t i = 0; i < header->number_files; i++) {
+        const struct index_file* rec = &index->files[i];
+        add_file_entry(arena, nodes[rec->dir], index_string(index, rec->name));
+    }
+
+    dir_contents* contents = nodes[0];
+    free(nodes);
+
+    if (!check_for_buildup_files(contents))
+        contents->error = not_a_buildup_directory;
+
+    return contents;
+}
+
+/******************************************************************************
+ * index_graph_add_dir -- Adds the files in a directory listing to the link   *
+ *                        graph. Pages that have not changed since the index  *
+ *                        was written are loaded from it, and only the rest   *
+ *                        are read and scanned.                               *
+ *                                                                            *
+ * Parameters                                                                 *
+ *      graph -- The link graph to add the files to.                          *
+ *      dir -- The directory listing to add.                                  *
+ *      index -- The open index, or NULL to read every page.                  *
+ *      stale -- Counts the pages that had to be read.                        *
+ *                                                                            *
+ * Returns                                                                    *
+ *      Nothing                                                               *
+ *****************************************************************************/
+void index_graph_add_dir(link_graph* graph, dir_contents* dir, const project_index* index, int* stale) {
+    string_buffer normalized;
+    string_buffer md;
+
+    for (int i = 0; i < dir->number_files; i++) {
+        const char* path = dir->files[i].path;
+        str_buf_init(&normalized);
+        normalize_path(&normalized, path, strlen(path));
+        int node = link_graph_add(graph, normalized.data, true);
+        str_buf_free(&normalized);
+
+        // Only the pages have links and headings in them
+        if (!string_ends_with(dir->files[i].name, ".md"))
+            continue;
+
+        // Use the saved links and title if the page is the same as when they were saved
+        struct stat st;
+        const struct index_file* rec = project_index_find_file(index, path);
+        if (rec != NULL && stat(path, &st) == 0 && st.st_size == rec->size && st.st_mtim.tv_sec == rec->mtime_sec && st.st_mtim.tv_nsec == rec->mtime_nsec) {
+            for (uint32_t j = 0; j < rec->number_links; j++) {
+                const struct index_link* link = &index->links[rec->first_link + j];
+                int target = link_graph_add(graph, index_string(index, link->target), false);
+                link_graph_add_link(graph, node, target, link->kind, link->line);
+            }
+            for (uint32_t j = 0; j < rec->number_headings; j++) {
+                const struct index_heading* heading = &index->headings[rec->first_heading + j];
+                const char* text = index_string(index, heading->text);
+                link_graph_add_heading(graph, node, heading->level, text, strlen(text), heading->line);
+            }
+            title_cache_seed(path, st.st_mtim, st.st_size, index_string(index, rec->title));
+            continue;
+        }
+
+        (*stale)++;
+        str_buf_init(&md);
+        if (read_whole_file(path, &md))
+            link_graph_scan_page(graph, node, md.data, md.len);
+        else
+            printf("Could not open the required file: %s.\n", path);
+        str_buf_free(&md);
+    }
+
+    for (int i = 0; i < dir->number_directories; i++)
+        index_graph_add_dir(graph, dir->dirs[i], index, stale);
+}
+
+/*
+ * The sections of an index while it is being written.
+ */
+struct index_writer {
+    string_buffer dirs;
+    string_buffer files;
+    string_buffer links;
+    string_buffer headings;
+    string_buffer strings;
+    uint32_t number_dirs;
+    uint32_t number_files;
+    uint32_t number_links;
+    uint32_t number_headings;
+};
+
+/******************************************************************************
+ * index_add_string -- Adds a string to the index's string block.             *
+ *                                                                            *
+ * Parameters                                                                 *
+ *      writer -- The index being written.                                    *
+ *      text -- The string to add.                                            *
+ *                                                                            *
+ * Returns                                                                    *
+ *      The offset of the string in the block.                                *
+ *****************************************************************************/
+uint32_t index_add_string(struct index_writer* writer, const char* text) {
+    uint32_t offset = (uint32_t)writer->strings.len;
+    str_buf_append(&writer->strings, text, strlen(text) + 1);
+
+    return offset;
+}
+
+/******************************************************************************
+ * index_add_dirs -- Adds the records for a directory and everything below it *
+ *                   to the index being written. Directories are written      *
+ *                   first so that files can refer to them by index.          *
+ *                                                                            *
+ * Parameters                                                                 *
+ *      writer -- The index being written.                                    *
+ *      dir -- The directory to add.                                          *
+ *      parent -- The index of the parent directory's record.                 *
+ *                                                                            *
+ * Returns                                                                    *
+ *      Nothing                                                               *
+ *****************************************************************************/
+void index_add_dirs(struct index_writer* writer, dir_contents* dir, uint32_t parent) {
+    struct stat st;
+    struct index_dir rec = {0};
+    rec.path = index_add_string(writer, dir->path);
+    rec.name = index_add_string(writer, dir->name);
+    rec.parent = parent;
+    if (stat(dir->path, &st) == 0) {
+        rec.mtime_sec = st.st_mtim.tv_sec;
+        rec.mtime_nsec = st.st_mtim.tv_nsec;
+    }
+
+    uint32_t self = writer->number_dirs++;
+    str_buf_append(&writer->dirs, (const char*)&rec, sizeof(rec));
+
+    for (int i = 0; i < dir->number_directories; i++)
+        index_add_dirs(writer, dir->dirs[i], self);
+}
+
+/******************************************************************************
+ * index_add_files -- Adds the records for the files in a directory and       *
+ *                    everything below it, in the same order that the         *
+ *                    directories were added.                                 *
+ *                                                                            *
+ * Parameters                                                                 *
+ *      writer -- The index being written.                                    *
+ *      dir -- The directory to add the files of.                             *
+ *      dir_index -- Counts the directories as they are visited.              *
+ *                                                                            *
+ * Returns                                                                    *
+ *      Nothing                                                               *
+ *****************************************************************************/
+void index_add_files(struct index_writer* writer, dir_contents* dir, uint32_t* dir_index) {
+    uint32_t self = (*dir_index)++;
+    string_buffer normalized;
+    string_buffer title;
+
+    for (int i = 0; i < dir->number_files; i++) {
+        struct file_entry* ent = &dir->files[i];
+        struct stat st;
+        struct index_file rec = {0};
+        rec.path = index_add_string(writer, ent->path);
+        rec.name = index_add_string(writer, ent->name);
+        rec.dir = self;
+        rec.title = INDEX_NO_STRING;
+        rec.first_link = writer->number_links;
+        rec.first_heading = writer->number_headings;
+
+        // A record that will never match the file makes sure the page is read again on the next open
+        if (stat(ent->path, &st) == 0) {
+            rec.mtime_sec = st.st_mtim.tv_sec;
+            rec.mtime_nsec = st.st_mtim.tv_nsec;
+            rec.size = st.st_size;
+        }
+        else {
+            rec.size = -1;
+        }
+
+        if (string_ends_with(ent->name, ".md")) {
+            str_buf_init(&title);
+            if (title_cache_lookup(ent->path, &title))
+                rec.title = index_add_string(writer, title.data);
+            str_buf_free(&title);
+
+            str_buf_init(&normalized);
+            normalize_path(&normalized, ent->path, strlen(ent->path));
+            int node = link_graph_find(&project_links, normalized.data);
+            str_buf_free(&normalized);
+
+            if (node >= 0) {
+                struct link_node* page = &project_links.nodes[node];
+                for (int j = 0; j < page->number_links; j++) {
+                    struct index_link link = {0};
+                    link.target = index_add_string(writer, project_links.nodes[page->links[j].target].path);
+                    link.kind = page->links[j].kind;
+                    link.line = page->links[j].line;
+                    str_buf_append(&writer->links, (const char*)&link, sizeof(link));
+                }
+                for (int j = 0; j < page->number_headings; j++) {
+                    struct index_heading heading = {0};
+                    heading.text = index_add_string(writer, page->headings[j].text);
+                    heading.level = page->headings[j].level;
+                    heading.line = page->headings[j].line;
+                    str_buf_append(&writer->headings, (const char*)&heading, sizeof(heading));
+                }
+                rec.number_links = page->number_links;
+                rec.number_headings = page->number_headings;
+                writer->number_links += page->number_links;
+                writer->number_headings += page->number_headings;
+            }
+        }
+
+        writer->number_files++;
+        str_buf_append(&writer->files, (const char*)&rec, sizeof(rec));
+    }
+
+    for (int i = 0; i < dir->number_directories; i++)
+        index_add_files(writer, dir->dirs[i], dir_index);
+}
+
+/******************************************************************************
+ * project_index_save -- Writes the index for the open project.               *
+ *                                                                            *
+ * Parameters                                                                 *
+ *      contents -- The root of the project tree.                             *
+ *                                                                            *
+ * Returns                                                                    *
+ *      A boolean specifying whether or not the index was written.            *
+ *****************************************************************************/
+bool project_index_save(dir_contents* contents) {
+    // Make the editor's directory first, since that changes the project directory's modification time
+    string_buffer path;
+    str_buf_init(&path);
+    str_buf_append_str(&path, contents->path);
+    str_buf_append_str(&path, PATH_SEP);
+    str_buf_append_str(&path, INDEX_DIR);
+    create_dir(path.data);
+    str_buf_reset(&path);
+    index_path(&path, contents->path);
+
+    struct index_writer writer;
+    memset(&writer, 0, sizeof(writer));
+    str_buf_init(&writer.dirs);
+    str_buf_init(&writer.files);
+    str_buf_init(&writer.links);
+    str_buf_init(&writer.headings);
+    str_buf_init(&writer.strings);
+
+    struct index_header header;
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, INDEX_MAGIC, sizeof(header.magic));
+    header.root_path = index_add_string(&writer, contents->path);
+
+    uint32_t dir_index = 0;
+    index_add_dirs(&writer, contents, 0);
+    index_add_files(&writer, contents, &dir_index);
+
+    header.number_dirs = writer.number_dirs;
+    header.number_files = writer.number_files;
+    header.number_links = writer.number_links;
+    header.number_headings = writer.number_headings;
+    header.strings_size = (uint32_t)writer.strings.len;
+
+    // Put the sections together in the order they are read back in
+    string_buffer out;
+    str_buf_init(&out);
+    str_buf_append(&out, (const char*)&header, sizeof(header));
+    str_buf_append(&out, writer.dirs.data, writer.dirs.len);
+    str_buf_append(&out, writer.files.data, writer.files.len);
+    str_buf_append(&out, writer.links.data, writer.links.len);
+    str_buf_append(&out, writer.headings.data, writer.headings.len);
+    str_buf_append(&out, writer.strings.data, writer.strings.len);
+
+    bool ok = write_file_atomic(path.data, out.data, out.len);
+    if (!ok)
+        printf("Unable to write the project index to %s.\n", path.data);
+    else
+        project_index_dirty = false;
+
+    str_buf_free(&path);
+    str_buf_free(&out);
+    str_buf_free(&writer.dirs);
+    str_buf_free(&writer.files);
+    str_buf_free(&writer.links);
+    str_buf_free(&writer.headings);
+    str_buf_free(&writer.strings);
+
+    return ok;
+}
+
+/******************************************************************************
+ * open_project -- Lists a project and builds its link graph, using the       *
+ *                 project's index for anything that has not changed since it *
+ *                 was written. The index is brought up to date afterwards if *
+ *                 anything had changed.                                      *
+ *                                                                            *
+ * Parameters                                                                 *
+ *      arena -- The arena to build the project tree in.                      *
+ *      dir_path -- The path to the project directory.                        *
+ *                                                                            *
+ * Returns                                                                    *
+ *      A pointer to the root of the project directory listing.               *
+ *****************************************************************************/
+dir_contents* open_project(tree_arena* arena, char* dir_path) {
+    project_index index;
+    bool have_index = project_index_open(&index, dir_path);
+
+    // Titles cached from the previous project are no longer needed
+    title_cache_clear();
+
+    // Only list the directories again if one of them has changed
+    dir_contents* contents = have_index ? project_index_tree(&index, arena) : NULL;
+    bool tree_from_index = contents != NULL;
+    if (contents == NULL)
+        contents = list_project_dir(arena, dir_path);
+
+    // Work out which pages link to which, reading only the pages that changed
+    int stale = 0;
+    link_graph_free(&project_links);
+    index_graph_add_dir(&project_links, contents, have_index ? &index : NULL, &stale);
+    link_graph_report_dangling();
+
+    project_index_close(&index);
+
+    // Only keep an index for projects that opened properly
+    project_index_dirty = !tree_from_index || stale > 0;
+    if (contents->error == no_error && project_index_dirty)
+        project_index_save(contents);
+
+    return contents;
+}
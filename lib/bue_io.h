@@ -9,12 +9,18 @@
 // #include <string.h>
 #include <dirent.h>
 #include <errno.h>
+#include <fcntl.h>
+#include <stddef.h>
+#include <stdatomic.h>
 
 /* Filesystem path separators vary by OS */
 #ifdef __linux__
     #include <sys/types.h>
     #include <sys/stat.h>
+    #include <sys/ioctl.h>
+    #include <linux/fs.h>
     #include <unistd.h>
+
     const char* PATH_SEP = "/";  // The filesystem path separator for Linux
     const char* NEWLINE = "\n";  // The newline character for Linux
 #elif defined __unix__
@@ -28,52 +34,192 @@
     const char* NEWLINE = "\n";  // The newliine character for MacOS
 #endif
 
-/* Define the maximum number of directories and files in a filesystem listing layer */
-#define MAX_NUM_DIRS 50
-#define MAX_NUM_FILES 250
-
-DIR* open_dir;  // DIRENT struct holding information on the open directory
-
 // Holds the types of files we are working with
-enum file_types {directory = 4, file = 8};
+enum file_types {unknown_type = 0, directory = 4, file = 8};
 
 // Holds the types of errors that we can see when working with directories
-enum dir_errors {no_error = 0, general_error = 1, does_not_exist = 2, not_a_buildup_directory = 3, dir_structure_too_deep = 4, exceeded_max_dirs = 5, exceeded_max_files = 6};
+enum dir_errors {no_error = 0, general_error = 1, does_not_exist = 2, not_a_buildup_directory = 3};
+
+/*
+ * A simple bump allocator that the project tree is built in. Everything in a
+ * tree is released at once when the arena is freed, so nodes, names and child
+ * arrays do not have to be tracked one by one.
+ */
+struct arena_chunk {
+    struct arena_chunk* next;  // The chunk that was allocated before this one
+    size_t used;  // The number of bytes handed out from this chunk
+    size_t size;  // The number of bytes of data in this chunk
+    max_align_t data[];  // The memory handed out by the arena
+};
+
+typedef struct tree_arena tree_arena;
+struct tree_arena {
+    struct arena_chunk* chunks;  // The most recently allocated chunk, which is being filled
+};
+
+// The default size of a chunk of arena memory
+#define ARENA_CHUNK_SIZE 65536
+
+// The directory inside of the project that the site is exported to, which is left out of the project tree
+#define EXPORT_SITE_DIR "_site"
 
 struct file_entry {
     char* name;
     char* path;
-    int selected;
-    int prev_selected;
 };
 
 typedef struct directory_contents {
     char* name;
+    char* path;  // The full path to the directory
+    struct directory_contents* parent;  // The directory holding this one, NULL for the project root
     int number_directories;
     int number_files;
-    int selected;
-    int prev_selected;
+    int dirs_capacity;  // The number of entries allocated for dirs
+    int files_capacity;  // The number of entries allocated for files
+    bool expanded;  // Whether or not the directory is expanded in the project tree
     int error;
-    struct directory_contents* dirs[MAX_NUM_DIRS];
-    struct file_entry files[MAX_NUM_FILES];
+    int watch;  // The file watch on the directory, 0 when it is not being watched
+    struct directory_contents** dirs;
+    struct file_entry* files;
 } dir_contents;
 
 /******************************************************************************
- * dir_free_list -- Frees the memory associated with the directory listing.   *
+ * arena_alloc -- Hands out a block of memory from the arena, adding a new    *
+ *                chunk to the arena when the current one is full.            *
  *                                                                            *
  * Parameters                                                                 *
- *      list -- The array of strings holding the directory listing.           *
- *      size -- The length of the array.                                      *
+ *      arena -- The arena to allocate from.                                  *
+ *      size -- The number of bytes needed.                                   *
  *                                                                            *
  * Returns                                                                    *
- *      void                                                                  *
+ *      A pointer to the block of memory, which lives until the arena is      *
+ *      freed.                                                                *
  *****************************************************************************/
-static void dir_free_list(char **list, size_t size)
-{
-    size_t i;
-    for (i = 0; i < size; i++)
-        free(list[i]);
-    // free(list);
+void* arena_alloc(tree_arena* arena, size_t size) {
+    // Keep every block aligned for any type
+    size = (size + sizeof(max_align_t) - 1) / sizeof(max_align_t) * sizeof(max_align_t);
+
+    struct arena_chunk* chunk = arena->chunks;
+    if (chunk == NULL || chunk->size - chunk->used < size) {
+        size_t chunk_size = size > ARENA_CHUNK_SIZE ? size : ARENA_CHUNK_SIZE;
+        chunk = malloc(sizeof(struct arena_chunk) + chunk_size);
+        if (chunk == NULL) {
+            printf("Unable to allocate memory for the project tree.\n");
+            exit(EXIT_FAILURE);
+        }
+        chunk->next = arena->chunks;
+        chunk->used = 0;
+        chunk->size = chunk_size;
+        arena->chunks = chunk;
+    }
+
+    void* block = (char*)chunk->data + chunk->used;
+    chunk->used += size;
+
+    return block;
+}
+
+/******************************************************************************
+ * arena_grow -- Grows a block that was allocated from the arena. The block   *
+ *               is grown in place if it was the last one handed out, and is  *
+ *               otherwise copied to a new block.                             *
+ *                                                                            *
+ * Parameters                                                                 *
+ *      arena -- The arena that the block came from.                          *
+ *      block -- The block to grow, or NULL to allocate a new one.            *
+ *      old_size -- The number of bytes in the block now.                     *
+ *      new_size -- The number of bytes needed.                               *
+ *                                                                            *
+ * Returns                                                                    *
+ *      A pointer to the grown block.                                         *
+ *****************************************************************************/
+void* arena_grow(tree_arena* arena, void* block, size_t old_size, size_t new_size) {
+    size_t align = sizeof(max_align_t);
+    size_t old_rounded = (old_size + align - 1) / align * align;
+    size_t new_rounded = (new_size + align - 1) / align * align;
+    struct arena_chunk* chunk = arena->chunks;
+
+    // Extend the block in place when nothing has been allocated after it
+    if (block != NULL && chunk != NULL && (char*)block + old_rounded == (char*)chunk->data + chunk->used && chunk->size - chunk->used >= new_rounded - old_rounded) {
+        chunk->used += new_rounded - old_rounded;
+        return block;
+    }
+
+    void* new_block = arena_alloc(arena, new_size);
+    if (block != NULL)
+        memcpy(new_block, block, old_size);
+
+    return new_block;
+}
+
+/******************************************************************************
+ * arena_strdup -- Copies a string into memory from the arena.                *
+ *                                                                            *
+ * Parameters                                                                 *
+ *      arena -- The arena to allocate from.                                  *
+ *      text -- The string to copy.                                           *
+ *                                                                            *
+ * Returns                                                                    *
+ *      The copy of the string.                                               *
+ *****************************************************************************/
+char* arena_strdup(tree_arena* arena, const char* text) {
+    size_t len = strlen(text);
+    char* copy = arena_alloc(arena, len + 1);
+    memcpy(copy, text, len + 1);
+
+    return copy;
+}
+
+/******************************************************************************
+ * arena_free -- Releases all of the memory held by the arena.                *
+ *                                                                            *
+ * Parameters                                                                 *
+ *      arena -- The arena to free.                                           *
+ *                                                                            *
+ * Returns                                                                    *
+ *      Nothing                                                               *
+ *****************************************************************************/
+void arena_free(tree_arena* arena) {
+    struct arena_chunk* chunk = arena->chunks;
+    while (chunk != NULL) {
+        struct arena_chunk* next = chunk->next;
+        free(chunk);
+        chunk = next;
+    }
+
+    arena->chunks = NULL;
+}
+
+/******************************************************************************
+ * arena_merge -- Moves all of the memory held by one arena into another, so  *
+ *                that it is freed along with the other arena's memory.       *
+ *                                                                            *
+ * Parameters                                                                 *
+ *      dest -- The arena to take the memory.                                 *
+ *      src -- The arena to give up its memory, which is left empty.          *
+ *                                                                            *
+ * Returns                                                                    *
+ *      Nothing                                                               *
+ *****************************************************************************/
+void arena_merge(tree_arena* dest, tree_arena* src) {
+    if (src->chunks == NULL)
+        return;
+
+    // Find the oldest chunk in the source so the whole list can be linked in
+    struct arena_chunk* last = src->chunks;
+    while (last->next != NULL)
+        last = last->next;
+
+    // Keep the destination's current chunk first so it carries on filling it
+    if (dest->chunks == NULL) {
+        dest->chunks = src->chunks;
+    }
+    else {
+        last->next = dest->chunks->next;
+        dest->chunks->next = src->chunks;
+    }
+
+    src->chunks = NULL;
 }
 
 /******************************************************************************
@@ -89,7 +235,7 @@ static void dir_free_list(char **list, size_t size)
  *      A boolean defining whether or not the given directory is a BuildUp    *
  *      project directory.                                                    *
  *****************************************************************************/
-static bool check_for_buildup_files(dir_contents contents) {
+static bool check_for_buildup_files(dir_contents* contents) {
     bool result = false;
     bool buildconf_found = false;
     bool big_p_parts_found = false;
@@ -98,13 +244,13 @@ static bool check_for_buildup_files(dir_contents contents) {
     bool small_t_tools_found = false;
 
     // Check for a few of the typical files
-    for (int i = 0; i < contents.number_files; i++) {
+    for (int i = 0; i < contents->number_files; i++) {
         // Check to see if the current name matches the buildconf.yaml file
-        if (strcmp(contents.files[i].name, "buildconf.yaml") == 0) buildconf_found = true;
-        if (strcmp(contents.files[i].name, "Parts.yaml") == 0) big_p_parts_found = true;
-        if (strcmp(contents.files[i].name, "parts.yaml") == 0) small_p_parts_found = true;
-        if (strcmp(contents.files[i].name, "Tools.yaml") == 0) big_t_tools_found = true;
-        if (strcmp(contents.files[i].name, "tools.yaml") == 0) small_t_tools_found = true;
+        if (strcmp(contents->files[i].name, "buildconf.yaml") == 0) buildconf_found = true;
+        if (strcmp(contents->files[i].name, "Parts.yaml") == 0) big_p_parts_found = true;
+        if (strcmp(contents->files[i].name, "parts.yaml") == 0) small_p_parts_found = true;
+        if (strcmp(contents->files[i].name, "Tools.yaml") == 0) big_t_tools_found = true;
+        if (strcmp(contents->files[i].name, "tools.yaml") == 0) small_t_tools_found = true;
     }
 
     // Make sure everything was found that is required
@@ -131,289 +277,670 @@ int sort_compare(const void *str1, const void *str2) {
 }
 
 /******************************************************************************
- * list_dir_contents -- Collects the contents of the directory to pass back   *
- *                       to the caller. This does not filter any files out as *
- *                       it is expected that the caller will do that.         *
+ * sort_dir_compare -- Allows an array of directory pointers to be sorted by  *
+ *                     name.                                                  *
  * Parameters                                                                 *
- *      dir_path -- A char pointer with the path to the directory to list.    *
- *      sort -- A boolean that sets whether or not to spend time on sorting   *
- *              the entries.                                                  *
+ *      dir1 -- Pointer to the first directory pointer to compare.            *
+ *      dir2 -- Pointer to the second directory pointer to compare.           *
+ *                                                                            *
+ * Returns                                                                    *
+ *      The result of the strcmp call on the names, 0 if they are equal.      *
+ *****************************************************************************/
+int sort_dir_compare(const void *dir1, const void *dir2) {
+    dir_contents *const *pp1 = dir1;
+    dir_contents *const *pp2 = dir2;
+
+    return strcmp((*pp1)->name, (*pp2)->name);
+}
+
+/******************************************************************************
+ * sort_file_compare -- Allows an array of file entries to be sorted by name. *
+ * Parameters                                                                 *
+ *      file1 -- Pointer to the first file entry to compare.                  *
+ *      file2 -- Pointer to the second file entry to compare.                 *
  *                                                                            *
  * Returns                                                                    *
- *      A struct holding the directory listing and additional information     *
- *      about the listing items.                                              *
+ *      The result of the strcmp call on the names, 0 if they are equal.      *
  *****************************************************************************/
-dir_contents list_dir_contents(char* dir_path, bool sort) {
-    dir_contents contents;  // The strings of the directory contents
+int sort_file_compare(const void *file1, const void *file2) {
+    const struct file_entry *p1 = file1;
+    const struct file_entry *p2 = file2;
 
-    // Initialize the variables that track the number of directories and the number of files
-    contents.number_directories = -1;
-    contents.number_files = -1;
+    return strcmp(p1->name, p2->name);
+}
 
-    // Start out with no error
-    contents.error = no_error;
+/******************************************************************************
+ * is_listed_file -- Checks whether a file is one of the kinds of files that  *
+ *                   are shown in the project tree.                           *
+ *                                                                            *
+ * Parameters                                                                 *
+ *      name -- The name of the file.                                         *
+ *                                                                            *
+ * Returns                                                                    *
+ *      A boolean specifying whether or not the file should be listed.        *
+ *****************************************************************************/
+bool is_listed_file(const char* name) {
+    return string_ends_with(name, ".md") || string_ends_with(name, ".yaml") || string_ends_with(name, ".png") || string_ends_with(name, ".jpeg") || string_ends_with(name, ".jpg");
+}
 
-    // Open the directory and make sure there was not a problem
-    open_dir = opendir(dir_path);
-    if (open_dir != NULL) {
-        // Step through the given directory's contents
-        struct dirent *data = NULL;
+/******************************************************************************
+ * is_listed_dir -- Checks whether a directory is shown in the project tree.  *
+ *                  The exported site is not part of the project, so its      *
+ *                  pages and images are not searched, indexed or watched.    *
+ *                                                                            *
+ * Parameters                                                                 *
+ *      parent -- The directory that the directory is in.                     *
+ *      name -- The name of the directory.                                    *
+ *                                                                            *
+ * Returns                                                                    *
+ *      A boolean specifying whether or not the directory should be listed.   *
+ *****************************************************************************/
+bool is_listed_dir(const dir_contents* parent, const char* name) {
+    return parent->parent != NULL || strcmp(name, EXPORT_SITE_DIR) != 0;
+}
 
-        while ((data = readdir(open_dir)) != NULL) {
-            // Ignore hidden files and directories
-            if (data->d_name[0] == '.')
+/******************************************************************************
+ * new_dir_node -- Allocates a new, empty directory node in the arena.        *
+ *                                                                            *
+ * Parameters                                                                 *
+ *      arena -- The arena to allocate the node from.                         *
+ *      parent -- The directory holding the new one, or NULL for the root.    *
+ *      name -- The name of the directory.                                    *
+ *      path -- The full path to the directory.                               *
+ *                                                                            *
+ * Returns                                                                    *
+ *      A pointer to the new directory node.                                  *
+ *****************************************************************************/
+dir_contents* new_dir_node(tree_arena* arena, dir_contents* parent, const char* name, const char* path) {
+    dir_contents* node = arena_alloc(arena, sizeof(dir_contents));
+    memset(node, 0, sizeof(dir_contents));
+
+    node->name = arena_strdup(arena, name);
+    node->path = arena_strdup(arena, path);
+    node->parent = parent;
+    node->error = no_error;
+
+    return node;
+}
+
+/******************************************************************************
+ * add_dir_entry -- Adds a subdirectory to a directory node, growing the      *
+ *                  child array as needed.                                    *
+ *                                                                            *
+ * Parameters                                                                 *
+ *      arena -- The arena that the tree lives in.                            *
+ *      dir -- The directory to add the subdirectory to.                      *
+ *      child -- The subdirectory to add.                                     *
+ *                                                                            *
+ * Returns                                                                    *
+ *      Nothing                                                               *
+ *****************************************************************************/
+void add_dir_entry(tree_arena* arena, dir_contents* dir, dir_contents* child) {
+    if (dir->number_directories == dir->dirs_capacity) {
+        int new_capacity = dir->dirs_capacity == 0 ? 4 : dir->dirs_capacity * 2;
+        dir->dirs = arena_grow(arena, dir->dirs, dir->dirs_capacity * sizeof(dir_contents*), new_capacity * sizeof(dir_contents*));
+        dir->dirs_capacity = new_capacity;
+    }
+
+    dir->dirs[dir->number_directories++] = child;
+}
+
+/******************************************************************************
+ * add_file_entry -- Adds a file to a directory node, growing the file array  *
+ *                   as needed.                                               *
+ *                                                                            *
+ * Parameters                                                                 *
+ *      arena -- The arena that the tree lives in.                            *
+ *      dir -- The directory to add the file to.                              *
+ *      name -- The name of the file.                                         *
+ *                                                                            *
+ * Returns                                                                    *
+ *      A pointer to the new file entry.                                      *
+ *****************************************************************************/
+struct file_entry* add_file_entry(tree_arena* arena, dir_contents* dir, const char* name) {
+    if (dir->number_files == dir->files_capacity) {
+        int new_capacity = dir->files_capacity == 0 ? 8 : dir->files_capacity * 2;
+        dir->files = arena_grow(arena, dir->files, dir->files_capacity * sizeof(struct file_entry), new_capacity * sizeof(struct file_entry));
+        dir->files_capacity = new_capacity;
+    }
+
+    // Keep track of this file name and path
+    string_buffer path;
+    str_buf_init(&path);
+    str_buf_append_str(&path, dir->path);
+    str_buf_append_str(&path, PATH_SEP);
+    str_buf_append_str(&path, name);
+
+    struct file_entry* ent = &dir->files[dir->number_files++];
+    ent->name = arena_strdup(arena, name);
+    ent->path = arena_strdup(arena, path.data);
+
+    str_buf_free(&path);
+
+    return ent;
+}
+
+/******************************************************************************
+ * list_dir_contents -- Fills in a directory node with the subdirectories     *
+ *                      and files that are in the directory. Only the files   *
+ *                      that the editor works with are listed.                *
+ * Parameters                                                                 *
+ *      arena -- The arena that the tree lives in.                            *
+ *      dir -- The directory node to fill in, with its path already set.      *
+ *      open_dir -- The directory stream to read the entries from.            *
+ *      sort -- A boolean that sets whether or not to spend time on sorting   *
+ *              the entries.                                                  *
+ *                                                                            *
+ * Returns                                                                    *
+ *      One of the dir_errors, which is also saved in the node.               *
+ *****************************************************************************/
+int list_dir_contents(tree_arena* arena, dir_contents* dir, DIR* open_dir, bool sort) {
+    // Step through the given directory's contents
+    struct dirent *data = NULL;
+    string_buffer child_path;
+    str_buf_init(&child_path);
+
+    while ((data = readdir(open_dir)) != NULL) {
+        // Ignore hidden files and directories
+        if (data->d_name[0] == '.')
+            continue;
+
+        // Some filesystems do not fill in the entry type, so ask for it relative to the open directory
+        int type = data->d_type;
+        if (type == unknown_type) {
+            struct stat st;
+            if (fstatat(dirfd(open_dir), data->d_name, &st, AT_SYMLINK_NOFOLLOW) != 0)
                 continue;
+            type = S_ISDIR(st.st_mode) ? directory : file;
+        }
 
-            // Make sure to only list files that we care about and directories
-            if (data->d_type != directory && !string_ends_with(data->d_name, ".md") && !string_ends_with(data->d_name, ".yaml") && !string_ends_with(data->d_name, ".png") && !string_ends_with(data->d_name, ".jpeg") && !string_ends_with(data->d_name, ".jpg")) {
+        // Determine whether we are working with a directory or a file
+        if (type == directory) {
+            if (!is_listed_dir(dir, data->d_name))
                 continue;
-            }
-
-            // Determine whether we are working with a directory or a file
-            if (data->d_type == directory) {
-                // Refuse to add any directories over the maximum amount
-                if (contents.number_directories >= MAX_NUM_DIRS) {
-                    contents.error = exceeded_max_dirs;
-                }
-                else {
-                    // Keep track of the number of directories, starting the count at 1
-                    if (contents.number_directories == -1) {
-                        contents.number_directories = 1;
-                    }
-                    else {
-                        contents.number_directories++;
-                    }
-
-                    // Keep track of this directory's information as a new array element
-                    contents.dirs[contents.number_directories - 1] = (dir_contents *)malloc(sizeof(dir_contents));
-                    contents.dirs[contents.number_directories - 1]->name = strdup(data->d_name);
-                    contents.dirs[contents.number_directories - 1]->selected = 0;
-                    contents.dirs[contents.number_directories - 1]->prev_selected = 0;
-                }
-            }
-            else {
-                // Refuse to add any files over the maximum amount
-                if (contents.number_files >= MAX_NUM_FILES) {
-                    contents.error = exceeded_max_files;
-                }
-                else {
-                    // Keep track of the number of files, starting the count at 1
-                    if (contents.number_files == -1) {
-                        contents.number_files = 1;
-                    }
-                    else {
-                        contents.number_files++;
-                    }
-
-                    // Keep track of this file name and path
-                    char new_path[strlen(dir_path) + strlen(PATH_SEP) + strlen(data->d_name) + 1];
-                    new_path[0] = '\0';
-                    strcat(new_path, dir_path);
-                    strcat(new_path, PATH_SEP);
-                    strcat(new_path, data->d_name);
-                    struct file_entry ent = {.name=strdup(data->d_name), .selected=0, .prev_selected=0, .path=strdup(new_path)};
-                    contents.files[contents.number_files - 1] = ent;
-                }
-            }
+
+            str_buf_reset(&child_path);
+            str_buf_append_str(&child_path, dir->path);
+            str_buf_append_str(&child_path, PATH_SEP);
+            str_buf_append_str(&child_path, data->d_name);
+
+            add_dir_entry(arena, dir, new_dir_node(arena, dir, data->d_name, child_path.data));
+        }
+        else if (is_listed_file(data->d_name)) {
+            add_file_entry(arena, dir, data->d_name);
         }
     }
-    else if (ENOENT == errno) {
-        // Set the size to a value that lets the caller know the directory does not exist
-        contents.error = does_not_exist;
+
+    str_buf_free(&child_path);
+
+    // If the caller has requested a sort, do that now
+    if (sort && dir->number_directories > 1)
+        qsort(dir->dirs, dir->number_directories, sizeof(dir_contents*), sort_dir_compare);
+    if (sort && dir->number_files > 1)
+        qsort(dir->files, dir->number_files, sizeof(struct file_entry), sort_file_compare);
+
+    return no_error;
+}
+
+// The most directories that a scan keeps open for their subdirectories at once, the rest are opened by path
+#define SCAN_MAX_OPEN_DIRS 64
+
+// How many times a directory is queued again when the process is out of file descriptors
+#define SCAN_OPEN_RETRIES 8
+
+/*
+ * An open directory that is shared by the scans of its subdirectories, so
+ * that they can be opened relative to it. The last one to finish closes it.
+ */
+struct scan_handle {
+    DIR* dir;
+    atomic_int refs;
+    atomic_int* open_dirs;  // The scan's count of shared directories, which this is taken off of when closed
+};
+
+/*
+ * The state shared by all of the tasks that are scanning a project. Each
+ * worker builds its part of the tree in its own arena so that no locking is
+ * needed, and the arenas are handed over to the caller once the scan is done.
+ */
+struct project_scan {
+    work_pool pool;
+    tree_arena arenas[POOL_MAX_THREADS];
+    atomic_int open_dirs;  // The number of directories being kept open for their subdirectories
+};
+
+struct scan_task {
+    struct project_scan* scan;
+    dir_contents* dir;  // The directory to list
+    struct scan_handle* parent;  // The open parent directory, or NULL to open the directory by its path
+    int retries;  // The number of times the directory was queued again for want of a file descriptor
+};
+
+/******************************************************************************
+ * release_scan_handle -- Drops a reference to a shared open directory,       *
+ *                        closing it when nothing else needs it.              *
+ *                                                                            *
+ * Parameters                                                                 *
+ *      handle -- The shared open directory.                                  *
+ *                                                                            *
+ * Returns                                                                    *
+ *      Nothing                                                               *
+ *****************************************************************************/
+void release_scan_handle(struct scan_handle* handle) {
+    if (atomic_fetch_sub(&handle->refs, 1) == 1) {
+        closedir(handle->dir);
+        atomic_fetch_sub(handle->open_dirs, 1);
+        free(handle);
+    }
+}
+
+/******************************************************************************
+ * scan_dir_task -- Lists one directory of a project on a worker thread, and  *
+ *                  queues up a task for each of its subdirectories.          *
+ *                                                                            *
+ * Parameters                                                                 *
+ *      arg -- Pointer to the scan_task, which is freed by this function.     *
+ *      worker -- The index of the worker that is running the task.           *
+ *                                                                            *
+ * Returns                                                                    *
+ *      Nothing                                                               *
+ *****************************************************************************/
+void scan_dir_task(void* arg, int worker) {
+    struct scan_task* task = arg;
+    dir_contents* dir = task->dir;
+
+    // Open the directory relative to its parent, which saves a full path lookup on slow file systems
+    int fd = -1;
+    if (task->parent != NULL) {
+        fd = openat(dirfd(task->parent->dir), dir->name, O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+        release_scan_handle(task->parent);
+    }
+    if (fd < 0)
+        fd = open(dir->path, O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+
+    // Running out of file descriptors is not a problem with the directory, so try it again once others are closed
+    if (fd < 0 && (errno == EMFILE || errno == ENFILE) && task->retries < SCAN_OPEN_RETRIES) {
+        task->parent = NULL;
+        task->retries++;
+        pool_submit(&task->scan->pool, scan_dir_task, task);
+        return;
+    }
+
+    DIR* open_dir = fd < 0 ? NULL : fdopendir(fd);
+    if (open_dir == NULL) {
+        dir->error = ENOENT == errno ? does_not_exist : general_error;
+        if (fd >= 0) close(fd);
+        free(task);
+        return;
+    }
+
+    list_dir_contents(&task->scan->arenas[worker], dir, open_dir, true);
+
+    // A wide tree would otherwise hold a descriptor for every directory waiting in the queue
+    struct scan_handle* handle = NULL;
+    if (dir->number_directories > 0 && atomic_fetch_add(&task->scan->open_dirs, 1) < SCAN_MAX_OPEN_DIRS) {
+        handle = malloc(sizeof(struct scan_handle));
+        if (handle == NULL) {
+            printf("Unable to allocate memory for the project scan.\n");
+            exit(EXIT_FAILURE);
+        }
+        handle->dir = open_dir;
+        handle->open_dirs = &task->scan->open_dirs;
+        atomic_init(&handle->refs, dir->number_directories + 1);
     }
     else {
-        contents.error = general_error;
+        if (dir->number_directories > 0)
+            atomic_fetch_sub(&task->scan->open_dirs, 1);
+        closedir(open_dir);
     }
 
-    // If the caller has requested a sort, do that now
-    if (!sort) {
-        printf("Sorting...\n");
+    // Fan the subdirectories out to the other workers, keeping this directory open for them when there is room
+
+    for (int i = 0; i < dir->number_directories; i++) {
+        struct scan_task* sub = malloc(sizeof(struct scan_task));
+        if (sub == NULL) {
+            printf("Unable to allocate memory for the project scan.\n");
+            exit(EXIT_FAILURE);
+        }
+        sub->scan = task->scan;
+        sub->dir = dir->dirs[i];
+        sub->parent = handle;
+        sub->retries = 0;
+        pool_submit(&task->scan->pool, scan_dir_task, sub);
     }
 
-    // Make sure the directory resource is closed if we sucessfully got it open.
-    if (open_dir) closedir(open_dir);
+    if (handle != NULL)
+        release_scan_handle(handle);
+    free(task);
+}
 
-    return contents;
+/******************************************************************************
+ * first_tree_error -- Finds the first error in the tree, in the order that   *
+ *                     the tree is displayed, so that the error reported does *
+ *                     not depend on which thread finished first.             *
+ *                                                                            *
+ * Parameters                                                                 *
+ *      dir -- The directory to start looking from.                           *
+ *                                                                            *
+ * Returns                                                                    *
+ *      The first of the dir_errors found, or no_error.                       *
+ *****************************************************************************/
+int first_tree_error(dir_contents* dir) {
+    if (dir->error != no_error)
+        return dir->error;
+
+    for (int i = 0; i < dir->number_directories; i++) {
+        int error = first_tree_error(dir->dirs[i]);
+        if (error != no_error)
+            return error;
+    }
+
+    return no_error;
 }
 
 /******************************************************************************
  * list_project_dir -- List all of the directories and files that are present *
- *                     in the given project directory.                        *
+ *                     in the given project directory, however deep the       *
+ *                     directory structure goes. The directories are listed   *
+ *                     in parallel, but the result is always sorted.          *
  * Parameters                                                                 *
+ *      arena -- The arena to build the project tree in.                      *
  *      dir_path -- The path to the project directory.                        *
  *                                                                            *
  * Returns                                                                    *
- *      A struct holding the project directory listing and additional         *
- *      information about the listing items.                                  *
+ *      A pointer to the root of the project directory listing. Its error     *
+ *      field is set if any of the directories could not be listed.           *
  *****************************************************************************/
-dir_contents list_project_dir(char* dir_path) {
-    dir_contents contents;  // The strings of the directory contents
-    dir_contents temp_level_1;  // The first sub-directory's contents
-    dir_contents temp_level_2;  // The second sub-directory's contents
-    dir_contents temp_level_3;  // The third sub-directory's contents
-    dir_contents temp_level_4;  // The fourth sub-directory's contents
-    dir_contents temp_level_5;  // The fifth sub-directory's contents
-
-    // Get the sorted listing of the root project directory
-    contents = list_dir_contents(dir_path, true);
-
-    // Step through all of the directories in the root project directory and get their listings
-    for (int i = 0; i < contents.number_directories; i++) {
-        // Assemble the subdirectory path
-        char sub_path[strlen(dir_path) + strlen(PATH_SEP) + strlen(contents.dirs[i]->name) + 1];
-        sub_path[0] = '\0';
-        strcat(sub_path, dir_path);
-        strcat(sub_path, PATH_SEP);
-        strcat(sub_path, contents.dirs[i]->name);
-
-        // List the subdirectory's contents
-        temp_level_1 = list_dir_contents(sub_path, true);
-
-        // If there is an error, go ahead and return the current contents
-        if (temp_level_1.error > 0 && contents.error == 0) {
-            contents.error = temp_level_1.error;
-        }
+dir_contents* list_project_dir(tree_arena* arena, char* dir_path) {
+    dir_contents* contents = new_dir_node(arena, NULL, dir_path, dir_path);
 
-        // Add the subdirectory's contents to the main listing of contents
-        contents.dirs[i]->number_directories = temp_level_1.number_directories;
-        contents.dirs[i]->number_files = temp_level_1.number_files;
-        if (temp_level_1.number_directories > 0) {
-            for (int j = 0; j < temp_level_1.number_directories; j++) {
-                contents.dirs[i]->dirs[j] = temp_level_1.dirs[j];
-
-                // List the second level directory's contents
-                char sub_path_2[strlen(sub_path) + strlen(PATH_SEP) + strlen(contents.dirs[i]->dirs[j]->name) + 1];
-                sub_path_2[0] = '\0';
-                strcat(sub_path_2, sub_path);
-                strcat(sub_path_2, PATH_SEP);
-                strcat(sub_path_2, contents.dirs[i]->dirs[j]->name);
-
-                // List the second level subdirectory
-                temp_level_2 = list_dir_contents(sub_path_2, true);
-
-                // If there is an error, go ahead and return the current contents
-                if (temp_level_2.error > 0 && contents.error == 0) {
-                    contents.error = temp_level_2.error;
-                }
-
-                // Add the second level subdirectory's contents to the main listing
-                contents.dirs[i]->dirs[j]->number_directories = temp_level_2.number_directories;
-                contents.dirs[i]->dirs[j]->number_files = temp_level_2.number_files;
-                if (temp_level_2.number_directories > 0) {
-                    for (int k = 0; k < temp_level_2.number_directories; k++) {
-                        contents.dirs[i]->dirs[j]->dirs[k] = temp_level_2.dirs[k];
-
-                        // List the third level directory's contents
-                        char sub_path_3[strlen(sub_path_2) + strlen(PATH_SEP) + strlen(contents.dirs[i]->dirs[j]->dirs[k]->name) + 1];
-                        sub_path_3[0] = '\0';
-                        strcat(sub_path_3, sub_path_2);
-                        strcat(sub_path_3, PATH_SEP);
-                        strcat(sub_path_3, contents.dirs[i]->dirs[j]->dirs[k]->name);
-
-                        // List the third level subdirectory
-                        temp_level_3 = list_dir_contents(sub_path_3, true);
-
-                        // If there is an error, go ahead and return the current contents
-                        if (temp_level_3.error > 0 && contents.error == 0) {
-                            contents.error = temp_level_3.error;
-                        }
-
-                        // Add the third level subdirectory's contents to the main listing
-                        contents.dirs[i]->dirs[j]->dirs[k]->number_directories = temp_level_3.number_directories;
-                        contents.dirs[i]->dirs[j]->dirs[k]->number_files = temp_level_3.number_files;
-                        if (temp_level_3.number_directories > 0) {
-                            for (int l = 0; l < temp_level_3.number_directories; l++) {
-                                contents.dirs[i]->dirs[j]->dirs[k]->dirs[l] = temp_level_3.dirs[k];
-
-                                // Create the path to the forth level directory's contents
-                                char sub_path_4[strlen(sub_path_3) + strlen(PATH_SEP) + strlen(contents.dirs[i]->dirs[j]->dirs[k]->dirs[l]->name) + 1];
-                                sub_path_4[0] = '\0';
-                                strcat(sub_path_4, sub_path_3);
-                                strcat(sub_path_4, PATH_SEP);
-                                strcat(sub_path_4, contents.dirs[i]->dirs[j]->dirs[k]->dirs[l]->name);
-
-                                // List the fourth level subdirectory
-                                temp_level_4 = list_dir_contents(sub_path_4, true);
-
-                                // If there is an error, go ahead and return the current contents
-                                if (temp_level_4.error > 0 && contents.error == 0) {
-                                    contents.error = temp_level_4.error;
-                                }
-
-                                // Add the fourth level subdirectory's contents to the main listing
-                                contents.dirs[i]->dirs[j]->dirs[k]->dirs[l]->number_directories = temp_level_4.number_directories;
-                                contents.dirs[i]->dirs[j]->dirs[k]->dirs[l]->number_files = temp_level_4.number_files;
-                                if (temp_level_4.number_directories > 0) {
-                                    for (int m = 0; m < temp_level_4.number_directories; m++) {
-                                        contents.dirs[i]->dirs[j]->dirs[k]->dirs[l]->dirs[m] = temp_level_4.dirs[m];
-
-                                        // Create the path to the fifth level directory's contents
-                                        char sub_path_5[strlen(sub_path_4) + strlen(PATH_SEP) + strlen(contents.dirs[i]->dirs[j]->dirs[k]->dirs[l]->dirs[m]->name) + 1];
-                                        sub_path_5[0] = '\0';
-                                        strcat(sub_path_5, sub_path_4);
-                                        strcat(sub_path_5, PATH_SEP);
-                                        strcat(sub_path_5, contents.dirs[i]->dirs[j]->dirs[k]->dirs[l]->dirs[m]->name);
-
-                                        // List the fifth level subdirectory
-                                        temp_level_5 = list_dir_contents(sub_path_5, true);
-
-                                        // If there is an error, go ahead and set it in the current contents
-                                        if (temp_level_5.error > 0 && contents.error == 0) {
-                                            contents.error = temp_level_5.error;
-                                        }
-
-                                        // Add the fifth level subdirectory's contents to the main listing
-                                        contents.dirs[i]->dirs[j]->dirs[k]->dirs[l]->dirs[m]->number_directories = temp_level_5.number_directories;
-                                        contents.dirs[i]->dirs[j]->dirs[k]->dirs[l]->dirs[m]->number_files = temp_level_5.number_files;
-                                        if (temp_level_5.number_directories > 0) {
-                                            // Add the directories of this sublisting to the main listing
-                                            for (int n = 0; n < temp_level_5.number_directories; n++) {
-                                                contents.dirs[i]->dirs[j]->dirs[k]->dirs[l]->dirs[m]->dirs[n] = temp_level_5.dirs[n];
-                                            }
-                                        }
-                                        if (temp_level_5.number_files > 0) {
-                                            for (int n = 0; n < temp_level_5.number_files; n++) {
-                                                contents.dirs[i]->dirs[j]->dirs[k]->dirs[l]->dirs[m]->files[n] = temp_level_5.files[n];
-                                            }
-                                        }
-                                    }
-                                }
-                                if (temp_level_4.number_files > 0) {
-                                    for (int m = 0; m < temp_level_4.number_files; m++) {
-                                        contents.dirs[i]->dirs[j]->dirs[k]->dirs[l]->files[m] = temp_level_4.files[m];
-                                    }
-                                }
-                            }
-                        }
-                        if (temp_level_3.number_files > 0) {
-                            for (int l = 0; l < temp_level_3.number_files; l++) {
-                                contents.dirs[i]->dirs[j]->dirs[k]->files[l] = temp_level_3.files[l];
-                            }
-                        }
-                    }
-                }
-                if (temp_level_2.number_files > 0) {
-                    for (int k = 0; k < temp_level_2.number_files; k++) {
-                        contents.dirs[i]->dirs[j]->files[k] = temp_level_2.files[k];
-                    }
-                }
-            }
-        }
-        if (temp_level_1.number_files > 0) {
-            for (int j = 0; j < temp_level_1.number_files; j++) {
-                contents.dirs[i]->files[j] = temp_level_1.files[j];
-            }
-        }
+    struct project_scan* scan = calloc(1, sizeof(struct project_scan));
+    struct scan_task* task = malloc(sizeof(struct scan_task));
+    if (scan == NULL || task == NULL) {
+        printf("Unable to allocate memory for the project scan.\n");
+        exit(EXIT_FAILURE);
     }
 
+    // Start from the project root and let the workers fan out from there
+    pool_start(&scan->pool, pool_default_threads());
+    task->scan = scan;
+    task->dir = contents;
+    task->parent = NULL;
+    task->retries = 0;
+    pool_submit(&scan->pool, scan_dir_task, task);
+    pool_wait(&scan->pool);
+    pool_stop(&scan->pool);
+
+    // The caller owns everything the workers allocated from now on
+    for (int i = 0; i < POOL_MAX_THREADS; i++)
+        arena_merge(arena, &scan->arenas[i]);
+    free(scan);
+
+    contents->error = first_tree_error(contents);
+
     // Make sure that we are dealing with a BuildUp project directory
-    if (!check_for_buildup_files(contents)) {
-        contents.error = not_a_buildup_directory;
+    if (contents->error == no_error && !check_for_buildup_files(contents)) {
+        contents->error = not_a_buildup_directory;
     }
 
     return contents;
 }
 
+/******************************************************************************
+ * read_whole_file -- Reads the entire contents of a file into a buffer.      *
+ *                                                                            *
+ * Parameters                                                                 *
+ *      path -- The path to the file to read.                                 *
+ *      out -- Buffer that the file contents will be appended to.             *
+ *                                                                            *
+ * Returns                                                                    *
+ *      A boolean specifying whether or not the file could be read.           *
+ *****************************************************************************/
+bool read_whole_file(const char* path, string_buffer* out) {
+    FILE* in_file = fopen(path, "rb");
+    if (in_file == NULL)
+        return false;
+
+    // Read in large chunks straight into the end of the buffer
+    size_t read_size = 0;
+    do {
+        str_buf_reserve(out, 65536);
+        read_size = fread(out->data + out->len, 1, 65536, in_file);
+        out->len += read_size;
+        out->data[out->len] = '\0';
+    } while (read_size > 0);
+
+    bool ok = !ferror(in_file);
+    fclose(in_file);
+
+    return ok;
+}
+
+/******************************************************************************
+ * write_all -- Writes all of a block of bytes to an open file, carrying on   *
+ *              after short writes.                                           *
+ *                                                                            *
+ * Parameters                                                                 *
+ *      fd -- The file to write to.                                           *
+ *      data -- The bytes to write.                                           *
+ *      len -- The number of bytes to write.                                  *
+ *                                                                            *
+ * Returns                                                                    *
+ *      A boolean specifying whether or not all of the bytes were written.    *
+ *****************************************************************************/
+bool write_all(int fd, const void* data, size_t len) {
+    const char* pos = data;
+    while (len > 0) {
+        ssize_t written = write(fd, pos, len);
+        if (written < 0 && errno == EINTR)
+            continue;
+        if (written <= 0)
+            return false;
+        pos += written;
+        len -= (size_t)written;
+    }
+
+    return true;
+}
+
+/******************************************************************************
+ * write_file_atomic -- Writes a whole file by writing a temporary file next  *
+ *                      to it and renaming it over the old one, so that       *
+ *                      readers never see a partly written file. The new      *
+ *                      file keeps the permissions of the old one, and a      *
+ *                      symbolic link is written through to its target. A     *
+ *                      file with other hard links is written in place, since *
+ *                      renaming over it would split it off from them.        *
+ *                                                                            *
+ * Parameters                                                                 *
+ *      path -- The path to the file to write.                                *
+ *      data -- The bytes to write.                                           *
+ *      len -- The number of bytes to write.                                  *
+ *                                                                            *
+ * Returns                                                                    *
+ *      A boolean specifying whether or not the file was written.             *
+ *****************************************************************************/
+bool write_file_atomic(const char* path, const void* data, size_t len) {
+    // A file that does not exist yet has no link to follow
+    char* resolved = realpath(path, NULL);
+    const char* target = resolved != NULL ? resolved : path;
+
+    struct stat st;
+    bool exists = stat(target, &st) == 0;
+    bool ok;
+
+    if (exists && st.st_nlink > 1) {
+        int out = open(target, O_WRONLY | O_TRUNC | O_CLOEXEC);
+        ok = out >= 0 && write_all(out, data, len);
+        ok = out >= 0 && fsync(out) == 0 && ok;
+        ok = out >= 0 && close(out) == 0 && ok;
+        free(resolved);
+        return ok;
+    }
+
+    string_buffer tmp_path;
+    str_buf_init(&tmp_path);
+    str_buf_append_str(&tmp_path, target);
+    str_buf_append_str(&tmp_path, ".tmp");
+
+    int out = open(tmp_path.data, O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0666);
+    if (out < 0) {
+        str_buf_free(&tmp_path);
+        free(resolved);
+        return false;
+    }
+
+    // The umask applies when the file is created, so the old permissions are set afterwards
+    ok = !exists || fchmod(out, st.st_mode & 07777) == 0;
+    ok = write_all(out, data, len) && ok;
+    ok = fsync(out) == 0 && ok;
+    ok = close(out) == 0 && ok;
+
+    // Only replace the old file once the new one is safely on disk
+    if (ok)
+        ok = rename(tmp_path.data, target) == 0;
+    if (!ok)
+        remove(tmp_path.data);
+
+    str_buf_free(&tmp_path);
+    free(resolved);
+
+    return ok;
+}
+
+/******************************************************************************
+ * copy_file_data -- Copies the rest of one open file into another. The       *
+ *                   filesystem is asked to share the blocks first, then to   *
+ *                   copy them in the kernel, and only if neither works are   *
+ *                   the bytes read and written here.                         *
+ *                                                                            *
+ * Parameters                                                                 *
+ *      in -- The file to copy from.                                          *
+ *      out -- The file to copy to.                                           *
+ *      size -- The number of bytes in the file being copied.                 *
+ *                                                                            *
+ * Returns                                                                    *
+ *      A boolean specifying whether or not the file was copied.              *
+ *****************************************************************************/
+bool copy_file_data(int in, int out, off_t size) {
+    #if defined __linux__ && defined FICLONE
+        // A reflink makes the copy share the blocks of the original until either one is changed
+        if (ioctl(out, FICLONE, in) == 0)
+            return true;
+    #endif
+
+    // copy_file_range came in with glibc 2.27, older ones go straight to reading and writing
+    #if defined __linux__ && defined __GLIBC__ && (__GLIBC__ > 2 || (__GLIBC__ == 2 && __GLIBC_MINOR__ >= 27))
+        // Both files' offsets move along, so a streamed copy can pick up wherever this stops
+        while (size > 0) {
+            ssize_t copied = copy_file_range(in, NULL, out, NULL, (size_t)size, 0);
+            if (copied < 0 && errno == EINTR)
+                continue;
+            if (copied <= 0)
+                break;
+            size -= copied;
+        }
+        if (size == 0)
+            return true;
+    #else
+        (void)size;
+    #endif
+
+    char buffer[65536];
+    while (true) {
+        ssize_t read_size = read(in, buffer, sizeof(buffer));
+        if (read_size < 0 && errno == EINTR)
+            continue;
+        if (read_size <= 0)
+            return read_size == 0;
+
+        if (!write_all(out, buffer, (size_t)read_size))
+            return false;
+    }
+}
+
+/******************************************************************************
+ * copy_file_atomic -- Copies a file by copying it to a temporary file next   *
+ *                     to the destination and renaming it into place. The     *
+ *                     copy is not synced to disk, so this is meant for       *
+ *                     files that can be made again, like exported ones.      *
+ *                                                                            *
+ * Parameters                                                                 *
+ *      src_path -- The path to the file to copy.                             *
+ *      path -- The path to copy the file to.                                 *
+ *                                                                            *
+ * Returns                                                                    *
+ *      A boolean specifying whether or not the file was copied.              *
+ *****************************************************************************/
+bool copy_file_atomic(const char* src_path, const char* path) {
+    int in = open(src_path, O_RDONLY | O_CLOEXEC);
+    if (in < 0)
+        return false;
+
+    struct stat st;
+    if (fstat(in, &st) != 0) {
+        close(in);
+        return false;
+    }
+
+    string_buffer tmp_path;
+    str_buf_init(&tmp_path);
+    str_buf_append_str(&tmp_path, path);
+    str_buf_append_str(&tmp_path, ".tmp");
+
+    int out = open(tmp_path.data, O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+    bool ok = out >= 0 && copy_file_data(in, out, st.st_size);
+    if (out >= 0)
+        ok = close(out) == 0 && ok;
+    close(in);
+
+    // Only replace the old file once the new one is whole
+    if (ok)
+        ok = rename(tmp_path.data, path) == 0;
+    if (!ok)
+        remove(tmp_path.data);
+
+    str_buf_free(&tmp_path);
+
+    return ok;
+}
+
+/******************************************************************************
+ * link_file_atomic -- Makes a path a hard link to an existing file, in place *
+ *                     of whatever was at the path before.                    *
+ *                                                                            *
+ * Parameters                                                                 *
+ *      existing -- The path to the file to link to.                          *
+ *      path -- The path of the new link.                                     *
+ *                                                                            *
+ * Returns                                                                    *
+ *      A boolean specifying whether or not the link was made.                *
+ *****************************************************************************/
+bool link_file_atomic(const char* existing, const char* path) {
+    // Renaming over a link to the same file does nothing, which would leave the temporary link behind
+    struct stat existing_st;
+    struct stat path_st;
+    if (stat(existing, &existing_st) == 0 && stat(path, &path_st) == 0 && existing_st.st_dev == path_st.st_dev && existing_st.st_ino == path_st.st_ino)
+        return true;
+
+    string_buffer tmp_path;
+    str_buf_init(&tmp_path);
+    str_buf_append_str(&tmp_path, path);
+    str_buf_append_str(&tmp_path, ".tmp");
+
+    // Renaming the link over the old file keeps readers from ever seeing the path missing
+    remove(tmp_path.data);
+    bool ok = link(existing, tmp_path.data) == 0;
+    if (ok)
+        ok = rename(tmp_path.data, path) == 0;
+    if (!ok)
+        remove(tmp_path.data);
+
+    str_buf_free(&tmp_path);
+
+    return ok;
+}
+
 /******************************************************************************
  * create_dir_nix -- Creates a directory properly on Linux or Unix.           *
  *                                                                            *
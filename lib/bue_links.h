@@ -0,0 +1,586 @@
+/******************************************************************************
+ * bue_links -- Keeps an in-memory graph of which project files link to       *
+ *              which, so that other parts of the editor do not have to       *
+ *              rescan the project files to find out.                         *
+ *                                                                            *
+ * Author: 7B Industries                                                      *
+ * License: Apache 2.0                                                        *
+ *                                                                            *
+ * ***************************************************************************/
+
+// The kinds of links that can be found in a page
+enum link_kinds {page_link = 0, step_link = 1, image_link = 2};
+
+struct page_link {
+    int target;  // Index of the linked-to node in the graph
+    int kind;  // One of the link_kinds
+    int line;  // The line number of the link in the source page, starting at 1
+};
+
+struct page_heading {
+    int level;  // The number of hash marks in front of the heading
+    int line;  // The line number of the heading, starting at 1
+    char* text;  // The heading text, without the hash marks
+};
+
+/*
+ * A node in the link graph. Every page and image in the project gets a node,
+ * and so does anything that a page links to that is not in the project so
+ * that dangling links can be found.
+ */
+struct link_node {
+    char* path;  // The normalized path to the file
+    uint64_t path_hash;  // Hash of the path used by the index
+    bool exists;  // Whether or not the file is part of the project
+    struct page_link* links;  // Outgoing links, in the order they appear
+    int number_links;
+    int links_capacity;
+    struct page_heading* headings;  // Headings, in the order they appear
+    int number_headings;
+    int headings_capacity;
+    int* backlinks;  // Indexes of the nodes linking here, once per link
+    int number_backlinks;
+    int backlinks_capacity;
+};
+
+typedef struct link_graph link_graph;
+struct link_graph {
+    struct link_node* nodes;  // All of the nodes in the graph
+    int number_nodes;
+    int nodes_capacity;
+    int* index;  // Open addressed table of node index + 1, zero when empty
+    size_t index_capacity;  // The number of slots in the index, a power of two
+};
+
+link_graph project_links;  // The link graph for the open project
+
+/******************************************************************************
+ * normalize_path -- Appends a path to the buffer with any "." and ".."       *
+ *                   segments and doubled separators collapsed, so that two   *
+ *                   spellings of the same path compare equal.                *
+ *                                                                            *
+ * Parameters                                                                 *
+ *      out -- Buffer that the normalized path is appended to.                *
+ *      path -- Pointer to the path to normalize.                             *
+ *      len -- The number of bytes in the path.                               *
+ *                                                                            *
+ * Returns                                                                    *
+ *      Nothing                                                               *
+ *****************************************************************************/
+void normalize_path(string_buffer* out, const char* path, size_t len) {
+    str_buf_reserve(out, len + 1);
+
+    size_t start = out->len;
+    const char* end = path + len;
+    const char* pos = path;
+
+    // Keep a leading separator for absolute paths
+    if (len > 0 && path[0] == PATH_SEP[0])
+        str_buf_append_char(out, PATH_SEP[0]);
+    size_t root = out->len;
+
+    while (pos < end) {
+        const char* sep = memchr(pos, PATH_SEP[0], end - pos);
+        const char* seg_end = sep ? sep : end;
+        size_t seg_len = seg_end - pos;
+
+        // The last segment in the output so far, used to resolve ".."
+        const char* last_seg = out->data + out->len;
+        while (last_seg > out->data + root && last_seg[-1] != PATH_SEP[0])
+            last_seg--;
+        bool last_is_parent = (out->data + out->len) - last_seg == 2 && memcmp(last_seg, "..", 2) == 0;
+
+        if (seg_len == 0 || (seg_len == 1 && pos[0] == '.')) {
+            // Nothing to add for empty or current directory segments
+        }
+        else if (seg_len == 2 && memcmp(pos, "..", 2) == 0 && out->len > root && !last_is_parent) {
+            // Drop the last segment that was added, along with its separator
+            out->len = last_seg - out->data;
+            if (out->len > root)
+                out->len--;
+            out->data[out->len] = '\0';
+        }
+        else if (seg_len == 2 && memcmp(pos, "..", 2) == 0 && root > start) {
+            // There is nothing above the root directory
+        }
+        else {
+            if (out->len > root)
+                str_buf_append_char(out, PATH_SEP[0]);
+            str_buf_append(out, pos, seg_len);
+        }
+
+        pos = sep ? sep + 1 : end;
+    }
+
+    // A path that collapsed to nothing refers to the current directory
+    if (out->len == start)
+        str_buf_append_char(out, '.');
+}
+
+/******************************************************************************
+ * link_graph_find -- Finds the node for a path in the link graph.            *
+ *                                                                            *
+ * Parameters                                                                 *
+ *      graph -- The link graph to search.                                    *
+ *      path -- The normalized path to look for.                              *
+ *                                                                            *
+ * Returns                                                                    *
+ *      The index of the node, or -1 if there is no node for the path.        *
+ *****************************************************************************/
+int link_graph_find(link_graph* graph, const char* path) {
+    if (graph->index_capacity == 0)
+        return -1;
+
+    uint64_t path_hash = hash_bytes(path, strlen(path));
+    size_t mask = graph->index_capacity - 1;
+
+    // Linear probing until either the path or an empty slot is found
+    for (size_t i = (size_t)path_hash & mask; graph->index[i] != 0; i = (i + 1) & mask) {
+        struct link_node* node = &graph->nodes[graph->index[i] - 1];
+        if (node->path_hash == path_hash && strcmp(node->path, path) == 0)
+            return graph->index[i] - 1;
+    }
+
+    return -1;
+}
+
+/******************************************************************************
+ * link_graph_index_insert -- Adds a node to the path index of the graph.     *
+ *                                                                            *
+ * Parameters                                                                 *
+ *      graph -- The link graph that holds the node.                          *
+ *      node_index -- The index of the node to add.                           *
+ *                                                                            *
+ * Returns                                                                    *
+ *      Nothing                                                               *
+ *****************************************************************************/
+void link_graph_index_insert(link_graph* graph, int node_index) {
+    size_t mask = graph->index_capacity - 1;
+    size_t i = (size_t)graph->nodes[node_index].path_hash & mask;
+
+    while (graph->index[i] != 0)
+        i = (i + 1) & mask;
+
+    graph->index[i] = node_index + 1;
+}
+
+/******************************************************************************
+ * link_graph_add -- Gets the node for a path, adding it if it is not in the  *
+ *                   graph yet.                                               *
+ *                                                                            *
+ * Parameters                                                                 *
+ *      graph -- The link graph to add the node to.                           *
+ *      path -- The normalized path of the node.                              *
+ *      exists -- Whether or not the file is part of the project.             *
+ *                                                                            *
+ * Returns                                                                    *
+ *      The index of the node for the path.                                   *
+ *****************************************************************************/
+int link_graph_add(link_graph* graph, const char* path, bool exists) {
+    int found = link_graph_find(graph, path);
+    if (found >= 0) {
+        graph->nodes[found].exists = graph->nodes[found].exists || exists;
+        return found;
+    }
+
+    // Make room for the new node
+    if (graph->number_nodes == graph->nodes_capacity) {
+        graph->nodes_capacity = graph->nodes_capacity == 0 ? 64 : graph->nodes_capacity * 2;
+        graph->nodes = realloc(graph->nodes, graph->nodes_capacity * sizeof(struct link_node));
+    }
+
+    // Keep the index no more than half full, rebuilding it when it grows
+    if ((size_t)(graph->number_nodes + 1) * 2 > graph->index_capacity) {
+        free(graph->index);
+        graph->index_capacity = graph->index_capacity == 0 ? 128 : graph->index_capacity * 2;
+        graph->index = calloc(graph->index_capacity, sizeof(int));
+        for (int i = 0; i < graph->number_nodes; i++)
+            link_graph_index_insert(graph, i);
+    }
+
+    struct link_node* node = &graph->nodes[graph->number_nodes];
+    memset(node, 0, sizeof(struct link_node));
+    node->path = strdup(path);
+    node->path_hash = hash_bytes(path, strlen(path));
+    node->exists = exists;
+
+    link_graph_index_insert(graph, graph->number_nodes);
+
+    return graph->number_nodes++;
+}
+
+/******************************************************************************
+ * link_graph_clear_page -- Removes the outgoing links and headings of a      *
+ *                          page, along with the backlinks they created.      *
+ *                                                                            *
+ * Parameters                                                                 *
+ *      graph -- The link graph holding the page.                             *
+ *      page -- The index of the page to clear.                               *
+ *                                                                            *
+ * Returns                                                                    *
+ *      Nothing                                                               *
+ *****************************************************************************/
+void link_graph_clear_page(link_graph* graph, int page) {
+    struct link_node* node = &graph->nodes[page];
+
+    // Take one backlink entry off the target for each outgoing link
+    for (int i = 0; i < node->number_links; i++) {
+        struct link_node* target = &graph->nodes[node->links[i].target];
+        for (int j = 0; j < target->number_backlinks; j++) {
+            if (target->backlinks[j] == page) {
+                target->backlinks[j] = target->backlinks[target->number_backlinks - 1];
+                target->number_backlinks--;
+                break;
+            }
+        }
+    }
+    node->number_links = 0;
+
+    for (int i = 0; i < node->number_headings; i++)
+        free(node->headings[i].text);
+    node->number_headings = 0;
+}
+
+/******************************************************************************
+ * link_graph_add_link -- Records a link from one node to another, and the    *
+ *                        matching backlink on the target.                    *
+ *                                                                            *
+ * Parameters                                                                 *
+ *      graph -- The link graph holding both nodes.                           *
+ *      page -- The index of the page holding the link.                       *
+ *      target -- The index of the node being linked to.                      *
+ *      kind -- The kind of link from link_kinds.                             *
+ *      line -- The line number that the link is on.                          *
+ *                                                                            *
+ * Returns                                                                    *
+ *      Nothing                                                               *
+ *****************************************************************************/
+void link_graph_add_link(link_graph* graph, int page, int target, int kind, int line) {
+    struct link_node* node = &graph->nodes[page];
+    if (node->number_links == node->links_capacity) {
+        node->links_capacity = node->links_capacity == 0 ? 8 : node->links_capacity * 2;
+        node->links = realloc(node->links, node->links_capacity * sizeof(struct page_link));
+    }
+    node->links[node->number_links++] = (struct page_link){.target = target, .kind = kind, .line = line};
+
+    struct link_node* target_node = &graph->nodes[target];
+    if (target_node->number_backlinks == target_node->backlinks_capacity) {
+        target_node->backlinks_capacity = target_node->backlinks_capacity == 0 ? 4 : target_node->backlinks_capacity * 2;
+        target_node->backlinks = realloc(target_node->backlinks, target_node->backlinks_capacity * sizeof(int));
+    }
+    target_node->backlinks[target_node->number_backlinks++] = page;
+}
+
+/******************************************************************************
+ * link_graph_add_heading -- Records a heading found in a page.               *
+ *                                                                            *
+ * Parameters                                                                 *
+ *      graph -- The link graph holding the page.                             *
+ *      page -- The index of the page holding the heading.                    *
+ *      level -- The number of hash marks in front of the heading.            *
+ *      text -- Pointer to the heading text.                                  *
+ *      len -- The number of bytes in the heading text.                       *
+ *      line -- The line number that the heading is on.                       *
+ *                                                                            *
+ * Returns                                                                    *
+ *      Nothing                                                               *
+ *****************************************************************************/
+void link_graph_add_heading(link_graph* graph, int page, int level, const char* text, size_t len, int line) {
+    struct link_node* node = &graph->nodes[page];
+    if (node->number_headings == node->headings_capacity) {
+        node->headings_capacity = node->headings_capacity == 0 ? 8 : node->headings_capacity * 2;
+        node->headings = realloc(node->headings, node->headings_capacity * sizeof(struct page_heading));
+    }
+    node->headings[node->number_headings++] = (struct page_heading){.level = level, .line = line, .text = strndup(text, len)};
+}
+
+/******************************************************************************
+ * link_target_is_local -- Checks whether a link target refers to a file in   *
+ *                         the project rather than a web address or anchor.   *
+ *                                                                            *
+ * Parameters                                                                 *
+ *      target -- Pointer to the link target text.                            *
+ *      len -- The number of bytes in the link target.                        *
+ *                                                                            *
+ * Returns                                                                    *
+ *      A boolean specifying whether the target is a project file.            *
+ *****************************************************************************/
+bool link_target_is_local(const char* target, size_t len) {
+    if (len == 0 || target[0] == '#')
+        return false;
+
+    // Anything with a scheme in front of it, like https: or mailto:, is external
+    const char* colon = memchr(target, ':', len);
+    const char* slash = memchr(target, '/', len);
+    if (colon != NULL && (slash == NULL || colon < slash))
+        return false;
+
+    return true;
+}
+
+/******************************************************************************
+ * link_graph_scan_page -- Parses the headings and links out of a page's      *
+ *                         markdown and adds them to the graph.               *
+ *                                                                            *
+ * Parameters                                                                 *
+ *      graph -- The link graph holding the page.                             *
+ *      page -- The index of the page that the markdown belongs to.           *
+ *      md -- Pointer to the markdown text of the page.                       *
+ *      len -- The number of bytes of markdown.                               *
+ *                                                                            *
+ * Returns                                                                    *
+ *      Nothing                                                               *
+ *****************************************************************************/
+void link_graph_scan_page(link_graph* graph, int page, const char* md, size_t len) {
+    const char* pos = md;
+    const char* end = md + len;
+    bool in_code_block = false;
+    int line_number = 0;
+
+    // Links are relative to the directory that holds the page
+    string_buffer target_path;
+    const char* page_path = graph->nodes[page].path;
+    const char* last_sep = strrchr(page_path, PATH_SEP[0]);
+    size_t dir_len = last_sep ? (size_t)(last_sep - page_path) : 0;
+
+    while (pos < end) {
+        const char* eol = memchr(pos, '\n', end - pos);
+        const char* line_end = eol ? eol : end;
+        line_number++;
+
+        if (line_end > pos && line_end[-1] == '\r')
+            line_end--;
+
+        // Skip over fenced code blocks, since anything in them is literal text
+        const char* text = pos;
+        while (text < line_end && text - pos < 3 && *text == ' ')
+            text++;
+        if (line_end - text >= 3 && (memcmp(text, "```", 3) == 0 || memcmp(text, "~~~", 3) == 0)) {
+            in_code_block = !in_code_block;
+        }
+        else if (!in_code_block && text < line_end && *text == '#') {
+            // Record the heading and its level
+            int level = 0;
+            while (text < line_end && *text == '#') {
+                level++;
+                text++;
+            }
+            while (text < line_end && *text == ' ')
+                text++;
+            link_graph_add_heading(graph, page, level, text, line_end - text, line_number);
+        }
+        else if (!in_code_block) {
+            // Find each [text](target) on the line
+            const char* scan = text;
+            const char* open_bracket;
+            while ((open_bracket = memchr(scan, '[', line_end - scan)) != NULL) {
+                const char* close_bracket = memchr(open_bracket, ']', line_end - open_bracket);
+                if (close_bracket == NULL || close_bracket + 1 >= line_end || close_bracket[1] != '(')
+                    break;
+                const char* target = close_bracket + 2;
+                const char* close_paren = memchr(target, ')', line_end - target);
+                if (close_paren == NULL)
+                    break;
+
+                // Drop any link title and anchor from the target
+                const char* target_end = target;
+                while (target_end < close_paren && *target_end != ' ' && *target_end != '#')
+                    target_end++;
+
+                int kind = page_link;
+                if (open_bracket > pos && open_bracket[-1] == '!')
+                    kind = image_link;
+                else if (line_end - close_paren > 6 && memcmp(close_paren + 1, "{step}", 6) == 0)
+                    kind = step_link;
+
+                if (link_target_is_local(target, target_end - target)) {
+                    str_buf_init(&target_path);
+                    if (target[0] != PATH_SEP[0]) {
+                        str_buf_append(&target_path, page_path, dir_len);
+                        str_buf_append_str(&target_path, PATH_SEP);
+                    }
+                    str_buf_append(&target_path, target, target_end - target);
+
+                    // Store the target in its normalized form so the paths match the project tree
+                    string_buffer normalized;
+                    str_buf_init(&normalized);
+                    normalize_path(&normalized, target_path.data, target_path.len);
+                    int target_index = link_graph_add(graph, normalized.data, false);
+                    link_graph_add_link(graph, page, target_index, kind, line_number);
+                    str_buf_free(&normalized);
+                    str_buf_free(&target_path);
+                }
+
+                scan = close_paren + 1;
+            }
+        }
+
+        pos = eol ? eol + 1 : end;
+    }
+}
+
+/******************************************************************************
+ * link_graph_update_page -- Replaces the links and headings of one page with *
+ *                           the ones in the given markdown. Only this page's *
+ *                           edges are touched, so saving a page does not     *
+ *                           need a rescan of the whole project.              *
+ *                                                                            *
+ * Parameters                                                                 *
+ *      path -- The path to the page.                                         *
+ *      md -- Pointer to the new markdown text of the page.                   *
+ *      len -- The number of bytes of markdown.                               *
+ *                                                                            *
+ * Returns                                                                    *
+ *      Nothing                                                               *
+ *****************************************************************************/
+void link_graph_update_page(const char* path, const char* md, size_t len) {
+    string_buffer normalized;
+    str_buf_init(&normalized);
+    normalize_path(&normalized, path, strlen(path));
+
+    int page = link_graph_add(&project_links, normalized.data, true);
+    link_graph_clear_page(&project_links, page);
+    link_graph_scan_page(&project_links, page, md, len);
+
+    str_buf_free(&normalized);
+}
+
+/******************************************************************************
+ * link_graph_remove_page -- Marks a file as no longer being part of the      *
+ *                           project, and drops the links that it made. Links *
+ *                           to the file are kept so they show as dangling.   *
+ *                                                                            *
+ * Parameters                                                                 *
+ *      path -- The path to the file that was removed.                        *
+ *                                                                            *
+ * Returns                                                                    *
+ *      Nothing                                                               *
+ *****************************************************************************/
+void link_graph_remove_page(const char* path) {
+    string_buffer normalized;
+    str_buf_init(&normalized);
+    normalize_path(&normalized, path, strlen(path));
+
+    int page = link_graph_find(&project_links, normalized.data);
+    if (page >= 0) {
+        link_graph_clear_page(&project_links, page);
+        project_links.nodes[page].exists = false;
+    }
+
+    str_buf_free(&normalized);
+}
+
+/******************************************************************************
+ * link_graph_free -- Releases all of the memory held by a link graph.        *
+ *                                                                            *
+ * Parameters                                                                 *
+ *      graph -- The link graph to free.                                      *
+ *                                                                            *
+ * Returns                                                                    *
+ *      Nothing                                                               *
+ *****************************************************************************/
+void link_graph_free(link_graph* graph) {
+    for (int i = 0; i < graph->number_nodes; i++) {
+        for (int j = 0; j < graph->nodes[i].number_headings; j++)
+            free(graph->nodes[i].headings[j].text);
+        free(graph->nodes[i].path);
+        free(graph->nodes[i].links);
+        free(graph->nodes[i].headings);
+        free(graph->nodes[i].backlinks);
+    }
+    free(graph->nodes);
+    free(graph->index);
+
+    memset(graph, 0, sizeof(link_graph));
+}
+
+/******************************************************************************
+ * link_graph_add_dir -- Adds all of the files in a directory listing, and    *
+ *                       the links in any of its pages, to the graph.         *
+ *                                                                            *
+ * Parameters                                                                 *
+ *      graph -- The link graph to add the files to.                          *
+ *      dir -- The directory listing to add.                                  *
+ *                                                                            *
+ * Returns                                                                    *
+ *      Nothing                                                               *
+ *****************************************************************************/
+void link_graph_add_dir(link_graph* graph, struct directory_contents* dir) {
+    string_buffer normalized;
+    string_buffer md;
+
+    for (int i = 0; i < dir->number_files; i++) {
+        str_buf_init(&normalized);
+        normalize_path(&normalized, dir->files[i].path, strlen(dir->files[i].path));
+        int node = link_graph_add(graph, normalized.data, true);
+        str_buf_free(&normalized);
+
+        // Only the pages have links and headings in them
+        if (string_ends_with(dir->files[i].name, ".md")) {
+            str_buf_init(&md);
+            if (read_whole_file(dir->files[i].path, &md))
+                link_graph_scan_page(graph, node, md.data, md.len);
+            else
+                printf("Could not open the required file: %s.\n", dir->files[i].path);
+            str_buf_free(&md);
+        }
+    }
+
+    for (int i = 0; i < dir->number_directories; i++)
+        link_graph_add_dir(graph, dir->dirs[i]);
+}
+
+/******************************************************************************
+ * link_graph_report_dangling -- Lets the user know about any links in the    *
+ *                               project that lead nowhere.                   *
+ *                                                                            *
+ * Parameters                                                                 *
+ *      None                                                                  *
+ *                                                                            *
+ * Returns                                                                    *
+ *      Nothing                                                               *
+ *****************************************************************************/
+void link_graph_report_dangling() {
+    for (int i = 0; i < project_links.number_nodes; i++) {
+        if (!project_links.nodes[i].exists && project_links.nodes[i].number_backlinks > 0)
+            printf("Dangling link to %s from %s.\n", project_links.nodes[i].path, project_links.nodes[project_links.nodes[i].backlinks[0]].path);
+    }
+}
+
+/******************************************************************************
+ * link_graph_build -- Builds the link graph for a newly opened project.      *
+ *                                                                            *
+ * Parameters                                                                 *
+ *      project -- The directory listing of the whole project.                *
+ *                                                                            *
+ * Returns                                                                    *
+ *      Nothing                                                               *
+ *****************************************************************************/
+void link_graph_build(struct directory_contents* project) {
+    link_graph_free(&project_links);
+    link_graph_add_dir(&project_links, project);
+    link_graph_report_dangling();
+}
+
+/******************************************************************************
+ * link_graph_backlinks -- Gets the pages that link to the given file.        *
+ *                                                                            *
+ * Parameters                                                                 *
+ *      path -- The normalized path of the file.                              *
+ *      count -- Set to the number of entries in the returned array.          *
+ *                                                                            *
+ * Returns                                                                    *
+ *      An array of node indexes, one for each link to the file, or NULL if   *
+ *      nothing links to it. The array is owned by the graph.                 *
+ *****************************************************************************/
+const int* link_graph_backlinks(const char* path, int* count) {
+    int node = link_graph_find(&project_links, path);
+
+    if (node < 0) {
+        *count = 0;
+        return NULL;
+    }
+
+    *count = project_links.nodes[node].number_backlinks;
+    return project_links.nodes[node].backlinks;
+}
@@ -0,0 +1,236 @@
+/******************************************************************************
+ * bue_pool -- A small pool of worker threads that run queued tasks. Used for *
+ *             jobs like scanning a project that can be split up and run in   *
+ *             parallel.                                                      *
+ *                                                                            *
+ * Author: 7B Industries                                                      *
+ * License: Apache 2.0                                                        *
+ *                                                                            *
+ * ***************************************************************************/
+
+#include <pthread.h>
+#include <unistd.h>
+
+// The most worker threads a pool will start
+#define POOL_MAX_THREADS 16
+
+// The function that runs a task, given the task's argument and the index of the worker running it
+typedef void (*pool_task_fn)(void* arg, int worker);
+
+struct pool_task {
+    pool_task_fn run;  // The function that does the work
+    void* arg;  // The argument to pass to the function
+};
+
+typedef struct work_pool work_pool;
+struct work_pool {
+    pthread_t threads[POOL_MAX_THREADS];
+    int number_threads;
+    pthread_mutex_t lock;
+    pthread_cond_t work;  // Signalled when a task is queued or the pool is stopping
+    pthread_cond_t idle;  // Signalled when the last running task finishes
+    struct pool_task* tasks;  // Ring buffer of queued tasks
+    int tasks_capacity;
+    int tasks_head;  // Index of the next task to run
+    int number_tasks;  // The number of tasks in the queue
+    int active;  // The number of tasks that are running right now
+    bool stopping;
+};
+
+/*
+ * Passed to each worker thread so that it knows which pool it belongs to and
+ * which worker it is.
+ */
+struct pool_worker_arg {
+    work_pool* pool;
+    int worker;
+};
+
+/******************************************************************************
+ * pool_default_threads -- Works out how many threads a pool should use. File *
+ *                         system work spends most of its time waiting, so    *
+ *                         this is more than the number of processors.        *
+ *                                                                            *
+ * Parameters                                                                 *
+ *      None                                                                  *
+ *                                                                            *
+ * Returns                                                                    *
+ *      The number of threads to start.                                       *
+ *****************************************************************************/
+int pool_default_threads() {
+    long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+    if (cpus < 1) cpus = 1;
+
+    long threads = cpus * 2;
+    if (threads < 4) threads = 4;
+    if (threads > POOL_MAX_THREADS) threads = POOL_MAX_THREADS;
+
+    return (int)threads;
+}
+
+/******************************************************************************
+ * pool_worker_main -- The loop run by each worker thread. Takes tasks off    *
+ *                     the queue until the pool is stopped.                   *
+ *                                                                            *
+ * Parameters                                                                 *
+ *      arg -- Pointer to the pool_worker_arg for this thread.                *
+ *                                                                            *
+ * Returns                                                                    *
+ *      NULL                                                                  *
+ *****************************************************************************/
+void* pool_worker_main(void* arg) {
+    struct pool_worker_arg worker_arg = *(struct pool_worker_arg*)arg;
+    work_pool* pool = worker_arg.pool;
+    free(arg);
+
+    pthread_mutex_lock(&pool->lock);
+    while (true) {
+        // Sleep until there is something to do
+        while (pool->number_tasks == 0 && !pool->stopping)
+            pthread_cond_wait(&pool->work, &pool->lock);
+
+        if (pool->number_tasks == 0 && pool->stopping)
+            break;
+
+        struct pool_task task = pool->tasks[pool->tasks_head];
+        pool->tasks_head = (pool->tasks_head + 1) % pool->tasks_capacity;
+        pool->number_tasks--;
+        pool->active++;
+        pthread_mutex_unlock(&pool->lock);
+
+        task.run(task.arg, worker_arg.worker);
+
+        pthread_mutex_lock(&pool->lock);
+        pool->active--;
+
+        // Let anyone waiting on the pool know that all of the work is done
+        if (pool->active == 0 && pool->number_tasks == 0)
+            pthread_cond_broadcast(&pool->idle);
+    }
+    pthread_mutex_unlock(&pool->lock);
+
+    return NULL;
+}
+
+/******************************************************************************
+ * pool_start -- Sets up a pool and starts its worker threads.                *
+ *                                                                            *
+ * Parameters                                                                 *
+ *      pool -- The pool to start.                                            *
+ *      number_threads -- How many worker threads to start, which is capped   *
+ *                        at POOL_MAX_THREADS.                                *
+ *                                                                            *
+ * Returns                                                                    *
+ *      The number of worker threads that were started.                       *
+ *****************************************************************************/
+int pool_start(work_pool* pool, int number_threads) {
+    if (number_threads < 1) number_threads = 1;
+    if (number_threads > POOL_MAX_THREADS) number_threads = POOL_MAX_THREADS;
+
+    memset(pool, 0, sizeof(work_pool));
+    pthread_mutex_init(&pool->lock, NULL);
+    pthread_cond_init(&pool->work, NULL);
+    pthread_cond_init(&pool->idle, NULL);
+
+    for (int i = 0; i < number_threads; i++) {
+        struct pool_worker_arg* arg = malloc(sizeof(struct pool_worker_arg));
+        if (arg == NULL) break;
+        arg->pool = pool;
+        arg->worker = i;
+
+        if (pthread_create(&pool->threads[i], NULL, pool_worker_main, arg) != 0) {
+            free(arg);
+            break;
+        }
+        pool->number_threads++;
+    }
+
+    if (pool->number_threads == 0) {
+        printf("Unable to start any worker threads.\n");
+        exit(EXIT_FAILURE);
+    }
+
+    return pool->number_threads;
+}
+
+/******************************************************************************
+ * pool_submit -- Queues a task to be run by one of the pool's workers. Tasks *
+ *                may submit more tasks while they run.                       *
+ *                                                                            *
+ * Parameters                                                                 *
+ *      pool -- The pool to run the task on.                                  *
+ *      run -- The function that does the work.                               *
+ *      arg -- The argument to pass to the function.                          *
+ *                                                                            *
+ * Returns                                                                    *
+ *      Nothing                                                               *
+ *****************************************************************************/
+void pool_submit(work_pool* pool, pool_task_fn run, void* arg) {
+    pthread_mutex_lock(&pool->lock);
+
+    // Grow the ring buffer, unwrapping the queued tasks into the new one
+    if (pool->number_tasks == pool->tasks_capacity) {
+        int new_capacity = pool->tasks_capacity == 0 ? 64 : pool->tasks_capacity * 2;
+        struct pool_task* tasks = malloc(new_capacity * sizeof(struct pool_task));
+        if (tasks == NULL) {
+            printf("Unable to allocate memory for the worker queue.\n");
+            exit(EXIT_FAILURE);
+        }
+        for (int i = 0; i < pool->number_tasks; i++)
+            tasks[i] = pool->tasks[(pool->tasks_head + i) % pool->tasks_capacity];
+        free(pool->tasks);
+        pool->tasks = tasks;
+        pool->tasks_capacity = new_capacity;
+        pool->tasks_head = 0;
+    }
+
+    int tail = (pool->tasks_head + pool->number_tasks) % pool->tasks_capacity;
+    pool->tasks[tail].run = run;
+    pool->tasks[tail].arg = arg;
+    pool->number_tasks++;
+
+    pthread_cond_signal(&pool->work);
+    pthread_mutex_unlock(&pool->lock);
+}
+
+/******************************************************************************
+ * pool_wait -- Waits until the queue is empty and no tasks are running.      *
+ *                                                                            *
+ * Parameters                                                                 *
+ *      pool -- The pool to wait on.                                          *
+ *                                                                            *
+ * Returns                                                                    *
+ *      Nothing                                                               *
+ *****************************************************************************/
+void pool_wait(work_pool* pool) {
+    pthread_mutex_lock(&pool->lock);
+    while (pool->number_tasks > 0 || pool->active > 0)
+        pthread_cond_wait(&pool->idle, &pool->lock);
+    pthread_mutex_unlock(&pool->lock);
+}
+
+/******************************************************************************
+ * pool_stop -- Lets the workers finish the queued tasks, then joins them and *
+ *              frees the pool's resources.                                   *
+ *                                                                            *
+ * Parameters                                                                 *
+ *      pool -- The pool to stop.                                             *
+ *                                                                            *
+ * Returns                                                                    *
+ *      Nothing                                                               *
+ *****************************************************************************/
+void pool_stop(work_pool* pool) {
+    pthread_mutex_lock(&pool->lock);
+    pool->stopping = true;
+    pthread_cond_broadcast(&pool->work);
+    pthread_mutex_unlock(&pool->lock);
+
+    for (int i = 0; i < pool->number_threads; i++)
+        pthread_join(pool->threads[i], NULL);
+
+    free(pool->tasks);
+    pthread_mutex_destroy(&pool->lock);
+    pthread_cond_destroy(&pool->work);
+    pthread_cond_destroy(&pool->idle);
+    memset(pool, 0, sizeof(work_pool));
+}
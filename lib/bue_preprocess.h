@@ -7,252 +7,625 @@
  *                                                                            *
  * ***************************************************************************/
 
+#include <pthread.h>
+
 /******************************************************************************
- * build_link -- Builds a markdown link given a title and file name. Can      *
- *               create an image link if is_image is true.                    *
+ * strip_title_text -- Removes the hash(es) and extra spaces from a section   *
+ *                     header title.                                          *
  *                                                                            *
  * Parameters                                                                 *
- *      dest -- char pointer that the completed link text will be stored in.  *
- *      md_title -- The text to use in the title portion of the link.         *
- *      md_file -- The text to use in the file portioin of the link.          *
- *      is_image -- Whether or not to turn this into an image link.           *
+ *      title -- A charcter pointer holding the full markdown section title.  *
  *                                                                            *
  * Returns                                                                    *
  *      Nothing                                                               *
  *****************************************************************************/
-void build_link(char* dest, char* md_title, char* md_file, bool is_image) {
-    // Turn this into an image link
-    if (is_image)
-        strcat(dest, "!");
-
-    // Assemble the link markdown
-    strcat(dest, "[");
-    strcat(dest, md_title);
-    strcat(dest, "]");
-    strcat(dest, "(");
-    strcat(dest, md_file);
-    strcat(dest, ")");
+void strip_title_text(char* title) {
+    // Remove the has character from the title
+    memmove(title, title+1, strlen(title));
+
+    // Remove any leading whitespace
+    while (title[0] == ' ')
+        memmove(title, title+1, strlen(title));
+
+    // Remove the newline character(s), if they exist
+    if (title[0] != '\0' && title[strlen(title) - 1] == '\n')
+        title[strlen(title) - 1] = '\0';
+    if (title[0] != '\0' && title[strlen(title) - 1] == '\r')
+        title[strlen(title) - 1] = '\0';
 }
 
 /******************************************************************************
- * get_link_title -- Extracts the title from the given markdown link text.    *
+ * check_for_step_link_span -- Given a span holding one line of markdown,     *
+ *                             determines whether or not that line contains   *
+ *                             a step link.                                   *
  *                                                                            *
  * Parameters                                                                 *
- *      link_line -- The line of text containing the markdown link.           *
+ *      line -- Pointer to the start of the line to check for a step link.    *
+ *      len -- The number of bytes in the line, not counting the line ending. *
  *                                                                            *
  * Returns                                                                    *
- *      A string representing the extracted link title.                       *
+ *      A boolean representing whether or not a line contains a step link.    *
  *****************************************************************************/
-char* get_link_title(char* link_line) {
-    char* md_title = strdup(link_line);
+bool check_for_step_link_span(const char* line, size_t len) {
+    // Check to make sure that the proper characters are present in the link text
+    if (memchr(line, '[', len) == NULL || memchr(line, ']', len) == NULL)
+        return false;
+    if (memchr(line, '(', len) == NULL || memchr(line, ')', len) == NULL)
+        return false;
 
-    // Attempt to find the link title
-    md_title = strchr(md_title, '[');
-    md_title = md_title + 1;
-    cut_string(md_title, ']');
+    // Check to see if there is a step link
+    return span_find(line, len, "{step}") != NULL;
+}
 
-    return md_title;
+/******************************************************************************
+ * check_for_step_link -- Given a line of markdown, determines whether or not *
+ *                        that line contains a step link.                     *
+ *                                                                            *
+ * Parameters                                                                 *
+ *      line -- A character pointer representing the line of text to check    *
+ *              for the step link.                                            *
+ *                                                                            *
+ * Returns                                                                    *
+ *      A boolean representing whether or not a line contains a step link.    *
+ *****************************************************************************/
+bool check_for_step_link(char* line) {
+    return check_for_step_link_span(line, strlen(line));
 }
 
 /******************************************************************************
- * get_link_file -- Extracts the file name from the given markdown link text. *
+ * read_page_title -- Pulls the top level title out of a markdown file.       *
  *                                                                            *
  * Parameters                                                                 *
- *      link_line -- The line of text containing the markdown link.           *
+ *      path -- The path to the markdown file to read the title from.         *
+ *      title -- Buffer that the title text will be appended to.              *
  *                                                                            *
  * Returns                                                                    *
- *      A string representing the extracted link file name.                   *
+ *      A boolean specifying whether or not a title was found.                *
  *****************************************************************************/
-char* get_link_file(char* link_line) {
-    char* md_file = strdup(link_line);
+bool read_page_title(const char* path, string_buffer* title) {
+    // Open the documentation file and make sure that the file opened properly
+    FILE* doc_file = fopen(path, "r");
+    if (doc_file == NULL) {
+        printf("Could not open the required file: %s.\n", path);
+        return false;
+    }
+
+    // Step through the lines of the file until we find a top level title header
+    bool title_found = false;
+    char line_temp[10000];
+    while (fgets(line_temp, sizeof(line_temp), doc_file) != NULL) {
+        if (line_temp[0] == '#') {
+            // We want only the text of the title, and not the hash or newline
+            strip_title_text(line_temp);
+            str_buf_append_str(title, line_temp);
+
+            title_found = true;
+            break;
+        }
+    }
 
-    // Attempt to find the link file
-    md_file = strchr(md_file, '(');
-    md_file = md_file + 1;
-    cut_string(md_file, ')');
+    // Make sure that we release the resources associated with the doc file
+    fclose(doc_file);
 
-    return md_file;
+    return title_found;
 }
 
 /******************************************************************************
- * strip_title_text -- Removes the hash(es) and extra spaces from a section   *
- *                     header title.                                          *
+ * build_page_path -- Assembles the path to a page that is linked to from     *
+ *                    the page at base_path.                                  *
  *                                                                            *
  * Parameters                                                                 *
- *      title -- A charcter pointer holding the full markdown section title.  *
+ *      path -- Buffer that the assembled path will be appended to.           *
+ *      base_path -- The path to the page that holds the link.                *
+ *      md_file -- Pointer to the relative file name in the link.             *
+ *      md_file_len -- The number of bytes in the relative file name.         *
  *                                                                            *
  * Returns                                                                    *
  *      Nothing                                                               *
  *****************************************************************************/
-void strip_title_text(char* title) {
-    // Remove the has character from the title
-    memmove(title, title+1, strlen(title));
+void build_page_path(string_buffer* path, const char* base_path, const char* md_file, size_t md_file_len) {
+    // Links are relative to the directory holding the current page
+    const char* last_sep = strrchr(base_path, PATH_SEP[0]);
+    if (last_sep != NULL)
+        str_buf_append(path, base_path, last_sep - base_path);
+    else
+        str_buf_append_str(path, ".");
+
+    str_buf_append_str(path, PATH_SEP);
+    str_buf_append(path, md_file, md_file_len);
+}
 
-    // Remove any leading whitespace
-    while (title[0] == ' ')
-        memmove(title, title+1, strlen(title));
+/*
+ * A project-wide cache of page titles so that step links can be resolved
+ * without opening the linked file on every render. Entries are keyed by path
+ * and checked against the file's modification time and size before use.
+ */
+typedef struct title_cache_entry title_cache_entry;
+struct title_cache_entry {
+    char* path;  // Path to the page, NULL marks an empty slot
+    uint64_t path_hash;  // Hash of the path used to place the entry
+    struct timespec mtime;  // Modification time of the file when the title was read
+    off_t size;  // Size of the file when the title was read
+    bool stale;  // Set when the file is known to have changed
+    bool has_title;  // Whether or not the file had a title in it
+    char* title;  // The title text, without the hash marks
+};
+
+typedef struct title_cache title_cache;
+struct title_cache {
+    title_cache_entry* entries;  // Open addressed table of entries
+    size_t count;  // The number of slots in use
+    size_t capacity;  // The number of slots, always a power of two
+    unsigned long generation;  // Bumped whenever a cached title changes
+    pthread_mutex_t lock;  // Guards the cache, which the preview worker also uses
+};
+
+title_cache page_titles = {.lock = PTHREAD_MUTEX_INITIALIZER};  // The title cache for the open project
 
-    // Remove the newline character, if it exists
-    if (title[strlen(title) - 1] == '\n')
-        title[strlen(title) - 1] = '\0';
+/******************************************************************************
+ * title_cache_slot -- Finds the slot for a path in the title cache, which    *
+ *                     is either the slot holding the path or the empty slot  *
+ *                     where it would be inserted.                            *
+ *                                                                            *
+ * Parameters                                                                 *
+ *      cache -- The title cache to search.                                   *
+ *      path -- The path of the page to look for.                             *
+ *      path_hash -- The hash of the path.                                    *
+ *                                                                            *
+ * Returns                                                                    *
+ *      A pointer to the slot for the path.                                   *
+ *****************************************************************************/
+title_cache_entry* title_cache_slot(title_cache* cache, const char* path, uint64_t path_hash) {
+    size_t mask = cache->capacity - 1;
+    size_t i = (size_t)path_hash & mask;
+
+    // Linear probing until either the path or an empty slot is found
+    while (cache->entries[i].path != NULL) {
+        if (cache->entries[i].path_hash == path_hash && strcmp(cache->entries[i].path, path) == 0)
+            break;
+        i = (i + 1) & mask;
+    }
+
+    return &cache->entries[i];
 }
 
 /******************************************************************************
- * check_for_step_link -- Given a line of markdown, determines whether or not *
- *                        that line contains a step link.                     *
+ * title_cache_grow -- Doubles the number of slots in the title cache and     *
+ *                     moves the existing entries over.                       *
  *                                                                            *
  * Parameters                                                                 *
- *      line -- A character pointer representing the line of text to check    *
- *              for the step link.                                            *
+ *      cache -- The title cache to grow.                                     *
  *                                                                            *
  * Returns                                                                    *
- *      A boolean representing whether or not a line contains a step link.    *
+ *      Nothing                                                               *
  *****************************************************************************/
-bool check_for_step_link(char* line) {
-    // Check to make sure that the proper characters are present in the link text
-    char* temp_char = strstr(line, "[");
-    if (temp_char == NULL) {
-        return false;
+void title_cache_grow(title_cache* cache) {
+    title_cache_entry* old_entries = cache->entries;
+    size_t old_capacity = cache->capacity;
+
+    cache->capacity = old_capacity == 0 ? 64 : old_capacity * 2;
+    cache->entries = calloc(cache->capacity, sizeof(title_cache_entry));
+
+    // Re-insert each of the existing entries into the new table
+    for (size_t i = 0; i < old_capacity; i++) {
+        if (old_entries[i].path != NULL)
+            *title_cache_slot(cache, old_entries[i].path, old_entries[i].path_hash) = old_entries[i];
     }
-    temp_char = strstr(line, "]");
-    if (temp_char == NULL) {
+
+    free(old_entries);
+}
+
+/******************************************************************************
+ * title_cache_lookup -- Gets the title of a page, only reading the file when *
+ *                       it is not cached or has changed since it was read.   *
+ *                                                                            *
+ * Parameters                                                                 *
+ *      path -- The path to the markdown file to get the title of.            *
+ *      title -- Buffer that the title text will be appended to.              *
+ *                                                                            *
+ * Returns                                                                    *
+ *      A boolean specifying whether or not a title was found.                *
+ *****************************************************************************/
+bool title_cache_lookup(const char* path, string_buffer* title) {
+    title_cache* cache = &page_titles;
+
+    // The file's stat data tells us whether a cached title is still good
+    struct stat st;
+    if (stat(path, &st) != 0) {
+        printf("Could not open the required file: %s.\n", path);
         return false;
     }
-    temp_char = strstr(line, "(");
-    if (temp_char == NULL) {
-        return false;
+
+    uint64_t path_hash = hash_bytes(path, strlen(path));
+    pthread_mutex_lock(&cache->lock);
+
+    // Serve the title from memory when the file has not changed
+    if (cache->capacity > 0) {
+        title_cache_entry* entry = title_cache_slot(cache, path, path_hash);
+        if (entry->path != NULL && !entry->stale && entry->size == st.st_size && entry->mtime.tv_sec == st.st_mtim.tv_sec && entry->mtime.tv_nsec == st.st_mtim.tv_nsec) {
+            bool has_title = entry->has_title;
+            if (has_title)
+                str_buf_append_str(title, entry->title);
+            pthread_mutex_unlock(&cache->lock);
+            return has_title;
+        }
     }
-    temp_char = strstr(line, ")");
-    if (temp_char == NULL) {
-        return false;
+
+    // Read the title from the file without holding up other users of the cache
+    pthread_mutex_unlock(&cache->lock);
+    string_buffer new_title;
+    str_buf_init(&new_title);
+    bool has_title = read_page_title(path, &new_title);
+    char* new_text = str_buf_detach(&new_title);
+    pthread_mutex_lock(&cache->lock);
+
+    // Keep the table no more than about three quarters full
+    if ((cache->count + 1) * 4 > cache->capacity * 3)
+        title_cache_grow(cache);
+    title_cache_entry* entry = title_cache_slot(cache, path, path_hash);
+
+    // Start tracking the path if this is the first time it has been seen, which may be after it was rendered as missing
+    if (entry->path == NULL) {
+        entry->path = strdup(path);
+        entry->path_hash = path_hash;
+        entry->title = NULL;
+        cache->count++;
+        cache->generation++;
+    }
+    else if (entry->has_title != has_title || strcmp(entry->title, new_text) != 0) {
+        // Anything rendered with the old title is now out of date
+        cache->generation++;
     }
 
-    // Check to see if there is a step link
-    char* link_tag = strstr(line, "{step}");
-    if (link_tag != NULL) {
-        return true;
+    free(entry->title);
+    entry->title = new_text;
+    entry->has_title = has_title;
+    entry->stale = false;
+    entry->mtime = st.st_mtim;
+    entry->size = st.st_size;
+
+    if (has_title)
+        str_buf_append_str(title, entry->title);
+
+    pthread_mutex_unlock(&cache->lock);
+
+    return has_title;
+}
+
+/******************************************************************************
+ * title_cache_seed -- Adds a title that was saved earlier to the cache, such *
+ *                     as from the project index. The title is still checked  *
+ *                     against the file's stat data before it is used.        *
+ *                                                                            *
+ * Parameters                                                                 *
+ *      path -- The path to the page.                                         *
+ *      mtime -- Modification time of the file when the title was read.       *
+ *      size -- Size of the file when the title was read.                     *
+ *      title -- The title text, or NULL if the page had no title.            *
+ *                                                                            *
+ * Returns                                                                    *
+ *      Nothing                                                               *
+ *****************************************************************************/
+void title_cache_seed(const char* path, struct timespec mtime, off_t size, const char* title) {
+    title_cache* cache = &page_titles;
+    uint64_t path_hash = hash_bytes(path, strlen(path));
+
+    pthread_mutex_lock(&cache->lock);
+
+    if ((cache->count + 1) * 4 > cache->capacity * 3)
+        title_cache_grow(cache);
+    title_cache_entry* entry = title_cache_slot(cache, path, path_hash);
+
+    // Anything that is already cached was read more recently, so keep it
+    if (entry->path == NULL) {
+        entry->path = strdup(path);
+        entry->path_hash = path_hash;
+        entry->title = strdup(title != NULL ? title : "");
+        entry->has_title = title != NULL;
+        entry->stale = false;
+        entry->mtime = mtime;
+        entry->size = size;
+        cache->count++;
+    }
+
+    pthread_mutex_unlock(&cache->lock);
+}
+
+/******************************************************************************
+ * title_cache_invalidate -- Marks the cached title of a page as out of date  *
+ *                           so that it will be read again on the next use,   *
+ *                           and bumps the generation so that anything        *
+ *                           rendered with the old title is rendered again.   *
+ *                                                                            *
+ * Parameters                                                                 *
+ *      path -- The path of the page that has changed.                        *
+ *                                                                            *
+ * Returns                                                                    *
+ *      Nothing                                                               *
+ *****************************************************************************/
+void title_cache_invalidate(const char* path) {
+    title_cache* cache = &page_titles;
+
+    if (path == NULL)
+        return;
+
+    pthread_mutex_lock(&cache->lock);
+
+    // Nothing to do if the cache is empty
+    if (cache->capacity > 0) {
+        title_cache_entry* entry = title_cache_slot(cache, path, hash_bytes(path, strlen(path)));
+        if (entry->path != NULL)
+            entry->stale = true;
     }
 
-    return false;
+    // A page that was not cached may still have been rendered as missing, so this is bumped either way
+    cache->generation++;
+
+    pthread_mutex_unlock(&cache->lock);
 }
 
 /******************************************************************************
- * build_link_line -- Takes the pieces of a line containing a buildup link    *
- *                    tag and puts them together again to form a proper link  *
- *                    line.                                                   *
+ * title_cache_clear -- Removes all of the entries from the title cache, such *
+ *                      as when another project is opened.                    *
  *                                                                            *
  * Parameters                                                                 *
- *      new_line -- Pointer to the completed line.                            *
- *      before -- The start of the original line that needs to be preserved.  *
- *      md_title -- The title of the markdown link.                           *
- *      md_file -- The relative file path for the markdown link.              *
- *      after -- The end of the original line that needs to be preserved.     *
+ *      None                                                                  *
  *                                                                            *
  * Returns                                                                    *
- *      A pointer to the newly assembled link line.                           *
+ *      Nothing                                                               *
  *****************************************************************************/
-char* build_link_line(char* new_line, char* before, char* md_title, char* md_file, char* after) {
-    // Make sure there is enough space in memory for the newly assembled line
-    new_line = realloc(new_line, str_size(before) + str_size(md_title) + str_size(md_file) + str_size(after) + 5);
-    new_line[0] = '\0';
+void title_cache_clear() {
+    title_cache* cache = &page_titles;
+
+    pthread_mutex_lock(&cache->lock);
 
-    // Assemble what was before the link, the link, and what was after the link
-    strcat(new_line, before);
-    build_link(new_line, md_title, md_file, false);
-    strcat(new_line, after);
+    for (size_t i = 0; i < cache->capacity; i++) {
+        free(cache->entries[i].path);
+        free(cache->entries[i].title);
+    }
+    free(cache->entries);
+
+    cache->entries = NULL;
+    cache->count = 0;
+    cache->capacity = 0;
+    cache->generation++;
 
-    return new_line;
+    pthread_mutex_unlock(&cache->lock);
 }
 
 /******************************************************************************
- * handle_step_link -- Given a line that contains a step link, returns a      *
+ * title_cache_generation -- Gets the current generation of the title cache,  *
+ *                           which changes whenever a cached title changes.   *
+ *                                                                            *
+ * Parameters                                                                 *
+ *      None                                                                  *
+ *                                                                            *
+ * Returns                                                                    *
+ *      The generation counter of the title cache.                            *
+ *****************************************************************************/
+unsigned long title_cache_generation() {
+    pthread_mutex_lock(&page_titles.lock);
+    unsigned long generation = page_titles.generation;
+    pthread_mutex_unlock(&page_titles.lock);
+
+    return generation;
+}
+
+/*
+ * A page's HTML depends on the titles of the pages it step links to. While a
+ * page is preprocessed those pages can be written to a dependency list, each
+ * entry being the NUL terminated path followed by the hash of the title that
+ * was used, so that the page can later be checked against the titles.
+ */
+
+/******************************************************************************
+ * page_title_hash -- Hashes a page title for a dependency list.              *
+ *                                                                            *
+ * Parameters                                                                 *
+ *      title -- The title text.                                              *
+ *      len -- The number of bytes in the title.                              *
+ *                                                                            *
+ * Returns                                                                    *
+ *      The hash, which is never 0 since that marks a page without a title.   *
+ *****************************************************************************/
+uint64_t page_title_hash(const char* title, size_t len) {
+    return hash_bytes(title, len) | 1;
+}
+
+/******************************************************************************
+ * add_page_dependency -- Adds an entry to a dependency list.                 *
+ *                                                                            *
+ * Parameters                                                                 *
+ *      deps -- The dependency list.                                          *
+ *      path -- The path to the page that was depended on.                    *
+ *      title_hash -- The hash of the page's title, or 0 if it had none.      *
+ *                                                                            *
+ * Returns                                                                    *
+ *      Nothing                                                               *
+ *****************************************************************************/
+void add_page_dependency(string_buffer* deps, const char* path, uint64_t title_hash) {
+    str_buf_append(deps, path, strlen(path) + 1);
+    str_buf_append(deps, (const char*)&title_hash, sizeof(title_hash));
+}
+
+/******************************************************************************
+ * next_page_dependency -- Steps through the entries of a dependency list.    *
+ *                                                                            *
+ * Parameters                                                                 *
+ *      pos -- The entry to read, updated to point at the next one.           *
+ *      end -- The end of the list.                                           *
+ *      path -- Set to the path of the page that was depended on.             *
+ *      title_hash -- Set to the hash of the page's title.                    *
+ *                                                                            *
+ * Returns                                                                    *
+ *      A boolean specifying whether or not there was an entry to read.       *
+ *****************************************************************************/
+bool next_page_dependency(const char** pos, const char* end, const char** path, uint64_t* title_hash) {
+    const char* path_end = *pos < end ? memchr(*pos, '\0', end - *pos) : NULL;
+    if (path_end == NULL || (size_t)(end - path_end - 1) < sizeof(uint64_t))
+        return false;
+
+    *path = *pos;
+    memcpy(title_hash, path_end + 1, sizeof(uint64_t));
+    *pos = path_end + 1 + sizeof(uint64_t);
+
+    return true;
+}
+
+/******************************************************************************
+ * page_dependency_current -- Checks whether a page depended on still has the *
+ *                            title that was used.                            *
+ *                                                                            *
+ * Parameters                                                                 *
+ *      path -- The path to the page.                                         *
+ *      title_hash -- The hash of the title that was used, 0 for none.        *
+ *                                                                            *
+ * Returns                                                                    *
+ *      A boolean specifying whether or not the title is the same.            *
+ *****************************************************************************/
+bool page_dependency_current(const char* path, uint64_t title_hash) {
+    // A page that is gone has no title, which is checked quietly here
+    struct stat st;
+    if (stat(path, &st) != 0)
+        return title_hash == 0;
+
+    string_buffer title;
+    str_buf_init(&title);
+    bool has_title = title_cache_lookup(path, &title);
+    uint64_t current = has_title ? page_title_hash(title.data, title.len) : 0;
+    str_buf_free(&title);
+
+    return current == title_hash;
+}
+
+/******************************************************************************
+ * handle_step_link -- Given a line that contains a step link, appends a      *
  *                     properly constructed step link with the title filled   *
- *                     in.                                                    *
+ *                     in to the output buffer.                               *
  *                                                                            *
  * Parameters                                                                 *
- *      line -- Character pointer representing the markdown line to transform.*
- *      base_path -- Path to the current project so that a referenced file's  *
+ *      out -- Buffer that the transformed line is appended to.               *
+ *      line -- Pointer to the start of the markdown line to transform.       *
+ *      len -- The number of bytes in the line, not counting the line ending. *
+ *      base_path -- Path to the current page so that a referenced file's     *
  *                   title can be pulled from its contents.                   *
+ *      deps -- Dependency list that a page whose title is used gets added    *
+ *              to, or NULL.                                                  *
  *                                                                            *
  * Returns                                                                    *
- *      A character pointer for the transformed line, with the title properly *
- *      filled in.                                                            *
+ *      Nothing                                                               *
  *****************************************************************************/
-char* handle_step_link(char* line, char* base_path) {
-    // Save the parts of the line before and after the step link
-    char* before = strdup(line);
-    cut_string(before, '[');
-    char* after = strdup(line);
-    after = strrchr(after, '}');
-    after++;
-
-    // Make sure that the converted line has a spot in memory
-    char* new_line = NULL;
-
-    // Make sure that we really did get a step link
-    if (line != NULL) {
-        // Pull the title and the file from the given line
-        char* md_title = get_link_title(line);
-        char* md_file = get_link_file(line);
-
-        // Construct the path to the linked file
-        char* path_start = strdup(base_path);
-        cut_string_last(path_start, PATH_SEP[0]);
-        if (strlen(base_path) < strlen(path_start) + strlen(md_file)) {
-            path_start = realloc(path_start, str_size(path_start) + str_size(md_file) + str_size(PATH_SEP) + 1);
-        }
-        strcat(path_start, PATH_SEP);
-        strcat(path_start, md_file);
-
-        // If there is a linked markdown file, pull the title from that
-        if (md_title[0] == '.') {
-            // Open the documentation file and make sure that the file opened properly
-            FILE* doc_file;
-            doc_file = fopen(path_start, "r");
-            if (doc_file == NULL) {
-                printf("Could not open the required file: %s.\n", path_start);
-            }
-            else {
-                // Get a line from the file and see if it is a title
-                char line_temp[10000];
-                line_temp[0] = '\0';
-
-                // Handle converting the md file extension to html
-                if (strcmp(strrchr(md_file, '.'), ".md") == 0)
-                    md_file = replace_file_extension(md_file, ".html");
-
-                // Step through the lines of the file until we find a top level title header
-                bool title_found = false;
-                while (fgets(line_temp, sizeof(line_temp), doc_file) != NULL) {
-                    // If we have found a title line, extract the title
-                    if (line_temp[0] == '#') {
-                        // We want only the text of the title, and not the hash or newline
-                        strip_title_text(line_temp);
-
-                        // Build the updated link with the file name
-                        new_line = build_link_line(new_line, before, strdup(line_temp), md_file, after);
-
-                        // We do not need to keep looking
-                        title_found = true;
-                        break;
-                    }
-                }
-
-                // If no title was found, provide some warning
-                if (!title_found)
-                    printf("No title found in file: %s", path_start);
-            }
-
-            // Make sure that we release the resources associated with the doc file
-            fclose(doc_file);
-        }
-        else {
-            // Build the updated link with the file name
-            new_line = build_link_line(new_line, before, line, md_file, after);
+void handle_step_link(string_buffer* out, const char* line, size_t len, const char* base_path, string_buffer* deps) {
+    const char* line_end = line + len;
+
+    // Locate each of the parts of the link
+    const char* open_bracket = memchr(line, '[', len);
+    const char* close_bracket = open_bracket ? memchr(open_bracket, ']', line_end - open_bracket) : NULL;
+    const char* open_paren = close_bracket ? memchr(close_bracket, '(', line_end - close_bracket) : NULL;
+    const char* close_paren = open_paren ? memchr(open_paren, ')', line_end - open_paren) : NULL;
+    const char* tag = close_paren ? span_find(close_paren, line_end - close_paren, "{step}") : NULL;
+
+    // If the parts are not in the right order this is not really a step link
+    if (tag == NULL) {
+        str_buf_append(out, line, len);
+        return;
+    }
+
+    const char* md_title = open_bracket + 1;
+    size_t md_title_len = close_bracket - md_title;
+    const char* md_file = open_paren + 1;
+    size_t md_file_len = close_paren - md_file;
+    const char* after = tag + strlen("{step}");
+
+    // Keep whatever came before the link
+    str_buf_append(out, line, open_bracket - line);
+
+    // If the link text is a period, pull the title from the linked markdown file
+    str_buf_append_char(out, '[');
+    if (md_title_len == 1 && md_title[0] == '.' && base_path != NULL) {
+        string_buffer path;
+        str_buf_init(&path);
+        build_page_path(&path, base_path, md_file, md_file_len);
+
+        // If no title was found, provide some warning and fall back to the file name
+        size_t title_start = out->len;
+        bool has_title = title_cache_lookup(path.data, out);
+        if (deps != NULL)
+            add_page_dependency(deps, path.data, has_title ? page_title_hash(out->data + title_start, out->len - title_start) : 0);
+        if (!has_title) {
+            printf("No title found in file: %s\n", path.data);
+            str_buf_append(out, md_file, md_file_len);
         }
+
+        str_buf_free(&path);
+    }
+    else {
+        str_buf_append(out, md_title, md_title_len);
+    }
+    str_buf_append(out, "](", 2);
+
+    // Handle converting the md file extension to html
+    if (md_file_len >= 3 && memcmp(md_file + md_file_len - 3, ".md", 3) == 0) {
+        str_buf_append(out, md_file, md_file_len - 3);
+        str_buf_append_str(out, ".html");
     }
+    else {
+        str_buf_append(out, md_file, md_file_len);
+    }
+    str_buf_append_char(out, ')');
+
+    // Keep whatever came after the link
+    str_buf_append(out, after, line_end - after);
+}
+
+/******************************************************************************
+ * preprocess_span -- Converts the BuildUp tags in a span of markdown and     *
+ *                    appends the result to the output buffer. The input is   *
+ *                    scanned once, line by line, so the cost is linear in    *
+ *                    the size of the document.                               *
+ *                                                                            *
+ * Parameters                                                                 *
+ *      out -- Buffer that the processed markdown is appended to.             *
+ *      buildup_md -- Pointer to the markdown with BuildUp tags in it.        *
+ *      len -- The number of bytes of markdown to process.                    *
+ *      base_path -- Path to the page that the markdown belongs to.           *
+ *      deps -- Dependency list that the pages whose titles are used get      *
+ *              added to, or NULL.                                            *
+ *                                                                            *
+ * Returns                                                                    *
+ *      Nothing                                                               *
+ *****************************************************************************/
+void preprocess_span(string_buffer* out, const char* buildup_md, size_t len, const char* base_path, string_buffer* deps) {
+    const char* pos = buildup_md;
+    const char* end = buildup_md + len;
+
+    // Most documents only grow a little bit when the tags are expanded
+    str_buf_reserve(out, len + len / 8);
 
-    return new_line;
+    // Step through each line of the content
+    while (pos < end) {
+        const char* eol = memchr(pos, '\n', end - pos);
+        const char* next = eol ? eol + 1 : end;
+
+        // Leave any carriage return out of the line so both LF and CRLF work
+        size_t line_len = (eol ? eol : end) - pos;
+        if (line_len > 0 && pos[line_len - 1] == '\r')
+            line_len--;
+
+        // Handle the step link, otherwise keep the line as it is
+        if (check_for_step_link_span(pos, line_len))
+            handle_step_link(out, pos, line_len, base_path, deps);
+        else
+            str_buf_append(out, pos, line_len);
+
+        // Keep the original line ending, making sure the last line is terminated too
+        if (eol)
+            str_buf_append(out, pos + line_len, next - (pos + line_len));
+        else
+            str_buf_append_str(out, NEWLINE);
+
+        pos = next;
+    }
 }
 
 /******************************************************************************
@@ -263,49 +636,17 @@ char* handle_step_link(char* line, char* base_path) {
  * Parameters                                                                 *
  *      buildup_md -- Character pointer holding the markdown with BuildUp     *
  *                    tags embedded within it.                                *
+ *      base_path -- Path to the page that the markdown belongs to.           *
  *                                                                            *
  * Returns                                                                    *
  *      A character pointer to a string with all of the BuildUp tags replaced *
- *      with their collated markdown data.                                    *
+ *      with their collated markdown data. The caller must free it.           *
  *****************************************************************************/
 char* preprocess(char* buildup_md, char* base_path) {
-    char* line;
-    char* old_md = strdup(buildup_md);
-    char* new_md = malloc(sizeof(char));
-    new_md[0] = '\0';
-
-    // Get the first line
-    line = strtok(old_md, NEWLINE);
-
-    // Step through each line of the content
-    while (line != NULL) {
-        // Save the current size of the processed markdown string
-        size_t new_md_size = str_size(new_md);
-
-        // Handle the step link
-        if (check_for_step_link(line)) {
-            // Get the new step link processed from the line
-            char* new_step_link = handle_step_link(line, base_path);
+    string_buffer new_md;
+    str_buf_init(&new_md);
 
-            // Resize the markdown variable appropriately
-            new_md = realloc(new_md, new_md_size + str_size(new_step_link) + str_size(NEWLINE) + 1);
+    preprocess_span(&new_md, buildup_md, strlen(buildup_md), base_path, NULL);
 
-            // Add the new link to the text
-            strcat(new_md, new_step_link);
-            strcat(new_md, NEWLINE);
-        }
-        else {
-            // Resize the new markdown string to hold the new data
-            new_md = realloc(new_md, new_md_size + str_size(line) + str_size(NEWLINE) + 1);
-
-            // Add the unchanged line back to the text
-            strcat(new_md, line);
-            strcat(new_md, NEWLINE);
-        }
-
-        // Get the next line
-        line = strtok(NULL, NEWLINE);
-   }
-
-    return new_md;
-}
\ No newline at end of file
+    return str_buf_detach(&new_md);
+}
@@ -0,0 +1,632 @@
+/******************************************************************************
+ * bue_preview -- Converts the BuildUp markdown in the editor to the HTML     *
+ *                preview. The document is split into top-level blocks and    *
+ *                the HTML for each block is cached, so that only the blocks  *
+ *                that were edited need to be rendered again.                 *
+ *                                                                            *
+ * Author: 7B Industries                                                      *
+ * License: Apache 2.0                                                        *
+ *                                                                            *
+ * ***************************************************************************/
+
+#include <strings.h>
+#include <stdatomic.h>
+#include <pthread.h>
+
+/*
+ * struct of user data that can be passed by the markdown parser.
+ */
+struct md_userdata {
+    char* name;
+    string_buffer* output;  // The buffer that the converted HTML is appended to
+};
+
+// md4c flags for converting markdown to HTML
+static unsigned parser_flags = 0;
+static unsigned renderer_flags = MD_HTML_FLAG_DEBUG;
+
+// A span of the document that can be rendered on its own
+struct preview_span {
+    size_t start;  // Offset of the first byte of the block
+    size_t len;  // The number of bytes in the block, including trailing blank lines
+};
+
+// The rendered form of one block of the document
+struct preview_block {
+    uint64_t hash;  // Hash of the block's BuildUp markdown
+    size_t src_len;  // Length of the block's BuildUp markdown
+    char* html;  // The HTML rendered from the block
+    size_t html_len;  // The length of the HTML
+    bool reused;  // Set once the HTML has been moved into a newer render
+};
+
+typedef struct preview_cache preview_cache;
+struct preview_cache {
+    struct preview_block* blocks;  // Open addressed table of rendered blocks
+    size_t capacity;  // The number of slots in the table, a power of two
+    char* base_path;  // The page that the blocks were rendered for
+    unsigned long title_generation;  // Generation of the title cache at render time
+    string_buffer scratch_md;  // Reused for the preprocessed markdown of each block
+    string_buffer scratch_html;  // Reused for the HTML of each block as md4c writes it
+};
+
+preview_cache preview_blocks;  // The rendered blocks of the open page
+
+/******************************************************************************
+ * process_output -- Call back function for the Markdown to HTML processor.   *
+ *                                                                            *
+ * Parameters                                                                 *
+ *      text - The markdown that has been converted to HTML                   *
+ *      size - The size of the converted HTML string                          *
+ *      userdata - A struct that holds custom data that is passed as-is       *
+ *                                                                            *
+ * Returns                                                                    *
+ *      N/A                                                                   *
+ *****************************************************************************/
+static void process_output(const MD_CHAR* text, MD_SIZE size, void* userdata)
+{
+    // To get rid of the unused variable warning for userdata
+    if (userdata == NULL) {
+        printf("No user data passed for markdown processor.\n");
+        return;
+    }
+
+    // The buffer keeps track of its length and grows geometrically, so each chunk is a plain copy
+    str_buf_append(((struct md_userdata*)userdata)->output, text, size);
+}
+
+/******************************************************************************
+ * line_is_blank -- Checks whether a line holds nothing but whitespace.       *
+ *                                                                            *
+ * Parameters                                                                 *
+ *      line -- Pointer to the start of the line.                             *
+ *      len -- The number of bytes in the line.                               *
+ *                                                                            *
+ * Returns                                                                    *
+ *      A boolean specifying whether or not the line is blank.                *
+ *****************************************************************************/
+bool line_is_blank(const char* line, size_t len) {
+    for (size_t i = 0; i < len; i++) {
+        if (line[i] != ' ' && line[i] != '\t' && line[i] != '\r')
+            return false;
+    }
+
+    return true;
+}
+
+/******************************************************************************
+ * line_starts_list_item -- Checks whether a line starts with a list marker,  *
+ *                          which could make it part of a list above it.      *
+ *                                                                            *
+ * Parameters                                                                 *
+ *      line -- Pointer to the start of the line.                             *
+ *      len -- The number of bytes in the line.                               *
+ *                                                                            *
+ * Returns                                                                    *
+ *      A boolean specifying whether or not the line starts a list item.      *
+ *****************************************************************************/
+bool line_starts_list_item(const char* line, size_t len) {
+    size_t i = 0;
+
+    // Bullet list markers
+    if (len > 0 && (line[0] == '-' || line[0] == '+' || line[0] == '*'))
+        return len == 1 || line[1] == ' ' || line[1] == '\t' || line[1] == '\r';
+
+    // Ordered list markers
+    while (i < len && i < 9 && line[i] >= '0' && line[i] <= '9')
+        i++;
+    if (i > 0 && i < len && (line[i] == '.' || line[i] == ')'))
+        return i + 1 == len || line[i + 1] == ' ' || line[i + 1] == '\t' || line[i + 1] == '\r';
+
+    return false;
+}
+
+/******************************************************************************
+ * raw_html_terminator -- Works out whether a line opens an HTML block that   *
+ *                        can continue past blank lines, and if so what ends  *
+ *                        that block.                                         *
+ *                                                                            *
+ * Parameters                                                                 *
+ *      line -- Pointer to the start of the line.                             *
+ *      len -- The number of bytes in the line.                               *
+ *                                                                            *
+ * Returns                                                                    *
+ *      The text that ends the HTML block, or NULL if the line does not open  *
+ *      one.                                                                  *
+ *****************************************************************************/
+const char* raw_html_terminator(const char* line, size_t len) {
+    static const char* openers[] = {"<script", "<pre", "<style", "<textarea"};
+    static const char* closers[] = {"</script>", "</pre>", "</style>", "</textarea>"};
+
+    if (len < 2 || line[0] != '<')
+        return NULL;
+
+    for (size_t i = 0; i < sizeof(openers) / sizeof(openers[0]); i++) {
+        size_t opener_len = strlen(openers[i]);
+        if (len >= opener_len && strncasecmp(line, openers[i], opener_len) == 0)
+            return closers[i];
+    }
+
+    if (len >= 4 && memcmp(line, "<!--", 4) == 0)
+        return "-->";
+    if (len >= 9 && memcmp(line, "<![CDATA[", 9) == 0)
+        return "]]>";
+    if (line[1] == '?')
+        return "?>";
+    if (line[1] == '!')
+        return ">";
+
+    return NULL;
+}
+
+/******************************************************************************
+ * split_preview_blocks -- Splits a document at the top-level block           *
+ *                         boundaries where rendering the pieces separately   *
+ *                         gives the same HTML as rendering the whole.        *
+ *                         Only a blank line followed by an unindented line   *
+ *                         that cannot continue the block above is treated    *
+ *                         as a boundary.                                     *
+ *                                                                            *
+ * Parameters                                                                 *
+ *      md -- Pointer to the BuildUp markdown to split.                       *
+ *      len -- The number of bytes of markdown.                               *
+ *      count -- Set to the number of spans that are returned.                *
+ *                                                                            *
+ * Returns                                                                    *
+ *      An array of spans covering the whole document, which the caller must  *
+ *      free.                                                                 *
+ *****************************************************************************/
+struct preview_span* split_preview_blocks(const char* md, size_t len, size_t* count) {
+    size_t capacity = 16;
+    struct preview_span* spans = malloc(capacity * sizeof(struct preview_span));
+    size_t number_spans = 0;
+    size_t block_start = 0;
+
+    const char* pos = md;
+    const char* end = md + len;
+    bool prev_blank = false;
+    char fence_char = '\0';  // Set while inside of a fenced code block
+    size_t fence_len = 0;
+    const char* html_end = NULL;  // Set while inside of a raw HTML block
+
+    while (pos < end) {
+        const char* eol = memchr(pos, '\n', end - pos);
+        const char* next = eol ? eol + 1 : end;
+        size_t line_len = (eol ? eol : end) - pos;
+        bool blank = line_is_blank(pos, line_len);
+
+        // Reference definitions apply to the whole document, so it cannot be split
+        const char* text = pos;
+        while (text < pos + line_len && text - pos < 3 && *text == ' ')
+            text++;
+        size_t text_len = line_len - (text - pos);
+        if (fence_char == '\0' && html_end == NULL && text_len > 0 && *text == '[') {
+            const char* close_bracket = memchr(text, ']', text_len);
+            if (close_bracket != NULL && close_bracket + 1 < text + text_len && close_bracket[1] == ':') {
+                spans[0] = (struct preview_span){.start = 0, .len = len};
+                *count = 1;
+                return spans;
+            }
+        }
+
+        // Start a new block when the line cannot belong to the block above it
+        if (prev_blank && !blank && fence_char == '\0' && html_end == NULL && pos[0] != ' ' && pos[0] != '\t' && !line_starts_list_item(pos, line_len)) {
+            if (number_spans == capacity) {
+                capacity *= 2;
+                spans = realloc(spans, capacity * sizeof(struct preview_span));
+            }
+            spans[number_spans++] = (struct preview_span){.start = block_start, .len = (pos - md) - block_start};
+            block_start = pos - md;
+        }
+
+        // Track the fenced code blocks and raw HTML blocks, which may hold blank lines
+        if (fence_char != '\0') {
+            size_t run = 0;
+            while (run < text_len && text[run] == fence_char)
+                run++;
+            if (run >= fence_len && line_is_blank(text + run, text_len - run))
+                fence_char = '\0';
+        }
+        else if (html_end != NULL) {
+            if (span_find(pos, line_len, html_end) != NULL)
+                html_end = NULL;
+        }
+        else if (text_len >= 3 && (memcmp(text, "```", 3) == 0 || memcmp(text, "~~~", 3) == 0)) {
+            fence_char = text[0];
+            fence_len = 0;
+            while (fence_len < text_len && text[fence_len] == fence_char)
+                fence_len++;
+        }
+        else if ((html_end = raw_html_terminator(text, text_len)) != NULL) {
+            if (span_find(text + 2, text_len - 2, html_end) != NULL)
+                html_end = NULL;
+        }
+
+        prev_blank = blank;
+        pos = next;
+    }
+
+    // The last block runs to the end of the document
+    if (number_spans == capacity)
+        spans = realloc(spans, (capacity + 1) * sizeof(struct preview_span));
+    spans[number_spans++] = (struct preview_span){.start = block_start, .len = len - block_start};
+
+    *count = number_spans;
+    return spans;
+}
+
+/******************************************************************************
+ * preview_cache_slot -- Finds the slot for a block in a block table, which   *
+ *                       is either the slot holding the block or the empty    *
+ *                       slot where it would be inserted.                     *
+ *                                                                            *
+ * Parameters                                                                 *
+ *      blocks -- The table of blocks to search.                              *
+ *      capacity -- The number of slots in the table, a power of two.         *
+ *      hash -- The hash of the block's markdown.                             *
+ *      src_len -- The length of the block's markdown.                        *
+ *                                                                            *
+ * Returns                                                                    *
+ *      A pointer to the slot for the block.                                  *
+ *****************************************************************************/
+struct preview_block* preview_cache_slot(struct preview_block* blocks, size_t capacity, uint64_t hash, size_t src_len) {
+    size_t mask = capacity - 1;
+    size_t i = (size_t)hash & mask;
+
+    while (blocks[i].html != NULL && !(blocks[i].hash == hash && blocks[i].src_len == src_len))
+        i = (i + 1) & mask;
+
+    return &blocks[i];
+}
+
+/******************************************************************************
+ * preview_cache_clear -- Frees all of the rendered blocks in the cache.      *
+ *                                                                            *
+ * Parameters                                                                 *
+ *      cache -- The preview cache to clear.                                  *
+ *                                                                            *
+ * Returns                                                                    *
+ *      Nothing                                                               *
+ *****************************************************************************/
+void preview_cache_clear(preview_cache* cache) {
+    for (size_t i = 0; i < cache->capacity; i++)
+        free(cache->blocks[i].html);
+    free(cache->blocks);
+    free(cache->base_path);
+
+    cache->blocks = NULL;
+    cache->capacity = 0;
+    cache->base_path = NULL;
+}
+
+/******************************************************************************
+ * preview_cache_free -- Frees the rendered blocks and the scratch buffers    *
+ *                       held by the cache.                                   *
+ *                                                                            *
+ * Parameters                                                                 *
+ *      cache -- The preview cache to free.                                   *
+ *                                                                            *
+ * Returns                                                                    *
+ *      Nothing                                                               *
+ *****************************************************************************/
+void preview_cache_free(preview_cache* cache) {
+    preview_cache_clear(cache);
+    str_buf_free(&cache->scratch_md);
+    str_buf_free(&cache->scratch_html);
+}
+
+/******************************************************************************
+ * render_preview_blocks -- Renders a document to HTML one block at a time,   *
+ *                          reusing the HTML of any block that has not        *
+ *                          changed since the last render.                    *
+ *                                                                            *
+ * Parameters                                                                 *
+ *      cache -- The cache of blocks from the last render of this page.       *
+ *      md -- Pointer to the BuildUp markdown to render.                      *
+ *      len -- The number of bytes of markdown.                               *
+ *      base_path -- Path to the page that the markdown belongs to.           *
+ *      failed -- Set to true if any of the blocks failed to parse.           *
+ *      latest -- Generation of the newest preview request, or NULL if the    *
+ *                render cannot be superseded.                                *
+ *      generation -- Generation of the request being rendered.               *
+ *                                                                            *
+ * Returns                                                                    *
+ *      The HTML for the whole document, which the caller must free, or NULL  *
+ *      if the document produced no HTML or a newer request came in.          *
+ *****************************************************************************/
+char* render_preview_blocks(preview_cache* cache, const char* md, size_t len, const char* base_path, bool* failed, atomic_ulong* latest, unsigned long generation) {
+    *failed = false;
+
+    // Blocks rendered for another page, or with titles that have since changed, cannot be reused
+    unsigned long title_generation = title_cache_generation();
+    bool same_page = (base_path == NULL && cache->base_path == NULL) || (base_path != NULL && cache->base_path != NULL && strcmp(base_path, cache->base_path) == 0);
+    if (!same_page || cache->title_generation != title_generation) {
+        preview_cache_clear(cache);
+        cache->base_path = base_path ? strdup(base_path) : NULL;
+        cache->title_generation = title_generation;
+    }
+    bool superseded = false;
+
+    size_t number_spans = 0;
+    struct preview_span* spans = split_preview_blocks(md, len, &number_spans);
+
+    // The new table only holds the blocks in the current document
+    size_t capacity = 16;
+    while (capacity < number_spans * 2)
+        capacity *= 2;
+    struct preview_block* blocks = calloc(capacity, sizeof(struct preview_block));
+
+    struct preview_block** ordered = malloc(number_spans * sizeof(struct preview_block*));
+    size_t total_len = 0;
+
+    for (size_t i = 0; i < number_spans; i++) {
+        const char* src = md + spans[i].start;
+        uint64_t hash = hash_bytes(src, spans[i].len);
+        struct preview_block* block = preview_cache_slot(blocks, capacity, hash, spans[i].len);
+
+        // Identical blocks only have to be found once
+        if (block->html == NULL) {
+            struct preview_block* old = cache->capacity ? preview_cache_slot(cache->blocks, cache->capacity, hash, spans[i].len) : NULL;
+
+            // Stop converting once a newer request comes in, but keep moving cached blocks over
+            if (!superseded && latest != NULL && atomic_load(latest) != generation)
+                superseded = true;
+
+            if (old != NULL && old->html != NULL && !old->reused) {
+                // Move the HTML over from the last render
+                *block = *old;
+                old->reused = true;
+            }
+            else if (superseded) {
+                continue;
+            }
+            else {
+                // Handle the BuildUp tags and convert just this block
+                struct md_userdata userdata = {.name = "Name", .output = &cache->scratch_html};
+                str_buf_reset(&cache->scratch_md);
+                str_buf_reset(&cache->scratch_html);
+                preprocess_span(&cache->scratch_md, src, spans[i].len, base_path, NULL);
+                if (md_html(cache->scratch_md.data, (MD_SIZE)cache->scratch_md.len, process_output, (void*)&userdata, parser_flags, renderer_flags) == -1)
+                    *failed = true;
+
+                // Keep an exactly sized copy of the HTML so the scratch buffer can be reused
+                block->hash = hash;
+                block->src_len = spans[i].len;
+                block->html_len = cache->scratch_html.len;
+                block->html = malloc(block->html_len + 1);
+                memcpy(block->html, cache->scratch_html.data ? cache->scratch_html.data : "", block->html_len);
+                block->html[block->html_len] = '\0';
+            }
+        }
+
+        ordered[i] = block;
+        total_len += block->html_len;
+    }
+
+    // Splice the blocks together into the full preview
+    char* html = NULL;
+    if (total_len > 0 && !superseded) {
+        html = malloc(total_len + 1);
+        size_t offset = 0;
+        for (size_t i = 0; i < number_spans; i++) {
+            memcpy(html + offset, ordered[i]->html, ordered[i]->html_len);
+            offset += ordered[i]->html_len;
+        }
+        html[total_len] = '\0';
+    }
+
+    // Whatever was not reused from the last render is no longer needed
+    for (size_t i = 0; i < cache->capacity; i++) {
+        if (!cache->blocks[i].reused)
+            free(cache->blocks[i].html);
+    }
+    free(cache->blocks);
+    cache->blocks = blocks;
+    cache->capacity = capacity;
+
+    free(ordered);
+    free(spans);
+
+    return html;
+}
+
+/*
+ * The preview worker renders the HTML preview on its own thread so that the
+ * UI never waits on markdown conversion. The UI hands it snapshots of the
+ * editor text and picks up the finished HTML on a later frame.
+ */
+typedef struct preview_worker preview_worker;
+struct preview_worker {
+    pthread_t thread;  // The thread doing the rendering
+    pthread_mutex_t lock;  // Guards everything below except latest
+    pthread_cond_t wake;  // Signalled when there is a new request or on shutdown
+    bool running;  // Cleared to stop the worker thread
+    atomic_ulong latest;  // Generation of the newest request
+    bool job_pending;  // Whether there is a request waiting to be rendered
+    struct doc_node* job_md;  // Snapshot of the editor text to render
+    char* job_path;  // Copy of the path of the page being rendered
+    struct timespec job_due;  // When the request may start, on the clock that pthread_cond_timedwait uses
+    bool result_ready;  // Whether there is finished HTML waiting for the UI
+    char* result_html;  // The finished HTML
+    bool result_failed;  // Whether any of the markdown failed to parse
+};
+
+preview_worker previewer = {.lock = PTHREAD_MUTEX_INITIALIZER, .wake = PTHREAD_COND_INITIALIZER};  // The preview worker
+
+/******************************************************************************
+ * preview_worker_main -- The loop run by the preview worker thread. Waits    *
+ *                        for requests to settle, renders them and publishes  *
+ *                        the result unless a newer request came in.          *
+ *                                                                            *
+ * Parameters                                                                 *
+ *      arg -- Pointer to the preview worker.                                 *
+ *                                                                            *
+ * Returns                                                                    *
+ *      NULL                                                                  *
+ *****************************************************************************/
+void* preview_worker_main(void* arg) {
+    preview_worker* worker = arg;
+
+    pthread_mutex_lock(&worker->lock);
+    while (worker->running) {
+        // Sleep until there is something to do
+        if (!worker->job_pending) {
+            pthread_cond_wait(&worker->wake, &worker->lock);
+            continue;
+        }
+
+        // Let a burst of typing finish before starting on it
+        struct timespec now;
+        clock_gettime(CLOCK_REALTIME, &now);
+        if (now.tv_sec < worker->job_due.tv_sec || (now.tv_sec == worker->job_due.tv_sec && now.tv_nsec < worker->job_due.tv_nsec)) {
+            pthread_cond_timedwait(&worker->wake, &worker->lock, &worker->job_due);
+            continue;
+        }
+
+        // Take the snapshot so the UI can queue up the next one while this one renders
+        struct doc_node* snapshot = worker->job_md;
+        char* path = worker->job_path;
+        unsigned long generation = atomic_load(&worker->latest);
+        worker->job_md = NULL;
+        worker->job_path = NULL;
+        worker->job_pending = false;
+        pthread_mutex_unlock(&worker->lock);
+
+        // The snapshot is never changed by the editor, so it is read here without the lock
+        size_t len;
+        char* md = doc_text(snapshot, &len);
+        doc_node_release(snapshot);
+
+        bool failed = false;
+        char* html = render_preview_blocks(&preview_blocks, md, len, path, &failed, &worker->latest, generation);
+        free(md);
+        free(path);
+
+        // Only publish the HTML if nothing newer was requested while rendering
+        pthread_mutex_lock(&worker->lock);
+        if (atomic_load(&worker->latest) == generation) {
+            free(worker->result_html);
+            worker->result_html = html;
+            worker->result_failed = failed;
+            worker->result_ready = true;
+
+            // The UI loop may be asleep, let it know there is HTML to show
+            wakeup_signal();
+        }
+        else {
+            free(html);
+        }
+    }
+    pthread_mutex_unlock(&worker->lock);
+
+    return NULL;
+}
+
+/******************************************************************************
+ * preview_worker_start -- Starts the preview worker thread.                  *
+ *                                                                            *
+ * Parameters                                                                 *
+ *      None                                                                  *
+ *                                                                            *
+ * Returns                                                                    *
+ *      Nothing                                                               *
+ *****************************************************************************/
+void preview_worker_start() {
+    previewer.running = true;
+    if (pthread_create(&previewer.thread, NULL, preview_worker_main, &previewer) != 0) {
+        printf("Unable to start the preview worker thread.\n");
+        exit(EXIT_FAILURE);
+    }
+}
+
+/******************************************************************************
+ * preview_worker_stop -- Stops the preview worker thread and frees anything  *
+ *                        it was still holding on to.                         *
+ *                                                                            *
+ * Parameters                                                                 *
+ *      None                                                                  *
+ *                                                                            *
+ * Returns                                                                    *
+ *      Nothing                                                               *
+ *****************************************************************************/
+void preview_worker_stop() {
+    pthread_mutex_lock(&previewer.lock);
+    previewer.running = false;
+    atomic_fetch_add(&previewer.latest, 1);
+    pthread_cond_signal(&previewer.wake);
+    pthread_mutex_unlock(&previewer.lock);
+
+    pthread_join(previewer.thread, NULL);
+
+    doc_node_release(previewer.job_md);
+    free(previewer.job_path);
+    free(previewer.result_html);
+    preview_cache_free(&preview_blocks);
+}
+
+/******************************************************************************
+ * request_preview -- Hands a snapshot of the markdown to the preview worker. *
+ *                    Any request that has not been rendered yet is replaced. *
+ *                                                                            *
+ * Parameters                                                                 *
+ *      snapshot -- Snapshot of the document to render, which the worker      *
+ *                  releases when it is done with it.                         *
+ *      base_path -- Path to the page that the markdown belongs to.           *
+ *      delay -- How many milliseconds to wait for more changes before        *
+ *               rendering.                                                   *
+ *                                                                            *
+ * Returns                                                                    *
+ *      Nothing                                                               *
+ *****************************************************************************/
+void request_preview(struct doc_node* snapshot, const char* base_path, long delay) {
+    char* path = base_path ? strdup(base_path) : NULL;
+
+    pthread_mutex_lock(&previewer.lock);
+    doc_node_release(previewer.job_md);
+    free(previewer.job_path);
+    previewer.job_md = snapshot;
+    previewer.job_path = path;
+
+    // Kept as a timespec, since milliseconds since the epoch do not fit in a 32 bit long
+    clock_gettime(CLOCK_REALTIME, &previewer.job_due);
+    previewer.job_due.tv_sec += delay / 1000;
+    previewer.job_due.tv_nsec += (delay % 1000) * 1000000L;
+    if (previewer.job_due.tv_nsec >= 1000000000L) {
+        previewer.job_due.tv_sec++;
+        previewer.job_due.tv_nsec -= 1000000000L;
+    }
+    previewer.job_pending = true;
+
+    // Anything rendered from an older request is now out of date
+    atomic_fetch_add(&previewer.latest, 1);
+    previewer.result_ready = false;
+    pthread_cond_signal(&previewer.wake);
+    pthread_mutex_unlock(&previewer.lock);
+}
+
+/******************************************************************************
+ * take_preview_result -- Picks up the HTML published by the preview worker,  *
+ *                        if there is any. Never waits on a render.           *
+ *                                                                            *
+ * Parameters                                                                 *
+ *      html -- Set to the finished HTML, which the caller must free.         *
+ *      failed -- Set to whether any of the markdown failed to parse.         *
+ *                                                                            *
+ * Returns                                                                    *
+ *      A boolean specifying whether or not there was a result to take.       *
+ *****************************************************************************/
+bool take_preview_result(char** html, bool* failed) {
+    bool ready = false;
+
+    pthread_mutex_lock(&previewer.lock);
+    if (previewer.result_ready) {
+        *html = previewer.result_html;
+        *failed = previewer.result_failed;
+        previewer.result_html = NULL;
+        previewer.result_ready = false;
+        ready = true;
+    }
+    pthread_mutex_unlock(&previewer.lock);
+
+    return ready;
+}
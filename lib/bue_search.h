@@ -0,0 +1,444 @@
+/******************************************************************************
+ * bue_search -- Find and replace across every page of the open project. The  *
+ *               files are searched in parallel on a pool of worker threads,  *
+ *               and the matches are handed to the UI as they are found, so   *
+ *               the UI keeps drawing while a large project is searched.      *
+ *                                                                            *
+ * Author: 7B Industries                                                      *
+ * License: Apache 2.0                                                        *
+ *                                                                            *
+ * ***************************************************************************/
+
+#include <stdatomic.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+// The longest search or replacement text that can be entered
+#define SEARCH_TEXT_MAX 256
+
+// Searching stops collecting matches after this many, to keep memory bounded
+#define SEARCH_MAX_HITS 10000
+
+// How much of the line around a match is kept to show in the results
+#define SEARCH_CONTEXT_MAX 100
+
+// Whether a search job only finds matches or replaces them too
+enum search_modes {search_find = 0, search_replace = 1};
+
+// One match in one file
+struct search_hit {
+    int file;  // Index of the file in the search's list of files
+    size_t line;  // The line the match is on, starting at 0
+    size_t offset;  // Byte offset of the match in the file
+    char* text;  // The text of the line around the match, for showing in the results
+};
+
+typedef struct project_search project_search;
+struct project_search {
+    work_pool pool;  // The threads that search the files
+    bool pool_running;
+    int mode;  // One of the search_modes
+    atomic_ulong generation;  // Bumped to cancel the running search
+    char** files;  // Copies of the paths of the files being searched
+    int number_files;
+    struct search_task* tasks;  // One task per file
+    char query[SEARCH_TEXT_MAX];  // The text being searched for
+    char replacement[SEARCH_TEXT_MAX];  // The text to replace it with, when replacing
+    char* skip_path;  // A copy of the path of a file that is left for the caller to handle, or NULL
+    atomic_int files_left;  // The number of files still to be searched
+    atomic_int files_changed;  // The number of files that had matches replaced
+    atomic_int files_failed;  // The number of files that could not be read or written
+    atomic_int replaced;  // The number of matches that were replaced
+    pthread_mutex_t lock;  // Guards the matches below
+    struct search_hit* hits;  // The matches found so far, in no particular order
+    int number_hits;
+    int hits_capacity;
+    bool hits_truncated;  // Set when there were more matches than SEARCH_MAX_HITS
+};
+
+// The work of searching one file
+struct search_task {
+    project_search* search;  // The search the file belongs to
+    int file;  // Index of the file in the search's list of files
+    unsigned long generation;  // The search that the task was queued for
+};
+
+project_search searcher = {.lock = PTHREAD_MUTEX_INITIALIZER};  // Search and replace across the open project
+
+/******************************************************************************
+ * search_add_hit -- Records a match found in a file.                         *
+ *                                                                            *
+ * Parameters                                                                 *
+ *      hits -- The list of matches to add to.                                *
+ *      count -- The number of matches in the list.                           *
+ *      capacity -- The number of matches there is room for.                  *
+ *      hit -- The match.                                                     *
+ *                                                                            *
+ * Returns                                                                    *
+ *      Nothing                                                               *
+ *****************************************************************************/
+void search_add_hit(struct search_hit** hits, int* count, int* capacity, struct search_hit hit) {
+    if (*count == *capacity) {
+        *capacity = *capacity == 0 ? 64 : *capacity * 2;
+        *hits = realloc(*hits, *capacity * sizeof(struct search_hit));
+        if (*hits == NULL) {
+            printf("Unable to allocate memory for the search results.\n");
+            exit(EXIT_FAILURE);
+        }
+    }
+
+    (*hits)[(*count)++] = hit;
+}
+
+/******************************************************************************
+ * search_context -- Copies the part of a line around a match to show in the  *
+ *                   search results.                                          *
+ *                                                                            *
+ * Parameters                                                                 *
+ *      line -- The start of the line holding the match.                      *
+ *      match -- The start of the match.                                      *
+ *      end -- The end of the text the line is in.                            *
+ *                                                                            *
+ * Returns                                                                    *
+ *      The NUL terminated text, which the caller must free.                  *
+ *****************************************************************************/
+char* search_context(const char* line, const char* match, const char* end) {
+    // Start a little before the match when the line is too long to show all of
+    if (match - line > SEARCH_CONTEXT_MAX / 3)
+        line = match - SEARCH_CONTEXT_MAX / 3;
+
+    const char* line_end = memchr(line, '\n', end - line);
+    if (line_end == NULL)
+        line_end = end;
+    if (line_end - line > SEARCH_CONTEXT_MAX)
+        line_end = line + SEARCH_CONTEXT_MAX;
+
+    char* text = strndup(line, line_end - line);
+    if (text == NULL) {
+        printf("Unable to allocate memory for the search results.\n");
+        exit(EXIT_FAILURE);
+    }
+
+    // Tabs and carriage returns would show up as boxes
+    for (char* c = text; *c != '\0'; c++) {
+        if (*c == '\t' || *c == '\r')
+            *c = ' ';
+    }
+
+    return text;
+}
+
+/******************************************************************************
+ * search_find_in_file -- Finds the matches in one file, which is mapped into *
+ *                        memory rather than read.                            *
+ *                                                                            *
+ * Parameters                                                                 *
+ *      search -- The search.                                                 *
+ *      task -- The task for the file.                                        *
+ *                                                                            *
+ * Returns                                                                    *
+ *      Nothing                                                               *
+ *****************************************************************************/
+void search_find_in_file(project_search* search, struct search_task* task) {
+    int fd = open(search->files[task->file], O_RDONLY | O_CLOEXEC);
+    if (fd < 0) {
+        atomic_fetch_add(&search->files_failed, 1);
+        return;
+    }
+
+    struct stat info;
+    if (fstat(fd, &info) != 0 || info.st_size == 0) {
+        close(fd);
+        return;
+    }
+
+    const char* data = mmap(NULL, info.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (data == MAP_FAILED) {
+        atomic_fetch_add(&search->files_failed, 1);
+        return;
+    }
+
+    // Collect the matches locally and hand them over all at once
+    struct search_hit* hits = NULL;
+    int number_hits = 0;
+    int hits_capacity = 0;
+
+    const char* end = data + info.st_size;
+    const char* pos = data;
+    const char* line_start = data;
+    size_t line = 0;
+    size_t query_len = strlen(search->query);
+
+    const char* match;
+    while ((match = span_find(pos, end - pos, search->query)) != NULL) {
+        // Count the lines between the last match and this one
+        const char* newline;
+        while ((newline = memchr(line_start, '\n', match - line_start)) != NULL) {
+            line++;
+            line_start = newline + 1;
+        }
+
+        struct search_hit hit = {task->file, line, match - data, search_context(line_start, match, end)};
+        search_add_hit(&hits, &number_hits, &hits_capacity, hit);
+        pos = match + query_len;
+
+        // A newer search has started, so there is no one left to use these
+        if (atomic_load(&search->generation) != task->generation)
+            break;
+    }
+
+    munmap((void*)data, info.st_size);
+
+    pthread_mutex_lock(&search->lock);
+    for (int i = 0; i < number_hits; i++) {
+        if (search->number_hits < SEARCH_MAX_HITS) {
+            search_add_hit(&search->hits, &search->number_hits, &search->hits_capacity, hits[i]);
+        }
+        else {
+            search->hits_truncated = true;
+            free(hits[i].text);
+        }
+    }
+    pthread_mutex_unlock(&search->lock);
+    free(hits);
+
+    // Let the UI show the new matches
+    if (number_hits > 0)
+        wakeup_signal();
+}
+
+/******************************************************************************
+ * search_replace_in_file -- Replaces the matches in one file, writing it     *
+ *                           back through the atomic save path.               *
+ *                                                                            *
+ * Parameters                                                                 *
+ *      search -- The search.                                                 *
+ *      task -- The task for the file.                                        *
+ *                                                                            *
+ * Returns                                                                    *
+ *      Nothing                                                               *
+ *****************************************************************************/
+void search_replace_in_file(project_search* search, struct search_task* task) {
+    const char* path = search->files[task->file];
+
+    string_buffer text;
+    str_buf_init(&text);
+    if (!read_whole_file(path, &text)) {
+        atomic_fetch_add(&search->files_failed, 1);
+        str_buf_free(&text);
+        return;
+    }
+
+    string_buffer out;
+    str_buf_init(&out);
+    size_t query_len = strlen(search->query);
+    const char* pos = text.data;
+    const char* end = text.data + text.len;
+    int replaced = 0;
+
+    const char* match;
+    while ((match = span_find(pos, end - pos, search->query)) != NULL) {
+        str_buf_append(&out, pos, match - pos);
+        str_buf_append_str(&out, search->replacement);
+        pos = match + query_len;
+        replaced++;
+    }
+    str_buf_append(&out, pos, end - pos);
+
+    if (replaced > 0 && atomic_load(&search->generation) == task->generation) {
+        if (write_file_atomic(path, out.data, out.len)) {
+            atomic_fetch_add(&search->files_changed, 1);
+            atomic_fetch_add(&search->replaced, replaced);
+        }
+        else {
+            atomic_fetch_add(&search->files_failed, 1);
+        }
+    }
+
+    str_buf_free(&out);
+    str_buf_free(&text);
+}
+
+/******************************************************************************
+ * search_file_task -- Searches one file on a worker thread.                  *
+ *                                                                            *
+ * Parameters                                                                 *
+ *      arg -- The search_task for the file.                                  *
+ *      worker -- The index of the worker running the task.                   *
+ *                                                                            *
+ * Returns                                                                    *
+ *      Nothing                                                               *
+ *****************************************************************************/
+void search_file_task(void* arg, int worker) {
+    (void)worker;
+    struct search_task* task = arg;
+    project_search* search = task->search;
+
+    // Skip the file if the search was cancelled before it got here
+    if (atomic_load(&search->generation) == task->generation &&
+        (search->skip_path == NULL || strcmp(search->files[task->file], search->skip_path) != 0)) {
+        if (search->mode == search_replace)
+            search_replace_in_file(search, task);
+        else
+            search_find_in_file(search, task);
+    }
+
+    // The UI should hear about the search finishing even if the last file had no matches
+    if (atomic_fetch_sub(&search->files_left, 1) == 1)
+        wakeup_signal();
+}
+
+/******************************************************************************
+ * search_collect_files -- Copies the paths of the pages in a directory, and  *
+ *                         the directories inside of it, into a search.       *
+ *                                                                            *
+ * Parameters                                                                 *
+ *      search -- The search.                                                 *
+ *      dir -- The directory.                                                 *
+ *      capacity -- The number of paths there is room for.                    *
+ *                                                                            *
+ * Returns                                                                    *
+ *      Nothing                                                               *
+ *****************************************************************************/
+void search_collect_files(project_search* search, dir_contents* dir, int* capacity) {
+    for (int i = 0; i < dir->number_files; i++) {
+        if (!string_ends_with(dir->files[i].name, ".md") && !string_ends_with(dir->files[i].name, ".yaml"))
+            continue;
+
+        if (search->number_files == *capacity) {
+            *capacity = *capacity == 0 ? 256 : *capacity * 2;
+            search->files = realloc(search->files, *capacity * sizeof(char*));
+            if (search->files == NULL) {
+                printf("Unable to allocate memory for the search.\n");
+                exit(EXIT_FAILURE);
+            }
+        }
+        search->files[search->number_files++] = strdup(dir->files[i].path);
+    }
+
+    for (int i = 0; i < dir->number_directories; i++)
+        search_collect_files(search, dir->dirs[i], capacity);
+}
+
+/******************************************************************************
+ * search_cancel -- Stops the running search and throws away its results.     *
+ *                  Waits only for the files that are being searched right    *
+ *                  now, the rest are skipped.                                *
+ *                                                                            *
+ * Parameters                                                                 *
+ *      search -- The search.                                                 *
+ *                                                                            *
+ * Returns                                                                    *
+ *      Nothing                                                               *
+ *****************************************************************************/
+void search_cancel(project_search* search) {
+    atomic_fetch_add(&search->generation, 1);
+    if (search->pool_running)
+        pool_wait(&search->pool);
+
+    for (int i = 0; i < search->number_hits; i++)
+        free(search->hits[i].text);
+    search->number_hits = 0;
+    search->hits_truncated = false;
+
+    for (int i = 0; i < search->number_files; i++)
+        free(search->files[i]);
+    free(search->files);
+    free(search->tasks);
+    free(search->skip_path);
+    search->files = NULL;
+    search->tasks = NULL;
+    search->number_files = 0;
+    search->skip_path = NULL;
+
+    atomic_store(&search->files_left, 0);
+    atomic_store(&search->files_changed, 0);
+    atomic_store(&search->files_failed, 0);
+    atomic_store(&search->replaced, 0);
+}
+
+/******************************************************************************
+ * search_start -- Starts searching, or replacing, across the pages of a      *
+ *                 project. Returns right away, the files are searched in     *
+ *                 the background.                                            *
+ *                                                                            *
+ * Parameters                                                                 *
+ *      search -- The search.                                                 *
+ *      root -- The root of the project tree.                                 *
+ *      mode -- One of the search_modes.                                      *
+ *      query -- The text to search for.                                      *
+ *      replacement -- The text to replace it with, when replacing.           *
+ *      skip_path -- The path of a file to leave alone, or NULL.              *
+ *                                                                            *
+ * Returns                                                                    *
+ *      Nothing                                                               *
+ *****************************************************************************/
+void search_start(project_search* search, dir_contents* root, int mode, const char* query, const char* replacement, const char* skip_path) {
+    search_cancel(search);
+
+    if (root == NULL || query[0] == '\0')
+        return;
+
+    if (!search->pool_running) {
+        pool_start(&search->pool, pool_default_threads());
+        search->pool_running = true;
+    }
+
+    search->mode = mode;
+    search->skip_path = skip_path != NULL ? strdup(skip_path) : NULL;
+    snprintf(search->query, sizeof(search->query), "%s", query);
+    snprintf(search->replacement, sizeof(search->replacement), "%s", replacement != NULL ? replacement : "");
+
+    int capacity = 0;
+    search_collect_files(search, root, &capacity);
+    if (search->number_files == 0)
+        return;
+
+    search->tasks = malloc(search->number_files * sizeof(struct search_task));
+    if (search->tasks == NULL) {
+        printf("Unable to allocate memory for the search.\n");
+        exit(EXIT_FAILURE);
+    }
+
+    unsigned long generation = atomic_load(&search->generation);
+    atomic_store(&search->files_left, search->number_files);
+    for (int i = 0; i < search->number_files; i++) {
+        search->tasks[i] = (struct search_task){search, i, generation};
+        pool_submit(&search->pool, search_file_task, &search->tasks[i]);
+    }
+}
+
+/******************************************************************************
+ * search_running -- Checks whether a search still has files to go through.   *
+ *                                                                            *
+ * Parameters                                                                 *
+ *      search -- The search.                                                 *
+ *                                                                            *
+ * Returns                                                                    *
+ *      A boolean specifying whether or not the search is still running.      *
+ *****************************************************************************/
+bool search_running(project_search* search) {
+    return atomic_load(&search->files_left) > 0;
+}
+
+/******************************************************************************
+ * search_stop -- Cancels any search and stops the worker threads.            *
+ *                                                                            *
+ * Parameters                                                                 *
+ *      search -- The search.                                                 *
+ *                                                                            *
+ * Returns                                                                    *
+ *      Nothing                                                               *
+ *****************************************************************************/
+void search_stop(project_search* search) {
+    search_cancel(search);
+    free(search->hits);
+    search->hits = NULL;
+    search->hits_capacity = 0;
+
+    if (search->pool_running) {
+        pool_stop(&search->pool);
+        search->pool_running = false;
+    }
+}
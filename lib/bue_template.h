@@ -0,0 +1,267 @@
+/******************************************************************************
+ * bue_template -- Parses the HTML page template of a project once into a     *
+ *                 list of segments, so that each exported page is put        *
+ *                 together by copying the segments and filling in the        *
+ *                 placeholders, without searching the template again.        *
+ *                                                                            *
+ * Author: 7B Industries                                                      *
+ * License: Apache 2.0                                                        *
+ *                                                                            *
+ * ***************************************************************************/
+
+/*
+ * The template used when a project has none of its own. Placeholders are
+ * written as {{name}}, see template_placeholders for the names.
+ */
+static const char template_default[] =
+    "<!DOCTYPE html>\n"
+    "<html>\n"
+    "<head>\n"
+    "<meta charset=\"utf-8\">\n"
+    "<meta name=\"viewport\" content=\"width=device-width, initial-scale=1\">\n"
+    "<title>{{title}}</title>\n"
+    "<link rel=\"stylesheet\" href=\"{{root}}style.css\">\n"
+    "</head>\n"
+    "<body>\n"
+    "<nav>\n{{nav}}</nav>\n"
+    "<main>\n{{content}}</main>\n"
+    "</body>\n"
+    "</html>\n";
+
+// The kinds of segments that a template is made of
+enum template_parts {
+    template_text = 0,  // Copied as it is
+    template_title = 1,  // The title of the page
+    template_content = 2,  // The HTML of the page
+    template_nav = 3,  // The site navigation
+    template_root = 4,  // The relative path from the page to the root of the site, like "../"
+    template_current = 5  // Marks a navigation link as the current one when it is for the page
+};
+
+// The placeholder for each of the template_parts, in the same order
+static const char* template_placeholders[] = {NULL, "{{title}}", "{{content}}", "{{nav}}", "{{root}}", NULL};
+
+struct template_segment {
+    int kind;  // One of the template_parts
+    int page;  // For template_current, the index of the page that the link is for
+    size_t start;  // For template_text, the offset of the text in the template's text
+    size_t len;
+};
+
+typedef struct page_template page_template;
+struct page_template {
+    string_buffer text;  // The text that the text segments point into
+    struct template_segment* segments;
+    int number_segments;
+    int segments_capacity;
+};
+
+// What is filled in for the placeholders of one page
+struct template_values {
+    const char* title;
+    const char* content;
+    size_t content_len;
+    const char* root;
+    int page;  // The index of the page, to mark it in the navigation
+    const page_template* nav;
+};
+
+/******************************************************************************
+ * template_init -- Sets up an empty template.                                *
+ *                                                                            *
+ * Parameters                                                                 *
+ *      tpl -- The template.                                                  *
+ *                                                                            *
+ * Returns                                                                    *
+ *      Nothing                                                               *
+ *****************************************************************************/
+void template_init(page_template* tpl) {
+    str_buf_init(&tpl->text);
+    tpl->segments = NULL;
+    tpl->number_segments = 0;
+    tpl->segments_capacity = 0;
+}
+
+/******************************************************************************
+ * template_free -- Releases the text and segments of a template.             *
+ *                                                                            *
+ * Parameters                                                                 *
+ *      tpl -- The template.                                                  *
+ *                                                                            *
+ * Returns                                                                    *
+ *      Nothing                                                               *
+ *****************************************************************************/
+void template_free(page_template* tpl) {
+    str_buf_free(&tpl->text);
+    free(tpl->segments);
+    template_init(tpl);
+}
+
+/******************************************************************************
+ * template_add -- Adds a segment to the end of a template.                   *
+ *                                                                            *
+ * Parameters                                                                 *
+ *      tpl -- The template.                                                  *
+ *      kind -- One of the template_parts.                                    *
+ *      page -- The page index for template_current segments.                 *
+ *                                                                            *
+ * Returns                                                                    *
+ *      Nothing                                                               *
+ *****************************************************************************/
+void template_add(page_template* tpl, int kind, int page) {
+    if (tpl->number_segments == tpl->segments_capacity) {
+        tpl->segments_capacity = tpl->segments_capacity == 0 ? 16 : tpl->segments_capacity * 2;
+        tpl->segments = realloc(tpl->segments, tpl->segments_capacity * sizeof(struct template_segment));
+        if (tpl->segments == NULL) {
+            printf("Unable to allocate memory for the page template.\n");
+            exit(EXIT_FAILURE);
+        }
+    }
+
+    tpl->segments[tpl->number_segments++] = (struct template_segment){.kind = kind, .page = page};
+}
+
+/******************************************************************************
+ * template_add_text -- Adds text to the end of a template, growing the last  *
+ *                      segment when it is text too.                          *
+ *                                                                            *
+ * Parameters                                                                 *
+ *      tpl -- The template.                                                  *
+ *      text -- Pointer to the text.                                          *
+ *      len -- The number of bytes of text.                                   *
+ *                                                                            *
+ * Returns                                                                    *
+ *      Nothing                                                               *
+ *****************************************************************************/
+void template_add_text(page_template* tpl, const char* text, size_t len) {
+    if (len == 0)
+        return;
+
+    if (tpl->number_segments == 0 || tpl->segments[tpl->number_segments - 1].kind != template_text) {
+        template_add(tpl, template_text, -1);
+        tpl->segments[tpl->number_segments - 1].start = tpl->text.len;
+    }
+    tpl->segments[tpl->number_segments - 1].len += len;
+    str_buf_append(&tpl->text, text, len);
+}
+
+/******************************************************************************
+ * template_escape -- Appends text with the characters that mean something in *
+ *                    HTML escaped.                                           *
+ *                                                                            *
+ * Parameters                                                                 *
+ *      out -- The buffer to append to.                                       *
+ *      text -- The NUL terminated text.                                      *
+ *                                                                            *
+ * Returns                                                                    *
+ *      Nothing                                                               *
+ *****************************************************************************/
+void template_escape(string_buffer* out, const char* text) {
+    for (const char* c = text; *c != '\0'; c++) {
+        switch (*c) {
+            case '&': str_buf_append_str(out, "&amp;"); break;
+            case '<': str_buf_append_str(out, "&lt;"); break;
+            case '>': str_buf_append_str(out, "&gt;"); break;
+            case '"': str_buf_append_str(out, "&quot;"); break;
+            default: str_buf_append_char(out, *c); break;
+        }
+    }
+}
+
+/******************************************************************************
+ * template_add_escaped -- Adds text to the end of a template with the        *
+ *                         characters that mean something in HTML escaped.    *
+ *                                                                            *
+ * Parameters                                                                 *
+ *      tpl -- The template.                                                  *
+ *      text -- The NUL terminated text.                                      *
+ *                                                                            *
+ * Returns                                                                    *
+ *      Nothing                                                               *
+ *****************************************************************************/
+void template_add_escaped(page_template* tpl, const char* text) {
+    string_buffer escaped;
+    str_buf_init(&escaped);
+    template_escape(&escaped, text);
+    template_add_text(tpl, escaped.data, escaped.len);
+    str_buf_free(&escaped);
+}
+
+/******************************************************************************
+ * template_parse -- Splits the text of a template into its segments.         *
+ *                   Anything in double braces that is not a placeholder is   *
+ *                   kept as text.                                            *
+ *                                                                            *
+ * Parameters                                                                 *
+ *      tpl -- An empty template to fill in.                                  *
+ *      text -- Pointer to the template text.                                 *
+ *      len -- The number of bytes of template text.                          *
+ *                                                                            *
+ * Returns                                                                    *
+ *      Nothing                                                               *
+ *****************************************************************************/
+void template_parse(page_template* tpl, const char* text, size_t len) {
+    const char* pos = text;
+    const char* end = text + len;
+    const char* open;
+
+    while ((open = span_find(pos, end - pos, "{{")) != NULL) {
+        int kind = template_text;
+        for (int i = 0; i < (int)(sizeof(template_placeholders) / sizeof(template_placeholders[0])); i++) {
+            const char* name = template_placeholders[i];
+            if (name != NULL && (size_t)(end - open) >= strlen(name) && memcmp(open, name, strlen(name)) == 0)
+                kind = i;
+        }
+
+        if (kind == template_text) {
+            template_add_text(tpl, pos, open + 2 - pos);
+            pos = open + 2;
+            continue;
+        }
+
+        template_add_text(tpl, pos, open - pos);
+        template_add(tpl, kind, -1);
+        pos = open + strlen(template_placeholders[kind]);
+    }
+    template_add_text(tpl, pos, end - pos);
+}
+
+/******************************************************************************
+ * template_render -- Appends a page put together from a template.            *
+ *                                                                            *
+ * Parameters                                                                 *
+ *      out -- The buffer to append the page to.                              *
+ *      tpl -- The template.                                                  *
+ *      values -- What to fill in for the placeholders.                       *
+ *                                                                            *
+ * Returns                                                                    *
+ *      Nothing                                                               *
+ *****************************************************************************/
+void template_render(string_buffer* out, const page_template* tpl, const struct template_values* values) {
+    for (int i = 0; i < tpl->number_segments; i++) {
+        const struct template_segment* segment = &tpl->segments[i];
+        switch (segment->kind) {
+            case template_text:
+                str_buf_append(out, tpl->text.data + segment->start, segment->len);
+                break;
+            case template_title:
+                template_escape(out, values->title);
+                break;
+            case template_content:
+                str_buf_append(out, values->content, values->content_len);
+                break;
+            case template_nav:
+                // The navigation is a template itself, so that it can be built once for every page
+                if (values->nav != NULL && values->nav != tpl)
+                    template_render(out, values->nav, values);
+                break;
+            case template_root:
+                str_buf_append_str(out, values->root);
+                break;
+            case template_current:
+                if (segment->page == values->page)
+                    str_buf_append_str(out, " aria-current=\"page\"");
+                break;
+        }
+    }
+}
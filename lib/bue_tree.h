@@ -0,0 +1,232 @@
+/******************************************************************************
+ * bue_tree -- A flattened view of the project tree that the UI draws from.   *
+ *             The nodes are stored in display order with the indices of      *
+ *             their parents and the end of their subtrees, so collapsed      *
+ *             directories can be skipped without walking what is in them.    *
+ *                                                                            *
+ * Author: 7B Industries                                                      *
+ * License: Apache 2.0                                                        *
+ *                                                                            *
+ * ***************************************************************************/
+
+// The kinds of nodes in the flattened tree
+enum tree_node_kinds {tree_dir_node = 0, tree_file_node = 1};
+
+struct tree_node {
+    int kind;  // One of the tree_node_kinds
+    int depth;  // How many directories deep the node is, 0 for the project root
+    int parent;  // Index of the directory holding the node, -1 for the project root
+    int subtree_end;  // Index one past the last node below this one
+    dir_contents* dir;  // The directory, for directory nodes
+    struct file_entry* file;  // The file, for file nodes
+};
+
+typedef struct tree_model tree_model;
+struct tree_model {
+    dir_contents* root;  // The project tree that the model was built from
+    struct tree_node* nodes;  // The nodes in the order they are displayed
+    int number_nodes;
+    int nodes_capacity;
+    uint64_t* expanded;  // One bit per node, set when a directory is expanded
+    int expanded_words;
+    int* visible;  // Indices of the nodes that are not inside of a collapsed directory
+    int number_visible;
+    int visible_capacity;
+    int selected_index;  // Index of the selected file's node, -1 when nothing is selected
+};
+
+tree_model project_tree = {.selected_index = -1};  // The flattened tree of the open project
+
+/******************************************************************************
+ * tree_model_add_node -- Appends a node to the flattened tree.               *
+ *                                                                            *
+ * Parameters                                                                 *
+ *      model -- The tree model to add to.                                    *
+ *      kind -- One of the tree_node_kinds.                                   *
+ *      depth -- How many directories deep the node is.                       *
+ *      parent -- Index of the directory holding the node.                    *
+ *                                                                            *
+ * Returns                                                                    *
+ *      The index of the new node.                                            *
+ *****************************************************************************/
+int tree_model_add_node(tree_model* model, int kind, int depth, int parent) {
+    if (model->number_nodes == model->nodes_capacity) {
+        model->nodes_capacity = model->nodes_capacity == 0 ? 256 : model->nodes_capacity * 2;
+        model->nodes = realloc(model->nodes, model->nodes_capacity * sizeof(struct tree_node));
+        if (model->nodes == NULL) {
+            printf("Unable to allocate memory for the project tree.\n");
+            exit(EXIT_FAILURE);
+        }
+    }
+
+    struct tree_node* node = &model->nodes[model->number_nodes];
+    memset(node, 0, sizeof(struct tree_node));
+    node->kind = kind;
+    node->depth = depth;
+    node->parent = parent;
+    node->subtree_end = model->number_nodes + 1;
+
+    return model->number_nodes++;
+}
+
+/******************************************************************************
+ * tree_model_add_dir -- Appends a directory and everything in it to the      *
+ *                       flattened tree, directories first as they are shown. *
+ *                                                                            *
+ * Parameters                                                                 *
+ *      model -- The tree model to add to.                                    *
+ *      dir -- The directory to add.                                          *
+ *      depth -- How many directories deep the directory is.                  *
+ *      parent -- Index of the directory holding this one.                    *
+ *                                                                            *
+ * Returns                                                                    *
+ *      Nothing                                                               *
+ *****************************************************************************/
+void tree_model_add_dir(tree_model* model, dir_contents* dir, int depth, int parent) {
+    int self = tree_model_add_node(model, tree_dir_node, depth, parent);
+    model->nodes[self].dir = dir;
+
+    for (int i = 0; i < dir->number_directories; i++)
+        tree_model_add_dir(model, dir->dirs[i], depth + 1, self);
+
+    for (int i = 0; i < dir->number_files; i++) {
+        int file = tree_model_add_node(model, tree_file_node, depth + 1, self);
+        model->nodes[file].file = &dir->files[i];
+    }
+
+    model->nodes[self].subtree_end = model->number_nodes;
+}
+
+/******************************************************************************
+ * tree_model_is_expanded -- Checks whether a directory node is expanded.     *
+ *                                                                            *
+ * Parameters                                                                 *
+ *      model -- The tree model.                                              *
+ *      index -- The index of the node.                                       *
+ *                                                                            *
+ * Returns                                                                    *
+ *      A boolean specifying whether or not the node is expanded.             *
+ *****************************************************************************/
+bool tree_model_is_expanded(const tree_model* model, int index) {
+    return (model->expanded[index / 64] >> (index % 64)) & 1;
+}
+
+/******************************************************************************
+ * tree_model_update_visible -- Works out which nodes are visible, skipping   *
+ *                              over the insides of collapsed directories.    *
+ *                                                                            *
+ * Parameters                                                                 *
+ *      model -- The tree model.                                              *
+ *                                                                            *
+ * Returns                                                                    *
+ *      Nothing                                                               *
+ *****************************************************************************/
+void tree_model_update_visible(tree_model* model) {
+    model->number_visible = 0;
+
+    int i = 0;
+    while (i < model->number_nodes) {
+        if (model->number_visible == model->visible_capacity) {
+            model->visible_capacity = model->visible_capacity == 0 ? 256 : model->visible_capacity * 2;
+            model->visible = realloc(model->visible, model->visible_capacity * sizeof(int));
+            if (model->visible == NULL) {
+                printf("Unable to allocate memory for the project tree.\n");
+                exit(EXIT_FAILURE);
+            }
+        }
+        model->visible[model->number_visible++] = i;
+
+        if (model->nodes[i].kind == tree_dir_node && !tree_model_is_expanded(model, i))
+            i = model->nodes[i].subtree_end;
+        else
+            i++;
+    }
+}
+
+/******************************************************************************
+ * tree_model_build -- Flattens a project tree, keeping the directories that  *
+ *                     were expanded and the selected file from before.       *
+ *                                                                            *
+ * Parameters                                                                 *
+ *      model -- The tree model to build.                                     *
+ *      root -- The root of the project tree, or NULL for no project.         *
+ *      selected -- The path of the selected file, or NULL.                   *
+ *                                                                            *
+ * Returns                                                                    *
+ *      Nothing                                                               *
+ *****************************************************************************/
+void tree_model_build(tree_model* model, dir_contents* root, const char* selected) {
+    // The project root starts out expanded the first time it is shown
+    if (root != NULL && root != model->root)
+        root->expanded = true;
+
+    model->root = root;
+    model->number_nodes = 0;
+    model->selected_index = -1;
+    if (root != NULL)
+        tree_model_add_dir(model, root, 0, -1);
+
+    // Copy the expanded state that is kept in the directories into the bitmap
+    int words = (model->number_nodes + 63) / 64;
+    if (words > model->expanded_words) {
+        model->expanded = realloc(model->expanded, words * sizeof(uint64_t));
+        if (model->expanded == NULL) {
+            printf("Unable to allocate memory for the project tree.\n");
+            exit(EXIT_FAILURE);
+        }
+        model->expanded_words = words;
+    }
+    if (model->expanded_words > 0)
+        memset(model->expanded, 0, model->expanded_words * sizeof(uint64_t));
+
+    for (int i = 0; i < model->number_nodes; i++) {
+        struct tree_node* node = &model->nodes[i];
+        if (node->kind == tree_dir_node && node->dir->expanded)
+            model->expanded[i / 64] |= (uint64_t)1 << (i % 64);
+        else if (node->kind == tree_file_node && selected != NULL && node->file->path == selected)
+            model->selected_index = i;
+    }
+
+    tree_model_update_visible(model);
+}
+
+/******************************************************************************
+ * tree_model_toggle -- Expands a collapsed directory, or collapses an        *
+ *                      expanded one.                                         *
+ *                                                                            *
+ * Parameters                                                                 *
+ *      model -- The tree model.                                              *
+ *      index -- The index of the directory's node.                           *
+ *                                                                            *
+ * Returns                                                                    *
+ *      Nothing                                                               *
+ *****************************************************************************/
+void tree_model_toggle(tree_model* model, int index) {
+    struct tree_node* node = &model->nodes[index];
+    if (node->kind != tree_dir_node)
+        return;
+
+    model->expanded[index / 64] ^= (uint64_t)1 << (index % 64);
+
+    // Keep the state in the directory too so that it lasts through a rebuild
+    node->dir->expanded = tree_model_is_expanded(model, index);
+
+    tree_model_update_visible(model);
+}
+
+/******************************************************************************
+ * tree_model_free -- Releases the memory held by a tree model.               *
+ *                                                                            *
+ * Parameters                                                                 *
+ *      model -- The tree model to free.                                      *
+ *                                                                            *
+ * Returns                                                                    *
+ *      Nothing                                                               *
+ *****************************************************************************/
+void tree_model_free(tree_model* model) {
+    free(model->nodes);
+    free(model->expanded);
+    free(model->visible);
+    memset(model, 0, sizeof(tree_model));
+    model->selected_index = -1;
+}
@@ -8,8 +8,21 @@
  *                                                                            *
  * ***************************************************************************/
 
+#include "bue_pool.h"
 #include "bue_io.h"
 #include "bue_preprocess.h"
+#include "bue_links.h"
+#include "bue_index.h"
+#include "bue_tree.h"
+#include "bue_watch.h"
+#include "bue_doc.h"
+#include "bue_editor.h"
+#include "bue_highlight.h"
+#include "bue_preview.h"
+#include "bue_search.h"
+#include "bue_image.h"
+#include "bue_template.h"
+#include "bue_export.h"
 
 // #define INCLUDE_STYLE
 // #ifdef INCLUDE_STYLE
@@ -23,9 +36,16 @@
 #define ERROR_MSG_MAX_LENGTH 1000
 #define FILE_PATH_MAX_LENGTH 1000
 
+// The height of each row in the project tree, and how far each level is indented
+#define TREE_ROW_HEIGHT 22
+#define TREE_INDENT 14
+
+// How long to wait for typing to pause before rendering the preview, in milliseconds
+#define PREVIEW_DEBOUNCE_MS 150
+
 typedef struct markdown_state markdown_state;
 struct markdown_state {
-    int prev_markdown_len;
+    unsigned long seen_version;  // The editor's version the last time the UI checked for changes
     bool is_dirty;
     char* dirty_path;
 };
@@ -33,16 +53,20 @@ struct markdown_state {
 char* selected_path = NULL;  // Tracks the currently selected path so see when a change occurs and to know where to save
 char file_path[FILE_PATH_MAX_LENGTH];  // Holds the selected file/folder path
 char* html_preview = NULL;  // Converted HTML text based on the markdowns
-struct directory_contents contents;  // Listed directory contents
+text_editor html_view;  // Read-only view of the HTML preview
+dir_contents* contents = NULL;  // Listed directory contents
+tree_arena project_arena = {0};  // Holds the memory for the listed directory contents
 int ret;  // The return code for the markdown to HTML conversions
 struct nk_rect bounds;  // The bounds of the popup dialog
 bool step_link_page_dialog_active = false;  // Tracks whether or not the step link page dialog should be opened
 bool image_link_dialog_active = false;  // Tracks whether or not the image dialog should be opened
 bool save_confirm_dialog_active = false;  // Tracks whether or not the save confirmation dialog should be opened
 bool about_dialog_active = false;  // Tracks whether or not the About dialog should be opened
+bool find_dialog_active = false;  // Tracks whether or not the Find in Project dialog should be opened
+bool export_dialog_active = false;  // Tracks whether or not the export progress dialog should be opened
 bool error_popup_active = false;  // Tracks whether or not the error popup should be displayed
 char error_popup_message[ERROR_MSG_MAX_LENGTH];  // The message that will be displayed in the error popup
-struct nk_text_edit tedit_state;  // The struct that holds the state of the BuildUp text editor
+text_editor md_editor;  // The BuildUp markdown editor
 markdown_state bu_state;  // Tracks the state of the BuildUp markdown editor
 clipboard_c *cb;  // Used to copy data to/from the clipboard
 
@@ -50,10 +74,6 @@ clipboard_c *cb;  // Used to copy data to/from the clipboard
 char step_link_insert_msg[200] = {'\0'};
 char insert_image_msg[200] = {'\0'};
 
-// md4c flags for converting markdown to HTML
-static unsigned parser_flags = 0;
-static unsigned renderer_flags = MD_HTML_FLAG_DEBUG;
-
 // Popup dialog control flags
 static int show_open_project = nk_false;
 
@@ -64,6 +84,8 @@ char step_link_link_file[1000];  // The page file to link to
 char step_link_link_text[1000];  // The link text field
 char image_alt_text[1000];  // The image alternate text field
 char image_path[1000];  // The path to the image file
+char find_query[SEARCH_TEXT_MAX];  // The text to find in the project
+char find_replacement[SEARCH_TEXT_MAX];  // The text to replace it with
 
 // X11 window representation
 // Linux only
@@ -83,41 +105,33 @@ struct XWindow {
     Atom wm_delete_window;
 };
 
-/*
- * struct of user data that can be passed by the markdown parser.
- * This is mostly just a placeholder right now.
- */
-struct md_userdata {
-    char* name;
-};
-
 /******************************************************************************
- * process_output -- Call back function for the Markdown to HTML processor.   *
+ * editor_copy_to_clipboard -- Puts text from the markdown editor in the      *
+ *                             system's clipboard.                            *
  *                                                                            *
  * Parameters                                                                 *
- *      text - The markdown that has been converted to HTML                   *
- *      size - The size of the converted HTML string                          *
- *      userdata - A struct that holds custom data that is passed as-is       *
+ *      text -- The NUL terminated text to copy.                              *
+ *      len -- The number of bytes of text.                                   *
  *                                                                            *
  * Returns                                                                    *
- *      N/A                                                                   *
+ *      Nothing                                                               *
  *****************************************************************************/
-static void process_output(const MD_CHAR* text, MD_SIZE size, void* userdata)
-{
-    // To get rid of the unused variable warning for userdata
-    if (userdata == NULL)
-        printf("No user data passed for markdown processor.\n");
-
-    // Make sure the correct amount of memory is allocated for the HTML preview
-    if (html_preview == NULL) {
-        html_preview = (char*)realloc(html_preview, size + 1);
-        html_preview[0] = '\0';
-    }
-    else {
-        html_preview = (char*)realloc(html_preview, strlen(html_preview) * sizeof(char) + size + 1);
-    }
+void editor_copy_to_clipboard(const char* text, size_t len) {
+    clipboard_set_text_ex(cb, text, (int)len, LCB_CLIPBOARD);
+}
 
-    strncat(html_preview, text, size);
+/******************************************************************************
+ * editor_paste_from_clipboard -- Gets the text in the system's clipboard for *
+ *                                the markdown editor.                        *
+ *                                                                            *
+ * Parameters                                                                 *
+ *      None                                                                  *
+ *                                                                            *
+ * Returns                                                                    *
+ *      The clipboard text, which the caller must free, or NULL.              *
+ *****************************************************************************/
+char* editor_paste_from_clipboard(void) {
+    return clipboard_text(cb);
 }
 
 /*
@@ -130,15 +144,21 @@ struct nk_context* ui_init(struct XWindow xw) {
     xw.font = nk_xfont_create(xw.dpy, "fixed");
     ctx = nk_xlib_init(xw.font, xw.dpy, xw.screen, xw.win, xw.width, xw.height);
 
-    // Initialize the text editor state
-    nk_textedit_init_default(&tedit_state);
+    // Initialize the text editor state, with the clipboard handled by libclipboard
+    editor_init(&md_editor);
+    md_editor.copy = editor_copy_to_clipboard;
+    md_editor.paste = editor_paste_from_clipboard;
+    md_editor.style_arg = &md_highlight;
 
-    // Make sure that the editor string buffer is zero'd out
-    memset(tedit_state.string.buffer.memory.ptr, 0, tedit_state.string.buffer.memory.size);
+    // The HTML preview can be selected and copied from, but not edited
+    editor_init(&html_view);
+    html_view.read_only = true;
+    html_view.wrap = true;
+    html_view.copy = editor_copy_to_clipboard;
 
     // Start the markdown editor's state off
     bu_state.is_dirty = false;
-    bu_state.prev_markdown_len = 0;
+    bu_state.seen_version = 0;
     bu_state.dirty_path = NULL;
 
     // Initialize all the BuildUp tag dialog variables
@@ -150,6 +170,9 @@ struct nk_context* ui_init(struct XWindow xw) {
     // Set up the clipboard
     cb = clipboard_new(NULL);
 
+    // The preview is rendered off of the UI thread
+    preview_worker_start();
+
     return ctx;
 }
 
@@ -198,10 +221,28 @@ void clear_html_preview() {
 
     // Start over again with the html_preview
     html_preview = NULL;
+    editor_set_text(&html_view, NULL, 0);
 }
 
 /******************************************************************************
- * update_preview -- Handles the work of updating the HTML preview.           *
+ * update_html_preview_after -- Asks the preview worker to render the editor  *
+ *                              text.                                         *
+ *                                                                            *
+ * Parameters                                                                 *
+ *      delay -- How many milliseconds to wait for more changes before        *
+ *               rendering, so that bursts of typing are rendered once.       *
+ *                                                                            *
+ * Returns                                                                    *
+ *      Nothing                                                               *
+ *****************************************************************************/
+void update_html_preview_after(long delay) {
+    // The worker renders from a snapshot, so the text is not copied here
+    request_preview(doc_snapshot(&md_editor.doc), selected_path, delay);
+}
+
+/******************************************************************************
+ * update_html_preview -- Asks the preview worker to render the editor text   *
+ *                        right away.                                         *
  *                                                                            *
  * Parameters                                                                 *
  *      None                                                                  *
@@ -210,25 +251,68 @@ void clear_html_preview() {
  *      Nothing                                                               *
  *****************************************************************************/
 void update_html_preview() {
-    // Reset the HTML preview text for the new conversion text
-    clear_html_preview();
+    update_html_preview_after(0);
+}
+
+/******************************************************************************
+ * check_preview_result -- Swaps in any HTML that the preview worker has      *
+ *                         finished since the last frame.                     *
+ *                                                                            *
+ * Parameters                                                                 *
+ *      None                                                                  *
+ *                                                                            *
+ * Returns                                                                    *
+ *      Nothing                                                               *
+ *****************************************************************************/
+void check_preview_result() {
+    char* html = NULL;
+    bool failed = false;
 
-    // Placeholder for user data that can be passed around
-    struct md_userdata userdata = {.name="Name"};
+    if (take_preview_result(&html, &failed)) {
+        // Reset the HTML preview text for the new conversion text
+        clear_html_preview();
+        html_preview = html;
 
-    // Preprocess the string to handle all the BuildUp-specific tags
-    char* processed_str = preprocess((char*)tedit_state.string.buffer.memory.ptr, selected_path);
+        // The view keeps its own copy, measured once here rather than every frame, and a page that renders to nothing has no HTML
+        editor_set_text(&html_view, html, html != NULL ? strlen(html) : 0);
 
-    // Convert the markdown to HTML
-    ret = md_html(processed_str, (MD_SIZE)str_size(processed_str), process_output, (void*) &userdata, parser_flags, renderer_flags);
-    if (ret == -1) {
-        set_error_popup("The markdown failed to parse.");
+        if (failed) {
+            ret = -1;
+            set_error_popup("The markdown failed to parse.");
+        }
     }
 }
 
 /******************************************************************************
- * save_selected_file -- Saves the text in the markdown editor to the open    *
- *                       file.                                                *
+ * find_tree_file -- Looks for the file with the given path in the project    *
+ *                   tree.                                                    *
+ *                                                                            *
+ * Parameters                                                                 *
+ *      dir -- The directory to start looking from.                           *
+ *      path -- The path of the file.                                         *
+ *                                                                            *
+ * Returns                                                                    *
+ *      The file entry, or NULL if the file is not in the tree.               *
+ *****************************************************************************/
+struct file_entry* find_tree_file(struct directory_contents* dir, const char* path) {
+    for (int i = 0; i < dir->number_files; i++) {
+        if (strcmp(dir->files[i].path, path) == 0)
+            return &dir->files[i];
+    }
+
+    for (int i = 0; i < dir->number_directories; i++) {
+        struct file_entry* ent = find_tree_file(dir->dirs[i], path);
+        if (ent != NULL)
+            return ent;
+    }
+
+    return NULL;
+}
+
+/******************************************************************************
+ * reload_project_tree -- Lists the open project again from scratch, keeping  *
+ *                        the selected file selected. Used when the file      *
+ *                        watch has lost track of some changes.               *
  *                                                                            *
  * Parameters                                                                 *
  *      None                                                                  *
@@ -236,59 +320,59 @@ void update_html_preview() {
  * Returns                                                                    *
  *      Nothing                                                               *
  *****************************************************************************/
-void save_selected_file() {
-    // If no file is selected, there is no reason to save this file
-    if (selected_path == NULL) {
-        // Let the user know that no file will be saved
-        set_error_popup("There is no selected file to save.");
+void reload_project_tree() {
+    if (contents == NULL)
         return;
-    }
 
+    tree_arena new_arena = {0};
+    dir_contents* new_contents = open_project(&new_arena, contents->path);
 
-    // If there is a selected file path
-    if (bu_state.dirty_path != NULL) {
-        // Open the dirty file path for writing and write the editor buffer
-        FILE* doc_file;
-        doc_file = fopen(bu_state.dirty_path, "w");
-        if (doc_file == NULL) {
-            set_error_popup("There was an error saving the open file.");
+    // The selected path points into the old tree, so move it over to the new one
+    if (selected_path != NULL) {
+        struct file_entry* ent = find_tree_file(new_contents, selected_path);
+        char* new_path = NULL;
+        if (ent != NULL) {
+            new_path = ent->path;
         }
         else {
-            // Save the editor text to the file
-            int res = fputs(tedit_state.string.buffer.memory.ptr, doc_file);
-            if (res == EOF) {
-                set_error_popup("There was an error saving the file.");
-            }
-            else {
-                bu_state.is_dirty = false;
-                bu_state.dirty_path = NULL;
-            }
+            new_path = arena_strdup(&new_arena, selected_path);
         }
-        fclose(doc_file);
+
+        if (bu_state.dirty_path == selected_path)
+            bu_state.dirty_path = new_path;
+        selected_path = new_path;
     }
+
+    arena_free(&project_arena);
+    project_arena = new_arena;
+    contents = new_contents;
+
+    tree_model_build(&project_tree, contents, selected_path);
+    project_watch_start(&project_arena, contents);
 }
 
 /******************************************************************************
- * deselect_all_files -- Helper function that deselects all the files in a    *
- *                       given directory.                                     *
+ * close_project -- Writes the index for the open project if it is out of     *
+ *                  date, and stops watching the project for changes.         *
  *                                                                            *
  * Parameters                                                                 *
- *      dir -- directory_contents struct holding the files to be deselected.  *
+ *      None                                                                  *
  *                                                                            *
  * Returns                                                                    *
  *      Nothing                                                               *
  *****************************************************************************/
-void deselect_all_files(struct directory_contents* dir) {
-    for (int i = 0; i < dir->number_files; i++) {
-        dir->files[i].selected = nk_false;
-        dir->files[i].prev_selected = nk_false;
-    }
+void close_project() {
+    project_watch_stop();
+    search_cancel(&searcher);
+    export_cancel(&exporter);
+
+    if (contents != NULL && contents->error == no_error && project_index_dirty)
+        project_index_save(contents);
 }
 
 /******************************************************************************
- * deselect_entire_tree -- Toggles the selection flag for all the files in    *
- *                         directory listing to off, so that just the current *
- *                         selection will be highlighted.                     *
+ * check_project_changes -- Applies any changes made to the project files     *
+ *                          outside of the editor since the last frame.       *
  *                                                                            *
  * Parameters                                                                 *
  *      None                                                                  *
@@ -296,33 +380,73 @@ void deselect_all_files(struct directory_contents* dir) {
  * Returns                                                                    *
  *      Nothing                                                               *
  *****************************************************************************/
-void deselect_entire_tree() {
-    // Deselect any level 0 files
-    deselect_all_files(&contents);
+void check_project_changes() {
+    char* old_selected = selected_path;
+    int changes = project_watch_poll(&selected_path);
 
-    // Deselect any level 1 files
-    for (int i = 0; i < contents.number_directories; i++) {
-        deselect_all_files(contents.dirs[i]);
+    // Keep saving to the right place if the open file was renamed
+    if (selected_path != old_selected && bu_state.dirty_path == old_selected)
+        bu_state.dirty_path = selected_path;
 
-        // Deselect any level 2 files
-        for (int j = 0; j < contents.dirs[i]->number_directories; j++) {
-            deselect_all_files(contents.dirs[i]->dirs[j]);
+    // The index needs to be written again before the project is closed
+    if (changes != watch_no_change)
+        project_index_dirty = true;
 
-            // Deselect any level 3 files
-            for (int k = 0; k < contents.dirs[i]->dirs[j]->number_directories; k++) {
-                deselect_all_files(contents.dirs[i]->dirs[j]->dirs[k]);
+    // Rows were added or removed, so flatten the tree again
+    if (changes & watch_tree_changed)
+        tree_model_build(&project_tree, contents, selected_path);
 
-                // Deselect any level 4 files
-                for (int l = 0; l < contents.dirs[i]->dirs[j]->dirs[k]->number_directories; l++) {
-                    deselect_all_files(contents.dirs[i]->dirs[j]->dirs[k]->dirs[l]);
+    if (changes & watch_overflow) {
+        printf("Too many project files changed at once, listing the project again.\n");
+        reload_project_tree();
+    }
 
-                    // Deselect any level 5 files
-                    for (int m = 0; m < contents.dirs[i]->dirs[j]->dirs[k]->dirs[l]->number_directories; m++) {
-                        deselect_all_files(contents.dirs[i]->dirs[j]->dirs[k]->dirs[l]->dirs[m]);
-                    }
-                }
-            }
+    // Titles and links that the preview depends on may have changed
+    if ((changes & watch_pages_changed) && selected_path != NULL && string_ends_with(selected_path, ".md"))
+        update_html_preview();
+}
+
+/******************************************************************************
+ * save_selected_file -- Saves the text in the markdown editor to the open    *
+ *                       file.                                                *
+ *                                                                            *
+ * Parameters                                                                 *
+ *      None                                                                  *
+ *                                                                            *
+ * Returns                                                                    *
+ *      Nothing                                                               *
+ *****************************************************************************/
+void save_selected_file() {
+    // If no file is selected, there is no reason to save this file
+    if (selected_path == NULL) {
+        // Let the user know that no file will be saved
+        set_error_popup("There is no selected file to save.");
+        return;
+    }
+
+
+    // If there is a selected file path
+    if (bu_state.dirty_path != NULL) {
+        // Save the editor text through a temporary file, so that a failed save leaves the old file whole
+        struct doc_node* snapshot = doc_snapshot(&md_editor.doc);
+        size_t len;
+        char* text = doc_text(snapshot, &len);
+        if (!write_file_atomic(bu_state.dirty_path, text, len)) {
+            set_error_popup("There was an error saving the file.");
         }
+        else {
+            // Any step links to this page need to pick up its new title
+            title_cache_invalidate(bu_state.dirty_path);
+
+            // Only this page's links can have changed
+            link_graph_update_page(bu_state.dirty_path, text, len);
+            project_index_dirty = true;
+
+            bu_state.is_dirty = false;
+            bu_state.dirty_path = NULL;
+        }
+        free(text);
+        doc_node_release(snapshot);
     }
 }
 
@@ -337,8 +461,8 @@ void deselect_entire_tree() {
  *****************************************************************************/
 void clear_editor() {
     // Clear the previous contents of the markdown editor
-    nk_textedit_select_all(&tedit_state);
-    nk_textedit_delete_selection(&tedit_state);
+    editor_select_all(&md_editor);
+    editor_delete_selection(&md_editor);
 }
 
 /******************************************************************************
@@ -352,23 +476,16 @@ void clear_editor() {
  *      Nothing                                                               *
  *****************************************************************************/
 void cut_copy_to_clipboard() {
-    int glyph_len;
-    nk_rune unicode;
-    const char *text;
-    int start = tedit_state.select_start;
-    int ending = tedit_state.select_end;
-
     // Get the selected text from the markdown editor control
-    int begin = NK_MIN(start, ending);
-    int end = NK_MAX(start, ending);
-    text = nk_str_at_const(&tedit_state.string, begin, &unicode, &glyph_len);
-    text = strndup(text, end - begin);
+    size_t len;
+    char* text = editor_selected_text(&md_editor, &len);
 
     // Make sure we have data to copy to the clipboard
-    if (text) {
+    if (len > 0) {
         // Copy the markdown editor's selected text to the system clipboard
-        clipboard_set_text(cb, text);
+        editor_copy_to_clipboard(text, len);
     }
+    free(text);
 }
 
 /******************************************************************************
@@ -384,99 +501,290 @@ void cut_copy_to_clipboard() {
  *****************************************************************************/
 void paste_from_clipboard() {
     char* text = clipboard_text(cb);
+    if (text == NULL)
+        return;
 
     // Add the clipboard text into the markdown editor
-    nk_textedit_text(&tedit_state, text, strlen(text));
+    editor_insert(&md_editor, text, strlen(text));
+    free(text);
 }
 
 /******************************************************************************
- * check_selected_tree_item -- Handles the logic for when a directory tree    *
- *                             item is selected.                              *
+ * load_selected_file -- Loads a file that was selected in the project tree   *
+ *                       into the markdown editor.                            *
  *                                                                            *
  * Parameters                                                                 *
- *      contents -- A pointer to the struct of directory contents to search   *
- *                  for a selected tree item.                                 *
+ *      ent -- The file entry that was selected.                              *
  *                                                                            *
  * Returns                                                                    *
  *      Nothing                                                               *
  *****************************************************************************/
-void check_selected_tree_item(struct directory_contents* contents) {
-    for (int i = 0; i < contents->number_files; i++) {
-        // Protect against switching away from a file that needs to be saved first
-        if (bu_state.is_dirty && bu_state.dirty_path != NULL && contents->files[i].selected == nk_true && strcmp(contents->files[i].path, bu_state.dirty_path) != 0) {
-            if (!save_confirm_dialog_active) {
-                // Deselect this file since it is not the one that needs to be saved
-                contents->files[i].selected = nk_false;
-
-                // Open the save confirm dialog that will stop the user before they lose changes accidentally
-                printf("You need to save the current file before switching to another.\n");
-                save_confirm_dialog_active = true;
-            }
-            return;
-        }
+void load_selected_file(struct file_entry* ent) {
+    printf("%s is selected.\n", ent->path);
 
-        // Check to see if an asterisk should be added to show that a file is dirty
-        if (contents->files[i].selected == nk_true && bu_state.is_dirty && contents->files[i].name[strlen(contents->files[i].name) - 1] != '*') {
-            // Append the asterisk to the file name
-            append_char_to_string(contents->files[i].name, '*');
-            bu_state.dirty_path = selected_path;
+    // Clear the HTML preview for the next render
+    clear_html_preview();
+
+    // Save this as the currently selected path
+    selected_path = ent->path;
+
+    // Only the text files can be loaded into the markdown editor
+    if (!string_ends_with(ent->name, ".md") && !string_ends_with(ent->name, ".yaml"))
+        return;
+
+    // Read the whole documentation file into the markdown editor at once
+    if (!editor_load_file(&md_editor, ent->path)) {
+        set_error_popup("There was an error opening the file\nthat you selected.");
+        return;
+    }
+
+    // Only markdown is highlighted
+    md_editor.style = string_ends_with(ent->name, ".md") ? highlight_style_line : NULL;
+
+    // Loading the file is not an edit, so it must not mark the file as dirty
+    bu_state.seen_version = md_editor.version;
+
+    // If a markdown file was just opened, render the HTML preview
+    if (string_ends_with(ent->name, ".md")) {
+        update_html_preview();
+    }
+}
+
+/******************************************************************************
+ * select_tree_node -- Handles the logic for when a file in the project tree  *
+ *                     is clicked on.                                         *
+ *                                                                            *
+ * Parameters                                                                 *
+ *      index -- The index of the file's node in the project tree.            *
+ *                                                                            *
+ * Returns                                                                    *
+ *      Nothing                                                               *
+ *****************************************************************************/
+void select_tree_node(int index) {
+    struct file_entry* ent = project_tree.nodes[index].file;
+
+    // Protect against switching away from a file that needs to be saved first
+    if (bu_state.is_dirty && bu_state.dirty_path != NULL && strcmp(ent->path, bu_state.dirty_path) != 0) {
+        if (!save_confirm_dialog_active) {
+            // Open the save confirm dialog that will stop the user before they lose changes accidentally
+            printf("You need to save the current file before switching to another.\n");
+            save_confirm_dialog_active = true;
         }
-        else if (contents->files[i].selected == nk_true && !bu_state.is_dirty && contents->files[i].name[strlen(contents->files[i].name) - 1] == '*') {
-            // If the file is not dirty, make sure it does not keep its asterisk
-            contents->files[i].name[strlen(contents->files[i].name) - 1] = '\0';
+        return;
+    }
+
+    // Selecting the same file again does not reload it
+    if (index == project_tree.selected_index)
+        return;
+
+    project_tree.selected_index = index;
+    load_selected_file(ent);
+}
+
+/******************************************************************************
+ * open_search_hit -- Opens the file holding a match from the project search, *
+ *                    and selects the match in the editor.                    *
+ *                                                                            *
+ * Parameters                                                                 *
+ *      path -- The path to the file.                                         *
+ *      offset -- Byte offset of the match in the file.                       *
+ *                                                                            *
+ * Returns                                                                    *
+ *      Nothing                                                               *
+ *****************************************************************************/
+void open_search_hit(const char* path, size_t offset) {
+    int index = -1;
+    for (int i = 0; i < project_tree.number_nodes; i++) {
+        struct tree_node* node = &project_tree.nodes[i];
+        if (node->kind == tree_file_node && strcmp(node->file->path, path) == 0) {
+            index = i;
+            break;
         }
+    }
+    if (index < 0)
+        return;
 
-        // If the item was previously selected, deselect it
-        if (contents->files[i].selected == nk_true && contents->files[i].prev_selected == nk_false) {
-            printf("%s is selected.\n", contents->files[i].path);
+    // The save confirmation dialog can keep the file from being opened
+    select_tree_node(index);
+    if (project_tree.selected_index != index)
+        return;
 
-            // Clear the HTML preview for the next render
-            clear_html_preview();
+    // The file may have been changed since it was searched, so stay inside of the text
+    size_t length = doc_length(md_editor.doc.root);
+    size_t end = offset + strlen(searcher.query);
+    md_editor.anchor = offset < length ? offset : length;
+    md_editor.cursor = end < length ? end : length;
+    md_editor.follow_cursor = true;
+    md_editor.active = true;
+}
 
-            // Save this as the currently selected path
-            selected_path = contents->files[i].path;
+/******************************************************************************
+ * replace_in_project -- Replaces the text in the find dialog everywhere in   *
+ *                       the project.                                         *
+ *                                                                            *
+ * Parameters                                                                 *
+ *      None                                                                  *
+ *                                                                            *
+ * Returns                                                                    *
+ *      Nothing                                                               *
+ *****************************************************************************/
+void replace_in_project() {
+    const char* skip_path = NULL;
 
-            // Load the contents of the selected file into the markdown editor
-            if (string_ends_with(contents->files[i].name, ".md") || string_ends_with(contents->files[i].name, ".yaml")) {
-                // Open the documentation file and make sure that the file opened properly
-                FILE* doc_file;
-                doc_file = fopen(contents->files[i].path, "r");
-                if (doc_file == NULL) {
-                    set_error_popup("There was an error opening the file\nthat you selected.");
-                }
-                else {
-                    // Clear the previous contents of the markdown editor
-                    clear_editor();
+    // The open file is changed in the editor instead, so that nothing unsaved is lost and the change can be undone
+    if (selected_path != NULL && (string_ends_with(selected_path, ".md") || string_ends_with(selected_path, ".yaml"))) {
+        skip_path = selected_path;
+        editor_replace_all(&md_editor, find_query, find_replacement);
+    }
 
-                    // Read all of the lines from the file
-                    char line_temp[1000] = {'\0'};
-                    while(fgets(line_temp, sizeof(line_temp), doc_file) != NULL) {
-                        // Add the line read from the file to the markdown editor
-                        nk_textedit_text(&tedit_state, line_temp, strlen(line_temp));
+    search_start(&searcher, contents, search_replace, find_query, find_replacement, skip_path);
+}
 
-                        // Save the current text length as the previous so the file will not be marked as dirty
-                        bu_state.prev_markdown_len = tedit_state.string.len;
-                    }
-                }
+/******************************************************************************
+ * draw_search_status -- Adds a line to the find dialog saying how the search *
+ *                       is going.                                            *
+ *                                                                            *
+ * Parameters                                                                 *
+ *      ctx -- The Nuklear context.                                           *
+ *                                                                            *
+ * Returns                                                                    *
+ *      Nothing                                                               *
+ *****************************************************************************/
+void draw_search_status(struct nk_context *ctx) {
+    int failed = atomic_load(&searcher.files_failed);
+
+    if (contents == NULL)
+        nk_label(ctx, "Open a project to search it.", NK_TEXT_LEFT);
+    else if (searcher.number_files == 0)
+        nk_label(ctx, "", NK_TEXT_LEFT);
+    else if (search_running(&searcher))
+        nk_labelf(ctx, NK_TEXT_LEFT, "Searching, %d of %d files left...", atomic_load(&searcher.files_left), searcher.number_files);
+    else if (searcher.mode == search_replace)
+        nk_labelf(ctx, NK_TEXT_LEFT, "Replaced %d matches in %d files, %d failed.", atomic_load(&searcher.replaced), atomic_load(&searcher.files_changed), failed);
+    else
+        nk_labelf(ctx, NK_TEXT_LEFT, "%d%s matches in %d files.", searcher.number_hits, searcher.hits_truncated ? "+" : "", searcher.number_files);
+}
 
-                // Make sure to close the file
-                fclose(doc_file);
+/******************************************************************************
+ * draw_search_hits -- Adds the matches from the project search that can be   *
+ *                     seen to the find dialog.                               *
+ *                                                                            *
+ * Parameters                                                                 *
+ *      ctx -- The Nuklear context.                                           *
+ *                                                                            *
+ * Returns                                                                    *
+ *      A boolean specifying whether or not a match was opened.               *
+ *****************************************************************************/
+bool draw_search_hits(struct nk_context *ctx) {
+    // The workers add matches while the list is drawn
+    pthread_mutex_lock(&searcher.lock);
+
+    struct nk_list_view view;
+    if (!nk_list_view_begin(ctx, &view, "Matches", NK_WINDOW_BORDER, TREE_ROW_HEIGHT, searcher.number_hits)) {
+        pthread_mutex_unlock(&searcher.lock);
+        return false;
+    }
 
-                // If a markdown file was just opened, render the HTML preview
-                if (string_ends_with(contents->files[i].name, ".md")) {
-                    update_html_preview();
-                }
-            }
+    size_t root_len = contents != NULL ? strlen(contents->path) + 1 : 0;
+    int clicked = -1;
+    nk_layout_row_dynamic(ctx, TREE_ROW_HEIGHT, 1);
+    for (int row = view.begin; row < view.end; row++) {
+        struct search_hit* hit = &searcher.hits[row];
+        const char* path = searcher.files[hit->file];
+
+        // Show the path from the project root to keep the rows short
+        char label[FILE_PATH_MAX_LENGTH];
+        snprintf(label, sizeof(label), "%s:%zu: %s", strlen(path) > root_len ? path + root_len : path, hit->line + 1, hit->text);
+
+        nk_bool value = nk_false;
+        if (nk_selectable_label(ctx, label, NK_TEXT_LEFT, &value))
+            clicked = row;
+    }
+    nk_list_view_end(&view);
+
+    // Copy the match out so that the lock is not held while the file is loaded
+    char* path = NULL;
+    size_t offset = 0;
+    if (clicked >= 0) {
+        path = strdup(searcher.files[searcher.hits[clicked].file]);
+        offset = searcher.hits[clicked].offset;
+    }
+    pthread_mutex_unlock(&searcher.lock);
 
-            // Deselect all other tree items
-            deselect_entire_tree();
+    if (path == NULL)
+        return false;
 
-            // Reselect just this one entry
-            contents->files[i].selected = nk_true;
+    open_search_hit(path, offset);
+    free(path);
+
+    return true;
+}
+
+/******************************************************************************
+ * draw_project_tree -- Adds the rows of the project tree that can be seen to *
+ *                      the UI. Only the rows that are scrolled into view are *
+ *                      laid out, however big the project is.                 *
+ *                                                                            *
+ * Parameters                                                                 *
+ *      ctx -- The Nuklear context to draw with.                              *
+ *                                                                            *
+ * Returns                                                                    *
+ *      Nothing                                                               *
+ *****************************************************************************/
+void draw_project_tree(struct nk_context *ctx) {
+    struct nk_list_view view;
+    if (!nk_list_view_begin(ctx, &view, "Project", NK_WINDOW_BORDER, TREE_ROW_HEIGHT, project_tree.number_visible))
+        return;
+
+    // Clicks are handled after the rows are drawn, since they can change the rows
+    int clicked = -1;
+
+    for (int row = view.begin; row < view.end; row++) {
+        int index = project_tree.visible[row];
+        struct tree_node* node = &project_tree.nodes[index];
+
+        // Indent each row to show how deep it is in the tree
+        if (node->depth == 0) {
+            nk_layout_row_dynamic(ctx, TREE_ROW_HEIGHT, 1);
+        }
+        else {
+            nk_layout_row_template_begin(ctx, TREE_ROW_HEIGHT);
+            nk_layout_row_template_push_static(ctx, node->depth * TREE_INDENT);
+            nk_layout_row_template_push_dynamic(ctx);
+            nk_layout_row_template_end(ctx);
+            nk_spacing(ctx, 1);
         }
 
-        // Save the the current state to use it again next frame
-        contents->files[i].prev_selected = contents->files[i].selected;
+        if (node->kind == tree_dir_node) {
+            enum nk_symbol_type symbol = tree_model_is_expanded(&project_tree, index) ? NK_SYMBOL_TRIANGLE_DOWN : NK_SYMBOL_TRIANGLE_RIGHT;
+            const char* name = node->depth == 0 ? "Project" : node->dir->name;
+            nk_bool value = nk_false;
+            if (nk_selectable_symbol_label(ctx, symbol, name, NK_TEXT_LEFT, &value))
+                clicked = index;
+        }
+        else {
+            nk_bool value = index == project_tree.selected_index;
+
+            // Show that the file is dirty without touching the name that is stored in the tree
+            if (bu_state.is_dirty && node->file->path == selected_path) {
+                char label[strlen(node->file->name) + 2];
+                snprintf(label, sizeof(label), "%s*", node->file->name);
+                if (nk_selectable_label(ctx, label, NK_TEXT_LEFT, &value))
+                    clicked = index;
+            }
+            else if (nk_selectable_label(ctx, node->file->name, NK_TEXT_LEFT, &value)) {
+                clicked = index;
+            }
+        }
+    }
+
+    nk_list_view_end(&view);
+
+    if (clicked >= 0) {
+        if (project_tree.nodes[clicked].kind == tree_dir_node)
+            tree_model_toggle(&project_tree, clicked);
+        else
+            select_tree_node(clicked);
     }
 }
 
@@ -493,6 +801,12 @@ void check_selected_tree_item(struct directory_contents* contents) {
  *      Nothing                                                               *
  *****************************************************************************/
 void ui_do(struct nk_context* ctx, int window_width, int window_height, int* running) {
+    // Show the newest preview if the worker has one ready
+    check_preview_result();
+
+    // Pick up any files that were added, removed or changed outside of the editor
+    check_project_changes();
+
     if (nk_begin(ctx, "Main Window", nk_rect(0, 0, window_width, window_height),
         NK_WINDOW_BORDER | NK_WINDOW_NO_SCROLLBAR))
     {
@@ -524,59 +838,15 @@ void ui_do(struct nk_context* ctx, int window_width, int window_height, int* run
                 update_html_preview();
             }
 
-            // Button to export the project
+            // Button to export every page of the project to the _site directory
             if (nk_menu_item_label(ctx, "EXPORT", NK_TEXT_LEFT)) {
                 // If there is nothing to export, let the user know
-                if (selected_path == NULL) {
+                if (contents == NULL)
                     set_error_popup("You must first open a project to use the\nexport feature.");
-                }
-                else {
-                    // Extract the base path
-                    char* base_path = strdup(selected_path);
-                    cut_string_last(base_path, PATH_SEP[0]);
-
-                    // Extract the file name without the extension
-                    char* export_file_base = strrchr(strdup(selected_path), PATH_SEP[0]);
-                    export_file_base++;
-                    cut_string_last(export_file_base, '.');
-
-                    // Export happens to the _site directory within the project root directory
-                    char* site_dir = "_site";
-                    char* extension = ".html";
-
-                    // Saves the parent path to see if we need to create the _site directory
-                    char* site_path = malloc(sizeof(base_path) + sizeof(PATH_SEP) + sizeof(site_dir) + 1);
-                    site_path[0] = '\0';
-                    strcat(site_path, base_path);
-                    strcat(site_path, PATH_SEP);
-                    strcat(site_path, site_dir);
-
-                    // Try to create the directory and see if it succeeds
-                    int res = create_dir(site_path);
-                    if (res != 0)
-                        set_error_popup("There was an error creating the\n_site directory.");
-
-                    // Create a string to hold all the parts of the path
-                    char* export_path = malloc(sizeof(base_path) + sizeof(PATH_SEP) + sizeof(site_dir) + sizeof(PATH_SEP) + sizeof(export_file_base) + sizeof(extension) + 1);
-                    export_path[0] = '\0';
-                    strcat(export_path, site_path);
-                    strcat(export_path, PATH_SEP);
-                    strcat(export_path, export_file_base);
-                    strcat(export_path, extension);
-
-                    // Write the contents of the HTML preview to the file
-                    FILE* html_file;
-                    html_file = fopen(export_path, "w");
-                    if (html_file == NULL) {
-                        strcat(step_link_insert_msg, "Unable to write to an HTML file.");
-                    }
-                    else {
-                        fputs(html_preview, html_file);
-                    }
-                    fclose(html_file);
-
-                    printf("%s\n", export_path);
-                }
+                else if (!export_start(&exporter, contents))
+                    set_error_popup("There was an error creating the\n_site directory.");
+                else
+                    export_dialog_active = true;
             }
 
             // Button to close the app
@@ -595,18 +865,18 @@ void ui_do(struct nk_context* ctx, int window_width, int window_height, int* run
 
             // The undo feature for the markdown editor
             if (nk_menu_item_label(ctx, "UNDO", NK_TEXT_LEFT)) {
-                printf("Undoing last edit...\n");
+                editor_undo(&md_editor);
             }
 
             // The redo feature for the markdown editor
             if (nk_menu_item_label(ctx, "REDO", NK_TEXT_LEFT)) {
-                printf("Redoing last edit...\n");
+                editor_redo(&md_editor);
             }
 
             // The copy feature for the markdown editor
             if (nk_menu_item_label(ctx, "CUT", NK_TEXT_LEFT)) {
                 cut_copy_to_clipboard();
-                nk_textedit_delete_selection(&tedit_state);
+                editor_delete_selection(&md_editor);
             }
 
             // The copy feature for the markdown editor
@@ -619,6 +889,11 @@ void ui_do(struct nk_context* ctx, int window_width, int window_height, int* run
                 paste_from_clipboard();
             }
 
+            // Finds, and optionally replaces, text in every page of the project
+            if (nk_menu_item_label(ctx, "FIND IN PROJECT", NK_TEXT_LEFT)) {
+                find_dialog_active = true;
+            }
+
             // Opens the settings dialog for the user
             if (nk_menu_item_label(ctx, "SETTINGS", NK_TEXT_LEFT)) {
                 printf("Opening the settings dialog...\n");
@@ -668,121 +943,31 @@ void ui_do(struct nk_context* ctx, int window_width, int window_height, int* run
 
         // Project tree structure
         nk_layout_row_push(ctx, 0.2f);
-        if (nk_group_begin(ctx, "Project", NK_WINDOW_BORDER)) {
-            // Add the directory contents to the project tree
-            if (nk_tree_push(ctx, NK_TREE_NODE, "Project", NK_MAXIMIZED)) {
-                // See if there are any directories to add to the tree
-                if (contents.number_directories > 0) {
-                    for (int i = 0; i < contents.number_directories; i++) {
-                        if (nk_tree_element_push_id(ctx, NK_TREE_NODE, contents.dirs[i]->name, NK_MINIMIZED, &contents.dirs[i]->selected, i)) {
-                            // Add this directory's dir contents
-                            for (int j = 0; j < contents.dirs[i]->number_directories; j++) {
-                                if (nk_tree_element_push_id(ctx, NK_TREE_NODE, contents.dirs[i]->dirs[j]->name, NK_MINIMIZED, &contents.dirs[i]->dirs[j]->selected, i+j)) {
-                                    // Add any subdirectories to the tree
-                                    for (int k = 0; k < contents.dirs[i]->dirs[j]->number_directories; k++) {
-                                        if (nk_tree_element_push_id(ctx, NK_TREE_NODE, contents.dirs[i]->dirs[j]->dirs[k]->name, NK_MINIMIZED, &contents.dirs[i]->dirs[j]->dirs[k]->selected, i+j+k)) {
-                                            // Add this directory's dir contents
-                                            for (int l = 0; l < contents.dirs[i]->dirs[j]->dirs[k]->number_directories; l++) {
-                                                if (nk_tree_element_push_id(ctx, NK_TREE_NODE, contents.dirs[i]->dirs[j]->dirs[k]->dirs[l]->name, NK_MINIMIZED, &contents.dirs[i]->dirs[j]->dirs[k]->dirs[l]->selected, i+j+k+l)) {
-                                                    // Add any subdirectories to the tree
-                                                    for (int m = 0; m < contents.dirs[i]->dirs[j]->dirs[k]->dirs[l]->number_directories; m++) {
-                                                        if (nk_tree_element_push_id(ctx, NK_TREE_NODE, contents.dirs[i]->dirs[j]->dirs[k]->dirs[l]->dirs[m]->name, NK_MINIMIZED, &contents.dirs[i]->dirs[j]->dirs[k]->dirs[l]->dirs[m]->selected, i+j+k+l+m)) {
-                                                            // Add only this bottom subdirectory's files to the tree
-                                                            for (int n = 0; n < contents.dirs[i]->dirs[j]->dirs[k]->dirs[l]->dirs[m]->number_files; n++) {
-                                                                nk_selectable_label(ctx, contents.dirs[i]->dirs[j]->dirs[k]->dirs[l]->dirs[m]->files[n].name, NK_TEXT_LEFT, &contents.dirs[i]->dirs[j]->dirs[k]->dirs[l]->dirs[m]->files[n].selected);
-                                                            }
-                                                            nk_tree_element_pop(ctx);
-                                                        }
-                                                    }
-
-                                                    // Add this directory's files
-                                                    for (int m = 0; m < contents.dirs[i]->dirs[j]->dirs[k]->dirs[l]->number_files; m++) {
-                                                        nk_selectable_label(ctx, contents.dirs[i]->dirs[j]->dirs[k]->dirs[l]->files[m].name, NK_TEXT_LEFT, &contents.dirs[i]->dirs[j]->dirs[k]->dirs[l]->files[m].selected);
-                                                    }
-                                                    nk_tree_element_pop(ctx);
-                                                }
-                                            }
-
-                                            // Add this directory's files
-                                            for (int l = 0; l < contents.dirs[i]->dirs[j]->dirs[k]->number_files; l++) {
-                                                nk_selectable_label(ctx, contents.dirs[i]->dirs[j]->dirs[k]->files[l].name, NK_TEXT_LEFT, &contents.dirs[i]->dirs[j]->dirs[k]->files[l].selected);
-                                            }
-                                            nk_tree_element_pop(ctx);
-                                        }
-                                    }
-
-                                    // Add this subdirectory's file contents
-                                    for (int k = 0; k < contents.dirs[i]->dirs[j]->number_files; k++) {
-                                        nk_selectable_label(ctx, contents.dirs[i]->dirs[j]->files[k].name, NK_TEXT_LEFT, &contents.dirs[i]->dirs[j]->files[k].selected);
-                                    }
-                                    nk_tree_element_pop(ctx);
-                                }
-                            }
-                            // Add this directory's file contents
-                            for (int j = 0; j < contents.dirs[i]->number_files; j++) {
-                                nk_selectable_label(ctx, contents.dirs[i]->files[j].name, NK_TEXT_LEFT, &contents.dirs[i]->files[j].selected);
-                            }
-
-                            nk_tree_element_pop(ctx);
-                        }
-                    }
-                }
-                // See if there are any files to add to the tree
-                if (contents.number_files > 0) {
-                    for (int i = 0; i < contents.number_files; i++) {
-                        nk_selectable_label(ctx, contents.files[i].name, NK_TEXT_LEFT, &contents.files[i].selected);
-                    }
-                }
-
-                // Work out which tree item, if any, has been selected
-                check_selected_tree_item(&contents);
-
-                // Check any level 1 directories to see if their files are selected
-                for (int i = 0; i < contents.number_directories; i++) {
-                    check_selected_tree_item(contents.dirs[i]);
-
-                    // Check any level 2 directories to see if their files are selected
-                    for (int j = 0; j < contents.dirs[i]->number_directories; j++) {
-                        check_selected_tree_item(contents.dirs[i]->dirs[j]);
-
-                        // Check any level 3 directories to see if their files are selected
-                        for (int k = 0; k < contents.dirs[i]->dirs[j]->number_directories; k++) {
-                            check_selected_tree_item(contents.dirs[i]->dirs[j]->dirs[k]);
-
-                            // Check any level 4 directories to see if their files are selected
-                            for (int l = 0; l < contents.dirs[i]->dirs[j]->dirs[k]->number_directories; l++) {
-                                check_selected_tree_item(contents.dirs[i]->dirs[j]->dirs[k]->dirs[l]);
-
-                                // Check any level 5 directories to see if their files are selected
-                                for (int m = 0; m < contents.dirs[i]->dirs[j]->dirs[k]->dirs[l]->number_directories; m++) {
-                                    check_selected_tree_item(contents.dirs[i]->dirs[j]->dirs[k]->dirs[l]->dirs[m]);
-                                }
-                            }
-                        }
-                    }
-                }
-
-                nk_tree_pop(ctx);
-            }
-
-            nk_group_end(ctx);
-        }
+        draw_project_tree(ctx);
 
         // BuildUp markdown editor text field
         nk_layout_row_push(ctx, 0.4f);
-        tedit_state.single_line = 0;
-        nk_edit_buffer(ctx, NK_EDIT_FIELD|NK_EDIT_MULTILINE|NK_EDIT_CLIPBOARD, &tedit_state, nk_filter_default);
+        editor_draw(ctx, &md_editor);
+
+        // Long documents are highlighted a slice at a time, so come back for another frame until it is done
+        if (md_editor.style != NULL && highlight_update(&md_highlight, &md_editor))
+            wakeup_signal();
 
         // Output HTML
         nk_layout_row_push(ctx, 0.4f);
         if (html_preview != NULL)
-            nk_edit_string_zero_terminated(ctx, NK_EDIT_FIELD|NK_EDIT_MULTILINE|NK_EDIT_CLIPBOARD, html_preview, strlen(html_preview) + 1, nk_filter_default);
+            editor_draw(ctx, &html_view);
 
-        // Check to see if the text has changed
-        if (tedit_state.string.len != bu_state.prev_markdown_len) {
+        // Check the edit journal to see if the text has changed, even by an edit that kept its length
+        if (md_editor.version != bu_state.seen_version) {
             // Save the previous state
             bu_state.is_dirty = true;
-            bu_state.prev_markdown_len = tedit_state.string.len;
+            bu_state.dirty_path = selected_path;
+            bu_state.seen_version = md_editor.version;
+
+            // Render the preview once the typing settles down
+            if (selected_path != NULL && string_ends_with(selected_path, ".md"))
+                update_html_preview_after(PREVIEW_DEBOUNCE_MS);
         }
 
         // Show and handle the Open Project dialog
@@ -810,8 +995,23 @@ void ui_do(struct nk_context* ctx, int window_width, int window_height, int* run
                     show_open_project = nk_false;
                     nk_popup_close(ctx);
 
-                    // Get the sorted contents at the specified path
-                    contents = list_project_dir(file_path);
+                    // Save anything the previous project's index is missing before letting it go
+                    close_project();
+
+                    // Get the sorted contents at the specified path, and let go of the previous project's tree
+                    tree_arena new_arena = {0};
+                    contents = open_project(&new_arena, file_path);
+                    arena_free(&project_arena);
+                    project_arena = new_arena;
+
+                    // Nothing from the previous project can still be selected
+                    selected_path = NULL;
+                    bu_state.dirty_path = NULL;
+                    bu_state.is_dirty = false;
+
+                    // Flatten the tree for drawing, and keep it up to date with changes made outside of the editor
+                    tree_model_build(&project_tree, contents, NULL);
+                    project_watch_start(&project_arena, contents);
 
                     // Clear the markdown editor of the previous contents
                     clear_editor();
@@ -820,33 +1020,22 @@ void ui_do(struct nk_context* ctx, int window_width, int window_height, int* run
                     clear_html_preview();
 
                     // If the user gave an invalid directory, let them know
-                    if (contents.error == does_not_exist) {
+                    if (contents->error == does_not_exist) {
                         set_error_popup("The directory you selected does not exist.\nPlease try to open another directory.");
 
                         // printf("The directory you selected does not exist.\nPlease try to open another directory.\n");
                     }
-                    else if (contents.error == not_a_buildup_directory) {
+                    else if (contents->error == not_a_buildup_directory) {
                         set_error_popup("This directory either does not exist, or\ndoes not appear to be a valid BuildUp\ndirectory. Please try to open another\ndirectory.");
 
                         // printf("This directory either does not exist, or does not appear to be a valid BuildUp directory.\nPlease try to open another directory.\n");
                     }
-                    else if (contents.error == dir_structure_too_deep) {
-                        set_error_popup("The directory structure of the project is\ndeeper than 5 levels, and the listing\nwill be truncated.");
-
-                        // printf("The directory struucture of the project is deeper than 5 levels, and the listing will be truncated.\n");
-                    }
-                    else if (contents.error == general_error) {
+                    else if (contents->error == general_error) {
                         set_error_popup("A general error occurred when opening a\nproject directory. Please make sure that you\nhave permissions to read the directory.");
 
                         // printf("A general error occurred when opening a project directory. Please make sure that you have permissions to read the directory.\n");
                     }
-                    else if (contents.error == exceeded_max_dirs) {
-                        set_error_popup("There are too many directories on at least\none level of your project documentation\nstructure. Your listing is likely\ntruncated.");
-                    }
-                    else if (contents.error == exceeded_max_files) {
-                        set_error_popup("There are too many files on at least\none level of your project documentation\nstructure. Your listing is likely\ntruncated.");
-                    }
-                    else if (contents.number_files <= 0) {
+                    else if (contents->number_files <= 0) {
                         set_error_popup("No project files were found, please try\nto open another directory.");
 
                         // printf("No project files were found, please try to open another directory.\n");
@@ -964,6 +1153,103 @@ void ui_do(struct nk_context* ctx, int window_width, int window_height, int* run
         }
     }
 
+    /*
+     * Handle the export progress popup dialog.
+     */
+    if (export_dialog_active) {
+        // The position and size of the popup
+        struct nk_rect s = {(window_width / 2) - (320 / 2), (window_height / 2) - (180 / 2), 320, 180};
+
+        // Construct the popup
+        if (nk_popup_begin(ctx, NK_POPUP_STATIC, "Export", NK_WINDOW_TITLE, s)) {
+            int total = exporter.number_pages + exporter.number_assets;
+            int left = atomic_load(&exporter.pages_left) + atomic_load(&exporter.assets_left);
+
+            // Says how far along the export is, or how it went
+            nk_layout_row_dynamic(ctx, 25, 1);
+            if (exporter.number_pages == 0) {
+                nk_label(ctx, "There are no pages to export.", NK_TEXT_LEFT);
+            }
+            else if (export_running(&exporter)) {
+                nk_labelf(ctx, NK_TEXT_LEFT, "Exporting, %d of %d pages and images done...", total - left, total);
+            }
+            else {
+                nk_labelf(ctx, NK_TEXT_LEFT, "Wrote %d pages, %d up to date, %d failed, in %ld ms.", atomic_load(&exporter.pages_written), atomic_load(&exporter.pages_unchanged), atomic_load(&exporter.pages_failed), atomic_load(&exporter.elapsed));
+                nk_labelf(ctx, NK_TEXT_LEFT, "Copied %d images, linked %d, shrank %d, %d up to date, %d failed.", atomic_load(&exporter.assets_copied), atomic_load(&exporter.assets_linked), atomic_load(&exporter.assets_shrunk), atomic_load(&exporter.assets_unchanged), atomic_load(&exporter.assets_failed));
+            }
+
+            // The progress bar
+            nk_size done = total - left;
+            nk_layout_row_dynamic(ctx, 20, 1);
+            nk_progress(ctx, &done, total, NK_FIXED);
+
+            // The Cancel button while the export runs, and the OK button once it is done
+            nk_layout_row_dynamic(ctx, 25, 1);
+            if (nk_button_label(ctx, export_running(&exporter) ? "Cancel" : "OK")) {
+                export_cancel(&exporter);
+                export_dialog_active = false;
+                nk_popup_close(ctx);
+            }
+
+            nk_popup_end(ctx);
+        }
+        else {
+            export_dialog_active = false;
+        }
+    }
+
+    /*
+     * Handle the Find in Project popup dialog.
+     */
+    if (find_dialog_active) {
+        // The position and size of the popup
+        struct nk_rect s = {(window_width / 2) - (600 / 2), (window_height / 2) - (460 / 2), 600, 460};
+
+        // Construct the popup
+        if (nk_popup_begin(ctx, NK_POPUP_STATIC, "Find in Project", NK_WINDOW_TITLE, s)) {
+            // The text to find, which can be searched for by pressing Enter
+            nk_layout_row_dynamic(ctx, 25, 1);
+            nk_label(ctx, "Find", NK_TEXT_LEFT);
+            nk_layout_row_dynamic(ctx, 25, 1);
+            nk_flags find_events = nk_edit_string_zero_terminated(ctx, NK_EDIT_FIELD|NK_EDIT_SIG_ENTER, find_query, sizeof(find_query), nk_filter_default);
+
+            // The text to replace the matches with
+            nk_layout_row_dynamic(ctx, 25, 1);
+            nk_label(ctx, "Replace With", NK_TEXT_LEFT);
+            nk_layout_row_dynamic(ctx, 25, 1);
+            nk_edit_string_zero_terminated(ctx, NK_EDIT_FIELD, find_replacement, sizeof(find_replacement), nk_filter_default);
+
+            // The status of the search
+            nk_layout_row_dynamic(ctx, 25, 1);
+            draw_search_status(ctx);
+
+            // The matches found so far
+            nk_layout_row_dynamic(ctx, 230, 1);
+            if (draw_search_hits(ctx)) {
+                find_dialog_active = false;
+                nk_popup_close(ctx);
+            }
+
+            // Search, Replace All and Close buttons
+            nk_layout_row_dynamic(ctx, 25, 3);
+            if ((nk_button_label(ctx, "Search") || (find_events & NK_EDIT_COMMITED)) && contents != NULL) {
+                search_start(&searcher, contents, search_find, find_query, NULL, NULL);
+            }
+            if (nk_button_label(ctx, "Replace All") && contents != NULL) {
+                replace_in_project();
+            }
+            if (nk_button_label(ctx, "Close")) {
+                find_dialog_active = false;
+                nk_popup_close(ctx);
+            }
+
+            nk_popup_end(ctx);
+        }
+        else {
+            find_dialog_active = false;
+        }
+    }
+
     /*
      * Handle the step link page popup dialog.
      */
@@ -1055,7 +1341,7 @@ void ui_do(struct nk_context* ctx, int window_width, int window_height, int* run
                     // If there is an error message, we do not want to close this dialog
                     if (step_link_insert_msg[0] == '\0') {
                         // Insert the assembled tag at the current cursor location in the editor
-                        nk_textedit_text(&tedit_state, step_link_tag, strlen(step_link_tag));
+                        editor_insert(&md_editor, step_link_tag, strlen(step_link_tag));
 
                         // Re-render the HTML preview
                         update_html_preview();
@@ -1169,7 +1455,7 @@ void ui_do(struct nk_context* ctx, int window_width, int window_height, int* run
                         strcat(image_tag, ")");
 
                         // Insert the assembled tag at the current cursor location in the editor
-                        nk_textedit_text(&tedit_state, image_tag, strlen(image_tag));
+                        editor_insert(&md_editor, image_tag, strlen(image_tag));
 
                         // Re-render the HTML preview
                         update_html_preview();
@@ -1,5 +1,8 @@
+#include <fcntl.h>
+#include <stdint.h>
 #include <sys/time.h>
 #include <time.h>
+#include <unistd.h>
 
 /******************************************************************************
  * timestamp - Provides a timestamp that can be used for a timer.             *
@@ -18,25 +21,69 @@ static long timestamp(void)
     return (long)((long)tv.tv_sec * 1000 + (long)tv.tv_usec/1000);
 }
 
+int wakeup_fds[2] = {-1, -1};  // Pipe that background threads write to so the UI loop wakes up
+
+/******************************************************************************
+ * wakeup_init -- Creates the pipe that lets background threads wake up the   *
+ *                UI loop while it is sleeping in poll().                     *
+ *                                                                            *
+ * Parameters                                                                 *
+ *      None                                                                  *
+ *                                                                            *
+ * Returns                                                                    *
+ *      The file descriptor for the UI loop to poll, or -1 on failure.        *
+ *****************************************************************************/
+static int wakeup_init(void)
+{
+    if (pipe(wakeup_fds) != 0) {
+        printf("Unable to create the wakeup pipe.\n");
+        wakeup_fds[0] = wakeup_fds[1] = -1;
+        return -1;
+    }
+
+    // Neither end may ever block, a full pipe already means a wakeup is pending
+    for (int i = 0; i < 2; i++) {
+        fcntl(wakeup_fds[i], F_SETFL, fcntl(wakeup_fds[i], F_GETFL) | O_NONBLOCK);
+        fcntl(wakeup_fds[i], F_SETFD, FD_CLOEXEC);
+    }
+
+    return wakeup_fds[0];
+}
+
+/******************************************************************************
+ * wakeup_signal -- Wakes up the UI loop so that it picks up finished work.   *
+ *                  Safe to call from any thread.                             *
+ *                                                                            *
+ * Parameters                                                                 *
+ *      None                                                                  *
+ *                                                                            *
+ * Returns                                                                    *
+ *      Nothing                                                               *
+ *****************************************************************************/
+static void wakeup_signal(void)
+{
+    if (wakeup_fds[1] < 0) return;
+
+    char byte = 1;
+    ssize_t written = write(wakeup_fds[1], &byte, 1);
+    (void)written;
+}
+
 /******************************************************************************
- * sleep_for -- Adds a delay into the UI loop of Nuklear to keep from maxing  *
- *              out the CPU.                                                  *
+ * wakeup_drain -- Empties the wakeup pipe once the UI loop has woken up.     *
  *                                                                            *
  * Parameters                                                                 *
- *      t -- A long integer representing the number of milliseconds to sleep  *
- *          for.                                                              *
+ *      None                                                                  *
  *                                                                            *
  * Returns                                                                    *
  *      Nothing                                                               *
  *****************************************************************************/
-static void sleep_for(long t)
+static void wakeup_drain(void)
 {
-    struct timespec req;
-    const time_t sec = (int)(t/1000);
-    const long ms = t - (sec * 1000);
-    req.tv_sec = sec;
-    req.tv_nsec = ms * 1000000L;
-    while(-1 == nanosleep(&req, &req));
+    if (wakeup_fds[0] < 0) return;
+
+    char buffer[64];
+    while (read(wakeup_fds[0], buffer, sizeof(buffer)) > 0);
 }
 
 /******************************************************************************
@@ -196,3 +243,222 @@ size_t str_size(const char* string) {
 
     return sz;
 }
+
+/*
+ * Growable byte buffer that tracks its own length so that appends do not
+ * have to rescan the string. The data is always kept null terminated.
+ */
+typedef struct string_buffer string_buffer;
+struct string_buffer {
+    char* data;  // The bytes held by the buffer, null terminated
+    size_t len;  // The number of bytes in use, not counting the null zero
+    size_t cap;  // The number of bytes allocated for data
+};
+
+/******************************************************************************
+ * str_buf_init -- Sets a string buffer up in its empty state.                *
+ *                                                                            *
+ * Parameters                                                                 *
+ *      buf -- The string buffer to initialize.                               *
+ *                                                                            *
+ * Returns                                                                    *
+ *      Nothing                                                               *
+ *****************************************************************************/
+void str_buf_init(string_buffer* buf) {
+    buf->data = NULL;
+    buf->len = 0;
+    buf->cap = 0;
+}
+
+/******************************************************************************
+ * str_buf_reserve -- Makes sure that the buffer has room for at least the    *
+ *                    given number of additional bytes plus the null zero.    *
+ *                    The allocation grows geometrically so that a series of  *
+ *                    appends costs linear time overall.                      *
+ *                                                                            *
+ * Parameters                                                                 *
+ *      buf -- The string buffer to grow.                                     *
+ *      extra -- The number of bytes that are about to be appended.           *
+ *                                                                            *
+ * Returns                                                                    *
+ *      Nothing                                                               *
+ *****************************************************************************/
+void str_buf_reserve(string_buffer* buf, size_t extra) {
+    size_t needed = buf->len + extra + 1;
+
+    // Nothing to do if the current allocation is already big enough
+    if (needed <= buf->cap)
+        return;
+
+    // Double the capacity until the requested size fits
+    size_t new_cap = buf->cap < 64 ? 64 : buf->cap;
+    while (new_cap < needed)
+        new_cap *= 2;
+
+    char* new_data = realloc(buf->data, new_cap);
+    if (new_data == NULL) {
+        printf("Unable to grow a string buffer to %zu bytes.\n", new_cap);
+        exit(EXIT_FAILURE);
+    }
+
+    buf->data = new_data;
+    buf->cap = new_cap;
+}
+
+/******************************************************************************
+ * str_buf_append -- Adds a span of bytes to the end of the buffer.           *
+ *                                                                            *
+ * Parameters                                                                 *
+ *      buf -- The string buffer to append to.                                *
+ *      text -- Pointer to the first byte to append.                          *
+ *      size -- The number of bytes to append.                                *
+ *                                                                            *
+ * Returns                                                                    *
+ *      Nothing                                                               *
+ *****************************************************************************/
+void str_buf_append(string_buffer* buf, const char* text, size_t size) {
+    str_buf_reserve(buf, size);
+
+    if (size > 0)
+        memcpy(buf->data + buf->len, text, size);
+    buf->len += size;
+    buf->data[buf->len] = '\0';
+}
+
+/******************************************************************************
+ * str_buf_append_str -- Adds a null terminated string to the buffer.         *
+ *                                                                            *
+ * Parameters                                                                 *
+ *      buf -- The string buffer to append to.                                *
+ *      text -- The null terminated string to append.                         *
+ *                                                                            *
+ * Returns                                                                    *
+ *      Nothing                                                               *
+ *****************************************************************************/
+void str_buf_append_str(string_buffer* buf, const char* text) {
+    str_buf_append(buf, text, strlen(text));
+}
+
+/******************************************************************************
+ * str_buf_append_char -- Adds a single character to the buffer.              *
+ *                                                                            *
+ * Parameters                                                                 *
+ *      buf -- The string buffer to append to.                                *
+ *      c -- The character to append.                                         *
+ *                                                                            *
+ * Returns                                                                    *
+ *      Nothing                                                               *
+ *****************************************************************************/
+void str_buf_append_char(string_buffer* buf, char c) {
+    str_buf_append(buf, &c, 1);
+}
+
+/******************************************************************************
+ * str_buf_reset -- Empties the buffer but keeps its memory so that it can be *
+ *                  filled again without allocating.                          *
+ *                                                                            *
+ * Parameters                                                                 *
+ *      buf -- The string buffer to empty.                                    *
+ *                                                                            *
+ * Returns                                                                    *
+ *      Nothing                                                               *
+ *****************************************************************************/
+void str_buf_reset(string_buffer* buf) {
+    buf->len = 0;
+    if (buf->data != NULL)
+        buf->data[0] = '\0';
+}
+
+/******************************************************************************
+ * str_buf_detach -- Hands the buffer's memory over to the caller and leaves  *
+ *                   the buffer empty.                                        *
+ *                                                                            *
+ * Parameters                                                                 *
+ *      buf -- The string buffer to take the data from.                       *
+ *                                                                            *
+ * Returns                                                                    *
+ *      A null terminated string that the caller is responsible for freeing.  *
+ *****************************************************************************/
+char* str_buf_detach(string_buffer* buf) {
+    // Make sure that an empty buffer still gives back a valid string
+    str_buf_reserve(buf, 0);
+    buf->data[buf->len] = '\0';
+
+    char* data = buf->data;
+    str_buf_init(buf);
+
+    return data;
+}
+
+/******************************************************************************
+ * str_buf_free -- Releases the memory held by the buffer.                    *
+ *                                                                            *
+ * Parameters                                                                 *
+ *      buf -- The string buffer to free.                                     *
+ *                                                                            *
+ * Returns                                                                    *
+ *      Nothing                                                               *
+ *****************************************************************************/
+void str_buf_free(string_buffer* buf) {
+    free(buf->data);
+    str_buf_init(buf);
+}
+
+/******************************************************************************
+ * span_find -- Searches a span of bytes that is not necessarily null         *
+ *              terminated for the first occurrence of a needle string.       *
+ *                                                                            *
+ * Parameters                                                                 *
+ *      text -- Pointer to the start of the span to search.                   *
+ *      len -- The number of bytes in the span.                               *
+ *      needle -- The null terminated string to search for.                   *
+ *                                                                            *
+ * Returns                                                                    *
+ *      A pointer to the first match inside of the span, or NULL if the       *
+ *      needle does not appear in the span.                                   *
+ *****************************************************************************/
+const char* span_find(const char* text, size_t len, const char* needle) {
+    size_t needle_len = strlen(needle);
+    const char* end = text + len;
+
+    // An empty needle matches at the start
+    if (needle_len == 0)
+        return text;
+
+    // Jump between candidate first characters and only compare the rest there
+    while ((size_t)(end - text) >= needle_len) {
+        const char* candidate = memchr(text, needle[0], (end - text) - needle_len + 1);
+        if (candidate == NULL)
+            return NULL;
+
+        if (memcmp(candidate, needle, needle_len) == 0)
+            return candidate;
+
+        text = candidate + 1;
+    }
+
+    return NULL;
+}
+
+/******************************************************************************
+ * hash_bytes -- Computes a 64-bit FNV-1a hash of a span of bytes. Used to    *
+ *               key caches and to detect when content has changed.           *
+ *                                                                            *
+ * Parameters                                                                 *
+ *      data -- Pointer to the first byte to hash.                            *
+ *      len -- The number of bytes to hash.                                   *
+ *                                                                            *
+ * Returns                                                                    *
+ *      The 64-bit hash of the bytes.                                         *
+ *****************************************************************************/
+uint64_t hash_bytes(const void* data, size_t len) {
+    const unsigned char* bytes = data;
+    uint64_t hash = 14695981039346656037ULL;
+
+    for (size_t i = 0; i < len; i++) {
+        hash ^= bytes[i];
+        hash *= 1099511628211ULL;
+    }
+
+    return hash;
+}
@@ -0,0 +1,514 @@
+/******************************************************************************
+ * bue_watch -- Watches the open project for files that are added, removed or *
+ *              changed outside of the editor, and applies the changes to the *
+ *              project tree and the caches that depend on the files.         *
+ *                                                                            *
+ * Author: 7B Industries                                                      *
+ * License: Apache 2.0                                                        *
+ *                                                                            *
+ * ***************************************************************************/
+
+#ifdef __linux__
+    #include <sys/inotify.h>
+#endif
+
+// Flags returned by project_watch_poll to say what changed
+enum watch_changes {watch_no_change = 0, watch_tree_changed = 1, watch_pages_changed = 2, watch_overflow = 4};
+
+typedef struct project_watch project_watch;
+struct project_watch {
+    int fd;  // The inotify instance, -1 when nothing is being watched
+    tree_arena* arena;  // The arena that the watched tree lives in
+    dir_contents* root;  // The root of the watched project tree
+    dir_contents** dirs;  // The watched directories, indexed by watch descriptor
+    int dirs_capacity;
+    uint32_t moved_cookie;  // Pairs up the two halves of a rename of the tracked file
+    bool tracked_moved;  // Whether or not the tracked file was just renamed away
+};
+
+project_watch project_watcher = {.fd = -1};
+
+/******************************************************************************
+ * find_dir_entry -- Looks for a subdirectory in a sorted directory node.     *
+ *                                                                            *
+ * Parameters                                                                 *
+ *      dir -- The directory to search.                                       *
+ *      name -- The name of the subdirectory.                                 *
+ *      found -- Set to whether or not the subdirectory is in the directory.  *
+ *                                                                            *
+ * Returns                                                                    *
+ *      The index of the subdirectory, or where it would be inserted.         *
+ *****************************************************************************/
+int find_dir_entry(dir_contents* dir, const char* name, bool* found) {
+    int low = 0;
+    int high = dir->number_directories;
+
+    while (low < high) {
+        int mid = (low + high) / 2;
+        int cmp = strcmp(dir->dirs[mid]->name, name);
+        if (cmp == 0) {
+            *found = true;
+            return mid;
+        }
+        if (cmp < 0) low = mid + 1;
+        else high = mid;
+    }
+
+    *found = false;
+    return low;
+}
+
+/******************************************************************************
+ * find_file_entry -- Looks for a file in a sorted directory node.            *
+ *                                                                            *
+ * Parameters                                                                 *
+ *      dir -- The directory to search.                                       *
+ *      name -- The name of the file.                                         *
+ *      found -- Set to whether or not the file is in the directory.          *
+ *                                                                            *
+ * Returns                                                                    *
+ *      The index of the file, or where it would be inserted.                 *
+ *****************************************************************************/
+int find_file_entry(dir_contents* dir, const char* name, bool* found) {
+    int low = 0;
+    int high = dir->number_files;
+
+    while (low < high) {
+        int mid = (low + high) / 2;
+        int cmp = strcmp(dir->files[mid].name, name);
+        if (cmp == 0) {
+            *found = true;
+            return mid;
+        }
+        if (cmp < 0) low = mid + 1;
+        else high = mid;
+    }
+
+    *found = false;
+    return low;
+}
+
+/******************************************************************************
+ * refresh_page -- Brings the title cache and link graph up to date with a    *
+ *                 page that was added or changed.                            *
+ *                                                                            *
+ * Parameters                                                                 *
+ *      path -- The path to the page.                                         *
+ *                                                                            *
+ * Returns                                                                    *
+ *      Nothing                                                               *
+ *****************************************************************************/
+void refresh_page(const char* path) {
+    title_cache_invalidate(path);
+
+    string_buffer md;
+    str_buf_init(&md);
+    if (read_whole_file(path, &md))
+        link_graph_update_page(path, md.data, md.len);
+    str_buf_free(&md);
+}
+
+/******************************************************************************
+ * forget_page_tree -- Drops the cached titles and links of every file in a   *
+ *                     directory that was removed, and stops watching it.     *
+ *                                                                            *
+ * Parameters                                                                 *
+ *      watch -- The project watch.                                           *
+ *      dir -- The directory that was removed.                                *
+ *                                                                            *
+ * Returns                                                                    *
+ *      Nothing                                                               *
+ *****************************************************************************/
+void forget_page_tree(project_watch* watch, dir_contents* dir) {
+    for (int i = 0; i < dir->number_files; i++) {
+        title_cache_invalidate(dir->files[i].path);
+        link_graph_remove_page(dir->files[i].path);
+    }
+
+    for (int i = 0; i < dir->number_directories; i++)
+        forget_page_tree(watch, dir->dirs[i]);
+
+#ifdef __linux__
+    if (dir->watch > 0) {
+        inotify_rm_watch(watch->fd, dir->watch);
+        if (dir->watch < watch->dirs_capacity)
+            watch->dirs[dir->watch] = NULL;
+        dir->watch = 0;
+    }
+#endif
+}
+
+#ifdef __linux__
+
+// The changes that are watched for in each project directory
+#define WATCH_MASK (IN_CREATE | IN_DELETE | IN_MOVED_FROM | IN_MOVED_TO | IN_CLOSE_WRITE | IN_ONLYDIR)
+
+/******************************************************************************
+ * watch_dir -- Starts watching a directory of the project.                   *
+ *                                                                            *
+ * Parameters                                                                 *
+ *      watch -- The project watch.                                           *
+ *      dir -- The directory to watch.                                        *
+ *                                                                            *
+ * Returns                                                                    *
+ *      Nothing                                                               *
+ *****************************************************************************/
+void watch_dir(project_watch* watch, dir_contents* dir) {
+    int wd = inotify_add_watch(watch->fd, dir->path, WATCH_MASK);
+    if (wd < 0) {
+        // A directory that is already gone again will show up as removed anyway
+        if (errno != ENOENT)
+            printf("Unable to watch %s for changes: %s.\n", dir->path, strerror(errno));
+        return;
+    }
+
+    if (wd >= watch->dirs_capacity) {
+        int new_capacity = watch->dirs_capacity == 0 ? 256 : watch->dirs_capacity;
+        while (wd >= new_capacity)
+            new_capacity *= 2;
+        watch->dirs = realloc(watch->dirs, new_capacity * sizeof(dir_contents*));
+        memset(watch->dirs + watch->dirs_capacity, 0, (new_capacity - watch->dirs_capacity) * sizeof(dir_contents*));
+        watch->dirs_capacity = new_capacity;
+    }
+
+    watch->dirs[wd] = dir;
+    dir->watch = wd;
+}
+
+/******************************************************************************
+ * watch_tree -- Starts watching a directory and everything below it.         *
+ *                                                                            *
+ * Parameters                                                                 *
+ *      watch -- The project watch.                                           *
+ *      dir -- The directory at the top of the tree to watch.                 *
+ *                                                                            *
+ * Returns                                                                    *
+ *      Nothing                                                               *
+ *****************************************************************************/
+void watch_tree(project_watch* watch, dir_contents* dir) {
+    watch_dir(watch, dir);
+
+    for (int i = 0; i < dir->number_directories; i++)
+        watch_tree(watch, dir->dirs[i]);
+}
+
+/******************************************************************************
+ * project_watch_stop -- Stops watching the project for changes.              *
+ *                                                                            *
+ * Parameters                                                                 *
+ *      None                                                                  *
+ *                                                                            *
+ * Returns                                                                    *
+ *      Nothing                                                               *
+ *****************************************************************************/
+void project_watch_stop() {
+    project_watch* watch = &project_watcher;
+
+    // Closing the instance drops all of its watches at once
+    if (watch->fd >= 0)
+        close(watch->fd);
+
+    free(watch->dirs);
+    memset(watch, 0, sizeof(project_watch));
+    watch->fd = -1;
+}
+
+/******************************************************************************
+ * project_watch_start -- Starts watching every directory of a newly opened   *
+ *                        project for changes.                                *
+ *                                                                            *
+ * Parameters                                                                 *
+ *      arena -- The arena that the project tree lives in.                    *
+ *      root -- The root of the project tree.                                 *
+ *                                                                            *
+ * Returns                                                                    *
+ *      A boolean specifying whether or not the project is being watched.     *
+ *****************************************************************************/
+bool project_watch_start(tree_arena* arena, dir_contents* root) {
+    project_watch* watch = &project_watcher;
+
+    project_watch_stop();
+
+    watch->fd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+    if (watch->fd < 0) {
+        printf("Unable to watch the project for changes: %s.\n", strerror(errno));
+        return false;
+    }
+
+    watch->arena = arena;
+    watch->root = root;
+    watch_tree(watch, root);
+
+    return true;
+}
+
+/******************************************************************************
+ * watch_add_dir -- Adds a directory that was created in, or moved into, the  *
+ *                  project, along with everything already inside of it.      *
+ *                                                                            *
+ * Parameters                                                                 *
+ *      watch -- The project watch.                                           *
+ *      parent -- The directory that the new directory is in.                 *
+ *      name -- The name of the new directory.                                *
+ *                                                                            *
+ * Returns                                                                    *
+ *      Nothing                                                               *
+ *****************************************************************************/
+void watch_add_dir(project_watch* watch, dir_contents* parent, const char* name) {
+    bool found;
+    int at = find_dir_entry(parent, name, &found);
+    if (found)
+        return;
+
+    string_buffer path;
+    str_buf_init(&path);
+    str_buf_append_str(&path, parent->path);
+    str_buf_append_str(&path, PATH_SEP);
+    str_buf_append_str(&path, name);
+    dir_contents* dir = new_dir_node(watch->arena, parent, name, path.data);
+    str_buf_free(&path);
+
+    // Slot the directory into its sorted place
+    add_dir_entry(watch->arena, parent, dir);
+    memmove(&parent->dirs[at + 1], &parent->dirs[at], (parent->number_directories - 1 - at) * sizeof(dir_contents*));
+    parent->dirs[at] = dir;
+
+    // Watch each directory before listing it so that nothing added in between is missed
+    int stack_size = 0;
+    int stack_capacity = 16;
+    dir_contents** stack = malloc(stack_capacity * sizeof(dir_contents*));
+    stack[stack_size++] = dir;
+
+    while (stack_size > 0) {
+        dir_contents* next = stack[--stack_size];
+        watch_dir(watch, next);
+
+        DIR* open_dir = opendir(next->path);
+        if (open_dir == NULL)
+            continue;
+        list_dir_contents(watch->arena, next, open_dir, true);
+        closedir(open_dir);
+
+        // A step link to one of these pages may have been rendered while it was missing
+        for (int i = 0; i < next->number_files; i++)
+            title_cache_invalidate(next->files[i].path);
+
+        if (stack_size + next->number_directories > stack_capacity) {
+            while (stack_size + next->number_directories > stack_capacity)
+                stack_capacity *= 2;
+            stack = realloc(stack, stack_capacity * sizeof(dir_contents*));
+        }
+        for (int i = 0; i < next->number_directories; i++)
+            stack[stack_size++] = next->dirs[i];
+    }
+
+    free(stack);
+
+    // Pick up the links in any pages that came along with the directory
+    link_graph_add_dir(&project_links, dir);
+}
+
+/******************************************************************************
+ * watch_remove_dir -- Removes a directory that was deleted from, or moved    *
+ *                     out of, the project.                                   *
+ *                                                                            *
+ * Parameters                                                                 *
+ *      watch -- The project watch.                                           *
+ *      parent -- The directory that the removed directory was in.            *
+ *      name -- The name of the removed directory.                            *
+ *                                                                            *
+ * Returns                                                                    *
+ *      Nothing                                                               *
+ *****************************************************************************/
+void watch_remove_dir(project_watch* watch, dir_contents* parent, const char* name) {
+    bool found;
+    int at = find_dir_entry(parent, name, &found);
+    if (!found)
+        return;
+
+    // The node's memory stays in the arena, so paths that still point into it remain valid
+    forget_page_tree(watch, parent->dirs[at]);
+    memmove(&parent->dirs[at], &parent->dirs[at + 1], (parent->number_directories - 1 - at) * sizeof(dir_contents*));
+    parent->number_directories--;
+}
+
+/******************************************************************************
+ * watch_add_file -- Adds a file that was created in, or moved into, the      *
+ *                   project. A page that was already listed is read again,   *
+ *                   since it was replaced.                                   *
+ *                                                                            *
+ * Parameters                                                                 *
+ *      watch -- The project watch.                                           *
+ *      parent -- The directory that the new file is in.                      *
+ *      name -- The name of the new file.                                     *
+ *                                                                            *
+ * Returns                                                                    *
+ *      The file entry, or NULL if it is not one that is listed.              *
+ *****************************************************************************/
+struct file_entry* watch_add_file(project_watch* watch, dir_contents* parent, const char* name) {
+    if (!is_listed_file(name))
+        return NULL;
+
+    bool found;
+    int at = find_file_entry(parent, name, &found);
+    if (found) {
+        // Saving through a temporary file renames it over the page, which is the only event the save makes
+        if (string_ends_with(name, ".md"))
+            refresh_page(parent->files[at].path);
+        return &parent->files[at];
+    }
+
+    // Slot the file into its sorted place
+    struct file_entry ent = *add_file_entry(watch->arena, parent, name);
+    memmove(&parent->files[at + 1], &parent->files[at], (parent->number_files - 1 - at) * sizeof(struct file_entry));
+    parent->files[at] = ent;
+
+    if (string_ends_with(name, ".md"))
+        refresh_page(ent.path);
+
+    return &parent->files[at];
+}
+
+/******************************************************************************
+ * watch_remove_file -- Removes a file that was deleted from, or moved out    *
+ *                      of, the project.                                      *
+ *                                                                            *
+ * Parameters                                                                 *
+ *      parent -- The directory that the removed file was in.                 *
+ *      name -- The name of the removed file.                                 *
+ *                                                                            *
+ * Returns                                                                    *
+ *      The path of the removed file, or NULL if it was not in the tree.      *
+ *****************************************************************************/
+char* watch_remove_file(dir_contents* parent, const char* name) {
+    bool found;
+    int at = find_file_entry(parent, name, &found);
+    if (!found)
+        return NULL;
+
+    char* path = parent->files[at].path;
+    title_cache_invalidate(path);
+    link_graph_remove_page(path);
+
+    memmove(&parent->files[at], &parent->files[at + 1], (parent->number_files - 1 - at) * sizeof(struct file_entry));
+    parent->number_files--;
+
+    return path;
+}
+
+/******************************************************************************
+ * project_watch_poll -- Applies any changes to the project files that have   *
+ *                       happened since the last call. Never blocks.          *
+ *                                                                            *
+ * Parameters                                                                 *
+ *      tracked_path -- Points to the path of a file that the caller is       *
+ *                      holding onto. If the file is renamed inside of the    *
+ *                      project, this is changed to the new path.             *
+ *                                                                            *
+ * Returns                                                                    *
+ *      The watch_changes flags for what changed. If watch_overflow is set,   *
+ *      changes were lost and the project needs to be listed again.           *
+ *****************************************************************************/
+int project_watch_poll(char** tracked_path) {
+    project_watch* watch = &project_watcher;
+    int changes = watch_no_change;
+
+    if (watch->fd < 0)
+        return changes;
+
+    _Alignas(struct inotify_event) char buffer[16384];
+
+    while (true) {
+        ssize_t len = read(watch->fd, buffer, sizeof(buffer));
+        if (len <= 0)
+            break;
+
+        for (char* pos = buffer; pos < buffer + len; ) {
+            const struct inotify_event* event = (const struct inotify_event*)pos;
+            pos += sizeof(struct inotify_event) + event->len;
+
+            if (event->mask & IN_Q_OVERFLOW) {
+                changes |= watch_overflow;
+                continue;
+            }
+
+            // Skip events for directories that are no longer in the tree, and for hidden files
+            if (event->wd <= 0 || event->wd >= watch->dirs_capacity || watch->dirs[event->wd] == NULL)
+                continue;
+            if (event->len == 0 || event->name[0] == '.')
+                continue;
+
+            dir_contents* parent = watch->dirs[event->wd];
+
+            if (event->mask & IN_ISDIR) {
+                // The export writes the site while the project is open, which is none of the tree's business
+                if (!is_listed_dir(parent, event->name))
+                    continue;
+
+                if (event->mask & (IN_CREATE | IN_MOVED_TO)) {
+                    watch_add_dir(watch, parent, event->name);
+                    changes |= watch_tree_changed | watch_pages_changed;
+                }
+                else if (event->mask & (IN_DELETE | IN_MOVED_FROM)) {
+                    watch_remove_dir(watch, parent, event->name);
+                    changes |= watch_tree_changed | watch_pages_changed;
+                }
+            }
+            else if (event->mask & (IN_CREATE | IN_MOVED_TO)) {
+                struct file_entry* ent = watch_add_file(watch, parent, event->name);
+                if (ent == NULL)
+                    continue;
+
+                // Follow the tracked file if this is the other half of its rename
+                if (watch->tracked_moved && (event->mask & IN_MOVED_TO) && event->cookie == watch->moved_cookie) {
+                    *tracked_path = ent->path;
+                    watch->tracked_moved = false;
+                }
+                changes |= watch_tree_changed | watch_pages_changed;
+            }
+            else if (event->mask & (IN_DELETE | IN_MOVED_FROM)) {
+                char* removed = watch_remove_file(parent, event->name);
+                if (removed == NULL)
+                    continue;
+
+                if (removed == *tracked_path && (event->mask & IN_MOVED_FROM)) {
+                    watch->moved_cookie = event->cookie;
+                    watch->tracked_moved = true;
+                }
+                changes |= watch_tree_changed | watch_pages_changed;
+            }
+            else if ((event->mask & IN_CLOSE_WRITE) && string_ends_with(event->name, ".md")) {
+                bool found;
+                int at = find_file_entry(parent, event->name, &found);
+                if (found) {
+                    refresh_page(parent->files[at].path);
+                    changes |= watch_pages_changed;
+                }
+            }
+        }
+    }
+
+    return changes;
+}
+
+#else
+
+/*
+ * File watching is only supported on Linux for now. Elsewhere the project
+ * tree is only updated when the project is opened again.
+ */
+bool project_watch_start(tree_arena* arena, dir_contents* root) {
+    (void)arena;
+    (void)root;
+    return false;
+}
+
+void project_watch_stop() {
+}
+
+int project_watch_poll(char** tracked_path) {
+    (void)tracked_path;
+    return watch_no_change;
+}
+
+#endif
@@ -11,6 +11,9 @@
  *      Run the binary without options to launch a GUI containing controls to *
  *      enter, convert and export your BuildUp documentation.                 *
  * ***************************************************************************/
+// Has the libc headers declare the Linux file calls, such as copy_file_range, as well as the POSIX ones
+#define _GNU_SOURCE
+
 /*#include <assert.h>*/
 #include <stdio.h>
 /*#include <stdlib.h>*/
@@ -20,6 +23,8 @@
 /*#include <math.h>*/
 /*#include <unistd.h>*/
 #include <stdbool.h>
+#include <errno.h>
+#include <poll.h>
 
 #define NK_INCLUDE_FIXED_TYPES
 #define NK_INCLUDE_STANDARD_IO
@@ -32,16 +37,24 @@
 #include "external/md4c.h"
 #include "external/md4c-html.h"
 #include "external/libclipboard.h"
+#define STBI_ONLY_JPEG
+#define STBI_ONLY_PNG
+#define STBI_NO_FAILURE_STRINGS
+#define STB_IMAGE_IMPLEMENTATION
+// stb_image is kept as it is upstream, so its warnings are left out of the build
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wmisleading-indentation"
+#pragma GCC diagnostic ignored "-Wshift-negative-value"
+#pragma GCC diagnostic ignored "-Wunused-function"
+#include "external/stb_image.h"
+#pragma GCC diagnostic pop
 
 #include "lib/bue_util.h"
 #include "lib/bue_ui.h"
 
-const int DTIME = 20;  // UI sleep threshold
 const int WINDOW_WIDTH = 800;  // Initial window width
 const int WINDOW_HEIGHT = 600;  // Initial window height
 
-long dt;  // Difference between the start of a timer and the current time
-long started;  // Milliseconds when the timer was started
 int running = 1;  // Setting to zero will shut down the app
 XWindow xw;  // Struct representing an XLib window
 XEvent evt;  // X11 event struct
@@ -69,14 +82,15 @@ int main(void)
     xw.cmap = XCreateColormap(xw.dpy,xw.root,xw.vis,AllocNone);
 
     xw.swa.colormap = xw.cmap;
+    xw.swa.background_pixmap = None;  // Everything is copied from the back buffer, so the server never has to clear
     xw.swa.event_mask =
         ExposureMask | KeyPressMask | KeyReleaseMask |
         ButtonPress | ButtonReleaseMask| ButtonMotionMask |
         Button1MotionMask | Button3MotionMask | Button4MotionMask | Button5MotionMask|
-        PointerMotionMask | KeymapStateMask;
+        PointerMotionMask | KeymapStateMask | StructureNotifyMask;
     xw.win = XCreateWindow(xw.dpy, xw.root, 0, 0, WINDOW_WIDTH, WINDOW_HEIGHT, 0,
         XDefaultDepth(xw.dpy, xw.screen), InputOutput,
-        xw.vis, CWEventMask | CWColormap, &xw.swa);
+        xw.vis, CWBackPixmap | CWEventMask | CWColormap, &xw.swa);
 
     XStoreName(xw.dpy, xw.win, "BuildUp Editor");
     XMapWindow(xw.dpy, xw.win);
@@ -89,39 +103,73 @@ int main(void)
     // Initialize the Nuklear GUI - encapsulated for use across OSes
     ctx = ui_init(xw);
 
+    // Background threads write to this pipe when they have something for the UI
+    int wakeup_fd = wakeup_init();
+    int x_fd = ConnectionNumber(xw.dpy);
+
+    // Nuklear settles some state, like hover and popups, a frame after the input
+    // that caused it, so each event is followed by a couple of frames
+    int frames_owed = 2;
+
     while (running)
     {
-        // Need the current size of the XWindow to scale the Nuklear window to it
-        XGetWindowAttributes(xw.dpy, xw.win, &xw.attr);
-        xw.width = (unsigned int)xw.attr.width;
-        xw.height = (unsigned int)xw.attr.height;
+        // Sleep until there is input, an expose or resize, or finished background work
+        if (frames_owed == 0 && XPending(xw.dpy) == 0) {
+            struct pollfd fds[3];
+            int number_fds = 0;
+            fds[number_fds++] = (struct pollfd){.fd = x_fd, .events = POLLIN};
+            if (wakeup_fd >= 0)
+                fds[number_fds++] = (struct pollfd){.fd = wakeup_fd, .events = POLLIN};
+            if (project_watcher.fd >= 0)
+                fds[number_fds++] = (struct pollfd){.fd = project_watcher.fd, .events = POLLIN};
+
+            if (poll(fds, number_fds, -1) < 0 && errno != EINTR)
+                die("Unable to wait for events: %s", strerror(errno));
+
+            // Anything other than X traffic is picked up by ui_do, so it needs a frame
+            for (int i = 1; i < number_fds; i++) {
+                if (fds[i].revents != 0)
+                    frames_owed = 1;
+            }
+            wakeup_drain();
+        }
 
         // Input
-        started = timestamp();
         nk_input_begin(ctx);
         while (XPending(xw.dpy)) {
             XNextEvent(xw.dpy, &evt);
             if (evt.type == ClientMessage) goto cleanup;
             if (XFilterEvent(&evt, xw.win)) continue;
+
+            // Keep track of the size here rather than asking the server every frame
+            if (evt.type == ConfigureNotify) {
+                xw.width = (unsigned int)evt.xconfigure.width;
+                xw.height = (unsigned int)evt.xconfigure.height;
+            }
+
             nk_xlib_handle_event(xw.dpy, xw.screen, xw.win, &evt);
+            frames_owed = 2;
         }
         nk_input_end(ctx);
 
+        // Nothing happened that could change what is on the screen
+        if (frames_owed == 0)
+            continue;
+        frames_owed--;
+
         // Render the Nuklear UI
-        ui_do(ctx, xw.attr.width, xw.attr.height, &running);
+        ui_do(ctx, (int)xw.width, (int)xw.height, &running);
 
-        // Draw
-        XClearWindow(xw.dpy, xw.win);
+        // Draw, only copying the parts of the back buffer that changed
         nk_xlib_render(xw.win, nk_rgb(30,30,30));
         XFlush(xw.dpy);
-
-        // Timing
-        dt = timestamp() - started;
-        if (dt < DTIME)
-            sleep_for(DTIME - dt);
     }
 
 cleanup:
+    preview_worker_stop();
+    search_stop(&searcher);
+    export_stop(&exporter);
+    close_project();
     nk_xfont_del(xw.dpy, xw.font);
     nk_xlib_shutdown();
     XUnmapWindow(xw.dpy, xw.win);